@@ -46,6 +46,12 @@ SPINLOCK_INLINE
 spinlock_data_t spinlock_data_get(volatile spinlock_data_t *sd);
 SPINLOCK_INLINE
 spinlock_data_t spinlock_data_testandset(volatile spinlock_data_t *sd);
+SPINLOCK_INLINE
+spinlock_data_t spinlock_data_fetchadd(volatile spinlock_data_t *sd,
+				       unsigned val);
+SPINLOCK_INLINE
+bool spinlock_data_cas(volatile spinlock_data_t *sd,
+		       spinlock_data_t oldval, spinlock_data_t newval);
 
 ////////////////////////////////////////////////////////////
 
@@ -118,5 +124,63 @@ spinlock_data_testandset(volatile spinlock_data_t *sd)
 	return x;
 }
 
+/*
+ * Atomically add VAL to a spinlock_data_t and return the old value.
+ * This also uses LL/SC (see above), retrying until the SC succeeds.
+ */
+SPINLOCK_INLINE
+spinlock_data_t
+spinlock_data_fetchadd(volatile spinlock_data_t *sd, unsigned val)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%3);"		/*   x = *sd */
+			"addu %1, %0, %2;"	/*   y = x + val */
+			"sc %1, 0(%3);"		/*   *sd = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y) : "r" (val), "r" (sd));
+	} while (y == 0);
+	return x;
+}
+
+
+/*
+ * Compare-and-swap a spinlock_data_t: if it contains OLDVAL, replace
+ * it with NEWVAL and return true; otherwise leave it alone and return
+ * false. Again LL/SC; a spurious SC failure is retried, so false
+ * always means the value really was different.
+ */
+SPINLOCK_INLINE
+bool
+spinlock_data_cas(volatile spinlock_data_t *sd,
+		  spinlock_data_t oldval, spinlock_data_t newval)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	do {
+		y = 0;
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *sd */
+			"bne %0, %3, 1f;"	/*   if (x != oldval) give up */
+			"move %1, %4;"		/*   y = newval */
+			"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+			"1:"
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "+r" (y)
+			: "r" (sd), "r" (oldval), "r" (newval));
+	} while (x == oldval && y == 0);
+	return x == oldval;
+}
+
 
 #endif /* _MIPS_SPINLOCK_H_ */
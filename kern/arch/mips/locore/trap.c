@@ -39,6 +39,7 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
+#include <acct.h>
 
 
 /* in exception-*.S */
@@ -128,6 +129,7 @@ mips_trap(struct trapframe *tf)
 	uint32_t code;
 	/*bool isutlb; -- not used */
 	bool iskern;
+	bool fastsys, charge;
 	int spl;
 
 	/* The trap frame is supposed to be 35 registers long. */
@@ -149,6 +151,13 @@ mips_trap(struct trapframe *tf)
 						+ STACK_SIZE));
 	}
 
+	/* Coming from user mode, the time since is user time. */
+	fastsys = code == EX_SYS && syscall_isfast(tf->tf_v0);
+	charge = !iskern;
+	if (charge) {
+		acct_kernelentry();
+	}
+
 	/* Interrupt? Call the interrupt handler and return. */
 	if (code == EX_IRQ) {
 		int old_in;
@@ -185,6 +194,9 @@ mips_trap(struct trapframe *tf)
 			doadjust = false;
 		}
 
+		/* Tell the profiler (via hardclock) where we were. */
+		curcpu->c_intrpc = tf->tf_epc;
+
 		mainbus_interrupt(tf);
 
 		if (doadjust) {
@@ -221,7 +233,12 @@ mips_trap(struct trapframe *tf)
 		DEBUG(DB_SYSCALL, "syscall: #%d, args %x %x %x %x\n",
 		      tf->tf_v0, tf->tf_a0, tf->tf_a1, tf->tf_a2, tf->tf_a3);
 
-		syscall(tf);
+		if (fastsys) {
+			syscall_fast(tf);
+		}
+		else {
+			syscall(tf);
+		}
 		goto done;
 	}
 
@@ -332,6 +349,11 @@ mips_trap(struct trapframe *tf)
 		return;
 	}
 
+	/* Going back to user mode; the time since entry is system time. */
+	if (charge) {
+		acct_kernelexit();
+	}
+
 	cputhreads[curcpu->c_number] = (vaddr_t)curthread;
 	cpustacks[curcpu->c_number] = (vaddr_t)curthread->t_stack + STACK_SIZE;
 
@@ -377,6 +399,8 @@ mips_usermode(struct trapframe *tf)
 	spl0();
 	cpu_irqoff();
 
+	acct_kernelexit();
+
 	cputhreads[curcpu->c_number] = (vaddr_t)curthread;
 	cpustacks[curcpu->c_number] = (vaddr_t)curthread->t_stack + STACK_SIZE;
 
@@ -31,11 +31,15 @@
 #include <kern/errno.h>
 #include <kern/syscall.h>
 #include <lib.h>
+#include <copyinout.h>
 #include <mips/trapframe.h>
 #include <thread.h>
 #include <current.h>
+#include <counter.h>
+#include <trace.h>
 #include <syscall.h>
 
+static struct counter syscall_counter = COUNTER_INITIALIZER("syscalls");
 
 /*
  * System call dispatcher.
@@ -74,50 +78,271 @@
  * values) further arguments must be fetched from the user-level
  * stack, starting at sp+16 to skip over the slots for the
  * registerized values, with copyin().
+ *
+ * All of this is done here, driven by the table below, so each call
+ * only says how many arguments it has and which are 64-bit.
  */
-void
-syscall(struct trapframe *tf)
+
+/*
+ * One argument, as fetched by the dispatcher. A 64-bit argument
+ * takes up an aligned pair of words, high word first (we're
+ * big-endian), but only one of these.
+ */
+union sysarg {
+	int32_t sa_int;
+	uint32_t sa_uint;
+	userptr_t sa_ptr;
+	int64_t sa_64;
+};
+
+/* Most arguments any call takes, and most words they can fill */
+#define SYS_MAXARGS	6
+#define SYS_MAXWORDS	8
+
+/*
+ * The system call table. For each call: its name, the glue function
+ * that passes the arguments on to the sys_* function, how many
+ * arguments there are, which of them are 64-bit (a bitmask), flags,
+ * and a counter of how many times it has been called. Calls with no
+ * entry get ENOSYS.
+ *
+ * SYF_FAST marks calls that mips_trap sends to syscall_fast. They
+ * may only take 32-bit arguments in registers and must not touch
+ * user memory, so syscall_fast can skip the argument fetch.
+ */
+#define SYF_FAST	0x1
+
+struct sysent {
+	const char *sy_name;
+	int (*sy_call)(struct trapframe *tf, const union sysarg *a,
+		       int32_t *retval);
+	unsigned sy_nargs;
+	unsigned sy_args64;
+	unsigned sy_flags;
+	struct counter sy_counter;
+};
+
+/*
+ * Glue functions. Not every call needs every parameter.
+ */
+#define SYSGLUE(name) \
+	static int sc_##name(struct trapframe *tf __UNUSED, \
+			     const union sysarg *a __UNUSED, \
+			     int32_t *retval __UNUSED)
+
+SYSGLUE(reboot)
 {
-	int callno;
-	int32_t retval;
-	int err;
+	return sys_reboot(a[0].sa_int);
+}
 
-	KASSERT(curthread != NULL);
-	KASSERT(curthread->t_curspl == 0);
-	KASSERT(curthread->t_iplhigh_count == 0);
+SYSGLUE(__time)
+{
+	return sys___time(a[0].sa_ptr, a[1].sa_ptr);
+}
 
-	callno = tf->tf_v0;
+SYSGLUE(nanosleep)
+{
+	return sys_nanosleep((const_userptr_t)a[0].sa_ptr, a[1].sa_ptr);
+}
 
-	/*
-	 * Initialize retval to 0. Many of the system calls don't
-	 * really return a value, just 0 for success and -1 on
-	 * error. Since retval is the value returned on success,
-	 * initialize it to 0 by default; thus it's not necessary to
-	 * deal with it except for calls that return other values,
-	 * like write.
-	 */
+SYSGLUE(fork)
+{
+	return sys_fork(tf, retval);
+}
 
-	retval = 0;
+SYSGLUE(vfork)
+{
+	return sys_vfork(tf, retval);
+}
+
+SYSGLUE(execv)
+{
+	return sys_execv((const_userptr_t)a[0].sa_ptr, a[1].sa_ptr);
+}
 
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
+SYSGLUE(waitpid)
+{
+	return sys_waitpid(a[0].sa_int, a[1].sa_ptr, a[2].sa_int, retval);
+}
 
-	    case SYS___time:
-		err = sys___time((userptr_t)tf->tf_a0,
-				 (userptr_t)tf->tf_a1);
-		break;
+SYSGLUE(_exit)
+{
+	sys__exit(a[0].sa_int);
+}
 
-	    /* Add stuff here */
+SYSGLUE(getpid)
+{
+	return sys_getpid(retval);
+}
 
-	    default:
-		kprintf("Unknown syscall %d\n", callno);
-		err = ENOSYS;
-		break;
+SYSGLUE(getrusage)
+{
+	return sys_getrusage(a[0].sa_int, a[1].sa_ptr);
+}
+
+SYSGLUE(open)
+{
+	return sys_open((const_userptr_t)a[0].sa_ptr, a[1].sa_int,
+			a[2].sa_uint, retval);
+}
+
+SYSGLUE(read)
+{
+	return sys_read(a[0].sa_int, a[1].sa_ptr, a[2].sa_uint, retval);
+}
+
+SYSGLUE(write)
+{
+	return sys_write(a[0].sa_int, a[1].sa_ptr, a[2].sa_uint, retval);
+}
+
+SYSGLUE(close)
+{
+	return sys_close(a[0].sa_int);
+}
+
+SYSGLUE(pipe)
+{
+	return sys_pipe(a[0].sa_ptr, retval);
+}
+
+SYSGLUE(poll)
+{
+	return sys_poll(a[0].sa_ptr, a[1].sa_uint, a[2].sa_int, retval);
+}
+
+SYSGLUE(select)
+{
+	return sys_select(a[0].sa_int, a[1].sa_ptr, a[2].sa_ptr, a[3].sa_ptr,
+			  a[4].sa_ptr, retval);
+}
+
+SYSGLUE(mmap)
+{
+	return sys_mmap(a[0].sa_ptr, a[1].sa_uint, a[2].sa_int, a[3].sa_int,
+			a[4].sa_int, a[5].sa_64, retval);
+}
+
+SYSGLUE(munmap)
+{
+	return sys_munmap(a[0].sa_ptr, a[1].sa_uint);
+}
+
+SYSGLUE(msync)
+{
+	return sys_msync(a[0].sa_ptr, a[1].sa_uint, a[2].sa_int);
+}
+
+SYSGLUE(futex)
+{
+	return sys_futex(a[0].sa_ptr, a[1].sa_int, a[2].sa_int,
+			 (const_userptr_t)a[3].sa_ptr, retval);
+}
+
+#define SYSENT(name, nargs, args64, flags) \
+	[SYS_##name] = { #name, sc_##name, nargs, args64, flags, \
+			 COUNTER_INITIALIZER("sys_" #name) }
+
+static struct sysent sysent[] = {
+	SYSENT(reboot,		1, 0, 0),
+	SYSENT(__time,		2, 0, 0),
+	SYSENT(nanosleep,	2, 0, 0),
+	SYSENT(fork,		0, 0, 0),
+	SYSENT(vfork,		0, 0, 0),
+	SYSENT(execv,		2, 0, 0),
+	SYSENT(waitpid,		3, 0, 0),
+	SYSENT(_exit,		1, 0, 0),
+	SYSENT(getpid,		0, 0, SYF_FAST),
+	SYSENT(getrusage,	2, 0, 0),
+	SYSENT(open,		3, 0, 0),
+	SYSENT(read,		3, 0, 0),
+	SYSENT(write,		3, 0, 0),
+	SYSENT(close,		1, 0, 0),
+	SYSENT(pipe,		1, 0, 0),
+	SYSENT(poll,		3, 0, 0),
+	SYSENT(select,		5, 0, 0),
+	SYSENT(mmap,		6, 1 << 5, 0),
+	SYSENT(munmap,		2, 0, 0),
+	SYSENT(msync,		3, 0, 0),
+	SYSENT(futex,		4, 0, 0),
+};
+
+#define NSYSENT (sizeof(sysent) / sizeof(sysent[0]))
+
+/*
+ * Look up a call number; NULL if there's no such call.
+ */
+static
+struct sysent *
+syscall_lookup(int callno)
+{
+	if (callno < 0 || (unsigned)callno >= NSYSENT ||
+	    sysent[callno].sy_call == NULL) {
+		return NULL;
 	}
+	return &sysent[callno];
+}
+
+/*
+ * Fetch the arguments of call SE into ARGS.
+ */
+static
+int
+syscall_getargs(struct trapframe *tf, const struct sysent *se,
+		union sysarg *args)
+{
+	uint32_t words[SYS_MAXWORDS];
+	unsigned i, w, nwords;
+	int result;
 
+	/* Count the words, aligning each 64-bit argument. */
+	nwords = 0;
+	for (i=0; i<se->sy_nargs; i++) {
+		if (se->sy_args64 & (1U << i)) {
+			nwords = ((nwords + 1) & ~1U) + 2;
+		}
+		else {
+			nwords++;
+		}
+	}
+	KASSERT(se->sy_nargs <= SYS_MAXARGS);
+	KASSERT(nwords <= SYS_MAXWORDS);
+
+	words[0] = tf->tf_a0;
+	words[1] = tf->tf_a1;
+	words[2] = tf->tf_a2;
+	words[3] = tf->tf_a3;
+	if (nwords > 4) {
+		result = copyin((const_userptr_t)(tf->tf_sp + 16), &words[4],
+				(nwords - 4) * sizeof(words[0]));
+		if (result) {
+			return result;
+		}
+	}
 
+	w = 0;
+	for (i=0; i<se->sy_nargs; i++) {
+		if (se->sy_args64 & (1U << i)) {
+			w = (w + 1) & ~1U;
+			args[i].sa_64 = ((uint64_t)words[w] << 32) | words[w+1];
+			w += 2;
+		}
+		else {
+			args[i].sa_uint = words[w];
+			w++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Put the result in the trapframe and step past the syscall
+ * instruction.
+ */
+static
+void
+syscall_return(struct trapframe *tf, int err, int32_t retval)
+{
 	if (err) {
 		/*
 		 * Return the error code. This gets converted at
@@ -139,6 +364,50 @@ syscall(struct trapframe *tf)
 	 */
 
 	tf->tf_epc += 4;
+}
+
+void
+syscall(struct trapframe *tf)
+{
+	union sysarg args[SYS_MAXARGS];
+	struct sysent *se;
+	int callno;
+	int32_t retval;
+	int err;
+
+	/* mips_trap has already checked the spl state. */
+
+	callno = tf->tf_v0;
+	counter_inc(&syscall_counter);
+	tracepoint(TRACE_SYSCALL, callno, 0);
+
+	/*
+	 * Initialize retval to 0. Many of the system calls don't
+	 * really return a value, just 0 for success and -1 on
+	 * error. Since retval is the value returned on success,
+	 * initialize it to 0 by default; thus it's not necessary to
+	 * deal with it except for calls that return other values,
+	 * like write.
+	 */
+
+	retval = 0;
+
+	se = syscall_lookup(callno);
+	if (se == NULL) {
+		kprintf("Unknown syscall %d\n", callno);
+		err = ENOSYS;
+	}
+	else {
+		counter_inc(&se->sy_counter);
+		err = syscall_getargs(tf, se, args);
+		if (!err) {
+			err = se->sy_call(tf, args, &retval);
+		}
+	}
+
+	syscall_return(tf, err, retval);
+
+	tracepoint(TRACE_SYSRET, callno, err);
 
 	/* Make sure the syscall code didn't forget to lower spl */
 	KASSERT(curthread->t_curspl == 0);
@@ -146,16 +415,69 @@ syscall(struct trapframe *tf)
 	KASSERT(curthread->t_iplhigh_count == 0);
 }
 
+/*
+ * Check if CALLNO is one of the register-only calls for syscall_fast.
+ */
+bool
+syscall_isfast(int callno)
+{
+	struct sysent *se;
+
+	se = syscall_lookup(callno);
+	return se != NULL && (se->sy_flags & SYF_FAST) != 0;
+}
+
+/*
+ * Dispatch for SYF_FAST calls: the arguments are all in registers,
+ * and there's nothing to check afterwards. Otherwise it's the same
+ * trap as any other call.
+ */
+void
+syscall_fast(struct trapframe *tf)
+{
+	union sysarg args[4];
+	struct sysent *se;
+	int callno;
+	int32_t retval;
+	int err;
+
+	callno = tf->tf_v0;
+	se = &sysent[callno];
+	KASSERT(se->sy_flags & SYF_FAST);
+	counter_inc(&syscall_counter);
+	counter_inc(&se->sy_counter);
+	tracepoint(TRACE_SYSCALL, callno, 0);
+
+	args[0].sa_uint = tf->tf_a0;
+	args[1].sa_uint = tf->tf_a1;
+	args[2].sa_uint = tf->tf_a2;
+	args[3].sa_uint = tf->tf_a3;
+
+	retval = 0;
+	err = se->sy_call(tf, args, &retval);
+	syscall_return(tf, err, retval);
+
+	tracepoint(TRACE_SYSRET, callno, err);
+}
+
 /*
  * Enter user mode for a newly forked process.
  *
- * This function is provided as a reminder. You need to write
- * both it and the code that calls it.
- *
- * Thus, you can trash it and do things another way if you prefer.
+ * TF is the parent's trapframe, copied into the heap by sys_fork.
+ * mips_usermode needs the trapframe on our own stack, so move it
+ * there, then make fork return 0 in the child.
  */
 void
 enter_forked_process(struct trapframe *tf)
 {
-	(void)tf;
+	struct trapframe mytf;
+
+	mytf = *tf;
+	kfree(tf);
+
+	mytf.tf_v0 = 0;
+	mytf.tf_a3 = 0;		/* signal no error */
+	mytf.tf_epc += 4;	/* skip the syscall instruction */
+
+	mips_usermode(&mytf);
 }
@@ -33,11 +33,15 @@
 #include <spl.h>
 #include <cpu.h>
 #include <spinlock.h>
+#include <thread.h>
 #include <proc.h>
 #include <current.h>
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <mmap.h>
+#include <counter.h>
+#include <trace.h>
 
 /*
  * Dumb MIPS-only "VM system" that is intended to only be just barely
@@ -64,10 +68,45 @@
  */
 static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
 
+static struct counter fault_counter = COUNTER_INITIALIZER("vm_faults");
+static struct counter flush_counter = COUNTER_INITIALIZER("tlb_flushes");
+
+/*
+ * Address space IDs.
+ *
+ * Each cpu hands out the hardware's 64 ASIDs on its own as address
+ * spaces are activated on it, and records the one it picked in the
+ * address space's as_asids[] slot for that cpu, together with the
+ * cpu's current generation number. When a cpu runs out of ASIDs it
+ * flushes its TLB and starts a new generation, which invalidates all
+ * the tags it handed out before. So switching between processes only
+ * costs a TLB flush once per 63 address spaces instead of every time.
+ *
+ * ASID 0 is never handed out. It is what's loaded when no address
+ * space has been activated yet, and what cpus past DUMBVM_MAXCPUS
+ * use; those flush on every activation.
+ *
+ * A cpu's state is only touched by that cpu, with interrupts off.
+ */
+struct dumbvm_asids {
+	unsigned da_gen;	/* current generation */
+	unsigned da_next;	/* next ASID to hand out */
+	unsigned da_cur;	/* ASID currently loaded */
+};
+static struct dumbvm_asids dumbvm_asids[DUMBVM_MAXCPUS];
+
+#define ASID_TAG(gen, asid)	(((gen) << TLBHI_PIDSHIFT) | (asid))
+#define ASID_TAG_GEN(tag)	((tag) >> TLBHI_PIDSHIFT)
+#define ASID_TAG_ASID(tag)	((tag) & (TLBHI_NPID - 1))
+
 void
 vm_bootstrap(void)
 {
-	/* Do nothing. */
+	unsigned i;
+
+	for (i=0; i<DUMBVM_MAXCPUS; i++) {
+		dumbvm_asids[i].da_next = 1;
+	}
 }
 
 /*
@@ -135,31 +174,174 @@ coremap_used_bytes() {
 	return 0;
 }
 
+/*
+ * Invalidate this cpu's entire TLB. Call with interrupts off.
+ */
+static
+void
+dumbvm_flush(void)
+{
+	int i;
+
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	counter_inc(&flush_counter);
+}
+
+/*
+ * The ASID this cpu is running user code under.
+ */
+static
+unsigned
+dumbvm_curasid(void)
+{
+	unsigned num;
+
+	num = curcpu->c_number;
+	return num < DUMBVM_MAXCPUS ? dumbvm_asids[num].da_cur : 0;
+}
+
+/*
+ * dumbvm itself never sends shootdowns (see dumbvm_retire) but
+ * handles them in case anything else does.
+ */
 void
 vm_tlbshootdown(const struct tlbshootdown *ts)
 {
-	(void)ts;
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	uint32_t ehi;
+	int i, spl;
+
+	spl = splhigh();
+	ehi = (ts->ts_vaddr & TLBHI_VPAGE) |
+		((ts->ts_asid << TLBHI_PIDSHIFT) & TLBHI_PID);
+	i = tlb_probe(ehi, 0);
+	if (i >= 0) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	tlb_setasid(dumbvm_curasid());
+	splx(spl);
+}
+
+void
+vm_tlbshootdown_all(void)
+{
+	int spl;
+
+	spl = splhigh();
+	dumbvm_flush();
+	tlb_setasid(dumbvm_curasid());
+	splx(spl);
 }
 
+/*
+ * Find the physical page behind the page-aligned user address VADDR
+ * in AS, for an access of type FAULTTYPE. Sets *MMAPPED_RET if the
+ * page belongs to an mmap region, where the answer can change.
+ */
+static
 int
-vm_fault(int faulttype, vaddr_t faultaddress)
+dumbvm_lookup(struct addrspace *as, vaddr_t vaddr, int faulttype,
+	      paddr_t *paddr_ret, bool *writable_ret, bool *mmapped_ret)
 {
 	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+
+	/* Assert that the address space has been set up properly. */
+	KASSERT(as->as_vbase1 != 0);
+	KASSERT(as->as_pbase1 != 0);
+	KASSERT(as->as_npages1 != 0);
+	KASSERT(as->as_vbase2 != 0);
+	KASSERT(as->as_pbase2 != 0);
+	KASSERT(as->as_npages2 != 0);
+	KASSERT(as->as_stackpbase != 0);
+	KASSERT((as->as_vbase1 & PAGE_FRAME) == as->as_vbase1);
+	KASSERT((as->as_pbase1 & PAGE_FRAME) == as->as_pbase1);
+	KASSERT((as->as_vbase2 & PAGE_FRAME) == as->as_vbase2);
+	KASSERT((as->as_pbase2 & PAGE_FRAME) == as->as_pbase2);
+	KASSERT((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
+
+	vbase1 = as->as_vbase1;
+	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
+	vbase2 = as->as_vbase2;
+	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	stacktop = USERSTACK;
+
+	*writable_ret = true;
+	*mmapped_ret = false;
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		*paddr_ret = (vaddr - vbase1) + as->as_pbase1;
+		return 0;
+	}
+	if (vaddr >= vbase2 && vaddr < vtop2) {
+		*paddr_ret = (vaddr - vbase2) + as->as_pbase2;
+		return 0;
+	}
+	if (vaddr >= stackbase && vaddr < stacktop) {
+		*paddr_ret = (vaddr - stackbase) + as->as_stackpbase;
+		return 0;
+	}
+	/* This may sleep reading the page in. */
+	*mmapped_ret = true;
+	return mmap_fault(as->as_mmaps, vaddr, faulttype,
+			  paddr_ret, writable_ret);
+}
+
+/*
+ * Forget the ASIDs AS has on other cpus, and on this one too if
+ * LOCAL, so that the next time it runs there it gets a fresh ASID and
+ * whatever TLB entries were left behind under the old one can never
+ * match again.
+ *
+ * This stands in for TLB shootdowns: a dumbvm address space belongs
+ * to one single-threaded process, which can't be running anywhere
+ * else while it's here changing its own mappings, so there is nobody
+ * to interrupt. Must be called by that process.
+ */
+static
+void
+dumbvm_retire(struct addrspace *as, bool local)
+{
+	unsigned i, self;
+	int spl;
+
+	spl = splhigh();
+	self = curcpu->c_number;
+	for (i=0; i<DUMBVM_MAXCPUS; i++) {
+		if (local || i != self) {
+			as->as_asids[i] = 0;
+		}
+	}
+	splx(spl);
+
+	if (local && as == proc_getas()) {
+		as_activate();
+	}
+}
+
+int
+vm_fault(int faulttype, vaddr_t faultaddress)
+{
 	paddr_t paddr;
-	int i;
+	bool writable, mmapped;
+	int i, result;
 	uint32_t ehi, elo;
 	struct addrspace *as;
+	unsigned majflt;
 	int spl;
 
 	faultaddress &= PAGE_FRAME;
+	counter_inc(&fault_counter);
+	tracepoint(TRACE_VMFAULT, faulttype, faultaddress);
 
 	DEBUG(DB_VM, "dumbvm: fault: 0x%x\n", faultaddress);
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/*
+		 * Only mmap'd pages are ever mapped read-only; this is
+		 * a write to one of them. mmap_fault sorts it out.
+		 */
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
 		break;
@@ -185,62 +367,71 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		return EFAULT;
 	}
 
-	/* Assert that the address space has been set up properly. */
-	KASSERT(as->as_vbase1 != 0);
-	KASSERT(as->as_pbase1 != 0);
-	KASSERT(as->as_npages1 != 0);
-	KASSERT(as->as_vbase2 != 0);
-	KASSERT(as->as_pbase2 != 0);
-	KASSERT(as->as_npages2 != 0);
-	KASSERT(as->as_stackpbase != 0);
-	KASSERT((as->as_vbase1 & PAGE_FRAME) == as->as_vbase1);
-	KASSERT((as->as_pbase1 & PAGE_FRAME) == as->as_pbase1);
-	KASSERT((as->as_vbase2 & PAGE_FRAME) == as->as_vbase2);
-	KASSERT((as->as_pbase2 & PAGE_FRAME) == as->as_pbase2);
-	KASSERT((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
-
-	vbase1 = as->as_vbase1;
-	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
-	vbase2 = as->as_vbase2;
-	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
-	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
-	stacktop = USERSTACK;
-
-	if (faultaddress >= vbase1 && faultaddress < vtop1) {
-		paddr = (faultaddress - vbase1) + as->as_pbase1;
+	/* The page cache counts the faults that had to read the page. */
+	majflt = curthread->t_acct.ac_majflt;
+	result = dumbvm_lookup(as, faultaddress, faulttype, &paddr, &writable,
+			       &mmapped);
+	if (result) {
+		return result;
 	}
-	else if (faultaddress >= vbase2 && faultaddress < vtop2) {
-		paddr = (faultaddress - vbase2) + as->as_pbase2;
+	if (curthread->t_acct.ac_majflt == majflt) {
+		curthread->t_acct.ac_minflt++;
 	}
-	else if (faultaddress >= stackbase && faultaddress < stacktop) {
-		paddr = (faultaddress - stackbase) + as->as_stackpbase;
-	}
-	else {
-		return EFAULT;
+	if (mmapped && faulttype != VM_FAULT_READ) {
+		/*
+		 * A write may have copied a private page; entries for
+		 * the old one on other cpus are stale now. (Ours gets
+		 * replaced below.)
+		 */
+		dumbvm_retire(as, false);
 	}
 
 	/* make sure it's page-aligned */
 	KASSERT((paddr & PAGE_FRAME) == paddr);
 
+	elo = paddr | TLBLO_VALID;
+	if (writable) {
+		elo |= TLBLO_DIRTY;
+	}
+	DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
+
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
+	/*
+	 * Tag the entry with our ASID. Every path below ends by writing
+	 * it, which leaves our ASID loaded again after the tlb_reads.
+	 */
+	ehi = faultaddress | (dumbvm_curasid() << TLBHI_PIDSHIFT);
+
+	/*
+	 * Replace the existing entry if there is one (as there is on a
+	 * write to a read-only page); two entries for the same page
+	 * would be fatal.
+	 */
+	i = tlb_probe(ehi, 0);
+	if (i >= 0) {
+		tlb_write(ehi, elo, i);
+		splx(spl);
+		return 0;
+	}
+
 	for (i=0; i<NUM_TLB; i++) {
-		tlb_read(&ehi, &elo, i);
-		if (elo & TLBLO_VALID) {
+		uint32_t oehi, oelo;
+
+		tlb_read(&oehi, &oelo, i);
+		if (oelo & TLBLO_VALID) {
 			continue;
 		}
-		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
-		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
 		return 0;
 	}
 
-	kprintf("dumbvm: Ran out of TLB entries - cannot handle page fault\n");
+	/* Full; mappings can be larger than the TLB, so evict one. */
+	tlb_random(ehi, elo);
 	splx(spl);
-	return EFAULT;
+	return 0;
 }
 
 struct addrspace *
@@ -258,6 +449,8 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_mmaps = NULL;
+	bzero(as->as_asids, sizeof(as->as_asids));
 
 	return as;
 }
@@ -266,14 +459,17 @@ void
 as_destroy(struct addrspace *as)
 {
 	dumbvm_can_sleep();
+	mmap_destroyall(&as->as_mmaps);
 	kfree(as);
 }
 
 void
 as_activate(void)
 {
-	int i, spl;
 	struct addrspace *as;
+	struct dumbvm_asids *da;
+	unsigned num, tag;
+	int spl;
 
 	as = proc_getas();
 	if (as == NULL) {
@@ -283,10 +479,31 @@ as_activate(void)
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
-	for (i=0; i<NUM_TLB; i++) {
-		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	num = curcpu->c_number;
+	if (num >= DUMBVM_MAXCPUS) {
+		/* No ASIDs here; flush everything as before. */
+		dumbvm_flush();
+		tlb_setasid(0);
+		splx(spl);
+		return;
 	}
 
+	da = &dumbvm_asids[num];
+	tag = as->as_asids[num];
+	if (tag == 0 || ASID_TAG_GEN(tag) != da->da_gen) {
+		if (da->da_next == TLBHI_NPID) {
+			/* Out of ASIDs; start a new generation. */
+			dumbvm_flush();
+			da->da_gen++;
+			da->da_next = 1;
+		}
+		tag = ASID_TAG(da->da_gen, da->da_next);
+		da->da_next++;
+		as->as_asids[num] = tag;
+	}
+	da->da_cur = ASID_TAG_ASID(tag);
+	tlb_setasid(da->da_cur);
+
 	splx(spl);
 }
 
@@ -431,6 +648,100 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
 		DUMBVM_STACKPAGES*PAGE_SIZE);
 
+	if (mmap_copy(old->as_mmaps, &new->as_mmaps)) {
+		as_destroy(new);
+		return ENOMEM;
+	}
+
 	*ret = new;
 	return 0;
 }
+
+/*
+ * mmap support: mappings go between the top of the two regions and
+ * the bottom of the stack.
+ */
+int
+as_mmap(struct addrspace *as, size_t len, int prot, int flags,
+	struct vnode *vn, off_t offset, vaddr_t *ret)
+{
+	vaddr_t lo, top2;
+
+	dumbvm_can_sleep();
+
+	lo = as->as_vbase1 + as->as_npages1 * PAGE_SIZE;
+	top2 = as->as_vbase2 + as->as_npages2 * PAGE_SIZE;
+	if (top2 > lo) {
+		lo = top2;
+	}
+	return mmap_create(&as->as_mmaps, lo,
+			   USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE,
+			   len, prot, flags, vn, offset, ret);
+}
+
+int
+as_munmap(struct addrspace *as, vaddr_t addr, size_t len)
+{
+	int result;
+
+	dumbvm_can_sleep();
+
+	result = mmap_remove(&as->as_mmaps, addr, len);
+	if (result) {
+		return result;
+	}
+	/* Drop any TLB entries for the pages that went away. */
+	dumbvm_retire(as, true);
+	return 0;
+}
+
+int
+as_msync(struct addrspace *as, vaddr_t addr, size_t len)
+{
+	bool flush;
+	int result;
+
+	dumbvm_can_sleep();
+
+	result = mmap_sync(as->as_mmaps, addr, len, &flush);
+	if (flush) {
+		/* Make the next write to a cleaned page fault again. */
+		dumbvm_retire(as, true);
+	}
+	return result;
+}
+
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	vaddr_t page;
+	paddr_t paddr, oldpaddr;
+	bool writable, mmapped;
+	int result;
+
+	dumbvm_can_sleep();
+
+	page = vaddr & PAGE_FRAME;
+	result = dumbvm_lookup(as, page, VM_FAULT_READ,
+			       &paddr, &writable, &mmapped);
+	if (result) {
+		return result;
+	}
+	if (mmapped) {
+		/*
+		 * Looking up for write may copy a private page, which
+		 * leaves any TLB entries for the old one stale.
+		 */
+		oldpaddr = paddr;
+		result = dumbvm_lookup(as, page, VM_FAULT_WRITE,
+				       &paddr, &writable, &mmapped);
+		if (result) {
+			return result;
+		}
+		if (paddr != oldpaddr) {
+			dumbvm_retire(as, true);
+		}
+	}
+	*ret = paddr | (vaddr & ~PAGE_FRAME);
+	return 0;
+}
@@ -76,6 +76,39 @@ mips_timer_set(uint32_t count)
 		:: "r" (count));
 }
 
+/*
+ * Read c0_count ($9) and c0_cause ($13).
+ */
+static
+uint32_t
+mips_count_get(void)
+{
+	uint32_t count;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* do it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
+static
+uint32_t
+mips_cause_get(void)
+{
+	uint32_t cause;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $13;"		/* do it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (cause));
+	return cause;
+}
+
 /*
  * LAMEbus data for the system. (We have only one LAMEbus per system.)
  * This does not need to be locked, because it's constant once
@@ -342,3 +375,46 @@ mainbus_interrupt(struct trapframe *tf)
 		}
 	}
 }
+
+/*
+ * Cycles since this cpu's timer was started.
+ *
+ * On System/161 c0_count goes back to zero when it reaches
+ * c0_compare, which is always one tick's worth of cycles, so the
+ * count is c_hardclocks whole ticks plus c0_count. If the timer has
+ * expired but the interrupt hasn't been taken yet, the tick is
+ * pending in c0_cause and is counted here; the retry makes sure
+ * c0_count didn't wrap between reading it and reading c0_cause.
+ *
+ * This only reads coprocessor 0, so it's cheap and doesn't touch
+ * the spl. Interrupts must be off, so c_hardclocks doesn't move
+ * and we don't change cpus; the result means nothing on any other
+ * cpu.
+ */
+uint64_t
+mainbus_cycles(void)
+{
+	uint32_t count, cause, again;
+	uint64_t ticks;
+
+	do {
+		count = mips_count_get();
+		cause = mips_cause_get();
+		again = mips_count_get();
+	} while (again < count);
+
+	ticks = curcpu->c_hardclocks;
+	if (cause & MIPS_TIMER_BIT) {
+		ticks++;
+	}
+	return ticks * (CPU_FREQUENCY / HZ) + count;
+}
+
+/*
+ * Convert cycles to nanoseconds. (Exact at 25 MHz: 40 ns a cycle.)
+ */
+uint64_t
+mainbus_cycles_to_ns(uint64_t cycles)
+{
+	return cycles * (1000000000 / CPU_FREQUENCY);
+}
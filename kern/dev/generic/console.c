@@ -39,6 +39,14 @@
  * supported, although such support could be added without undue
  * difficulty.
  *
+ * Output from threads goes into a ring buffer of
+ * CONSOLE_OUTPUT_BUFFER_SIZE characters, and the write-done
+ * interrupt (con_start) sends the next one. So writers only wait
+ * when the ring is full, and then until it has drained halfway.
+ * Polled output empties the ring first so everything comes out in
+ * order; in particular, a panic message follows whatever was
+ * printed before it.
+ *
  * Note that nothing happens until we have a device to write to. A
  * buffer of size DELAYBUFSIZE is used to hold output that is
  * generated before this point. This means that (1) using kprintf for
@@ -49,12 +57,14 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <cpu.h>
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <wchan.h>
 #include <generic/console.h>
 #include <vfs.h>
 #include <device.h>
@@ -100,37 +110,122 @@ static
 void
 flush_delay_buf(void)
 {
-	size_t i;
-	for (i=0; i<delayed_outbuf_pos; i++) {
-		putch(delayed_outbuf[i]);
-	}
+	putchars(delayed_outbuf, delayed_outbuf_pos);
 	delayed_outbuf_pos = 0;
 }
 
 //////////////////////////////////////////////////
 
+/* Writers waiting for room are woken when the ring drains to here. */
+#define OUTBUF_LOWAT  (CONSOLE_OUTPUT_BUFFER_SIZE / 2)
+
+/*
+ * Take the oldest character out of the output ring.
+ */
+static
+int
+outbuf_take(struct con_softc *cs)
+{
+	unsigned tail;
+
+	KASSERT(spinlock_do_i_hold(&cs->cs_outlock));
+	KASSERT(cs->cs_outcount > 0);
+
+	tail = (cs->cs_outhead + CONSOLE_OUTPUT_BUFFER_SIZE - cs->cs_outcount)
+		% CONSOLE_OUTPUT_BUFFER_SIZE;
+	cs->cs_outcount--;
+	return (unsigned char)cs->cs_outbuf[tail];
+}
+
+/*
+ * If the device is idle and there's output waiting, send the next
+ * character. The device calls con_start when it's done.
+ */
+static
+void
+outbuf_kick(struct con_softc *cs)
+{
+	KASSERT(spinlock_do_i_hold(&cs->cs_outlock));
+
+	if (!cs->cs_outbusy && cs->cs_outcount > 0) {
+		cs->cs_outbusy = true;
+		cs->cs_send(cs->cs_devdata, outbuf_take(cs));
+	}
+}
+
+//////////////////////////////////////////////////
+
 /*
  * Print a character, using polling instead of interrupts to wait for
- * I/O completion.
+ * I/O completion. Anything still in the output ring goes first.
+ *
+ * If we already hold cs_outlock, we're panicking inside the console
+ * code; just print.
  */
 static
 void
 putch_polled(struct con_softc *cs, int ch)
 {
+	bool drained = false;
+
+	if (!spinlock_do_i_hold(&cs->cs_outlock)) {
+		spinlock_acquire(&cs->cs_outlock);
+		if (cs->cs_outcount > 0) {
+			while (cs->cs_outcount > 0) {
+				cs->cs_sendpolled(cs->cs_devdata,
+						  outbuf_take(cs));
+			}
+			/* It may never pass OUTBUF_LOWAT in con_start now. */
+			wchan_wakeall(cs->cs_outwchan, &cs->cs_outlock);
+			drained = true;
+		}
+		spinlock_release(&cs->cs_outlock);
+	}
 	cs->cs_sendpolled(cs->cs_devdata, ch);
+
+	if (drained) {
+		pollq_wakeup(&cs->cs_pollq, POLLOUT);
+	}
 }
 
 //////////////////////////////////////////////////
 
 /*
- * Print a character, using interrupts to wait for I/O completion.
+ * Print characters, using interrupts to wait for I/O completion.
+ * Copies as much as fits into the output ring at a time and only
+ * sleeps if it fills up.
+ *
+ * Up to OUTBUF_ATOMIC characters go into the ring together, so that
+ * callers handing over a line at a time (kprintf, con_write) don't
+ * get their lines mixed with anyone else's. This is no more than the
+ * room a woken writer is guaranteed to find.
  */
+#define OUTBUF_ATOMIC  (CONSOLE_OUTPUT_BUFFER_SIZE - OUTBUF_LOWAT)
+
 static
 void
-putch_intr(struct con_softc *cs, int ch)
+putchars_intr(struct con_softc *cs, const char *buf, size_t len)
 {
-	P(cs->cs_wsem);
-	cs->cs_send(cs->cs_devdata, ch);
+	unsigned n, want;
+
+	spinlock_acquire(&cs->cs_outlock);
+	while (len > 0) {
+		want = len < OUTBUF_ATOMIC ? len : OUTBUF_ATOMIC;
+		while (CONSOLE_OUTPUT_BUFFER_SIZE - cs->cs_outcount < want) {
+			wchan_sleep(cs->cs_outwchan, &cs->cs_outlock);
+		}
+		for (n = 0; n < len &&
+			     cs->cs_outcount < CONSOLE_OUTPUT_BUFFER_SIZE; n++) {
+			cs->cs_outbuf[cs->cs_outhead] = buf[n];
+			cs->cs_outhead = (cs->cs_outhead + 1)
+				% CONSOLE_OUTPUT_BUFFER_SIZE;
+			cs->cs_outcount++;
+		}
+		buf += n;
+		len -= n;
+		outbuf_kick(cs);
+	}
+	spinlock_release(&cs->cs_outlock);
 }
 
 /*
@@ -174,6 +269,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 
 	V(cs->cs_rsem);
+	pollq_wakeup(&cs->cs_pollq, POLLIN);
 }
 
 /*
@@ -183,8 +279,20 @@ void
 con_start(void *vcs)
 {
 	struct con_softc *cs = vcs;
+	bool drained;
+
+	spinlock_acquire(&cs->cs_outlock);
+	cs->cs_outbusy = false;
+	outbuf_kick(cs);
+	drained = cs->cs_outcount == OUTBUF_LOWAT;
+	if (drained) {
+		wchan_wakeall(cs->cs_outwchan, &cs->cs_outlock);
+	}
+	spinlock_release(&cs->cs_outlock);
 
-	V(cs->cs_wsem);
+	if (drained) {
+		pollq_wakeup(&cs->cs_pollq, POLLOUT);
+	}
 }
 
 //////////////////////////////////////////////////
@@ -199,19 +307,32 @@ con_start(void *vcs)
 
 void
 putch(int ch)
+{
+	char c = ch;
+
+	putchars(&c, 1);
+}
+
+void
+putchars(const char *buf, size_t len)
 {
 	struct con_softc *cs = the_console;
+	size_t i;
 
 	if (cs==NULL) {
-		putch_delayed(ch);
+		for (i=0; i<len; i++) {
+			putch_delayed(buf[i]);
+		}
 	}
 	else if (curthread->t_in_interrupt ||
 		 curthread->t_curspl > 0 ||
 		 curcpu->c_spinlocks > 0) {
-		putch_polled(cs, ch);
+		for (i=0; i<len; i++) {
+			putch_polled(cs, buf[i]);
+		}
 	}
 	else {
-		putch_intr(cs, ch);
+		putchars_intr(cs, buf, len);
 	}
 }
 
@@ -240,12 +361,68 @@ con_eachopen(struct device *dev, int openflags)
 	return 0;
 }
 
+/*
+ * User writes are copied in this many bytes at a time.
+ */
+#define CON_WRITECHUNK  128
+
 static
 int
-con_io(struct device *dev, struct uio *uio)
+con_read(struct uio *uio)
 {
 	int result;
 	char ch;
+
+	while (uio->uio_resid > 0) {
+		ch = getch();
+		if (ch=='\r') {
+			ch = '\n';
+		}
+		result = uiomove(&ch, 1, uio);
+		if (result) {
+			return result;
+		}
+		if (ch=='\n') {
+			break;
+		}
+	}
+	return 0;
+}
+
+static
+int
+con_write(struct uio *uio)
+{
+	char in[CON_WRITECHUNK];
+	char out[CON_WRITECHUNK * 2];	/* room to turn \n into \r\n */
+	size_t len, i, j;
+	int result;
+
+	while (uio->uio_resid > 0) {
+		len = uio->uio_resid;
+		if (len > sizeof(in)) {
+			len = sizeof(in);
+		}
+		result = uiomove(in, len, uio);
+		if (result) {
+			return result;
+		}
+		for (i = j = 0; i < len; i++) {
+			if (in[i]=='\n') {
+				out[j++] = '\r';
+			}
+			out[j++] = in[i];
+		}
+		putchars(out, j);
+	}
+	return 0;
+}
+
+static
+int
+con_io(struct device *dev, struct uio *uio)
+{
+	int result;
 	struct lock *lk;
 
 	(void)dev;  // unused
@@ -259,36 +436,14 @@ con_io(struct device *dev, struct uio *uio)
 
 	KASSERT(lk != NULL);
 	lock_acquire(lk);
-
-	while (uio->uio_resid > 0) {
-		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
-			if (ch=='\r') {
-				ch = '\n';
-			}
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				break;
-			}
-		}
-		else {
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				putch('\r');
-			}
-			putch(ch);
-		}
+	if (uio->uio_rw==UIO_READ) {
+		result = con_read(uio);
+	}
+	else {
+		result = con_write(uio);
 	}
 	lock_release(lk);
-	return 0;
+	return result;
 }
 
 static
@@ -302,10 +457,37 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Poll. Input is ready when there are buffered characters; output is
+ * ready when the output ring has room. (A poller waiting for output
+ * is woken when the ring has drained halfway, like a writer.)
+ */
+static
+int
+con_poll(struct device *dev, int events, struct pollset *ps)
+{
+	struct con_softc *cs = dev->d_data;
+	int revents;
+
+	if (ps != NULL) {
+		pollq_register(&cs->cs_pollq, ps);
+	}
+
+	revents = 0;
+	if (cs->cs_outcount < CONSOLE_OUTPUT_BUFFER_SIZE) {
+		revents |= POLLOUT;
+	}
+	if (cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+		revents |= POLLIN;
+	}
+	return revents & events;
+}
+
 static const struct device_ops console_devops = {
 	.devop_eachopen = con_eachopen,
 	.devop_io = con_io,
 	.devop_ioctl = con_ioctl,
+	.devop_poll = con_poll,
 };
 
 static
@@ -343,7 +525,8 @@ attach_console_to_vfs(struct con_softc *cs)
 int
 config_con(struct con_softc *cs, int unit)
 {
-	struct semaphore *rsem, *wsem;
+	struct semaphore *rsem;
+	struct wchan *wchan;
 	struct lock *rlk, *wlk;
 
 	/*
@@ -363,29 +546,35 @@ config_con(struct con_softc *cs, int unit)
 	if (rsem == NULL) {
 		return ENOMEM;
 	}
-	wsem = sem_create("console write", 1);
-	if (wsem == NULL) {
+	wchan = wchan_create("console write");
+	if (wchan == NULL) {
 		sem_destroy(rsem);
 		return ENOMEM;
 	}
 	rlk = lock_create("console-lock-read");
 	if (rlk == NULL) {
 		sem_destroy(rsem);
-		sem_destroy(wsem);
+		wchan_destroy(wchan);
 		return ENOMEM;
 	}
 	wlk = lock_create("console-lock-write");
 	if (wlk == NULL) {
 		lock_destroy(rlk);
 		sem_destroy(rsem);
-		sem_destroy(wsem);
+		wchan_destroy(wchan);
 		return ENOMEM;
 	}
 
 	cs->cs_rsem = rsem;
-	cs->cs_wsem = wsem;
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	pollq_init(&cs->cs_pollq);
+
+	spinlock_init(&cs->cs_outlock);
+	cs->cs_outwchan = wchan;
+	cs->cs_outhead = 0;
+	cs->cs_outcount = 0;
+	cs->cs_outbusy = false;
 
 	the_console = cs;
 	con_userlock_read = rlk;
@@ -37,7 +37,11 @@
  * device, and are to be initialized by the attach routine.
  */
 
+#include <spinlock.h>
+#include <poll.h>
+
 #define CONSOLE_INPUT_BUFFER_SIZE 32
+#define CONSOLE_OUTPUT_BUFFER_SIZE 1024
 
 struct con_softc {
 	/* initialized by attach routine */
@@ -47,10 +51,18 @@ struct con_softc {
 
 	/* initialized by config routine */
 	struct semaphore *cs_rsem;
-	struct semaphore *cs_wsem;
 	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
 	unsigned cs_gotchars_head;	/* next slot to put a char in */
 	unsigned cs_gotchars_tail;	/* next slot to take a char out */
+	struct pollq cs_pollq;		/* pollers waiting for input */
+
+	/* output ring, drained by con_start; protected by cs_outlock */
+	struct spinlock cs_outlock;
+	struct wchan *cs_outwchan;	/* writers waiting for room */
+	char cs_outbuf[CONSOLE_OUTPUT_BUFFER_SIZE];
+	unsigned cs_outhead;		/* next slot to put a char in */
+	unsigned cs_outcount;		/* chars waiting to go out */
+	bool cs_outbusy;		/* device is sending one */
 };
 
 /*
@@ -62,7 +74,7 @@ void con_start(/*struct con_softc*/ void *cs);
 /*
  * Functions called by higher-level code
  *
- * putch/getch - see <lib.h>
+ * putch/putchars/getch - see <lib.h>
  */
 
 #endif /* _GENERIC_CONSOLE_H_ */
@@ -845,13 +845,17 @@ emufs_namefile(struct vnode *v, struct uio *uio)
 
 /*
  * VOP_MMAP
+ *
+ * Like SFS files, emufs files can be paged through the page cache
+ * with emufs_read and emufs_write. This lets mmap be tested without
+ * an SFS volume.
  */
 static
 int
 emufs_mmap(struct vnode *v)
 {
 	(void)v;
-	return ENOSYS;
+	return 0;
 }
 
 //////////////////////////////
@@ -1086,6 +1090,7 @@ static const struct vnode_ops emufs_fileops = {
 	.vop_stat = emufs_stat,
 	.vop_gettype = emufs_file_gettype,
 	.vop_isseekable = emufs_isseekable,
+	.vop_poll = vnode_pollready,
 	.vop_fsync = emufs_fsync,
 	.vop_mmap = emufs_mmap,
 	.vop_truncate = emufs_truncate,
@@ -1120,6 +1125,7 @@ static const struct vnode_ops emufs_dirops = {
 	.vop_stat = emufs_stat,
 	.vop_gettype = emufs_dir_gettype,
 	.vop_isseekable = emufs_isseekable,
+	.vop_poll = vnode_pollready,
 	.vop_fsync = emufs_void_op_isdir,
 	.vop_mmap = emufs_void_op_isdir,
 	.vop_truncate = emufs_truncate_isdir,
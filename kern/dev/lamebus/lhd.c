@@ -39,6 +39,8 @@
 #include <synch.h>
 #include <platform/bus.h>
 #include <vfs.h>
+#include <counter.h>
+#include <trace.h>
 #include <lamebus/lhd.h>
 #include "autoconf.h"
 
@@ -60,6 +62,8 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+static struct counter lhd_counter = COUNTER_INITIALIZER("disk_ops");
+
 /*
  * Shortcut for reading a register.
  */
@@ -207,6 +211,8 @@ lhd_io(struct device *d, struct uio *uio)
 		return EINVAL;
 	}
 
+	counter_inc(&lhd_counter);
+
 	/* Set up the value to write into the status register. */
 	if (uio->uio_rw==UIO_WRITE) {
 		statval |= LHD_ISWRITE;
@@ -235,6 +241,7 @@ lhd_io(struct device *d, struct uio *uio)
 		lhd_wreg(lh, LHD_REG_SECT, sector+i);
 
 		/* and start the operation. */
+		tracepoint(TRACE_DISKIO, sector+i, uio->uio_rw == UIO_WRITE);
 		lhd_wreg(lh, LHD_REG_STAT, statval);
 
 		/* Now wait until the interrupt handler tells us we're done. */
@@ -242,6 +249,7 @@ lhd_io(struct device *d, struct uio *uio)
 
 		/* Get the result value saved by the interrupt handler. */
 		result = lh->lh_result;
+		tracepoint(TRACE_DISKDONE, sector+i, result);
 
 		/*
 		 * Are we reading? If so, and if we succeeded,
@@ -33,6 +33,7 @@
 #include <array.h>
 #include <fs.h>
 #include <vnode.h>
+#include <poll.h>
 
 #ifndef SEMFS_INLINE
 #define SEMFS_INLINE INLINE
@@ -57,6 +58,7 @@ struct semfs_sem {
 	unsigned sems_count;			/* Semaphore count */
 	bool sems_hasvnode;			/* The vnode exists */
 	bool sems_linked;			/* In the directory */
+	struct pollq sems_pollq;		/* Pollers waiting for P */
 };
 DECLARRAY(semfs_sem, SEMFS_INLINE);
 
@@ -30,6 +30,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/poll.h>
 #include <stat.h>
 #include <uio.h>
 #include <synch.h>
@@ -151,6 +152,7 @@ semfs_wakeup(struct semfs_sem *sem, unsigned newcount)
 	else {
 		cv_broadcast(sem->sems_cv, sem->sems_lock);
 	}
+	pollq_wakeup(&sem->sems_pollq, POLLIN);
 }
 
 /*
@@ -291,6 +293,34 @@ semfs_truncate(struct vnode *vn, off_t len)
 	return 0;
 }
 
+/*
+ * Poll. A semaphore is readable (P won't block) when its count is
+ * nonzero; V never blocks, so it's always writable.
+ */
+static
+int
+semfs_poll(struct vnode *vn, int events, struct pollset *ps)
+{
+	struct semfs_vnode *semv = vn->vn_data;
+	struct semfs_sem *sem;
+	int revents;
+
+	sem = semfs_getsem(semv);
+
+	if (ps != NULL) {
+		pollq_register(&sem->sems_pollq, ps);
+	}
+
+	revents = POLLOUT;
+	lock_acquire(sem->sems_lock);
+	if (sem->sems_count > 0) {
+		revents |= POLLIN;
+	}
+	lock_release(sem->sems_lock);
+
+	return revents & events;
+}
+
 ////////////////////////////////////////////////////////////
 // directory ops
 
@@ -662,6 +692,7 @@ static const struct vnode_ops semfs_dirops = {
 	.vop_stat = semfs_dirstat,
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
+	.vop_poll = vnode_pollready,
 	.vop_fsync = semfs_fsync,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
@@ -695,6 +726,7 @@ static const struct vnode_ops semfs_semops = {
 	.vop_stat = semfs_semstat,
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
+	.vop_poll = semfs_poll,
 	.vop_fsync = semfs_fsync,
 	.vop_mmap = vopfail_mmap_perm,
 	.vop_truncate = semfs_truncate,
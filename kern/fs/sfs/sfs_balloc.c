@@ -63,7 +63,7 @@ sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
 	if (result) {
 		return result;
 	}
-	sfs->sfs_freemapdirty = true;
+	sfs_dirty_freemap(sfs);
 
 	if (*diskblock >= sfs->sfs_sb.sb_nblocks) {
 		panic("sfs: %s: balloc: invalid block %u\n",
@@ -85,7 +85,7 @@ void
 sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock)
 {
 	bitmap_unmark(sfs->sfs_freemap, diskblock);
-	sfs->sfs_freemapdirty = true;
+	sfs_dirty_freemap(sfs);
 }
 
 /*
@@ -89,7 +89,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 
 			/* Remember what we allocated; mark inode dirty */
 			sv->sv_i.sfi_direct[fileblock] = block;
-			sv->sv_dirty = true;
+			sfs_dirty_inode(sv);
 		}
 
 		/*
@@ -152,7 +152,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		sv->sv_i.sfi_indirect = idblock;
 
 		/* Mark the inode dirty */
-		sv->sv_dirty = true;
+		sfs_dirty_inode(sv);
 
 		/* Clear the indirect block buffer */
 		bzero(idbuf, sizeof(idbuf));
@@ -236,7 +236,7 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 		if (i >= blocklen && block != 0) {
 			sfs_bfree(sfs, block);
 			sv->sv_i.sfi_direct[i] = 0;
-			sv->sv_dirty = true;
+			sfs_dirty_inode(sv);
 		}
 	}
 
@@ -278,7 +278,7 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 			/* The whole indirect block is empty now; free it */
 			sfs_bfree(sfs, idblock);
 			sv->sv_i.sfi_indirect = 0;
-			sv->sv_dirty = true;
+			sfs_dirty_inode(sv);
 		}
 		else if (iddirty) {
 			/* The indirect block is dirty; write it back */
@@ -295,7 +295,7 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	sv->sv_i.sfi_size = len;
 
 	/* Mark the inode dirty */
-	sv->sv_dirty = true;
+	sfs_dirty_inode(sv);
 
 	vfs_biglock_release();
 	return 0;
@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * SFS filesystem
+ *
+ * Background writeback.
+ *
+ * One kernel thread, started with the first mount, flushes every
+ * mounted SFS volume. Every sfs_flushinterval ticks it writes back
+ * the inodes and free block map that have been dirty for at least
+ * sfs_flushexpire ticks, plus mapped file pages of the same age. This
+ * bounds how much is lost in a crash and keeps a later sync from
+ * having a large backlog to write at once.
+ *
+ * Each volume's writes go out in ascending block order: superblock,
+ * then freemap, then inodes sorted by inode number (which is also
+ * the block number). If a volume dirties SFS_FLUSH_DIRTYMAX inodes
+ * between passes, or the page cache holds SFS_FLUSH_PAGESMAX dirty
+ * pages, the flusher is woken early and writes everything regardless
+ * of age.
+ *
+ * The list of mounted volumes is protected by the vfs biglock, which
+ * the flusher holds for the whole of a volume pass. Unmount (which
+ * runs with the biglock held) just takes the volume off the list, so
+ * it never has to wait for the flusher.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <thread.h>
+#include <counter.h>
+#include <pagecache.h>
+#include <vfs.h>
+#include <sfs.h>
+#include "sfsprivate.h"
+
+#define SFS_FLUSH_INTERVAL	(5 * HZ)	/* default time between passes */
+#define SFS_FLUSH_EXPIRE	(30 * HZ)	/* default age to write back */
+#define SFS_FLUSH_DIRTYMAX	64	/* inodes dirtied that force a pass */
+#define SFS_FLUSH_PAGESMAX	64	/* dirty mapped pages that do too */
+#define SFS_FLUSH_BATCH		32	/* inodes sorted and written at once */
+
+/* sfs_flushlock protects the parameters and sfs_flushpoked. */
+static struct lock *sfs_flushlock;
+static struct cv *sfs_flushcv;
+static bool sfs_flushpoked;
+static unsigned sfs_flushinterval = SFS_FLUSH_INTERVAL;
+static unsigned sfs_flushexpire = SFS_FLUSH_EXPIRE;
+
+/* Protected by the vfs biglock. */
+static struct sfs_fs *sfs_mounted;
+
+static struct counter flushpass_counter =
+	COUNTER_INITIALIZER("sfs_flush_passes");
+static struct counter flushinode_counter =
+	COUNTER_INITIALIZER("sfs_flush_inodes");
+static struct counter flushpage_counter =
+	COUNTER_INITIALIZER("sfs_flush_pages");
+
+/*
+ * Wake the flusher now and have it write everything.
+ */
+static
+void
+sfs_flush_poke(void)
+{
+	if (sfs_flushlock == NULL) {
+		return;
+	}
+	lock_acquire(sfs_flushlock);
+	sfs_flushpoked = true;
+	cv_signal(sfs_flushcv, sfs_flushlock);
+	lock_release(sfs_flushlock);
+}
+
+/*
+ * Mark an inode dirty. Its age counts from the first time.
+ */
+void
+sfs_dirty_inode(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (sv->sv_dirty) {
+		return;
+	}
+	sv->sv_dirty = true;
+	sv->sv_dirtytime = clock_getticks();
+	sfs->sfs_ndirtied++;
+	if (sfs->sfs_ndirtied == SFS_FLUSH_DIRTYMAX) {
+		sfs_flush_poke();
+	}
+}
+
+/*
+ * Mark the free block map dirty.
+ */
+void
+sfs_dirty_freemap(struct sfs_fs *sfs)
+{
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (sfs->sfs_freemapdirty) {
+		return;
+	}
+	sfs->sfs_freemapdirty = true;
+	sfs->sfs_freemaptime = clock_getticks();
+}
+
+/*
+ * Insert SV into BATCH, which holds *N inodes sorted by number and
+ * has room for SFS_FLUSH_BATCH. If it is full, the highest-numbered
+ * inode loses. Returns false if something was left out.
+ */
+static
+bool
+sfs_flush_pick(struct sfs_vnode **batch, unsigned *n, struct sfs_vnode *sv)
+{
+	bool fits = true;
+	unsigned i;
+
+	if (*n == SFS_FLUSH_BATCH) {
+		fits = false;
+		if (sv->sv_ino > batch[*n - 1]->sv_ino) {
+			return fits;
+		}
+		--*n;
+	}
+	for (i = *n; i > 0 && batch[i-1]->sv_ino > sv->sv_ino; i--) {
+		batch[i] = batch[i-1];
+	}
+	batch[i] = sv;
+	++*n;
+	return fits;
+}
+
+/*
+ * Write back whatever on SFS is at least EXPIRE ticks old.
+ */
+static
+void
+sfs_flush_fs(struct sfs_fs *sfs, unsigned expire)
+{
+	struct sfs_vnode *batch[SFS_FLUSH_BATCH];
+	struct sfs_vnode *sv;
+	struct vnode *v;
+	unsigned i, n, num, now;
+	bool done;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	now = clock_getticks();
+	sfs->sfs_ndirtied = 0;
+
+	result = sfs_sync_superblock(sfs);
+	if (result) {
+		kprintf("sfs: %s: flush: superblock: %s\n",
+			sfs->sfs_sb.sb_volname, strerror(result));
+	}
+
+	if (sfs->sfs_freemapdirty && now - sfs->sfs_freemaptime >= expire) {
+		result = sfs_sync_freemap(sfs);
+		if (result) {
+			kprintf("sfs: %s: flush: freemap: %s\n",
+				sfs->sfs_sb.sb_volname, strerror(result));
+		}
+	}
+
+	/*
+	 * Inodes, a batch at a time in ascending order. Each batch is
+	 * the lowest-numbered expired inodes still dirty, so the
+	 * batches also come out in order.
+	 */
+	do {
+		done = true;
+		n = 0;
+		num = vnodearray_num(sfs->sfs_vnodes);
+		for (i=0; i<num; i++) {
+			v = vnodearray_get(sfs->sfs_vnodes, i);
+			sv = v->vn_data;
+			if (sv->sv_dirty && now - sv->sv_dirtytime >= expire) {
+				if (!sfs_flush_pick(batch, &n, sv)) {
+					done = false;
+				}
+			}
+		}
+
+		for (i=0; i<n; i++) {
+			result = sfs_sync_inode(batch[i]);
+			if (result) {
+				kprintf("sfs: %s: flush: inode %u: %s\n",
+					sfs->sfs_sb.sb_volname,
+					batch[i]->sv_ino, strerror(result));
+				/* Don't spin on it; try next pass. */
+				return;
+			}
+			counter_inc(&flushinode_counter);
+		}
+	} while (!done);
+}
+
+/*
+ * One pass over everything.
+ */
+static
+void
+sfs_flush_pass(unsigned expire)
+{
+	struct sfs_fs *sfs;
+	unsigned npages;
+
+	if (pagecache_ndirty() >= SFS_FLUSH_PAGESMAX) {
+		expire = 0;
+	}
+
+	/*
+	 * Mapped pages first, since writing them can dirty inodes.
+	 * This goes through VOP_WRITE, so don't hold the biglock.
+	 * Written pages start aging again, so this loop runs out; but
+	 * with EXPIRE 0 it wouldn't, so then do just one batch.
+	 */
+	do {
+		npages = pagecache_flush(expire);
+		counter_add(&flushpage_counter, npages);
+	} while (npages > 0 && expire > 0);
+
+	vfs_biglock_acquire();
+	for (sfs = sfs_mounted; sfs != NULL; sfs = sfs->sfs_flushnext) {
+		sfs_flush_fs(sfs, expire);
+	}
+	vfs_biglock_release();
+
+	counter_inc(&flushpass_counter);
+}
+
+/*
+ * The flusher thread.
+ */
+static
+void
+sfs_flusher(void *junk, unsigned long junk2)
+{
+	unsigned expire;
+
+	(void)junk;
+	(void)junk2;
+
+	lock_acquire(sfs_flushlock);
+	while (1) {
+		if (!sfs_flushpoked) {
+			(void)cv_wait_timeout(sfs_flushcv, sfs_flushlock,
+					      sfs_flushinterval);
+		}
+		expire = sfs_flushpoked ? 0 : sfs_flushexpire;
+		sfs_flushpoked = false;
+		lock_release(sfs_flushlock);
+
+		sfs_flush_pass(expire);
+
+		lock_acquire(sfs_flushlock);
+	}
+}
+
+/*
+ * Add a newly mounted volume to the flusher's list, starting the
+ * flusher if this is the first one.
+ */
+int
+sfs_flush_attach(struct sfs_fs *sfs)
+{
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (sfs_flushlock == NULL) {
+		sfs_flushlock = lock_create("sfsflush");
+		if (sfs_flushlock == NULL) {
+			return ENOMEM;
+		}
+		sfs_flushcv = cv_create("sfsflush");
+		if (sfs_flushcv == NULL) {
+			lock_destroy(sfs_flushlock);
+			sfs_flushlock = NULL;
+			return ENOMEM;
+		}
+		result = thread_fork("sfsflush", NULL, sfs_flusher, NULL, 0);
+		if (result) {
+			cv_destroy(sfs_flushcv);
+			lock_destroy(sfs_flushlock);
+			sfs_flushcv = NULL;
+			sfs_flushlock = NULL;
+			return result;
+		}
+	}
+
+	sfs->sfs_flushnext = sfs_mounted;
+	sfs_mounted = sfs;
+	return 0;
+}
+
+/*
+ * Take a volume that is being unmounted off the list.
+ */
+void
+sfs_flush_detach(struct sfs_fs *sfs)
+{
+	struct sfs_fs **pp;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	for (pp = &sfs_mounted; *pp != sfs; pp = &(*pp)->sfs_flushnext) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = sfs->sfs_flushnext;
+	sfs->sfs_flushnext = NULL;
+}
+
+void
+sfs_flush_setparams(unsigned interval, unsigned expire)
+{
+	KASSERT(interval > 0);
+
+	if (sfs_flushlock == NULL) {
+		/* Nothing mounted yet, so no flusher to tell. */
+		sfs_flushinterval = interval;
+		sfs_flushexpire = expire;
+		return;
+	}
+	lock_acquire(sfs_flushlock);
+	sfs_flushinterval = interval;
+	sfs_flushexpire = expire;
+	cv_signal(sfs_flushcv, sfs_flushlock);
+	lock_release(sfs_flushlock);
+}
+
+void
+sfs_flush_getparams(unsigned *interval, unsigned *expire)
+{
+	*interval = sfs_flushinterval;
+	*expire = sfs_flushexpire;
+}
@@ -126,7 +126,6 @@ sfs_sync_vnodes(struct sfs_fs *sfs)
 /*
  * Sync routine for the freemap.
  */
-static
 int
 sfs_sync_freemap(struct sfs_fs *sfs)
 {
@@ -146,7 +145,6 @@ sfs_sync_freemap(struct sfs_fs *sfs)
 /*
  * Sync routine for the superblock.
  */
-static
 int
 sfs_sync_superblock(struct sfs_fs *sfs)
 {
@@ -290,6 +288,9 @@ sfs_unmount(struct fs *fs)
 	KASSERT(sfs->sfs_superdirty == false);
 	KASSERT(sfs->sfs_freemapdirty == false);
 
+	/* Take it off the flusher's list. */
+	sfs_flush_detach(sfs);
+
 	/* The vfs layer takes care of the device for us */
 	sfs->sfs_device = NULL;
 
@@ -359,6 +360,11 @@ sfs_fs_create(void)
 	/* freemap */
 	sfs->sfs_freemap = NULL;
 	sfs->sfs_freemapdirty = false;
+	sfs->sfs_freemaptime = 0;
+
+	/* background writeback */
+	sfs->sfs_ndirtied = 0;
+	sfs->sfs_flushnext = NULL;
 
 	return sfs;
 
@@ -464,6 +470,15 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 		return result;
 	}
 
+	/* Start writing it back in the background */
+	result = sfs_flush_attach(sfs);
+	if (result) {
+		sfs->sfs_device = NULL;
+		sfs_fs_destroy(sfs);
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* Hand back the abstract fs */
 	*ret = &sfs->sfs_absfs;
 
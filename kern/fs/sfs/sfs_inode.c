@@ -204,16 +204,17 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 
 	/* Not dirty yet */
 	sv->sv_dirty = false;
+	sv->sv_dirtytime = 0;
 
 	/*
 	 * FORCETYPE is set if we're creating a new file, because the
 	 * block on disk will have been zeroed out by sfs_balloc and
-	 * thus the type recorded there will be SFS_TYPE_INVAL.
+	 * thus the type recorded there will be SFS_TYPE_INVAL. (The
+	 * inode is marked dirty below, once the vnode is set up.)
 	 */
 	if (forcetype != SFS_TYPE_INVAL) {
 		KASSERT(sv->sv_i.sfi_type == SFS_TYPE_INVAL);
 		sv->sv_i.sfi_type = forcetype;
-		sv->sv_dirty = true;
 	}
 
 	/*
@@ -241,6 +242,9 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 
 	/* Set the other fields in our vnode structure */
 	sv->sv_ino = ino;
+	if (forcetype != SFS_TYPE_INVAL) {
+		sfs_dirty_inode(sv);
+	}
 
 	/* Add it to our table */
 	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_absvn, NULL);
@@ -378,7 +378,7 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	    uio->uio_rw == UIO_WRITE &&
 	    uio->uio_offset > (off_t)sv->sv_i.sfi_size) {
 		sv->sv_i.sfi_size = uio->uio_offset;
-		sv->sv_dirty = true;
+		sfs_dirty_inode(sv);
 	}
 
 	/* Add in any extra amount we couldn't read because of EOF */
@@ -471,7 +471,7 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 		endpos = actualpos + len;
 		if (endpos > (off_t)sv->sv_i.sfi_size) {
 			sv->sv_i.sfi_size = endpos;
-			sv->sv_dirty = true;
+			sfs_dirty_inode(sv);
 		}
 	}
 
@@ -232,14 +232,15 @@ sfs_fsync(struct vnode *v)
 }
 
 /*
- * Called for mmap().
+ * Called for mmap(). Any file can be mapped; the page cache moves
+ * pages in and out through sfs_read and sfs_write.
  */
 static
 int
-sfs_mmap(struct vnode *v   /* add stuff as needed */)
+sfs_mmap(struct vnode *v)
 {
 	(void)v;
-	return ENOSYS;
+	return 0;
 }
 
 /*
@@ -338,7 +339,7 @@ sfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
 	newguy->sv_i.sfi_linkcount++;
 
 	/* and consequently mark it dirty. */
-	newguy->sv_dirty = true;
+	sfs_dirty_inode(newguy);
 
 	*ret = &newguy->sv_absvn;
 
@@ -378,7 +379,7 @@ sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 
 	/* and update the link count, marking the inode dirty */
 	f->sv_i.sfi_linkcount++;
-	f->sv_dirty = true;
+	sfs_dirty_inode(f);
 
 	vfs_biglock_release();
 	return 0;
@@ -411,7 +412,7 @@ sfs_remove(struct vnode *dir, const char *name)
 		/* If we succeeded, decrement the link count. */
 		KASSERT(victim->sv_i.sfi_linkcount > 0);
 		victim->sv_i.sfi_linkcount--;
-		victim->sv_dirty = true;
+		sfs_dirty_inode(victim);
 	}
 
 	/* Discard the reference that sfs_lookonce got us */
@@ -468,7 +469,7 @@ sfs_rename(struct vnode *d1, const char *n1,
 
 	/* Increment the link count, and mark inode dirty */
 	g1->sv_i.sfi_linkcount++;
-	g1->sv_dirty = true;
+	sfs_dirty_inode(g1);
 
 	/* Unlink the old slot */
 	result = sfs_dir_unlink(sv, slot1);
@@ -482,7 +483,7 @@ sfs_rename(struct vnode *d1, const char *n1,
 	 */
 	KASSERT(g1->sv_i.sfi_linkcount>0);
 	g1->sv_i.sfi_linkcount--;
-	g1->sv_dirty = true;
+	sfs_dirty_inode(g1);
 
 	/* Let go of the reference to g1 */
 	VOP_DECREF(&g1->sv_absvn);
@@ -598,6 +599,7 @@ const struct vnode_ops sfs_fileops = {
 	.vop_stat = sfs_stat,
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
+	.vop_poll = vnode_pollready,
 	.vop_fsync = sfs_fsync,
 	.vop_mmap = sfs_mmap,
 	.vop_truncate = sfs_truncate,
@@ -632,6 +634,7 @@ const struct vnode_ops sfs_dirops = {
 	.vop_stat = sfs_stat,
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
+	.vop_poll = vnode_pollready,
 	.vop_fsync = sfs_fsync,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
@@ -62,6 +62,16 @@ int sfs_lookonce(struct sfs_vnode *sv, const char *name,
 		struct sfs_vnode **ret,
 		int *slot);
 
+/* Functions in sfs_flush.c */
+void sfs_dirty_inode(struct sfs_vnode *sv);
+void sfs_dirty_freemap(struct sfs_fs *sfs);
+int sfs_flush_attach(struct sfs_fs *sfs);
+void sfs_flush_detach(struct sfs_fs *sfs);
+
+/* Functions in sfs_fsops.c */
+int sfs_sync_freemap(struct sfs_fs *sfs);
+int sfs_sync_superblock(struct sfs_fs *sfs);
+
 /* Functions in sfs_inode.c */
 int sfs_sync_inode(struct sfs_vnode *sv);
 int sfs_reclaim(struct vnode *v);
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _ACCT_H_
+#define _ACCT_H_
+
+/*
+ * Resource accounting.
+ *
+ * Every thread keeps a struct acct of what it has used. When a
+ * thread leaves its process, its usage is added to the process's
+ * p_acct; when a process is collected with waitpid, its total is
+ * added to the parent's p_acctchildren. getrusage reports these.
+ *
+ * Times are in nanoseconds, measured with mainbus_cycles(), which
+ * only reads cpu registers; so the trap path can use it with
+ * interrupts off, without going to the bus or changing the spl. Its
+ * count is per-cpu, which is fine because a thread is always charged
+ * on the cpu where its clock was last started. The time between two
+ * charges goes to user time if the thread was in user mode and to
+ * system time otherwise. Charges happen when a thread enters the
+ * kernel from user mode and goes back (mips_trap, mips_usermode),
+ * and when it is switched off the cpu; the clock restarts when it
+ * is switched back on (thread_switch, thread_startup), so time on
+ * the run queue and in other threads is not charged to anyone.
+ *
+ * Switch and fault counts are bumped directly by thread_switch and
+ * vm_fault; they belong to the current thread, so need no locking.
+ */
+
+struct rusage;
+
+struct acct {
+	uint64_t ac_utime;		/* ns spent in user mode */
+	uint64_t ac_stime;		/* ns spent in the kernel */
+	unsigned ac_nvcsw;		/* voluntary context switches */
+	unsigned ac_nivcsw;		/* involuntary (preempted) */
+	unsigned ac_minflt;		/* faults that did no I/O */
+	unsigned ac_majflt;		/* faults that read the page in */
+};
+
+/*
+ * Operations:
+ *    acct_bootstrap   - start the clock; call after mainbus_bootstrap.
+ *    acct_kernelentry - the current thread entered the kernel from
+ *                       user mode.
+ *    acct_kernelexit  - the current thread is going to user mode.
+ *    acct_switchout   - the current thread is leaving the cpu.
+ *    acct_switchin    - the current thread is back on the cpu.
+ *    acct_sync        - charge the current thread's time so far, so
+ *                       its t_acct is up to date.
+ *    acct_add         - add FROM into TO.
+ *    acct_torusage    - convert to the form getrusage returns.
+ *
+ * The kernelentry/kernelexit/switchout/switchin hooks expect
+ * interrupts to be off.
+ */
+void acct_bootstrap(void);
+void acct_kernelentry(void);
+void acct_kernelexit(void);
+void acct_switchout(void);
+void acct_switchin(void);
+void acct_sync(void);
+void acct_add(struct acct *to, const struct acct *from);
+void acct_torusage(const struct acct *ac, struct rusage *ru);
+
+
+#endif /* _ACCT_H_ */
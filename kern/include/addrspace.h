@@ -39,7 +39,10 @@
 #include "opt-dumbvm.h"
 
 struct vnode;
+struct mmapping;
 
+/* CPUs that get their own ASIDs under dumbvm; others flush instead */
+#define DUMBVM_MAXCPUS 32
 
 /*
  * Address space - data structure associated with the virtual memory
@@ -57,6 +60,8 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        struct mmapping *as_mmaps;
+        unsigned as_asids[DUMBVM_MAXCPUS];	/* per-cpu ASID tags */
 #else
         /* Put stuff here for your VM system */
 #endif
@@ -99,6 +104,18 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_mmap   - map LEN bytes of file VN starting at OFFSET, for
+ *                mmap(). Chooses the address and hands it back.
+ *
+ *    as_munmap - remove the mappings in a range, for munmap().
+ *
+ *    as_msync  - write back shared mappings in a range, for msync().
+ *
+ *    as_translate - find the physical address behind a user address,
+ *                faulting the page in for writing first if need be.
+ *                Processes sharing a page get the same answer; used
+ *                to key futexes.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -117,6 +134,13 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_mmap(struct addrspace *as, size_t len, int prot,
+                          int flags, struct vnode *vn, off_t offset,
+                          vaddr_t *ret);
+int               as_munmap(struct addrspace *as, vaddr_t addr, size_t len);
+int               as_msync(struct addrspace *as, vaddr_t addr, size_t len);
+int               as_translate(struct addrspace *as, vaddr_t vaddr,
+                               paddr_t *ret);
 
 
 /*
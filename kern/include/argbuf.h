@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _ARGBUF_H_
+#define _ARGBUF_H_
+
+/*
+ * Argument marshalling for execv and runprogram.
+ *
+ * A struct argbuf holds the argv array for a new program already laid
+ * out the way it goes on the user stack: argc+1 pointers followed by
+ * the packed strings. While it is being built the pointers are byte
+ * offsets into ab_args; argbuf_copyout turns them into user addresses
+ * and copies the whole thing out in one go.
+ *
+ * Buffers are ARG_MAX bytes and live in a small pool that is filled
+ * on demand and never shrinks, so an exec does not allocate (or, under
+ * dumbvm, leak) 64K of kernel memory each time.
+ */
+
+#include <limits.h>
+
+struct argbuf {
+	char ab_args[ARG_MAX];		/* argv image; must be first */
+	char ab_progname[PATH_MAX];	/* program name, for execv */
+	int ab_argc;			/* number of arguments */
+	size_t ab_len;			/* bytes of ab_args in use */
+};
+
+/* Call once during system startup. */
+void argbuf_bootstrap(void);
+
+/* Get a buffer from the pool, waiting if all are in use. */
+int argbuf_get(struct argbuf **ret);
+
+/* Return a buffer to the pool. */
+void argbuf_put(struct argbuf *ab);
+
+/* Fill in the arguments from a user argv array. */
+int argbuf_copyin(struct argbuf *ab, userptr_t uargv);
+
+/* Fill in the arguments from a kernel array of NARGS strings. */
+int argbuf_fromkernel(struct argbuf *ab, char **args, int nargs);
+
+/*
+ * Copy the argv image to the user stack below *STACKPTR, update
+ * *STACKPTR, and hand back the user address of argv. Can only be
+ * done once per fill.
+ */
+int argbuf_copyout(struct argbuf *ab, vaddr_t *stackptr, userptr_t *argv_ret);
+
+#endif /* _ARGBUF_H_ */
@@ -48,6 +48,12 @@
 void hardclock_bootstrap(void);
 void hardclock(void);
 
+/*
+ * clock_getticks() returns the number of hardclock ticks since boot,
+ * as counted on CPU 0. It wraps around; compare values by subtracting.
+ */
+unsigned clock_getticks(void);
+
 /*
  * timerclock() is called on one CPU once a second to allow simple
  * timed operations. (This is a fairly simpleminded interface.)
@@ -79,5 +85,10 @@ void timespec_sub(const struct timespec *t1,
  */
 void clocksleep(int seconds);
 
+/*
+ * clocksleep_ticks() is the same, but in hardclock ticks.
+ */
+void clocksleep_ticks(unsigned ticks);
+
 
 #endif /* _CLOCK_H_ */
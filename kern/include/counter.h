@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _COUNTER_H_
+#define _COUNTER_H_
+
+/*
+ * Per-cpu event counters.
+ *
+ * A counter is declared where it is used:
+ *
+ *      static struct counter foo_counter = COUNTER_INITIALIZER("foo");
+ *      ...
+ *      counter_inc(&foo_counter);
+ *
+ * Each cpu has its own array of counter values and counter_add only
+ * touches the current cpu's, so there is no shared cache line and no
+ * lock. The update is an LL/SC add, so it is safe against interrupts
+ * on the same cpu; if the thread migrates between finding curcpu and
+ * the add, it just adds to the old cpu's slot, which is atomic too.
+ * Reading a counter sums the slots of every cpu, so the result is a
+ * snapshot that may be a few events stale.
+ *
+ * A counter registers itself (gets a slot) the first time it is
+ * used, or when counter_register is called. There are COUNTER_MAX
+ * slots; counters past that all share the "(overflow)" slot.
+ *
+ * Values are 32 bits and wrap.
+ */
+
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef COUNTER_INLINE
+#define COUNTER_INLINE INLINE
+#endif
+
+#define COUNTER_MAX		64
+
+struct counter {
+	const char *cn_name;		/* Name, for dumping */
+	volatile unsigned cn_slot;	/* Slot number; 0 if unregistered */
+};
+
+#define COUNTER_INITIALIZER(name)	{ name, 0 }
+
+/*
+ * Operations:
+ *    counter_cpuinit  - set up the counter slots of a new cpu.
+ *    counter_register - give CN a slot, if it hasn't one yet.
+ *    counter_add      - add N to CN on the current cpu.
+ *    counter_inc      - add 1 to CN on the current cpu.
+ *    counter_read     - sum CN over all cpus.
+ *    counter_dump     - print every registered counter that isn't 0.
+ *    counter_reset    - zero every counter.
+ */
+void counter_cpuinit(struct cpu *c);
+unsigned counter_register(struct counter *cn);
+COUNTER_INLINE void counter_add(struct counter *cn, unsigned n);
+COUNTER_INLINE void counter_inc(struct counter *cn);
+unsigned counter_read(struct counter *cn);
+void counter_dump(void);
+void counter_reset(void);
+
+
+COUNTER_INLINE
+void
+counter_add(struct counter *cn, unsigned n)
+{
+	volatile spinlock_data_t *slots;
+	unsigned slot;
+
+	slot = cn->cn_slot;
+	if (slot == 0) {
+		slot = counter_register(cn);
+	}
+	if (!CURCPU_EXISTS()) {
+		return;
+	}
+	slots = curcpu->c_counters;
+	if (slots != NULL) {
+		spinlock_data_fetchadd(&slots[slot], n);
+	}
+}
+
+COUNTER_INLINE
+void
+counter_inc(struct counter *cn)
+{
+	counter_add(cn, 1);
+}
+
+
+#endif /* _COUNTER_H_ */
@@ -62,6 +62,11 @@ struct cpu {
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
+	LOCKSTAT_PERCPU(c_lockstat);	/* Lock statistics counters */
+	unsigned c_rcu_gen;		/* Last RCU grace period reported */
+	struct timerwheel *c_timers;	/* Timers started on this cpu */
+	volatile spinlock_data_t *c_counters;	/* Counter slots (counter.h) */
+	vaddr_t c_intrpc;		/* PC the current interrupt came in at */
 
 	/*
 	 * Accessed by other cpus.
@@ -71,6 +76,14 @@ struct cpu {
 	struct threadlist c_runqueue;	/* Run queue for this cpu */
 	struct spinlock c_runqueue_lock;
 
+	/*
+	 * Exited threads kept for reuse by thread_fork. Used by this
+	 * cpu, but emptied by thread_cache_drain from any cpu.
+	 * Protected by the thread cache lock.
+	 */
+	struct threadlist c_threadcache;
+	struct spinlock c_threadcache_lock;
+
 	/*
 	 * Accessed by other cpus.
 	 * Protected by the IPI lock.
@@ -78,7 +91,10 @@ struct cpu {
 	 * TLB shootdown requests made to this CPU are queued in
 	 * c_shootdown[], with c_numshootdown holding the number of
 	 * requests. TLBSHOOTDOWN_MAX is the maximum number that can
-	 * be queued at once, which is machine-dependent.
+	 * be queued at once, which is machine-dependent. If more than
+	 * that arrive before the target gets to them, the queue
+	 * collapses to TLBSHOOTDOWN_ALL and the target flushes its
+	 * whole TLB instead.
 	 *
 	 * The contents of struct tlbshootdown are also machine-
 	 * dependent and might reasonably be either an address space
@@ -95,6 +111,9 @@ struct cpu {
 	HANGMAN_ACTOR(c_hangman);
 };
 
+/* c_numshootdown value meaning "just flush everything" */
+#define TLBSHOOTDOWN_ALL	(TLBSHOOTDOWN_MAX + 1)
+
 /*
  * Initialization functions.
  *
@@ -156,6 +175,12 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_batch queues several shootdowns behind one IPI.
+ * ipi_tlbshootdown_all asks the target to flush its whole TLB.
+ *
+ * Shootdowns are queued on the target and only one IPI is sent per
+ * batch: if the target already has an IPI pending, new requests ride
+ * along with it.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -170,6 +195,9 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_batch(struct cpu *target,
+			    const struct tlbshootdown *mappings, unsigned n);
+void ipi_tlbshootdown_all(struct cpu *target);
 
 void interprocessor_interrupt(void);
 
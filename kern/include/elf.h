@@ -55,14 +55,14 @@ typedef struct {
 	uint32_t	e_version;             /* ELF version */
 	uint32_t	e_entry;           /* address of program entry point */
 	uint32_t	e_phoff;           /* location in file of phdrs */
-	uint32_t	e_shoff;           /* ignore */
+	uint32_t	e_shoff;           /* location in file of shdrs */
 	uint32_t	e_flags;	   /* ignore */
 	uint16_t	e_ehsize;          /* actual size of file header */
 	uint16_t	e_phentsize;       /* actual size of phdr */
 	uint16_t	e_phnum;           /* number of phdrs */
-	uint16_t	e_shentsize;       /* ignore */
-	uint16_t	e_shnum;           /* ignore */
-	uint16_t	e_shstrndx;        /* ignore */
+	uint16_t	e_shentsize;       /* actual size of shdr */
+	uint16_t	e_shnum;           /* number of shdrs */
+	uint16_t	e_shstrndx;        /* section with section names */
 } Elf32_Ehdr;
 
 /* Offsets for the 1-byte fields within e_ident[] */
@@ -193,8 +193,58 @@ typedef struct {
 #define	PF_X		0x1	/* Segment is executable */
 
 
+/*
+ * "Section Header" - link-time section header. Not needed to load a
+ * program, but it's how to find the symbol table.
+ * There are Ehdr.e_shnum of these at Ehdr.e_shoff in the file.
+ */
+typedef struct {
+	uint32_t	sh_name;     /* Name (offset in e_shstrndx section) */
+	uint32_t	sh_type;     /* Type of section */
+	uint32_t	sh_flags;    /* Flags */
+	uint32_t	sh_addr;     /* Virtual address, if loaded */
+	uint32_t	sh_offset;   /* Location of data within file */
+	uint32_t	sh_size;     /* Size of data within file */
+	uint32_t	sh_link;     /* Related section (e.g. string table) */
+	uint32_t	sh_info;     /* Extra information */
+	uint32_t	sh_addralign; /* Required alignment */
+	uint32_t	sh_entsize;  /* Size of entries, for tables */
+} Elf32_Shdr;
+
+/* values for sh_type */
+#define	SHT_NULL	0		/* Section header entry unused */
+#define	SHT_PROGBITS	1		/* Program data */
+#define	SHT_SYMTAB	2		/* Symbol table */
+#define	SHT_STRTAB	3		/* String table */
+#define	SHT_NOBITS	8		/* Occupies no file space (bss) */
+
+/*
+ * Symbol table entry.
+ */
+typedef struct {
+	uint32_t	st_name;     /* Name (offset in sh_link section) */
+	uint32_t	st_value;    /* Value (address) */
+	uint32_t	st_size;     /* Size of object, 0 if unknown */
+	unsigned char	st_info;     /* Binding and type */
+	unsigned char	st_other;    /* Ignore */
+	uint16_t	st_shndx;    /* Section the symbol is in */
+} Elf32_Sym;
+
+#define	ELF32_ST_BIND(info)	((info) >> 4)
+#define	ELF32_ST_TYPE(info)	((info) & 0xf)
+
+/* values for ELF32_ST_TYPE */
+#define	STT_NOTYPE	0		/* Unspecified */
+#define	STT_OBJECT	1		/* Data object */
+#define	STT_FUNC	2		/* Function */
+#define	STT_SECTION	3		/* Section */
+#define	STT_FILE	4		/* Source file */
+
+
 typedef Elf32_Ehdr Elf_Ehdr;
 typedef Elf32_Phdr Elf_Phdr;
+typedef Elf32_Shdr Elf_Shdr;
+typedef Elf32_Sym Elf_Sym;
 
 
 #endif /* _ELF_H_ */
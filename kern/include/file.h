@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FILE_H_
+#define _FILE_H_
+
+/*
+ * Open files and per-process file tables.
+ *
+ * A struct openfile is what a file handle refers to: an open vnode
+ * plus the seek position and access mode, which are shared by all
+ * handles that came from the same open() (e.g. via fork or dup2).
+ * It is reference counted; the vnode is closed when the last
+ * reference goes away.
+ *
+ * A struct filetable maps file handle numbers to openfiles.
+ */
+
+#include <limits.h>
+#include <spinlock.h>
+
+struct lock;
+struct vnode;
+
+struct openfile {
+	struct vnode *of_vnode;		/* The object that's open */
+	int of_accmode;			/* O_RDONLY, O_WRONLY, or O_RDWR */
+	bool of_append;			/* O_APPEND: writes go at the end */
+
+	struct lock *of_offsetlock;	/* Lock for of_offset */
+	off_t of_offset;		/* Current seek position */
+
+	struct spinlock of_countlock;	/* Lock for of_refcount */
+	unsigned of_refcount;		/* Number of references */
+};
+
+/*
+ * openfile_open opens PATH with vfs_open and wraps it in a new
+ * openfile. Calls vfs_open and thus may destroy PATH.
+ *
+ * openfile_fromvnode wraps an already-open vnode (e.g. a pipe end);
+ * it takes over the caller's reference to VN, even on failure.
+ *
+ * Both hand back an openfile with one reference.
+ */
+int openfile_open(char *path, int openflags, mode_t mode,
+		  struct openfile **ret);
+int openfile_fromvnode(struct vnode *vn, int accmode, struct openfile **ret);
+void openfile_incref(struct openfile *file);
+void openfile_decref(struct openfile *file);
+
+struct filetable {
+	struct spinlock ft_lock;		/* Lock for ft_files */
+	struct openfile *ft_files[OPEN_MAX];	/* Indexed by file handle */
+};
+
+/*
+ * Operations:
+ *    filetable_create  - make an empty table.
+ *    filetable_destroy - drop all references and free the table.
+ *    filetable_copy    - make a new table sharing all of SRC's
+ *                        openfiles, as for fork.
+ *    filetable_openstd - open the console as handles 0, 1, and 2.
+ *    filetable_place   - put FILE in the lowest free slot and return
+ *                        the handle number in *FD. Consumes the
+ *                        caller's reference on success.
+ *    filetable_get     - look up FD and return a new reference to the
+ *                        openfile; drop it with openfile_decref.
+ *    filetable_remove  - clear slot FD and hand back the table's
+ *                        reference to the openfile that was there.
+ */
+struct filetable *filetable_create(void);
+void filetable_destroy(struct filetable *ft);
+int filetable_copy(struct filetable *src, struct filetable **ret);
+int filetable_openstd(struct filetable *ft);
+int filetable_place(struct filetable *ft, struct openfile *file, int *fd);
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_remove(struct filetable *ft, int fd, struct openfile **ret);
+
+
+#endif /* _FILE_H_ */
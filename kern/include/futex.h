@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+/*
+ * Futexes: sleeping and waking on a word of user memory.
+ *
+ * User-level locks keep their state in an ordinary int and only call
+ * into the kernel to sleep when the lock is busy, or to wake sleepers
+ * when they let go of it. A sleeper is filed under the physical
+ * address of its word (see as_translate), so two processes that share
+ * a page through a MAP_SHARED mapping can use a futex between them;
+ * within one process this is the same thing as going by the user
+ * address.
+ *
+ * futex_wait rechecks the word after it has queued the caller, so a
+ * futex_wake issued after the word changes can't be missed.
+ */
+
+#include <kern/futex.h>
+
+void futex_bootstrap(void);
+
+/*
+ * Sleep on the int at UADDR as long as it contains VAL. Returns
+ * EAGAIN if it doesn't, and ETIMEDOUT if TICKS is nonzero and that
+ * many ticks go by first.
+ */
+int futex_wait(userptr_t uaddr, int val, unsigned ticks);
+
+/*
+ * Wake up to MAX threads sleeping on the int at UADDR, oldest first.
+ * Hands back the number woken.
+ */
+int futex_wake(userptr_t uaddr, unsigned max, unsigned *ret);
+
+
+#endif /* _FUTEX_H_ */
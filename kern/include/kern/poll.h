@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+#include <kern/limits.h>	/* for __OPEN_MAX */
+
+/*
+ * Definitions for poll() and select(), shared between the kernel and
+ * libc's <poll.h> and <sys/select.h>.
+ */
+
+
+/*
+ * poll() takes an array of these, one per file handle of interest.
+ * The kernel fills in revents.
+ */
+struct pollfd {
+	int fd;			/* File handle to check */
+	short events;		/* Conditions we're interested in */
+	short revents;		/* Conditions that hold (output) */
+};
+
+/* Bits for events and revents */
+#define POLLIN		0x0001	/* Data may be read without blocking */
+#define POLLPRI		0x0002	/* Priority data may be read */
+#define POLLOUT		0x0004	/* Data may be written without blocking */
+#define POLLERR		0x0008	/* Error condition (revents only) */
+#define POLLHUP		0x0010	/* Other end hung up (revents only) */
+#define POLLNVAL	0x0020	/* Not a valid file handle (revents only) */
+
+/* Synonyms; OS/161 has no out-of-band data, so these are the same. */
+#define POLLRDNORM	POLLIN
+#define POLLWRNORM	POLLOUT
+
+
+/*
+ * Descriptor set for select(). One bit per file handle; the size
+ * matches the per-process open file limit.
+ */
+#define __FD_SETSIZE	__OPEN_MAX
+#define __NFDBITS	32
+
+struct __fd_set {
+	__u32 __fds_bits[(__FD_SETSIZE + __NFDBITS - 1) / __NFDBITS];
+};
+
+
+#endif /* _KERN_POLL_H_ */
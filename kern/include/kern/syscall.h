@@ -65,6 +65,7 @@
 //#define SYS_munlock    14
 //#define SYS_munlockall 15
 //#define SYS_minherit   16
+#define SYS_msync        121
 //                              (security/credentials)
 #define SYS_umask        17
 #define SYS_issetugid    18
@@ -86,7 +87,7 @@
 //#define SYS_sigaltstack 33
 //                              (resource tracking and usage)
 //#define SYS_wait4      34
-//#define SYS_getrusage  35
+#define SYS_getrusage    35
 //                              (resource limits)
 //#define SYS_getrlimit  36
 //#define SYS_setrlimit  37
@@ -196,6 +197,7 @@
 #define SYS_sync         118
 #define SYS_reboot       119
 //#define SYS___sysctl   120
+#define SYS_futex        122
 
 /*CALLEND*/
 
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_TRACE_H_
+#define _KERN_TRACE_H_
+
+/*
+ * Kernel event trace file format, as written by the kernel's
+ * "trace save" menu command and read by the tracedump tool.
+ *
+ * The file is a struct trace_header followed by th_nrecords struct
+ * trace_records. Each cpu's records come out in order, one cpu after
+ * another; sort by time to get a timeline. Everything is in the
+ * kernel's byte order, which for OS/161 is big-endian.
+ */
+
+#define TRACE_MAGIC	0x54726331	/* "Trc1" */
+
+struct trace_header {
+	uint32_t th_magic;		/* TRACE_MAGIC */
+	uint32_t th_ncpus;		/* number of cpus traced */
+	uint32_t th_nrecords;		/* number of records that follow */
+	uint32_t th_dropped;		/* records overwritten before saving */
+};
+
+struct trace_record {
+	uint32_t tr_sec;		/* time (from gettime) */
+	uint32_t tr_nsec;
+	uint16_t tr_event;		/* TRACE_* below */
+	uint16_t tr_cpu;		/* cpu number */
+	uint32_t tr_thread;		/* current thread (address) */
+	uint32_t tr_arg0;		/* event arguments */
+	uint32_t tr_arg1;
+};
+
+/*
+ * Events and their arguments.
+ */
+#define TRACE_SWITCH	1	/* thread_switch: next thread, new state */
+#define TRACE_SLEEP	2	/* wchan_sleep: wchan, timeout ticks */
+#define TRACE_WAKE	3	/* wchan wakeup: wchan, thread woken */
+#define TRACE_SYSCALL	4	/* syscall entry: call number, 0 */
+#define TRACE_SYSRET	5	/* syscall exit: call number, error */
+#define TRACE_VMFAULT	6	/* vm_fault: fault type, address */
+#define TRACE_DISKIO	7	/* lhd_io issue: sector, is-write */
+#define TRACE_DISKDONE	8	/* lhd_io completion: sector, error */
+#define TRACE_KMALLOC	9	/* kmalloc: size, address */
+#define TRACE_NEVENTS	10
+
+
+#endif /* _KERN_TRACE_H_ */
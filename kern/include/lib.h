@@ -164,6 +164,7 @@ const char *strerror(int errcode);
  * Low-level console access.
  */
 void putch(int ch);
+void putchars(const char *buf, size_t len);
 int getch(void);
 void beep(void);
 
@@ -176,9 +177,10 @@ void beep(void);
  * badassert calls panic in a way suitable for an assertion failure.
  * kgets is like gets, only with a buffer size argument.
  *
- * kprintf_bootstrap sets up a lock for kprintf and should be called
- * during boot once malloc is available and before any additional
- * threads are created.
+ * kprintf_bootstrap switches kprintf from polled output to per-cpu
+ * line buffering and should be called during boot once threads and
+ * the console are set up and before any additional threads are
+ * created.
  */
 int kprintf(const char *format, ...) __PF(1,2);
 __DEAD void panic(const char *format, ...) __PF(1,2);
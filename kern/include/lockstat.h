@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock contention statistics. Enable with "options lockstat" in the
+ * kernel config.
+ *
+ * Every spinlock, lock, CV, and rwlock belongs to a lock class.
+ * Locks, CVs, and rwlocks are classed by kind and name, so e.g. all
+ * the locks called "vfs_biglock" share one class. Spinlocks have no
+ * name; one set up with spinlock_init is classed by the address it
+ * was initialized from, and a statically initialized one by its own
+ * address, so look the address up in the kernel's symbol table.
+ *
+ * For each class and each cpu we count acquires, acquires that had
+ * to wait (contended), iterations spent spinning, and microseconds
+ * spent asleep. The counters are per-cpu so recording never touches
+ * shared memory; they are only summed when dumped.
+ */
+
+#include "opt-lockstat.h"
+
+/* Kinds of lock. */
+#define LOCKSTAT_SPINLOCK	0
+#define LOCKSTAT_LOCK		1
+#define LOCKSTAT_CV		2
+#define LOCKSTAT_RWLOCK		3
+
+#if OPT_LOCKSTAT
+
+struct cpu;
+
+/* Class 0 means not classified yet; class 1 collects the overflow. */
+#define LOCKSTAT_NOCLASS	0
+#define LOCKSTAT_OVERFLOW	1
+#define LOCKSTAT_MAXCLASSES	128
+
+/* Per-cpu, per-class counters. */
+struct lockstat_counters {
+	unsigned lsc_acquires;		/* Number of acquires */
+	unsigned lsc_contended;		/* Acquires that had to wait */
+	unsigned lsc_spins;		/* Iterations spent spinning */
+	unsigned lsc_sleepus;		/* Microseconds spent asleep */
+};
+
+/* What happened during one acquire, filled in as it goes. */
+struct lockstat_sample {
+	bool lss_contended;
+	unsigned lss_spins;
+	uint64_t lss_sleepstart;
+	unsigned lss_sleepus;
+};
+
+void lockstat_cpuinit(struct cpu *c);
+unsigned lockstat_class_named(unsigned kind, const char *name);
+unsigned lockstat_class_addr(unsigned kind, const void *addr);
+void lockstat_sleepstart(struct lockstat_sample *s);
+void lockstat_sleepend(struct lockstat_sample *s);
+void lockstat_record(unsigned cls, const struct lockstat_sample *s);
+void lockstat_dump(unsigned topn);
+void lockstat_reset(void);
+
+#define LOCKSTAT_CLASS(sym)		unsigned sym
+#define LOCKSTAT_PERCPU(sym)		struct lockstat_counters *sym
+#define LOCKSTAT_CLASS_INITIALIZER	LOCKSTAT_NOCLASS,
+
+#define LOCKSTAT_SETCLASS(c, kind, name) \
+	((c) = lockstat_class_named(kind, name))
+#define LOCKSTAT_SETCLASS_ADDR(c, kind, addr) \
+	((c) = lockstat_class_addr(kind, addr))
+
+#define LOCKSTAT_SAMPLE(s)	struct lockstat_sample s = { false, 0, 0, 0 }
+#define LOCKSTAT_CONTENDED(s)	((s).lss_contended = true)
+#define LOCKSTAT_SPINS(s, n)	((s).lss_spins += (n))
+#define LOCKSTAT_SLEEPSTART(s)	lockstat_sleepstart(&(s))
+#define LOCKSTAT_SLEEPEND(s)	lockstat_sleepend(&(s))
+#define LOCKSTAT_RECORD(c, s)	lockstat_record(c, &(s))
+
+#else
+
+#define LOCKSTAT_CLASS(sym)
+#define LOCKSTAT_PERCPU(sym)
+#define LOCKSTAT_CLASS_INITIALIZER
+
+#define LOCKSTAT_SETCLASS(c, kind, name)
+#define LOCKSTAT_SETCLASS_ADDR(c, kind, addr)
+
+#define LOCKSTAT_SAMPLE(s)
+#define LOCKSTAT_CONTENDED(s)
+#define LOCKSTAT_SPINS(s, n)
+#define LOCKSTAT_SLEEPSTART(s)
+#define LOCKSTAT_SLEEPEND(s)
+#define LOCKSTAT_RECORD(c, s)
+
+#endif
+
+#endif /* _LOCKSTAT_H_ */
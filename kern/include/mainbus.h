@@ -58,6 +58,13 @@ void mainbus_send_ipi(struct cpu *target);
 /* Request breaking into the debugger, where available. */
 void mainbus_debugger(void);
 
+/*
+ * Cheap per-cpu cycle counter, and conversion to nanoseconds. Call
+ * with interrupts off; values from different cpus can't be compared.
+ */
+uint64_t mainbus_cycles(void);
+uint64_t mainbus_cycles_to_ns(uint64_t cycles);
+
 /*
  * The various ways to shut down the system. (These are very low-level
  * and should generally not be called directly - md_poweroff, for
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MMAP_H_
+#define _MMAP_H_
+
+/*
+ * File mappings (mmap) within an address space.
+ *
+ * An address space keeps its mappings in a list sorted by address.
+ * Each page of a mapping starts out empty and is filled in on first
+ * fault from the page cache (pagecache.h). A MAP_SHARED page stays
+ * the cache page. A MAP_PRIVATE page is the cache page, mapped read
+ * only, until the first write, which gives it a private copy.
+ *
+ * These functions only keep the books; the VM system calls them and
+ * does the MMU work (see dumbvm.c).
+ */
+
+struct vnode;
+struct pcpage;
+
+struct mmpage {
+	struct pcpage *mp_cached;	/* page cache page, or NULL */
+	paddr_t mp_private;		/* private copy, or 0 */
+};
+
+struct mmapping {
+	vaddr_t mm_base;		/* page-aligned start */
+	unsigned mm_npages;		/* length in pages */
+	int mm_prot;			/* PROT_* */
+	int mm_flags;			/* MAP_SHARED or MAP_PRIVATE */
+	struct vnode *mm_vnode;		/* file; we hold a reference */
+	off_t mm_offset;		/* page-aligned offset of mm_base */
+	struct mmpage *mm_pages;	/* per-page state */
+	struct mmapping *mm_next;	/* next higher mapping */
+};
+
+/*
+ * Operations:
+ *    mmap_create     - map LEN bytes of VN from OFFSET at the highest
+ *                      free address in [LO, HI); hands back the address.
+ *    mmap_remove     - unmap whole mappings in [ADDR, ADDR+LEN); fails
+ *                      with EINVAL if any mapping is only partly
+ *                      covered. Shared pages are written back.
+ *    mmap_sync       - write back shared pages in [ADDR, ADDR+LEN).
+ *                      Sets *FLUSH if pages were marked clean, in which
+ *                      case the caller must drop any writable TLB
+ *                      entries it has for them.
+ *    mmap_fault      - resolve a fault at VADDR in some mapping; hands
+ *                      back the physical page and whether it may be
+ *                      mapped writable. EFAULT if there is no mapping
+ *                      or the access isn't permitted.
+ *    mmap_copy       - copy a list of mappings, as for fork.
+ *    mmap_destroyall - unmap everything.
+ */
+int mmap_create(struct mmapping **list, vaddr_t lo, vaddr_t hi, size_t len,
+		int prot, int flags, struct vnode *vn, off_t offset,
+		vaddr_t *ret);
+int mmap_remove(struct mmapping **list, vaddr_t addr, size_t len);
+int mmap_sync(struct mmapping *list, vaddr_t addr, size_t len, bool *flush);
+int mmap_fault(struct mmapping *list, vaddr_t vaddr, int faulttype,
+	       paddr_t *paddr_ret, bool *writable_ret);
+int mmap_copy(struct mmapping *old, struct mmapping **ret);
+void mmap_destroyall(struct mmapping **list);
+
+#endif /* _MMAP_H_ */
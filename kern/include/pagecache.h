@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PAGECACHE_H_
+#define _PAGECACHE_H_
+
+/*
+ * Page cache for mapped files.
+ *
+ * Holds one physical page per (vnode, page-aligned offset) that some
+ * mapping refers to, so that every MAP_SHARED mapping of a file page
+ * sees the same memory, and MAP_PRIVATE mappings can read it without
+ * a copy until they first write.
+ *
+ * Pages are read in with VOP_READ the first time they're needed and
+ * written back with VOP_WRITE. A page is dropped (after writeback, if
+ * dirty) when the last reference to it goes away.
+ */
+
+struct vnode;
+
+struct pcpage {
+	struct vnode *pc_vnode;		/* file; we hold a reference */
+	off_t pc_offset;		/* page-aligned offset in file */
+	paddr_t pc_paddr;		/* the page */
+	unsigned pc_refcount;		/* mappings using this page */
+	bool pc_busy;			/* being read in */
+	bool pc_dirty;			/* needs writeback */
+	unsigned pc_dirtytime;		/* tick it was dirtied or written */
+	struct pcpage *pc_next;		/* hash chain */
+};
+
+/* Call once during system startup. */
+void pagecache_bootstrap(void);
+
+/* Get (reading in if needed) a referenced page of VN at OFFSET. */
+int pagecache_get(struct vnode *vn, off_t offset, struct pcpage **ret);
+
+/* Add a reference to a page that is already held. */
+void pagecache_incref(struct pcpage *pg);
+
+/* Drop a reference; the last one writes back and frees the page. */
+void pagecache_release(struct pcpage *pg);
+
+/* Note that the page has been (or is about to be) written. */
+void pagecache_markdirty(struct pcpage *pg);
+
+/*
+ * Write the page back if it is dirty. Sets *CLEANED if the page was
+ * marked clean, which is only done if the caller holds the only
+ * reference; the caller must then make sure it takes a fault (and
+ * calls pagecache_markdirty) before writing to it again.
+ */
+int pagecache_sync(struct pcpage *pg, bool *cleaned);
+
+/*
+ * Write back up to a batch of the pages that have been dirty for at
+ * least EXPIRE ticks, oldest first. Pages stay dirty, since they may
+ * still be mapped writable, but their age starts over. Returns how
+ * many pages were written. For the filesystem flusher.
+ */
+unsigned pagecache_flush(unsigned expire);
+
+/* Number of dirty pages. */
+unsigned pagecache_ndirty(void);
+
+#endif /* _PAGECACHE_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PID_H_
+#define _PID_H_
+
+/*
+ * Process ID management.
+ *
+ * The PID table holds one slot per possible live process. A PID
+ * always lives in slot (pid % PROCS_MAX), so lookup is an array
+ * index. Free slots are tracked in a bitmap with a hint pointing at
+ * the lowest word that may have a free bit, so allocation doesn't
+ * scan the table. Successive PIDs for the same slot step through
+ * the PID space, so a PID isn't reused soon after it's freed.
+ *
+ * A slot outlives its process: after _exit it holds the exit status
+ * and final resource usage until the parent collects them with
+ * waitpid, or until the parent itself exits.
+ */
+
+struct acct;
+
+/* Maximum number of processes (live or awaiting waitpid) at once */
+#define PROCS_MAX	256
+
+/* Not a valid PID; used as "no parent" and for the kernel process */
+#define INVALID_PID	0
+
+/*
+ * Operations:
+ *    pid_bootstrap - call once during system startup.
+ *    pid_alloc     - allocate a PID for a new child of PARENT (which
+ *                    may be INVALID_PID).
+ *    pid_unalloc   - release a PID that was never used (fork failed).
+ *    pid_exit      - record the exit status and resource usage of
+ *                    PID and wake its parent. Its own children are
+ *                    orphaned; any of them that have already exited
+ *                    are released.
+ *    pid_wait      - wait for PID, which must be a child of PARENT,
+ *                    to exit; hand back its status and usage and
+ *                    release it. With WNOHANG, sets *RET to 0
+ *                    instead of waiting.
+ */
+void pid_bootstrap(void);
+int pid_alloc(pid_t parent, pid_t *ret);
+void pid_unalloc(pid_t pid);
+void pid_exit(pid_t pid, int status, const struct acct *acct);
+int pid_wait(pid_t pid, pid_t parent, int flags, int *status,
+	     struct acct *acct, pid_t *ret);
+
+
+#endif /* _PID_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Readiness notification, for poll() and select().
+ *
+ * Any object that can block a reader or writer (the console, pipes,
+ * and so forth) embeds a struct pollq. When a thread polls the
+ * object, its VOP_POLL routine registers the caller's pollset on the
+ * pollq with pollq_register() and reports which of the requested
+ * events are already true. When the object's state changes, it calls
+ * pollq_wakeup() with the events that may now be true.
+ *
+ * pollq_wakeup() does not merely wake the poller; it also queues the
+ * matching registration on the pollset's ready list. After sleeping,
+ * the poller only rechecks the objects on that list, so the cost of
+ * each wakeup is proportional to the number of objects that became
+ * ready rather than to the number of file handles being watched.
+ *
+ * pollq_wakeup() may be called from interrupt handlers.
+ */
+
+#include <kern/poll.h>
+#include <spinlock.h>
+
+struct pollent;		/* Opaque; one registration of one file handle */
+struct pollset;		/* Opaque; state of one poll()/select() call */
+
+struct pollq {
+	struct spinlock pq_lock;	/* protects pq_head */
+	struct pollent *pq_head;	/* registered pollsets */
+};
+
+void pollq_init(struct pollq *pq);
+void pollq_cleanup(struct pollq *pq);
+void pollq_register(struct pollq *pq, struct pollset *ps);
+void pollq_wakeup(struct pollq *pq, int events);
+
+/*
+ * In-kernel poll entry point, shared by sys_poll and sys_select.
+ * FDS/NFDS are already copied into the kernel; on return the revents
+ * fields are filled in and *NREADY holds the number of entries with
+ * nonzero revents. TIMEOUT_MS < 0 means wait forever; 0 means don't
+ * wait at all.
+ */
+int poll_kern(struct pollfd *fds, unsigned nfds, int timeout_ms,
+	      unsigned *nready);
+
+
+#endif /* _POLL_H_ */
@@ -37,21 +37,26 @@
  */
 
 #include <spinlock.h>
+#include <acct.h>
 
 struct addrspace;
+struct filetable;
+struct semaphore;
 struct thread;
 struct vnode;
 
 /*
  * Process structure.
  *
- * Note that we only count the number of threads in each process.
- * (And, unless you implement multithreaded user processes, this
- * number will not exceed 1 except in kproc.) If you want to know
- * exactly which threads are in the process, e.g. for debugging, add
- * an array and a sleeplock to protect it. (You can't use a spinlock
- * to protect an array because arrays need to be able to call
- * kmalloc.)
+ * The threads in each process are kept on a list threaded through
+ * t_procnext, under p_lock, so their resource usage can be added
+ * up. (Unless you implement multithreaded user processes, there
+ * will not be more than one except in kproc.)
+ *
+ * p_acct holds the usage of the process's threads that have
+ * already left it; p_acctchildren that of its children that have
+ * been collected with waitpid (and, recursively, theirs). Both are
+ * protected by p_lock.
  *
  * You will most likely be adding stuff to this structure, so you may
  * find you need a sleeplock in here for other reasons as well.
@@ -63,12 +68,22 @@ struct proc {
 	char *p_name;			/* Name of this process */
 	struct spinlock p_lock;		/* Lock for this structure */
 	unsigned p_numthreads;		/* Number of threads in this process */
+	struct thread *p_threads;	/* The threads themselves */
+	pid_t p_pid;			/* Process ID (see pid.h) */
+	struct proc *p_allnext;		/* Link on list of all processes */
+	struct proc *p_allprev;
+
+	/* Resource usage */
+	struct acct p_acct;		/* of threads that have left */
+	struct acct p_acctchildren;	/* of children waited for */
 
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
+	struct semaphore *p_vforksem;	/* set while borrowing parent's */
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
+	struct filetable *p_filetable;	/* open file handles */
 
 	/* add more material here as needed */
 };
@@ -82,15 +97,30 @@ void proc_bootstrap(void);
 /* Create a fresh process for use by runprogram(). */
 struct proc *proc_create_runprogram(const char *name);
 
+/* Create a copy of the current process for fork() or vfork(). */
+int proc_fork(struct semaphore *vforksem, struct proc **ret);
+
+/* Hand a borrowed address space back to the vfork parent, if any. */
+bool proc_vforkdone(void);
+
 /* Destroy a process. */
 void proc_destroy(struct proc *proc);
 
+/* Exit the current process with wait status STATUS. Does not return. */
+__DEAD void proc_exit(int status);
+
 /* Attach a thread to a process. Must not already have a process. */
 int proc_addthread(struct proc *proc, struct thread *t);
 
 /* Detach a thread from its process. */
 void proc_remthread(struct thread *t);
 
+/* Add up the resource usage of a process's threads, past and present. */
+void proc_getacct(struct proc *proc, struct acct *ret);
+
+/* Print a line for each process, for the "ps" menu command. */
+void proc_dump(void);
+
 /* Fetch the address space of the current process. */
 struct addrspace *proc_getas(void);
 
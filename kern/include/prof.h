@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+/*
+ * Kernel sampling profiler.
+ *
+ * While the profiler is running, every hardclock on every cpu looks
+ * at the PC the timer interrupt came in at and counts it in that
+ * cpu's histogram of the kernel text. Samples taken in user mode are
+ * only counted, not located. The report adds up all the cpus and
+ * attributes the buckets to functions using the symbol table of the
+ * kernel image, read from disk; if that can't be found, it prints
+ * raw addresses instead.
+ *
+ * Starting, stopping, and resetting also turn trace161's own
+ * profiler on and off and clear it (see ltrace.h), so a profile
+ * collected there covers the same stretch.
+ *
+ * These are meant to be run from the menu, one at a time.
+ *
+ *    prof_start     - start sampling. Returns ENOMEM if the histograms
+ *                     can't be allocated.
+ *    prof_stop      - stop sampling; the data is kept.
+ *    prof_reset     - discard the samples collected so far.
+ *    prof_dump      - print the TOPN hottest functions, using the
+ *                     kernel image at KERNELPATH (NULL for the
+ *                     default, PROF_KERNEL).
+ *    prof_count     - total kernel samples with PCs in [START, END).
+ *    prof_hardclock - take a sample on the current cpu; called from
+ *                     hardclock.
+ */
+
+/* Defaults for prof_dump */
+#define PROF_KERNEL	"emu0:kernel"
+#define PROF_DEFTOP	20
+
+int prof_start(void);
+void prof_stop(void);
+void prof_reset(void);
+void prof_dump(unsigned topn, const char *kernelpath);
+unsigned prof_count(vaddr_t start, vaddr_t end);
+void prof_hardclock(void);
+
+
+#endif /* _PROF_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _RCU_H_
+#define _RCU_H_
+
+/*
+ * Read-copy-update.
+ *
+ * For tables that are read all the time and hardly ever changed.
+ * Readers bracket their lookups with rcu_read_lock/rcu_read_unlock,
+ * which take no locks and touch no shared memory; they just keep the
+ * thread from being preempted. Read-side sections may not sleep.
+ *
+ * Writers (which must still exclude each other by some other means)
+ * build a new version of whatever they are changing, publish it with
+ * rcu_assign_pointer, and then free the old version only after a
+ * grace period: by then every cpu has passed through a quiescent
+ * state (a context switch, or a clock tick outside any read-side
+ * section), so no reader can still be looking at it.
+ *
+ *    rcu_read_lock     - Enter a read-side section. Nests.
+ *    rcu_read_unlock   - Leave a read-side section.
+ *    rcu_dereference   - Fetch a pointer published with
+ *                        rcu_assign_pointer, inside a read section.
+ *    rcu_assign_pointer - Publish a pointer to a new version.
+ *    rcu_synchronize   - Wait for a grace period. May sleep.
+ *    rcu_call          - Run FUNC(HEAD) after a grace period, from
+ *                        the rcu thread. Does not sleep.
+ *
+ * rcu_quiescent is called by the thread and clock code to report
+ * quiescent states; it must be called with interrupts off.
+ */
+
+#include <membar.h>
+
+struct cpu;
+
+struct rcu_head {
+	struct rcu_head *rh_next;
+	void (*rh_func)(struct rcu_head *);
+};
+
+void rcu_bootstrap(void);
+void rcu_cpuinit(struct cpu *c);
+void rcu_quiescent(void);
+
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+void rcu_synchronize(void);
+void rcu_call(struct rcu_head *head, void (*func)(struct rcu_head *));
+
+/*
+ * Readers only follow the pointer they load, and no cpu we run on
+ * reorders dependent loads, so a volatile load is enough; the writer
+ * needs a barrier so the new version's contents are visible before
+ * the pointer to it is.
+ */
+#define rcu_dereference(p)	(*(__typeof__(p) volatile *)&(p))
+
+#define rcu_assign_pointer(p, v) \
+	do { membar_store_store(); (p) = (v); } while (0)
+
+#endif /* _RCU_H_ */
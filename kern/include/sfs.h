@@ -56,6 +56,7 @@ struct sfs_vnode {
 	struct sfs_dinode sv_i;		/* copy of on-disk inode */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	unsigned sv_dirtytime;          /* tick sv_dirty was last set */
 };
 
 /*
@@ -69,6 +70,9 @@ struct sfs_fs {
 	struct vnodearray *sfs_vnodes;  /* vnodes loaded into memory */
 	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
 	bool sfs_freemapdirty;          /* true if freemap modified */
+	unsigned sfs_freemaptime;       /* tick freemapdirty was set */
+	unsigned sfs_ndirtied;          /* inodes dirtied since flush */
+	struct sfs_fs *sfs_flushnext;   /* list of mounted volumes */
 };
 
 /*
@@ -76,5 +80,13 @@ struct sfs_fs {
  */
 int sfs_mount(const char *device);
 
+/*
+ * Background writeback. Every INTERVAL ticks the flusher writes out
+ * metadata (and mapped file pages) that has been dirty for at least
+ * EXPIRE ticks. Both are in ticks; INTERVAL must be nonzero.
+ */
+void sfs_flush_setparams(unsigned interval, unsigned expire);
+void sfs_flush_getparams(unsigned *interval, unsigned *expire);
+
 
 #endif /* _SFS_H_ */
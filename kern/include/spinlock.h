@@ -37,6 +37,7 @@
 
 #include <cdefs.h>
 #include <hangman.h>
+#include <lockstat.h>
 
 /* Inlining support - for making sure an out-of-line copy gets built */
 #ifndef SPINLOCK_INLINE
@@ -51,24 +52,36 @@
  *
  * Note that spinlocks are held by CPUs, not by threads.
  *
+ * This is a ticket lock: each CPU that wants the lock atomically
+ * takes the next number from splk_next and then waits until
+ * splk_owner reaches it. This hands the lock out in arrival order,
+ * so no CPU can be starved, and waiters only read while they spin
+ * instead of all hammering the same word with test-and-set.
+ *
  * This structure is made public so spinlocks do not have to be
  * malloc'd; however, code that uses spinlocks should not look inside
  * the structure directly but always use the spinlock API functions.
  */
 struct spinlock {
-	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
-	struct cpu *splk_holder;	    /* CPU holding this lock. */
-	HANGMAN_LOCKABLE(splk_hangman);     /* Deadlock detector hook. */
+	volatile spinlock_data_t splk_next;  /* Next ticket to hand out. */
+	volatile spinlock_data_t splk_owner; /* Ticket now being served. */
+	struct cpu *splk_holder;	     /* CPU holding this lock. */
+	LOCKSTAT_CLASS(splk_lsclass);	     /* Lock statistics class. */
+	HANGMAN_LOCKABLE(splk_hangman);      /* Deadlock detector hook. */
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
  */
 #ifdef OPT_HANGMAN
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL, \
+#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, \
+				  SPINLOCK_DATA_INITIALIZER, NULL, \
+				  LOCKSTAT_CLASS_INITIALIZER \
 				  HANGMAN_LOCKABLE_INITIALIZER }
 #else
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, \
+				  SPINLOCK_DATA_INITIALIZER, NULL, \
+				  LOCKSTAT_CLASS_INITIALIZER }
 #endif
 
 /*
@@ -80,7 +80,11 @@ struct lock {
 		struct wchan *lk_wchan;
 		struct spinlock lk_lock;
 		volatile bool lk_locked;
-		struct thread *lk_holder;
+		struct thread *volatile lk_holder;
+		bool lk_handoff;	/* see lock_sethandoff */
+		struct thread *lk_piwaiters;	/* sleepers, via t_pinext */
+		struct lock *lk_heldnext;	/* holder's t_heldlocks */
+		LOCKSTAT_CLASS(lk_lsclass);
 };
 
 struct lock *lock_create(const char *name);
@@ -96,10 +100,37 @@ void lock_destroy(struct lock *);
  *                   false otherwise.
  *
  * These operations must be atomic. You get to write them.
+ *
+ * Locks are adaptive: if the holder is running on another cpu,
+ * lock_acquire spins for a short while waiting for it to let go
+ * before giving up and sleeping, since that is usually cheaper than
+ * a pair of context switches. If the holder is asleep, runnable but
+ * not running, or on our own cpu, lock_acquire sleeps right away.
+ *
+ *    lock_sethandoff - In handoff mode, lock_release with threads
+ *                   asleep on the lock gives it directly to the first
+ *                   of them instead of freeing it, so the woken
+ *                   thread can't lose it to a newcomer and go back to
+ *                   sleep. That costs throughput when the lock is
+ *                   busy (nobody can take it until the new owner gets
+ *                   to run), so it's off by default.
+ *
+ * Locks do priority inheritance: while a thread sleeps in lock_acquire,
+ * the holder runs at (at least) the sleeper's priority, and so does
+ * whatever thread holds a lock the holder is itself asleep on, and so
+ * on down the chain. lock_release drops whatever boost the released
+ * lock brought, and wakes the highest priority sleeper.
  */
 void lock_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_do_i_hold(struct lock *);
+void lock_sethandoff(struct lock *, bool);
+
+/*
+ * Recompute the current thread's priority from its base priority and
+ * the threads asleep on locks it holds. For thread_setpriority.
+ */
+void lock_pi_update(void);
 
 
 /*
@@ -122,6 +153,8 @@ struct cv {
         // (don't forget to mark things volatile as needed)
 		struct wchan *cv_wchan;
 		struct spinlock cv_lock;
+		struct lock *cv_waitlock;	/* lock the sleepers hold, if one */
+		LOCKSTAT_CLASS(cv_lsclass);
 };
 
 struct cv *cv_create(const char *name);
@@ -134,13 +167,25 @@ void cv_destroy(struct cv *);
  *    cv_signal    - Wake up one thread that's sleeping on this CV.
  *    cv_broadcast - Wake up all threads sleeping on this CV.
  *
- * For all three operations, the current thread must hold the lock passed
+ *    cv_wait_timeout - Like cv_wait, but give up waiting after TICKS
+ *                   hardclock ticks. Returns 0 if signaled and
+ *                   ETIMEDOUT if not; reacquires the lock either way.
+ *
+ * For all these operations, the current thread must hold the lock passed
  * in. Note that under normal circumstances the same lock should be used
  * on all operations with any particular CV.
  *
+ * Since the signaler holds the lock, a thread woken by cv_signal or
+ * cv_broadcast would only run to find the lock taken and go back to
+ * sleep on it. So instead, if the lock is the one the sleepers are
+ * waiting with, they are moved straight onto the lock's wait channel
+ * ("wait morphing") and woken one at a time as the lock is released.
+ * All threads waiting on a CV at once must use the same lock.
+ *
  * These operations must be atomic. You get to write them.
  */
 void cv_wait(struct cv *cv, struct lock *lock);
+int cv_wait_timeout(struct cv *cv, struct lock *lock, unsigned ticks);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
 
@@ -154,20 +199,36 @@ void cv_broadcast(struct cv *cv, struct lock *lock);
  * (should be) made internally.
  */
 
-#define RWHASHVAL 6 
+/*
+ * The state word holds the number of readers plus the RW_WRITER and
+ * RW_WAITERS bits. When nobody is waiting, acquiring and releasing
+ * is a single compare-and-swap on it. Once anyone has to wait,
+ * RW_WAITERS is set and everyone goes through rw_lk instead, which
+ * also protects the waiter counts below.
+ *
+ * Waiting writers are preferred over arriving readers, but after
+ * RW_WRITEBATCH writers in a row have gone ahead of waiting readers,
+ * the readers waiting at that point get their turn.
+ */
+#define RW_WRITER	0x80000000	/* A writer holds the lock */
+#define RW_WAITERS	0x40000000	/* Someone is waiting */
+#define RW_READERS	0x3fffffff	/* Mask for the reader count */
+#define RW_WRITEBATCH	4
 
 struct rwlock {
         char *rw_name;
         // add what you need here
         // (don't forget to mark things volatile as needed)
-		struct lock *rw_lock;
-		struct cv *rw_cvread;
-		struct cv *rw_cvwrite;
-		volatile unsigned rw_readin;
-		volatile unsigned rw_writein;
-		volatile unsigned rw_wturnin;
-		volatile unsigned rw_readwt;
-		volatile unsigned rw_writewt;
+		volatile spinlock_data_t rw_state;
+		struct thread *rw_writer;
+		struct spinlock rw_lk;
+		struct wchan *rw_rwchan;
+		struct wchan *rw_wwchan;
+		unsigned rw_nrwait;	/* Readers waiting */
+		unsigned rw_nwwait;	/* Writers waiting */
+		unsigned rw_readadmit;	/* Waiting readers to let in */
+		unsigned rw_wstreak;	/* Writers ahead of waiting readers */
+		LOCKSTAT_CLASS(rw_lsclass);
 };
 
 struct rwlock * rwlock_create(const char *name);
@@ -35,10 +35,13 @@
 struct trapframe; /* from <machine/trapframe.h> */
 
 /*
- * The system call dispatcher.
+ * The system call dispatcher, and a variant for calls that take
+ * only register arguments (for which syscall_isfast is true).
  */
 
 void syscall(struct trapframe *tf);
+bool syscall_isfast(int callno);
+void syscall_fast(struct trapframe *tf);
 
 /*
  * Support functions.
@@ -58,5 +61,32 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_nanosleep(const_userptr_t req, userptr_t rem);
+
+int sys_fork(struct trapframe *tf, int32_t *retval);
+int sys_vfork(struct trapframe *tf, int32_t *retval);
+int sys_execv(const_userptr_t program, userptr_t args);
+int sys_waitpid(pid_t pid, userptr_t status, int options, int32_t *retval);
+__DEAD void sys__exit(int exitcode);
+int sys_getpid(int32_t *retval);
+int sys_getrusage(int who, userptr_t usage);
+
+int sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd,
+	     off_t offset, int32_t *retval);
+int sys_munmap(userptr_t addr, size_t len);
+int sys_msync(userptr_t addr, size_t len, int flags);
+
+int sys_futex(userptr_t uaddr, int op, int val, const_userptr_t timeout,
+	      int32_t *retval);
+
+int sys_open(const_userptr_t path, int flags, mode_t mode, int32_t *retval);
+int sys_read(int fd, userptr_t buf, size_t size, int32_t *retval);
+int sys_write(int fd, userptr_t buf, size_t size, int32_t *retval);
+int sys_close(int fd);
+int sys_pipe(userptr_t fds, int32_t *retval);
+
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int32_t *retval);
+int sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	       userptr_t exceptfds, userptr_t timeout, int32_t *retval);
 
 #endif /* _SYSCALL_H_ */
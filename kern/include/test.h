@@ -57,12 +57,15 @@ int threadlisttest(int, char **);
 int threadtest(int, char **);
 int threadtest2(int, char **);
 int threadtest3(int, char **);
+int threadbench(int, char **);
 int semtest(int, char **);
 int locktest(int, char **);
 int locktest2(int, char **);
 int locktest3(int, char **);
 int locktest4(int, char **);
 int locktest5(int, char **);
+int spinlocktest(int, char **);
+int lockbench(int, char **);
 int cvtest(int, char **);
 int cvtest2(int, char **);
 int cvtest3(int, char **);
@@ -73,6 +76,15 @@ int rwtest2(int, char **);
 int rwtest3(int, char **);
 int rwtest4(int, char **);
 int rwtest5(int, char **);
+int rwbench(int, char **);
+int rcutest(int, char **);
+int timertest(int, char **);
+int cvbench(int, char **);
+int pitest(int, char **);
+int counttest(int, char **);
+int proftest(int, char **);
+int tracetest(int, char **);
+int workqtest(int, char **);
 
 /* semaphore unit tests */
 int semu1(int, char **);
@@ -119,7 +131,7 @@ int kmalloctest5(int, char **);
 int nettest(int, char **);
 
 /* Routine for running a user-level program. */
-int runprogram(char *progname);
+int runprogram(char *progname, char **args, int nargs);
 
 /* Kernel menu system. */
 void menu(char *argstr);
@@ -39,8 +39,10 @@
 #include <array.h>
 #include <spinlock.h>
 #include <threadlist.h>
+#include <acct.h>
 
 struct cpu;
+struct lock;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -56,6 +58,11 @@ struct cpu;
 /* Macro to test if two addresses are on the same kernel stack */
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
+/* Thread priorities. Higher numbers run first. */
+#define PRI_MIN		0
+#define PRI_DEFAULT	16
+#define PRI_MAX		31
+
 
 /* States a thread can be in. */
 typedef enum {
@@ -82,7 +89,9 @@ struct thread {
 
 	char t_name[MAX_NAME_LENGTH];
 	const char *t_wchan_name;	/* Name of wait channel, if sleeping */
+	struct wchan *t_wchan;		/* Wait channel, if sleeping */
 	threadstate_t t_state;		/* State this thread is in */
+	unsigned t_nswitches;		/* Times switched off the cpu */
 
 	/*
 	 * Thread subsystem internal fields.
@@ -92,7 +101,9 @@ struct thread {
 	void *t_stack;			/* Kernel-level stack */
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
+	bool t_bound;			/* Never migrate off t_cpu */
 	struct proc *t_proc;		/* Process thread belongs to */
+	struct thread *t_procnext;	/* Next thread in t_proc */
 	HANGMAN_ACTOR(t_hangman);	/* Deadlock detector hook */
 
 	/*
@@ -112,6 +123,38 @@ struct thread {
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	/*
+	 * t_rcudepth counts nested rcu_read_lock calls. While it is
+	 * nonzero the thread may not sleep and is not preempted.
+	 */
+	unsigned t_rcudepth;
+
+	/*
+	 * Priority. t_basepri is what thread_setpriority set; t_pri is
+	 * what the scheduler goes by, and is higher while a thread of
+	 * higher priority is blocked on a lock this one holds. Run
+	 * queues and wait channels are kept sorted by t_pri.
+	 *
+	 * The rest is priority inheritance state, and belongs to
+	 * synch.c: the lock we're asleep in lock_acquire for, our link
+	 * on that lock's list of such sleepers, and the locks we hold.
+	 */
+	int t_basepri;
+	volatile int t_pri;
+	struct lock *t_waitlock;
+	struct thread *t_pinext;
+	struct lock *t_heldlocks;
+
+	/*
+	 * Resource usage (see acct.h). t_acct_since is when the thread
+	 * was last charged for its time, in cycles on the cpu it is
+	 * running on, and t_acct_user is whether that time goes to
+	 * user or system time.
+	 */
+	struct acct t_acct;
+	uint64_t t_acct_since;
+	bool t_acct_user;
+
 	/*
 	 * Public fields
 	 */
@@ -155,6 +198,25 @@ int thread_fork(const char *name, struct proc *proc,
                 void (*func)(void *, unsigned long),
                 void *data1, unsigned long data2);
 
+/*
+ * The same, but the new thread runs on cpu C and stays there: the
+ * scheduler never migrates it. For per-cpu service threads.
+ */
+int thread_fork_bound(const char *name, struct proc *proc, struct cpu *c,
+		      void (*func)(void *, unsigned long),
+		      void *data1, unsigned long data2);
+
+/*
+ * Get the number of times thread_fork has reused an exited thread
+ * from a cpu's cache, and the number of times it had to allocate one.
+ */
+void thread_cachestats(unsigned *hits, unsigned *misses);
+
+/*
+ * Free the exited threads the cpus are keeping for reuse.
+ */
+void thread_cache_drain(void);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
@@ -168,6 +230,18 @@ __DEAD void thread_exit(void);
  */
 void thread_yield(void);
 
+/*
+ * Set the current thread's base priority, PRI_MIN to PRI_MAX. Threads
+ * start out with their creator's base priority.
+ */
+void thread_setpriority(int pri);
+
+/*
+ * Called by the lock code after changing T's t_pri, to move it to its
+ * new place if it's waiting on a run queue.
+ */
+void thread_reprioritize(struct thread *t);
+
 /*
  * Reshuffle the run queue. Called from the timer interrupt.
  */
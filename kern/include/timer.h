@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+/*
+ * Kernel timers.
+ *
+ * A timer calls FUNC(DATA) once, from hardclock, some number of ticks
+ * in the future. Each cpu keeps its own timer wheel; a timer goes on
+ * the wheel of the cpu that starts it and fires there, in interrupt
+ * context, so the callback may take spinlocks but must not sleep.
+ *
+ *    timer_init  - Set up a timer. The struct timer belongs to the
+ *                  caller and is usually embedded in something else.
+ *    timer_start - Arm the timer to fire TICKS hardclock ticks from
+ *                  now (at least one). Restarts it if already armed.
+ *    timer_stop  - Disarm the timer. Returns true if it was armed
+ *                  and so will now never fire. If the callback is
+ *                  running on another cpu, waits for it to finish,
+ *                  so afterwards the timer may be freed. Don't call
+ *                  it holding a spinlock the callback takes.
+ *
+ * Starting and stopping the same timer must be serialized by the
+ * caller (in practice, one thread owns each timer).
+ *
+ * Ticks are in clock_getticks() units; see HZ in clock.h.
+ */
+
+struct cpu;
+struct timerwheel;	/* Opaque */
+
+struct timer {
+	struct timer *tm_next;		/* wheel slot linkage */
+	struct timer **tm_prevp;
+	struct timerwheel *tm_wheel;	/* wheel last started on */
+	bool tm_pending;		/* on the wheel, not yet fired */
+	unsigned tm_expires;		/* deadline, in ticks */
+	void (*tm_func)(void *);
+	void *tm_data;
+};
+
+void timer_init(struct timer *tm, void (*func)(void *), void *data);
+void timer_start(struct timer *tm, unsigned ticks);
+bool timer_stop(struct timer *tm);
+
+/* Convert milliseconds to ticks, rounding up. */
+#define TIMER_MSTOTICKS(ms) DIVROUNDUP((unsigned)(ms), 1000 / HZ)
+
+/* Called from cpu_create and hardclock. */
+void timer_cpuinit(struct cpu *c);
+void timer_hardclock(void);
+
+
+#endif /* _TIMER_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/*
+ * In-kernel event tracing.
+ *
+ * Tracepoints are compiled in where the events happen:
+ *
+ *      tracepoint(TRACE_VMFAULT, faulttype, faultaddress);
+ *
+ * and cost one flag check while tracing is off. While it's on, each
+ * one writes a binary record (struct trace_record, in <kern/trace.h>)
+ * into the current cpu's ring. A ring is only ever written by its own
+ * cpu, with interrupts off for the few instructions it takes, so
+ * there is no lock and no shared cache line, and nothing goes near
+ * the console. When a ring fills up, the oldest records are
+ * overwritten.
+ *
+ * The control functions are meant to be run from the menu, one at a
+ * time.
+ *
+ *    trace_start  - start recording, allocating the rings the first
+ *                   time. Returns ENOMEM if they can't be allocated.
+ *    trace_stop   - stop recording; the records are kept.
+ *    trace_reset  - discard the records.
+ *    trace_dump   - print the last NUM records, all cpus merged in
+ *                   time order.
+ *    trace_save   - write all the records to the file PATH, for the
+ *                   tracedump tool.
+ *    trace_count  - number of EVENT records currently held.
+ *    tracepoint   - record EVENT with arguments ARG0 and ARG1.
+ */
+
+#include <kern/trace.h>
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef TRACE_INLINE
+#define TRACE_INLINE INLINE
+#endif
+
+/* Default number of records trace_dump is asked for */
+#define TRACE_DEFDUMP	100
+
+extern volatile bool trace_enabled;
+
+int trace_start(void);
+void trace_stop(void);
+void trace_reset(void);
+void trace_dump(unsigned num);
+int trace_save(const char *path);
+unsigned trace_count(unsigned event);
+void trace_record(unsigned event, uint32_t arg0, uint32_t arg1);
+TRACE_INLINE void tracepoint(unsigned event, uint32_t arg0, uint32_t arg1);
+
+
+TRACE_INLINE
+void
+tracepoint(unsigned event, uint32_t arg0, uint32_t arg1)
+{
+	if (trace_enabled) {
+		trace_record(event, arg0, arg1);
+	}
+}
+
+
+#endif /* _TRACE_H_ */
@@ -33,6 +33,7 @@
 #include <spinlock.h>
 struct uio;
 struct stat;
+struct pollset;
 
 
 /*
@@ -117,12 +118,22 @@ struct vnode {
  *                      and directories are seekable, but some devices are
  *                      not.
  *
+ *    vop_poll        - Return the subset of the poll events EVENTS
+ *                      (see kern/poll.h) that are currently true of
+ *                      this object. If PS is not NULL and the object
+ *                      can block, register PS on the object's pollq
+ *                      (see poll.h) *before* checking its state, so
+ *                      that a change that happens afterwards is not
+ *                      missed. Objects that never block can use
+ *                      vnode_pollready.
+ *
  *    vop_fsync       - Force any dirty buffers associated with this file
  *                      to stable storage.
  *
- *    vop_mmap        - Map file into memory. If you implement this
- *                      feature, you're responsible for choosing the
- *                      arguments for this operation.
+ *    vop_mmap        - Check whether the file can be mapped into
+ *                      memory. Returns 0 if so; the pages are then
+ *                      read and written with vop_read and vop_write
+ *                      by the page cache (see pagecache.h).
  *
  *    vop_truncate    - Forcibly set size of file to the length passed
  *                      in, discarding any excess blocks.
@@ -192,6 +203,7 @@ struct vnode_ops {
 	int (*vop_stat)(struct vnode *object, struct stat *statbuf);
 	int (*vop_gettype)(struct vnode *object, mode_t *result);
 	bool (*vop_isseekable)(struct vnode *object);
+	int (*vop_poll)(struct vnode *object, int events, struct pollset *ps);
 	int (*vop_fsync)(struct vnode *object);
 	int (*vop_mmap)(struct vnode *file /* add stuff */);
 	int (*vop_truncate)(struct vnode *file, off_t len);
@@ -236,6 +248,7 @@ struct vnode_ops {
 #define VOP_STAT(vn, ptr) 	        (__VOP(vn, stat)(vn, ptr))
 #define VOP_GETTYPE(vn, result)         (__VOP(vn, gettype)(vn, result))
 #define VOP_ISSEEKABLE(vn)              (__VOP(vn, isseekable)(vn))
+#define VOP_POLL(vn, events, ps)        (__VOP(vn, poll)(vn, events, ps))
 #define VOP_FSYNC(vn)                   (__VOP(vn, fsync)(vn))
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
 #define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
@@ -279,6 +292,12 @@ int vnode_init(struct vnode *, const struct vnode_ops *ops,
  */
 void vnode_cleanup(struct vnode *);
 
+/*
+ * vop_poll for objects that are always ready for I/O, such as
+ * regular files.
+ */
+int vnode_pollready(struct vnode *vn, int events, struct pollset *ps);
+
 /*
  * Common stubs for vnode functions that just fail, in various ways.
  */
@@ -66,6 +66,15 @@ bool wchan_isempty(struct wchan *wc, struct spinlock *lk);
  */
 void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Like wchan_sleep, but wake up anyway after TICKS hardclock ticks
+ * (see HZ in clock.h). Returns 0 if awakened by someone else and
+ * ETIMEDOUT if the time ran out. Only the thread whose time ran out
+ * is awakened.
+ */
+int wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk,
+			unsigned ticks);
+
 /*
  * Wake up one thread, or all threads, sleeping on a wait channel.
  * The associated spinlock should be locked.
@@ -76,5 +85,28 @@ void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeone(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeall(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Return the thread wchan_wakeone would wake next, without waking it,
+ * or NULL if the channel is empty. The associated spinlock should be
+ * locked.
+ */
+struct thread *wchan_peek(struct wchan *wc, struct spinlock *lk);
+
+/*
+ * Wake up a particular thread T, which must be sleeping on the
+ * channel. The associated spinlock should be locked.
+ */
+void wchan_wakethread(struct wchan *wc, struct spinlock *lk,
+		      struct thread *t);
+
+/*
+ * Move up to MAX threads sleeping on FROM, oldest first, to the end
+ * of TO without waking them; they stay asleep until TO is woken. Both
+ * spinlocks should be locked. Returns the number of threads moved.
+ */
+unsigned wchan_requeue(struct wchan *from, struct spinlock *fromlk,
+		       struct wchan *to, struct spinlock *tolk,
+		       unsigned max);
+
 
 #endif /* _WCHAN_H_ */
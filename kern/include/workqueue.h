@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Deferred work.
+ *
+ * A work item calls FUNC(DATA) later, in a kernel thread, where it
+ * may sleep, take locks and do I/O. This is for interrupt handlers
+ * and other code that can't do these things itself, and for
+ * background jobs that don't deserve a thread of their own.
+ *
+ * Each cpu has its own queue and a small pool of worker threads
+ * bound to it. Work runs on the cpu that queued it, so whatever it
+ * touches is likely to still be in that cpu's cache. Items on one
+ * queue are started in order, but with more than one worker they
+ * may overlap.
+ *
+ *    work_init    - Set up a work item. The struct work belongs to
+ *                   the caller and is usually embedded in something
+ *                   else.
+ *    work_queue   - Queue WK on this cpu. Does nothing and returns
+ *                   false if it is already pending (queued, or
+ *                   waiting to be). Does not sleep, so may be called
+ *                   from interrupt handlers.
+ *    work_queue_delayed - The same, but wait TICKS hardclock ticks
+ *                   (at least one) first.
+ *    work_cancel  - If WK is waiting out its delay, stop it and
+ *                   return true. Work already queued still runs;
+ *                   use work_flush to wait for it.
+ *    work_flush   - Wait until everything queued (on any cpu) before
+ *                   the call has finished running. Must not be
+ *                   called from a work function.
+ *
+ * The function may queue its own work item again. It may also free
+ * it: nothing touches the struct work after the call.
+ */
+
+#include <spinlock.h>
+#include <timer.h>
+
+struct cpu;
+
+struct work {
+	struct work *wk_next;		/* queue linkage */
+	volatile spinlock_data_t wk_pending; /* queued or delayed */
+	unsigned wk_seq;		/* position in its queue */
+	struct timer wk_timer;		/* for work_queue_delayed */
+	void (*wk_func)(void *);
+	void *wk_data;
+};
+
+void work_init(struct work *wk, void (*func)(void *), void *data);
+bool work_queue(struct work *wk);
+bool work_queue_delayed(struct work *wk, unsigned ticks);
+bool work_cancel(struct work *wk);
+void work_flush(void);
+
+/* Called from cpu_create, and from boot once the cpus are running. */
+void workqueue_cpuinit(struct cpu *c);
+void workqueue_bootstrap(void);
+
+
+#endif /* _WORKQUEUE_H_ */
@@ -35,7 +35,7 @@
 #include <cpu.h>
 #include <thread.h>
 #include <current.h>
-#include <synch.h>
+#include <spinlock.h>
 #include <mainbus.h>
 #include <vfs.h>          // for vfs_sync()
 #include <lamebus/ltrace.h> // for ltrace_stop()
@@ -46,12 +46,36 @@
 /* Flags word for DEBUG() macro. */
 uint32_t dbflags = 0;
 
-/* Lock for non-polled kprintfs */
-static struct lock *kprintf_lock;
-
 /* Lock for polled kprintfs */
 static struct spinlock kprintf_spinlock;
 
+/*
+ * Staging buffers for non-polled kprintfs.
+ *
+ * Each cpu has a line buffer that kprintf formats into; each time a
+ * line is finished (or the buffer fills) it goes to the console in
+ * one putchars call, which puts it in the console's output ring as a
+ * unit. So there is no global lock: concurrent kprintfs only meet,
+ * briefly, at the ring, and their lines don't get mixed up.
+ *
+ * A thread can be preempted or migrate while it's formatting, so a
+ * buffer is claimed with ks_busy rather than by being on its cpu. A
+ * kprintf that finds its cpu's buffer taken (which is rare) sends its
+ * text straight on, a piece at a time, instead of waiting. (Using a
+ * buffer on the stack would cost every kprintf that much stack.)
+ */
+#define KPRINTF_MAXCPUS		32
+#define KPRINTF_LINESIZE	160
+
+struct kprintf_stage {
+	volatile spinlock_data_t ks_busy;
+	size_t ks_len;
+	char ks_buf[KPRINTF_LINESIZE];
+};
+
+static struct kprintf_stage kprintf_stages[KPRINTF_MAXCPUS];
+static bool kprintf_staging;
+
 
 /*
  * Warning: all this has to work from interrupt handlers and when
@@ -60,19 +84,16 @@ static struct spinlock kprintf_spinlock;
 
 
 /*
- * Create the kprintf lock. Must be called before creating a second
- * thread or enabling a second CPU.
+ * Turn on staged (non-polled) kprintf. Must be called before creating
+ * a second thread or enabling a second CPU.
  */
 void
 kprintf_bootstrap(void)
 {
-	KASSERT(kprintf_lock == NULL);
+	KASSERT(kprintf_staging == false);
 
-	kprintf_lock = lock_create("kprintf_lock");
-	if (kprintf_lock == NULL) {
-		panic("Could not create kprintf_lock\n");
-	}
 	spinlock_init(&kprintf_spinlock);
+	kprintf_staging = true;
 }
 
 /*
@@ -82,12 +103,51 @@ static
 void
 console_send(void *junk, const char *data, size_t len)
 {
-	size_t i;
-
 	(void)junk;
 
+	putchars(data, len);
+}
+
+/*
+ * Claim the current cpu's staging buffer, or return NULL if it's in
+ * use (or there isn't one).
+ */
+static
+struct kprintf_stage *
+kprintf_getstage(void)
+{
+	struct kprintf_stage *ks;
+	unsigned num;
+
+	num = curcpu->c_number;
+	if (num >= KPRINTF_MAXCPUS) {
+		return NULL;
+	}
+	ks = &kprintf_stages[num];
+	if (spinlock_data_testandset(&ks->ks_busy) != 0) {
+		return NULL;
+	}
+	ks->ks_len = 0;
+	return ks;
+}
+
+/*
+ * Backend for __printf when staging: collect text and send it on a
+ * line at a time.
+ */
+static
+void
+stage_send(void *vks, const char *data, size_t len)
+{
+	struct kprintf_stage *ks = vks;
+	size_t i;
+
 	for (i=0; i<len; i++) {
-		putch(data[i]);
+		ks->ks_buf[ks->ks_len++] = data[i];
+		if (data[i] == '\n' || ks->ks_len == KPRINTF_LINESIZE) {
+			putchars(ks->ks_buf, ks->ks_len);
+			ks->ks_len = 0;
+		}
 	}
 }
 
@@ -99,30 +159,33 @@ inline
 int
 __kprintf(const char *fmt, va_list ap)
 {
+	struct kprintf_stage *ks;
 	int chars;
-	bool dolock;
+	bool polled;
 
-	dolock = kprintf_lock != NULL
-		&& curthread->t_in_interrupt == false
-		&& curthread->t_curspl == 0
-		&& curcpu->c_spinlocks == 0;
+	polled = kprintf_staging == false
+		|| curthread->t_in_interrupt
+		|| curthread->t_curspl > 0
+		|| curcpu->c_spinlocks > 0;
 
-	if (dolock) {
-		lock_acquire(kprintf_lock);
-	}
-	else {
+	if (polled) {
 		spinlock_acquire(&kprintf_spinlock);
+		chars = __vprintf(console_send, NULL, fmt, ap);
+		spinlock_release(&kprintf_spinlock);
+		return chars;
 	}
 
-	chars = __vprintf(console_send, NULL, fmt, ap);
-
-	if (dolock) {
-		lock_release(kprintf_lock);
-	}
-	else {
-		spinlock_release(&kprintf_spinlock);
+	ks = kprintf_getstage();
+	if (ks == NULL) {
+		return __vprintf(console_send, NULL, fmt, ap);
 	}
 
+	chars = __vprintf(stage_send, ks, fmt, ap);
+	if (ks->ks_len > 0) {
+		/* Partial line; can't keep it, the buffer isn't ours. */
+		putchars(ks->ks_buf, ks->ks_len);
+	}
+	spinlock_data_set(&ks->ks_busy, 0);
 	return chars;
 }
 
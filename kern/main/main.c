@@ -40,6 +40,13 @@
 #include <clock.h>
 #include <thread.h>
 #include <proc.h>
+#include <pid.h>
+#include <argbuf.h>
+#include <pagecache.h>
+#include <rcu.h>
+#include <futex.h>
+#include <acct.h>
+#include <workqueue.h>
 #include <current.h>
 #include <synch.h>
 #include <vm.h>
@@ -109,8 +116,13 @@ boot(void)
 	/* Early initialization. */
 	ram_bootstrap();
 	proc_bootstrap();
+	pid_bootstrap();
+	argbuf_bootstrap();
+	pagecache_bootstrap();
 	thread_bootstrap();
 	hardclock_bootstrap();
+	rcu_bootstrap();
+	futex_bootstrap();
 	vfs_bootstrap();
 	kheap_nextgeneration();
 
@@ -127,7 +139,9 @@ boot(void)
 	/* Late phase of initialization. */
 	vm_bootstrap();
 	kprintf_bootstrap();
+	acct_bootstrap();
 	thread_start_cpus();
+	workqueue_bootstrap();
 	test161_bootstrap();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
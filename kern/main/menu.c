@@ -31,12 +31,17 @@
 #include <kern/errno.h>
 #include <kern/reboot.h>
 #include <kern/unistd.h>
+#include <kern/wait.h>
 #include <limits.h>
 #include <lib.h>
 #include <uio.h>
 #include <clock.h>
 #include <mainbus.h>
 #include <synch.h>
+#include <lockstat.h>
+#include <counter.h>
+#include <prof.h>
+#include <trace.h>
 #include <thread.h>
 #include <proc.h>
 #include <vfs.h>
@@ -48,6 +53,7 @@
 #include "opt-net.h"
 #include "opt-synchprobs.h"
 #include "opt-automationtest.h"
+#include "opt-lockstat.h"
 
 /*
  * In-kernel menu and command dispatcher.
@@ -82,20 +88,17 @@ cmd_progthread(void *ptr, unsigned long nargs)
 
 	KASSERT(nargs >= 1);
 
-	if (nargs > 2) {
-		kprintf("Warning: argument passing from menu not supported\n");
-	}
-
 	/* Hope we fit. */
 	KASSERT(strlen(args[0]) < sizeof(progname));
 
 	strcpy(progname, args[0]);
 
-	result = runprogram(progname);
+	result = runprogram(progname, args, nargs);
 	if (result) {
 		kprintf("Running program %s failed: %s\n", args[0],
 			strerror(result));
-		return;
+		/* Release the process and its PID */
+		proc_exit(_MKWAIT_EXIT(1));
 	}
 
 	/* NOTREACHED: runprogram only returns on error. */
@@ -249,6 +252,32 @@ cmd_sync(int nargs, char **args)
 	return 0;
 }
 
+#if OPT_SFS
+/*
+ * Command for showing or setting the SFS flusher's interval and
+ * expiry age, in seconds.
+ */
+static
+int
+cmd_sfsflush(int nargs, char **args)
+{
+	unsigned interval, expire;
+
+	if (nargs == 3 && atoi(args[1]) > 0 && atoi(args[2]) >= 0) {
+		sfs_flush_setparams(atoi(args[1]) * HZ, atoi(args[2]) * HZ);
+	}
+	else if (nargs != 1) {
+		kprintf("Usage: sfsflush [interval expire]\n");
+		return EINVAL;
+	}
+
+	sfs_flush_getparams(&interval, &expire);
+	kprintf("sfsflush: every %u s, writing back after %u s\n",
+		interval / HZ, expire / HZ);
+	return 0;
+}
+#endif
+
 /*
  * Command for dropping to the debugger.
  */
@@ -482,6 +511,8 @@ cmd_kheapused(int nargs, char **args)
 	(void)nargs;
 	(void)args;
 
+	/* Cached exited threads would otherwise count as in use. */
+	thread_cache_drain();
 	kheap_printused();
 
 	return 0;
@@ -499,6 +530,144 @@ cmd_kheapgeneration(int nargs, char **args)
 	return 0;
 }
 
+#if OPT_LOCKSTAT
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		lockstat_dump(0);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		lockstat_reset();
+	}
+	else if (nargs == 2 && atoi(args[1]) > 0) {
+		lockstat_dump(atoi(args[1]));
+	}
+	else {
+		kprintf("Usage: lockstat [count | reset]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+#endif
+
+static
+int
+cmd_counters(int nargs, char **args)
+{
+	if (nargs == 1) {
+		counter_dump();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		counter_reset();
+	}
+	else {
+		kprintf("Usage: counters [reset]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Command for listing processes and their resource usage.
+ */
+static
+int
+cmd_ps(int nargs, char **args)
+{
+	(void)args;
+
+	if (nargs != 1) {
+		kprintf("Usage: ps\n");
+		return EINVAL;
+	}
+
+	proc_dump();
+	return 0;
+}
+
+/*
+ * Command for the sampling profiler.
+ */
+static
+int
+cmd_prof(int nargs, char **args)
+{
+	int result;
+
+	if (nargs == 1) {
+		prof_dump(PROF_DEFTOP, NULL);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "start")) {
+		result = prof_start();
+		if (result) {
+			kprintf("prof: %s\n", strerror(result));
+			return result;
+		}
+	}
+	else if (nargs == 2 && !strcmp(args[1], "stop")) {
+		prof_stop();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		prof_reset();
+	}
+	else if ((nargs == 2 || nargs == 3) && atoi(args[1]) > 0) {
+		prof_dump(atoi(args[1]), nargs == 3 ? args[2] : NULL);
+	}
+	else {
+		kprintf("Usage: prof [start | stop | reset | count [kernel]]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Command for the event trace.
+ */
+static
+int
+cmd_trace(int nargs, char **args)
+{
+	int result;
+
+	if (nargs == 1) {
+		trace_dump(TRACE_DEFDUMP);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "start")) {
+		result = trace_start();
+		if (result) {
+			kprintf("trace: %s\n", strerror(result));
+			return result;
+		}
+	}
+	else if (nargs == 2 && !strcmp(args[1], "stop")) {
+		trace_stop();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		trace_reset();
+	}
+	else if (nargs == 3 && !strcmp(args[1], "save")) {
+		result = trace_save(args[2]);
+		if (result) {
+			kprintf("trace: %s: %s\n", args[2], strerror(result));
+			return result;
+		}
+	}
+	else if (nargs == 2 && atoi(args[1]) > 0) {
+		trace_dump(atoi(args[1]));
+	}
+	else {
+		kprintf("Usage: trace [start | stop | reset | save file | count]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
 static
 int
 cmd_kheapdump(int nargs, char **args)
@@ -554,7 +723,13 @@ static const char *opsmenu[] = {
 	"[pf]      Print a file              ",
 	"[cd]      Change directory          ",
 	"[pwd]     Print current directory   ",
+	"[ps]      List processes            ",
 	"[sync]    Sync filesystems          ",
+#if OPT_SFS
+	"[sfsflush] SFS write-back timing    ",
+#endif
+	"[prof]    Kernel profiler           ",
+	"[trace]   Kernel tracepoints        ",
 	"[debug]   Drop to debugger          ",
 	"[panic]   Intentional panic         ",
 	"[deadlock] Intentional deadlock     ",
@@ -586,6 +761,7 @@ static const char *testmenu[] = {
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
+	"[tfb] Thread create+exit bench      ",
 #if OPT_NET
 	"[net] Network test                  ",
 #endif
@@ -595,6 +771,8 @@ static const char *testmenu[] = {
 	"[lt3]  Lock test 3           (1*)   ",
 	"[lt4]  Lock test 4           (1*)   ",
 	"[lt5]  Lock test 5           (1*)   ",
+	"[spt]  Spinlock stress test         ",
+	"[lkb]  Lock contention benchmark    ",
 	"[cvt1] CV test 1             (1)    ",
 	"[cvt2] CV test 2             (1)    ",
 	"[cvt3] CV test 3             (1*)   ",
@@ -605,6 +783,15 @@ static const char *testmenu[] = {
 	"[rwt3] RW lock test 3        (1?)   ",
 	"[rwt4] RW lock test 4        (1?)   ",
 	"[rwt5] RW lock test 5        (1?)   ",
+	"[rwb]  RW lock reader scaling bench ",
+	"[rcut] RCU test                     ",
+	"[tmt]  Timed wait test              ",
+	"[cvb]  CV broadcast bench           ",
+	"[pit]  Priority inversion test      ",
+	"[pcnt] Per-cpu counter test         ",
+	"[proft] Sampling profiler test      ",
+	"[trt]  Event trace test             ",
+	"[wqt]  Workqueue test               ",
 #if OPT_SYNCHPROBS
 	"[sp1] Whalemating test       (1)    ",
 	"[sp2] Stoplight test         (1)    ",
@@ -667,6 +854,10 @@ static const char *mainmenu[] = {
 	"[khu] Kernel heap usage             ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[counters] Event counters           ",
+#if OPT_LOCKSTAT
+	"[lockstat] Lock contention stats    ",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -709,7 +900,11 @@ static struct {
 	{ "pf",		printfile },
 	{ "cd",		cmd_chdir },
 	{ "pwd",	cmd_pwd },
+	{ "ps",		cmd_ps },
 	{ "sync",	cmd_sync },
+#if OPT_SFS
+	{ "sfsflush",	cmd_sfsflush },
+#endif
 	{ "debug",	cmd_debug },
 	{ "panic",	cmd_panic },
 	{ "deadlock",	cmd_deadlock },
@@ -722,6 +917,12 @@ static struct {
 	{ "khu",        cmd_kheapused },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "counters",   cmd_counters },
+	{ "prof",       cmd_prof },
+	{ "trace",      cmd_trace },
+#if OPT_LOCKSTAT
+	{ "lockstat",   cmd_lockstat },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -739,6 +940,7 @@ static struct {
 	{ "tt1",	threadtest },
 	{ "tt2",	threadtest2 },
 	{ "tt3",	threadtest3 },
+	{ "tfb",	threadbench },
 
 	/* synchronization assignment tests */
 	{ "sem1",	semtest },
@@ -747,6 +949,8 @@ static struct {
 	{ "lt3",	locktest3 },
 	{ "lt4", 	locktest4 },
 	{ "lt5", 	locktest5 },
+	{ "spt",	spinlocktest },
+	{ "lkb",	lockbench },
 	{ "cvt1",	cvtest },
 	{ "cvt2",	cvtest2 },
 	{ "cvt3",	cvtest3 },
@@ -757,6 +961,15 @@ static struct {
 	{ "rwt3",	rwtest3 },
 	{ "rwt4",	rwtest4 },
 	{ "rwt5",	rwtest5 },
+	{ "rwb",	rwbench },
+	{ "rcut",	rcutest },
+	{ "tmt",	timertest },
+	{ "cvb",	cvbench },
+	{ "pit",	pitest },
+	{ "pcnt",	counttest },
+	{ "proft",	proftest },
+	{ "trt",	tracetest },
+	{ "wqt",	workqtest },
 #if OPT_SYNCHPROBS
 	{ "sp1",	whalemating },
 	{ "sp2",	stoplight },
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Process ID management. See pid.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/wait.h>
+#include <limits.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <acct.h>
+#include <pid.h>
+
+#define PIDMAP_BITS	32
+#define PIDMAP_WORDS	(PROCS_MAX / PIDMAP_BITS)
+
+/*
+ * One PID table slot.
+ */
+struct pidinfo {
+	pid_t pi_pid;			/* PID in this slot, or INVALID_PID */
+	pid_t pi_ppid;			/* parent, or INVALID_PID */
+	bool pi_exited;			/* true once _exit has happened */
+	int pi_status;			/* encoded exit status */
+	struct acct pi_acct;		/* final resource usage */
+	struct wchan *pi_wchan;		/* parent waits here */
+
+	/* List of this process's children, for orphaning them at exit */
+	struct pidinfo *pi_children;
+	struct pidinfo *pi_nextsib;
+	struct pidinfo *pi_prevsib;
+};
+
+static struct spinlock pid_lock = SPINLOCK_INITIALIZER;
+static struct pidinfo pidtable[PROCS_MAX];
+static uint32_t pidmap[PIDMAP_WORDS];	/* 1 = slot in use */
+static unsigned pidmap_hint;		/* lowest word with a free bit */
+static unsigned pid_nfree;		/* number of free slots */
+static pid_t pid_next;			/* allocate at or above this */
+
+/*
+ * Find the slot for PID, or NULL if PID is not in use.
+ */
+static
+struct pidinfo *
+pid_lookup(pid_t pid)
+{
+	struct pidinfo *pi;
+
+	KASSERT(spinlock_do_i_hold(&pid_lock));
+
+	if (pid < PID_MIN || pid > PID_MAX) {
+		return NULL;
+	}
+	pi = &pidtable[pid % PROCS_MAX];
+	if (pi->pi_pid != pid) {
+		return NULL;
+	}
+	return pi;
+}
+
+/*
+ * Pick the PID for slot SLOT: the first one at or above pid_next
+ * that maps to the slot, wrapping around at PID_MAX.
+ */
+static
+pid_t
+pid_forslot(unsigned slot)
+{
+	pid_t pid;
+
+	pid = pid_next - (pid_next % PROCS_MAX) + slot;
+	if (pid < pid_next) {
+		pid += PROCS_MAX;
+	}
+	if (pid > PID_MAX) {
+		pid = slot;
+	}
+	if (pid < PID_MIN) {
+		pid += PROCS_MAX;
+	}
+	return pid;
+}
+
+/*
+ * Mark a slot free.
+ */
+static
+void
+pid_freeslot(struct pidinfo *pi)
+{
+	unsigned slot, word;
+
+	KASSERT(spinlock_do_i_hold(&pid_lock));
+	KASSERT(pi->pi_children == NULL);
+
+	slot = pi - pidtable;
+	word = slot / PIDMAP_BITS;
+	KASSERT(pidmap[word] & ((uint32_t)1 << (slot % PIDMAP_BITS)));
+	pidmap[word] &= ~((uint32_t)1 << (slot % PIDMAP_BITS));
+	if (word < pidmap_hint) {
+		pidmap_hint = word;
+	}
+	pid_nfree++;
+
+	pi->pi_pid = INVALID_PID;
+	pi->pi_ppid = INVALID_PID;
+}
+
+/*
+ * Unhook PI from its parent's list of children.
+ */
+static
+void
+pid_unlinkchild(struct pidinfo *parent, struct pidinfo *pi)
+{
+	if (pi->pi_prevsib != NULL) {
+		pi->pi_prevsib->pi_nextsib = pi->pi_nextsib;
+	}
+	else {
+		KASSERT(parent->pi_children == pi);
+		parent->pi_children = pi->pi_nextsib;
+	}
+	if (pi->pi_nextsib != NULL) {
+		pi->pi_nextsib->pi_prevsib = pi->pi_prevsib;
+	}
+	pi->pi_nextsib = pi->pi_prevsib = NULL;
+	pi->pi_ppid = INVALID_PID;
+}
+
+void
+pid_bootstrap(void)
+{
+	unsigned i;
+
+	/* Every slot must have at least one usable PID */
+	KASSERT(PROCS_MAX % PIDMAP_BITS == 0);
+	KASSERT(PID_MIN + PROCS_MAX <= PID_MAX);
+
+	for (i=0; i<PROCS_MAX; i++) {
+		pidtable[i].pi_pid = INVALID_PID;
+		pidtable[i].pi_ppid = INVALID_PID;
+		pidtable[i].pi_exited = false;
+		pidtable[i].pi_status = 0;
+		pidtable[i].pi_wchan = wchan_create("pid");
+		if (pidtable[i].pi_wchan == NULL) {
+			panic("pid_bootstrap: Out of memory\n");
+		}
+		pidtable[i].pi_children = NULL;
+		pidtable[i].pi_nextsib = NULL;
+		pidtable[i].pi_prevsib = NULL;
+	}
+	for (i=0; i<PIDMAP_WORDS; i++) {
+		pidmap[i] = 0;
+	}
+	pidmap_hint = 0;
+	pid_nfree = PROCS_MAX;
+	pid_next = PID_MIN;
+}
+
+int
+pid_alloc(pid_t parent, pid_t *ret)
+{
+	struct pidinfo *pi, *ppi;
+	unsigned word, bit, slot;
+	uint32_t freebits;
+
+	spinlock_acquire(&pid_lock);
+
+	if (pid_nfree == 0) {
+		spinlock_release(&pid_lock);
+		return ENPROC;
+	}
+
+	/* The hint is the lowest word that can have a free bit */
+	for (word = pidmap_hint; pidmap[word] == 0xffffffff; word++) {
+		KASSERT(word < PIDMAP_WORDS - 1);
+	}
+	pidmap_hint = word;
+	freebits = ~pidmap[word];
+	bit = __builtin_ctz(freebits);
+	slot = word * PIDMAP_BITS + bit;
+	pidmap[word] |= (uint32_t)1 << bit;
+	pid_nfree--;
+
+	pi = &pidtable[slot];
+	KASSERT(pi->pi_pid == INVALID_PID);
+	pi->pi_pid = pid_forslot(slot);
+	pi->pi_ppid = parent;
+	pi->pi_exited = false;
+	pi->pi_status = 0;
+	pi->pi_children = NULL;
+	pi->pi_prevsib = NULL;
+	pi->pi_nextsib = NULL;
+	pid_next = pi->pi_pid + 1;
+	if (pid_next > PID_MAX) {
+		pid_next = PID_MIN;
+	}
+
+	if (parent != INVALID_PID) {
+		ppi = pid_lookup(parent);
+		KASSERT(ppi != NULL);
+		pi->pi_nextsib = ppi->pi_children;
+		if (ppi->pi_children != NULL) {
+			ppi->pi_children->pi_prevsib = pi;
+		}
+		ppi->pi_children = pi;
+	}
+
+	*ret = pi->pi_pid;
+	spinlock_release(&pid_lock);
+	return 0;
+}
+
+void
+pid_unalloc(pid_t pid)
+{
+	struct pidinfo *pi, *ppi;
+
+	spinlock_acquire(&pid_lock);
+	pi = pid_lookup(pid);
+	KASSERT(pi != NULL);
+	KASSERT(!pi->pi_exited);
+	if (pi->pi_ppid != INVALID_PID) {
+		ppi = pid_lookup(pi->pi_ppid);
+		KASSERT(ppi != NULL);
+		pid_unlinkchild(ppi, pi);
+	}
+	pid_freeslot(pi);
+	spinlock_release(&pid_lock);
+}
+
+void
+pid_exit(pid_t pid, int status, const struct acct *acct)
+{
+	struct pidinfo *pi, *kid;
+
+	spinlock_acquire(&pid_lock);
+	pi = pid_lookup(pid);
+	KASSERT(pi != NULL);
+	KASSERT(!pi->pi_exited);
+
+	pi->pi_exited = true;
+	pi->pi_status = status;
+	pi->pi_acct = *acct;
+
+	/* Orphan our children; release the ones nobody will wait for */
+	while (pi->pi_children != NULL) {
+		kid = pi->pi_children;
+		pid_unlinkchild(pi, kid);
+		if (kid->pi_exited) {
+			pid_freeslot(kid);
+		}
+	}
+
+	if (pi->pi_ppid == INVALID_PID) {
+		pid_freeslot(pi);
+	}
+	else {
+		wchan_wakeall(pi->pi_wchan, &pid_lock);
+	}
+	spinlock_release(&pid_lock);
+}
+
+int
+pid_wait(pid_t pid, pid_t parent, int flags, int *status,
+	 struct acct *acct, pid_t *ret)
+{
+	struct pidinfo *pi, *ppi;
+
+	if ((flags & ~WNOHANG) != 0) {
+		return EINVAL;
+	}
+
+	spinlock_acquire(&pid_lock);
+	pi = pid_lookup(pid);
+	if (pi == NULL) {
+		spinlock_release(&pid_lock);
+		return ESRCH;
+	}
+	if (pi->pi_ppid != parent || parent == INVALID_PID) {
+		spinlock_release(&pid_lock);
+		return ECHILD;
+	}
+
+	while (!pi->pi_exited) {
+		if (flags & WNOHANG) {
+			spinlock_release(&pid_lock);
+			*ret = 0;
+			return 0;
+		}
+		wchan_sleep(pi->pi_wchan, &pid_lock);
+		/* Only the parent can release us, so we're still here */
+		KASSERT(pi->pi_pid == pid);
+	}
+
+	*status = pi->pi_status;
+	*acct = pi->pi_acct;
+	ppi = pid_lookup(parent);
+	KASSERT(ppi != NULL);
+	pid_unlinkchild(ppi, pi);
+	pid_freeslot(pi);
+	spinlock_release(&pid_lock);
+
+	*ret = pid;
+	return 0;
+}
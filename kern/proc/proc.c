@@ -43,17 +43,29 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <spl.h>
 #include <proc.h>
+#include <thread.h>
 #include <current.h>
+#include <synch.h>
 #include <addrspace.h>
 #include <vnode.h>
+#include <file.h>
+#include <pid.h>
 
 /*
  * The process for the kernel; this holds all the kernel-only threads.
  */
 struct proc *kproc;
 
+/*
+ * List of all processes, for ps. Acquire p_lock inside allprocs_lock,
+ * not the other way around.
+ */
+static struct proc *allprocs;
+static struct spinlock allprocs_lock = SPINLOCK_INITIALIZER;
+
 /*
  * Create a proc structure.
  */
@@ -74,13 +86,28 @@ proc_create(const char *name)
 	}
 
 	proc->p_numthreads = 0;
+	proc->p_threads = NULL;
+	proc->p_vforksem = NULL;
 	spinlock_init(&proc->p_lock);
+	proc->p_pid = INVALID_PID;
+	bzero(&proc->p_acct, sizeof(proc->p_acct));
+	bzero(&proc->p_acctchildren, sizeof(proc->p_acctchildren));
 
 	/* VM fields */
 	proc->p_addrspace = NULL;
 
 	/* VFS fields */
 	proc->p_cwd = NULL;
+	proc->p_filetable = NULL;
+
+	spinlock_acquire(&allprocs_lock);
+	proc->p_allprev = NULL;
+	proc->p_allnext = allprocs;
+	if (allprocs != NULL) {
+		allprocs->p_allprev = proc;
+	}
+	allprocs = proc;
+	spinlock_release(&allprocs_lock);
 
 	return proc;
 }
@@ -88,8 +115,9 @@ proc_create(const char *name)
 /*
  * Destroy a proc structure.
  *
- * Note: nothing currently calls this. Your wait/exit code will
- * probably want to do so.
+ * A process that exits has already given up its PID in proc_exit;
+ * if we still have one, the process never ran (e.g. fork failed
+ * partway) and nobody can be waiting for it.
  */
 void
 proc_destroy(struct proc *proc)
@@ -105,13 +133,35 @@ proc_destroy(struct proc *proc)
 	KASSERT(proc != NULL);
 	KASSERT(proc != kproc);
 
+	/* Take it off the list first, so ps can't find it. */
+	spinlock_acquire(&allprocs_lock);
+	if (proc->p_allprev != NULL) {
+		proc->p_allprev->p_allnext = proc->p_allnext;
+	}
+	else {
+		allprocs = proc->p_allnext;
+	}
+	if (proc->p_allnext != NULL) {
+		proc->p_allnext->p_allprev = proc->p_allprev;
+	}
+	spinlock_release(&allprocs_lock);
+
 	/*
 	 * We don't take p_lock in here because we must have the only
 	 * reference to this structure. (Otherwise it would be
 	 * incorrect to destroy it.)
 	 */
 
+	if (proc->p_pid != INVALID_PID) {
+		pid_unalloc(proc->p_pid);
+		proc->p_pid = INVALID_PID;
+	}
+
 	/* VFS fields */
+	if (proc->p_filetable) {
+		filetable_destroy(proc->p_filetable);
+		proc->p_filetable = NULL;
+	}
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
 		proc->p_cwd = NULL;
@@ -162,10 +212,21 @@ proc_destroy(struct proc *proc)
 			as = proc->p_addrspace;
 			proc->p_addrspace = NULL;
 		}
-		as_destroy(as);
+
+		/*
+		 * A vfork child that never ran is still borrowing its
+		 * parent's address space; it isn't ours to destroy.
+		 * The parent is the one cleaning up, so there is
+		 * nobody to wake.
+		 */
+		if (proc->p_vforksem == NULL) {
+			as_destroy(as);
+		}
+		proc->p_vforksem = NULL;
 	}
 
 	KASSERT(proc->p_numthreads == 0);
+	KASSERT(proc->p_threads == NULL);
 	spinlock_cleanup(&proc->p_lock);
 
 	kfree(proc->p_name);
@@ -206,6 +267,17 @@ proc_create_runprogram(const char *name)
 
 	/* VFS fields */
 
+	if (pid_alloc(INVALID_PID, &newproc->p_pid)) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
+	newproc->p_filetable = filetable_create();
+	if (newproc->p_filetable == NULL) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
 	/*
 	 * Lock the current process to copy its current directory.
 	 * (We don't need to lock the new process, though, as we have
@@ -221,6 +293,139 @@ proc_create_runprogram(const char *name)
 	return newproc;
 }
 
+/*
+ * Create a child of the current process for fork: a copy of the
+ * address space, the same open files and current directory, and a
+ * new PID. The caller still needs to give it a thread.
+ *
+ * If VFORKSEM is not NULL, this is for vfork: rather than copying
+ * the address space, the child borrows ours, and VFORKSEM is V'd
+ * when the child gives it back (see proc_vforkdone). The caller
+ * must not touch the address space until then.
+ */
+int
+proc_fork(struct semaphore *vforksem, struct proc **ret)
+{
+	struct proc *newproc;
+	struct addrspace *as;
+	int result;
+
+	newproc = proc_create(curproc->p_name);
+	if (newproc == NULL) {
+		return ENOMEM;
+	}
+
+	result = pid_alloc(curproc->p_pid, &newproc->p_pid);
+	if (result) {
+		proc_destroy(newproc);
+		return result;
+	}
+
+	/* VM fields */
+
+	as = proc_getas();
+	if (vforksem != NULL) {
+		newproc->p_addrspace = as;
+		newproc->p_vforksem = vforksem;
+	}
+	else if (as != NULL) {
+		result = as_copy(as, &newproc->p_addrspace);
+		if (result) {
+			proc_destroy(newproc);
+			return result;
+		}
+	}
+
+	/* VFS fields */
+
+	/*
+	 * The file table is only changed by the process itself, and
+	 * we're it, so it can't change under us.
+	 */
+	result = filetable_copy(curproc->p_filetable, &newproc->p_filetable);
+	if (result) {
+		proc_destroy(newproc);
+		return result;
+	}
+
+	spinlock_acquire(&curproc->p_lock);
+	if (curproc->p_cwd != NULL) {
+		VOP_INCREF(curproc->p_cwd);
+		newproc->p_cwd = curproc->p_cwd;
+	}
+	spinlock_release(&curproc->p_lock);
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * If the current process is a vfork child, give the address space
+ * back to the parent and let it run again. Returns true if so, in
+ * which case the caller must not destroy the old address space.
+ *
+ * The caller should already have switched away from the borrowed
+ * address space; once the parent is awake it may be changing it.
+ */
+bool
+proc_vforkdone(void)
+{
+	struct proc *proc = curproc;
+	struct semaphore *sem;
+
+	spinlock_acquire(&proc->p_lock);
+	sem = proc->p_vforksem;
+	proc->p_vforksem = NULL;
+	spinlock_release(&proc->p_lock);
+
+	if (sem == NULL) {
+		return false;
+	}
+	V(sem);
+	return true;
+}
+
+/*
+ * Exit the current process.
+ *
+ * Everything is torn down before the exit is reported through the
+ * PID table, so that when waitpid returns in the parent the child's
+ * files (e.g. pipe ends) have been closed.
+ */
+void
+proc_exit(int status)
+{
+	struct proc *proc = curproc;
+	struct addrspace *as;
+	struct acct acct;
+	pid_t pid;
+
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+
+	/* Drop the address space while it's still ours to deactivate */
+	as = proc_setas(NULL);
+	as_deactivate();
+	if (!proc_vforkdone() && as != NULL) {
+		as_destroy(as);
+	}
+
+	pid = proc->p_pid;
+	proc->p_pid = INVALID_PID;
+
+	/*
+	 * What the parent collects is our usage and our children's.
+	 * Nobody else can see the proc now, so no need to lock it.
+	 */
+	proc_remthread(curthread);
+	acct = proc->p_acct;
+	acct_add(&acct, &proc->p_acctchildren);
+	proc_destroy(proc);
+
+	pid_exit(pid, status, &acct);
+	thread_exit();
+}
+
 /*
  * Add a thread to a process. Either the thread or the process might
  * or might not be current.
@@ -239,6 +444,8 @@ proc_addthread(struct proc *proc, struct thread *t)
 
 	spinlock_acquire(&proc->p_lock);
 	proc->p_numthreads++;
+	t->t_procnext = proc->p_threads;
+	proc->p_threads = t;
 	spinlock_release(&proc->p_lock);
 
 	spl = splhigh();
@@ -250,7 +457,8 @@ proc_addthread(struct proc *proc, struct thread *t)
 
 /*
  * Remove a thread from its process. Either the thread or the process
- * might or might not be current.
+ * might or might not be current. The thread's resource usage stays
+ * behind in the process.
  *
  * Turn off interrupts on the local cpu while changing t_proc, in
  * case it's current, to protect against the as_activate call in
@@ -261,14 +469,25 @@ void
 proc_remthread(struct thread *t)
 {
 	struct proc *proc;
+	struct thread **tp;
 	int spl;
 
 	proc = t->t_proc;
 	KASSERT(proc != NULL);
 
+	if (t == curthread) {
+		acct_sync();
+	}
+
 	spinlock_acquire(&proc->p_lock);
 	KASSERT(proc->p_numthreads > 0);
 	proc->p_numthreads--;
+	for (tp = &proc->p_threads; *tp != t; tp = &(*tp)->t_procnext) {
+		KASSERT(*tp != NULL);
+	}
+	*tp = t->t_procnext;
+	t->t_procnext = NULL;
+	acct_add(&proc->p_acct, &t->t_acct);
 	spinlock_release(&proc->p_lock);
 
 	spl = splhigh();
@@ -276,6 +495,99 @@ proc_remthread(struct thread *t)
 	splx(spl);
 }
 
+/*
+ * Add up the resource usage of PROC: the threads that have left it
+ * and the ones still in it. The latter are read on the fly, so a
+ * thread running on another cpu is counted up to when it was last
+ * charged.
+ */
+void
+proc_getacct(struct proc *proc, struct acct *ret)
+{
+	struct thread *t;
+
+	acct_sync();
+
+	spinlock_acquire(&proc->p_lock);
+	*ret = proc->p_acct;
+	for (t = proc->p_threads; t != NULL; t = t->t_procnext) {
+		acct_add(ret, &t->t_acct);
+	}
+	spinlock_release(&proc->p_lock);
+}
+
+/*
+ * One line of ps output, copied out so we can print it without
+ * holding any locks.
+ */
+struct procsnap {
+	pid_t ps_pid;
+	unsigned ps_nthreads;
+	struct acct ps_acct;
+	char ps_name[16];
+};
+
+/*
+ * Print a line for each process: PID, number of threads, user and
+ * system time in milliseconds, context switches and faults.
+ */
+void
+proc_dump(void)
+{
+	struct procsnap *snaps;
+	struct proc *proc;
+	unsigned i, n, max;
+
+	/* Count first; processes that appear after this are skipped. */
+	max = 0;
+	spinlock_acquire(&allprocs_lock);
+	for (proc = allprocs; proc != NULL; proc = proc->p_allnext) {
+		max++;
+	}
+	spinlock_release(&allprocs_lock);
+
+	snaps = kmalloc(max * sizeof(*snaps));
+	if (snaps == NULL) {
+		kprintf("ps: Out of memory\n");
+		return;
+	}
+
+	acct_sync();
+
+	n = 0;
+	spinlock_acquire(&allprocs_lock);
+	for (proc = allprocs; proc != NULL && n < max;
+	     proc = proc->p_allnext) {
+		struct thread *t;
+
+		spinlock_acquire(&proc->p_lock);
+		snaps[n].ps_pid = proc->p_pid;
+		snaps[n].ps_nthreads = proc->p_numthreads;
+		snaps[n].ps_acct = proc->p_acct;
+		for (t = proc->p_threads; t != NULL; t = t->t_procnext) {
+			acct_add(&snaps[n].ps_acct, &t->t_acct);
+		}
+		snprintf(snaps[n].ps_name, sizeof(snaps[n].ps_name), "%s",
+			 proc->p_name);
+		spinlock_release(&proc->p_lock);
+		n++;
+	}
+	spinlock_release(&allprocs_lock);
+
+	kprintf("  PID THR   USER(ms)    SYS(ms)   VCSW  IVCSW "
+		"MINFLT MAJFLT NAME\n");
+	for (i=0; i<n; i++) {
+		kprintf("%5d %3u %10u %10u %6u %6u %6u %6u %s\n",
+			snaps[i].ps_pid, snaps[i].ps_nthreads,
+			(unsigned)(snaps[i].ps_acct.ac_utime / 1000000),
+			(unsigned)(snaps[i].ps_acct.ac_stime / 1000000),
+			snaps[i].ps_acct.ac_nvcsw, snaps[i].ps_acct.ac_nivcsw,
+			snaps[i].ps_acct.ac_minflt, snaps[i].ps_acct.ac_majflt,
+			snaps[i].ps_name);
+	}
+	kfree(snaps);
+}
+
 /*
  * Fetch the address space of (the current) process.
  *
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Argument marshalling for execv and runprogram. See argbuf.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <argbuf.h>
+
+/*
+ * Most buffers we'll ever allocate. Beyond this many concurrent
+ * execs, the rest wait their turn.
+ */
+#define ARGBUF_MAX 4
+
+static struct lock *argbuf_lock;
+static struct cv *argbuf_cv;
+static struct argbuf *argbuf_free[ARGBUF_MAX];	/* idle buffers */
+static unsigned argbuf_nfree;			/* entries in argbuf_free */
+static unsigned argbuf_nalloc;			/* buffers in existence */
+
+/* The argv pointer slots at the front of the image. */
+#define ARGBUF_SLOTS(ab) ((vaddr_t *)(ab)->ab_args)
+#define ARGBUF_MAXSLOTS (ARG_MAX / sizeof(vaddr_t))
+
+void
+argbuf_bootstrap(void)
+{
+	argbuf_lock = lock_create("argbuf");
+	if (argbuf_lock == NULL) {
+		panic("argbuf_bootstrap: Out of memory\n");
+	}
+	argbuf_cv = cv_create("argbuf");
+	if (argbuf_cv == NULL) {
+		panic("argbuf_bootstrap: Out of memory\n");
+	}
+}
+
+int
+argbuf_get(struct argbuf **ret)
+{
+	struct argbuf *ab;
+
+	lock_acquire(argbuf_lock);
+	while (argbuf_nfree == 0 && argbuf_nalloc == ARGBUF_MAX) {
+		cv_wait(argbuf_cv, argbuf_lock);
+	}
+	if (argbuf_nfree > 0) {
+		ab = argbuf_free[--argbuf_nfree];
+		lock_release(argbuf_lock);
+	}
+	else {
+		/* Reserve our place, then allocate without the lock */
+		argbuf_nalloc++;
+		lock_release(argbuf_lock);
+
+		ab = kmalloc(sizeof(*ab));
+		if (ab == NULL) {
+			lock_acquire(argbuf_lock);
+			argbuf_nalloc--;
+			cv_signal(argbuf_cv, argbuf_lock);
+			lock_release(argbuf_lock);
+			return ENOMEM;
+		}
+	}
+
+	ab->ab_argc = 0;
+	ab->ab_len = 0;
+	*ret = ab;
+	return 0;
+}
+
+void
+argbuf_put(struct argbuf *ab)
+{
+	lock_acquire(argbuf_lock);
+	KASSERT(argbuf_nfree < argbuf_nalloc);
+	argbuf_free[argbuf_nfree++] = ab;
+	cv_signal(argbuf_cv, argbuf_lock);
+	lock_release(argbuf_lock);
+}
+
+/*
+ * Copy in a user argv array.
+ *
+ * The user's pointers are copied straight into the slots where the
+ * final argv array goes; that tells us argc, and so where the strings
+ * start, before we touch any of them. Then each string is copied
+ * directly to its final place and its slot is overwritten with its
+ * offset. Nothing is copied twice and nothing is allocated.
+ */
+int
+argbuf_copyin(struct argbuf *ab, userptr_t uargv)
+{
+	vaddr_t *slots = ARGBUF_SLOTS(ab);
+	userptr_t uarg;
+	size_t len, pos;
+	unsigned argc, i;
+	int result;
+
+	argc = 0;
+	while (1) {
+		if (argc >= ARGBUF_MAXSLOTS) {
+			return E2BIG;
+		}
+		result = copyin(uargv + argc * sizeof(userptr_t),
+				&slots[argc], sizeof(userptr_t));
+		if (result) {
+			return result;
+		}
+		if (slots[argc] == 0) {
+			break;
+		}
+		argc++;
+	}
+
+	pos = (argc + 1) * sizeof(vaddr_t);
+	for (i=0; i<argc; i++) {
+		uarg = (userptr_t)slots[i];
+		result = copyinstr(uarg, ab->ab_args + pos, ARG_MAX - pos,
+				   &len);
+		if (result == ENAMETOOLONG) {
+			/* Ran out of room in the buffer, not in the string */
+			result = E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		slots[i] = pos;
+		pos += len;
+	}
+
+	ab->ab_argc = argc;
+	ab->ab_len = pos;
+	return 0;
+}
+
+/*
+ * Same, but for kernel strings (runprogram, from the menu).
+ */
+int
+argbuf_fromkernel(struct argbuf *ab, char **args, int nargs)
+{
+	vaddr_t *slots = ARGBUF_SLOTS(ab);
+	size_t len, pos;
+	int i;
+
+	KASSERT(nargs >= 0);
+
+	pos = (nargs + 1) * sizeof(vaddr_t);
+	if (pos > ARG_MAX) {
+		return E2BIG;
+	}
+	for (i=0; i<nargs; i++) {
+		len = strlen(args[i]) + 1;
+		if (len > ARG_MAX - pos) {
+			return E2BIG;
+		}
+		memcpy(ab->ab_args + pos, args[i], len);
+		slots[i] = pos;
+		pos += len;
+	}
+	slots[nargs] = 0;
+
+	ab->ab_argc = nargs;
+	ab->ab_len = pos;
+	return 0;
+}
+
+int
+argbuf_copyout(struct argbuf *ab, vaddr_t *stackptr, userptr_t *argv_ret)
+{
+	vaddr_t *slots = ARGBUF_SLOTS(ab);
+	vaddr_t base;
+	size_t size;
+	int i, result;
+
+	/* Keep the stack 8-byte aligned, as the MIPS ABI wants. */
+	size = ROUNDUP(ab->ab_len, 8);
+	KASSERT(size <= ARG_MAX);
+	KASSERT(*stackptr % 8 == 0);
+	base = *stackptr - size;
+
+	/* Don't hand the padding from some earlier exec to this one */
+	bzero(ab->ab_args + ab->ab_len, size - ab->ab_len);
+
+	for (i=0; i<ab->ab_argc; i++) {
+		slots[i] += base;
+	}
+	KASSERT(slots[ab->ab_argc] == 0);
+
+	result = copyout(ab->ab_args, (userptr_t)base, size);
+	if (result) {
+		return result;
+	}
+
+	*stackptr = base;
+	*argv_ret = (userptr_t)base;
+	return 0;
+}
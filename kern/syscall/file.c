@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Open file objects and per-process file tables.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <synch.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <file.h>
+
+////////////////////////////////////////////////////////////
+//
+// Open files
+
+/*
+ * Wrap VN in a new openfile. Consumes the reference to VN.
+ */
+int
+openfile_fromvnode(struct vnode *vn, int accmode, struct openfile **ret)
+{
+	struct openfile *file;
+
+	file = kmalloc(sizeof(*file));
+	if (file == NULL) {
+		vfs_close(vn);
+		return ENOMEM;
+	}
+
+	file->of_offsetlock = lock_create("openfile");
+	if (file->of_offsetlock == NULL) {
+		kfree(file);
+		vfs_close(vn);
+		return ENOMEM;
+	}
+
+	file->of_vnode = vn;
+	file->of_accmode = accmode;
+	file->of_append = false;
+	file->of_offset = 0;
+	spinlock_init(&file->of_countlock);
+	file->of_refcount = 1;
+
+	*ret = file;
+	return 0;
+}
+
+/*
+ * Open PATH and make an openfile for it.
+ */
+int
+openfile_open(char *path, int openflags, mode_t mode, struct openfile **ret)
+{
+	struct vnode *vn;
+	int accmode;
+	int result;
+
+	accmode = openflags & O_ACCMODE;
+	if (accmode != O_RDONLY && accmode != O_WRONLY && accmode != O_RDWR) {
+		return EINVAL;
+	}
+
+	result = vfs_open(path, openflags, mode, &vn);
+	if (result) {
+		return result;
+	}
+
+	result = openfile_fromvnode(vn, accmode, ret);
+	if (result) {
+		return result;
+	}
+	(*ret)->of_append = (openflags & O_APPEND) != 0;
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *file)
+{
+	spinlock_acquire(&file->of_countlock);
+	file->of_refcount++;
+	spinlock_release(&file->of_countlock);
+}
+
+/*
+ * Drop a reference. The last one closes the vnode.
+ */
+void
+openfile_decref(struct openfile *file)
+{
+	bool destroy;
+
+	spinlock_acquire(&file->of_countlock);
+	KASSERT(file->of_refcount > 0);
+	file->of_refcount--;
+	destroy = (file->of_refcount == 0);
+	spinlock_release(&file->of_countlock);
+
+	if (destroy) {
+		vfs_close(file->of_vnode);
+		lock_destroy(file->of_offsetlock);
+		spinlock_cleanup(&file->of_countlock);
+		kfree(file);
+	}
+}
+
+////////////////////////////////////////////////////////////
+//
+// File tables
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	unsigned i;
+
+	ft = kmalloc(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+
+	spinlock_init(&ft->ft_lock);
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = NULL;
+	}
+	return ft;
+}
+
+/*
+ * Destroy a file table. The caller must have the only reference to
+ * it, so no locking is needed.
+ */
+void
+filetable_destroy(struct filetable *ft)
+{
+	unsigned i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_decref(ft->ft_files[i]);
+			ft->ft_files[i] = NULL;
+		}
+	}
+	spinlock_cleanup(&ft->ft_lock);
+	kfree(ft);
+}
+
+int
+filetable_copy(struct filetable *src, struct filetable **ret)
+{
+	struct filetable *ft;
+	unsigned i;
+
+	ft = filetable_create();
+	if (ft == NULL) {
+		return ENOMEM;
+	}
+
+	spinlock_acquire(&src->ft_lock);
+	for (i=0; i<OPEN_MAX; i++) {
+		if (src->ft_files[i] != NULL) {
+			openfile_incref(src->ft_files[i]);
+			ft->ft_files[i] = src->ft_files[i];
+		}
+	}
+	spinlock_release(&src->ft_lock);
+
+	*ret = ft;
+	return 0;
+}
+
+/*
+ * Attach the console as stdin, stdout, and stderr.
+ */
+int
+filetable_openstd(struct filetable *ft)
+{
+	static const int flags[3] = { O_RDONLY, O_WRONLY, O_WRONLY };
+	char path[5];
+	struct openfile *file;
+	int fd, i;
+	int result;
+
+	for (i=0; i<3; i++) {
+		/* vfs_open destroys the path, so make a fresh copy */
+		strcpy(path, "con:");
+		result = openfile_open(path, flags[i], 0664, &file);
+		if (result) {
+			return result;
+		}
+		result = filetable_place(ft, file, &fd);
+		if (result) {
+			openfile_decref(file);
+			return result;
+		}
+		KASSERT(fd == i);
+	}
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct openfile *file, int *fd)
+{
+	unsigned i;
+
+	spinlock_acquire(&ft->ft_lock);
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] == NULL) {
+			ft->ft_files[i] = file;
+			spinlock_release(&ft->ft_lock);
+			*fd = i;
+			return 0;
+		}
+	}
+	spinlock_release(&ft->ft_lock);
+	return EMFILE;
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	struct openfile *file;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	file = ft->ft_files[fd];
+	if (file == NULL) {
+		spinlock_release(&ft->ft_lock);
+		return EBADF;
+	}
+	openfile_incref(file);
+	spinlock_release(&ft->ft_lock);
+
+	*ret = file;
+	return 0;
+}
+
+int
+filetable_remove(struct filetable *ft, int fd, struct openfile **ret)
+{
+	struct openfile *file;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	spinlock_acquire(&ft->ft_lock);
+	file = ft->ft_files[fd];
+	ft->ft_files[fd] = NULL;
+	spinlock_release(&ft->ft_lock);
+
+	if (file == NULL) {
+		return EBADF;
+	}
+	*ret = file;
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File-handle-related system calls.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/stat.h>
+#include <limits.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <proc.h>
+#include <current.h>
+#include <copyinout.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <file.h>
+#include <pipe.h>
+#include <syscall.h>
+
+/*
+ * open()
+ */
+int
+sys_open(const_userptr_t upath, int flags, mode_t mode, int32_t *retval)
+{
+	const int allflags = O_ACCMODE | O_CREAT | O_EXCL | O_TRUNC |
+		O_APPEND | O_NOCTTY;
+	char *path;
+	struct openfile *file;
+	int fd;
+	int result;
+
+	if ((flags & allflags) != flags) {
+		return EINVAL;
+	}
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = openfile_open(path, flags, mode, &file);
+	kfree(path);
+	if (result) {
+		return result;
+	}
+
+	result = filetable_place(curproc->p_filetable, file, &fd);
+	if (result) {
+		openfile_decref(file);
+		return result;
+	}
+
+	*retval = fd;
+	return 0;
+}
+
+/*
+ * Common logic for read and write.
+ *
+ * Only seekable objects use the shared seek position, so only they
+ * need the offset lock; pipes and devices do their own locking.
+ */
+static
+int
+file_rw(int fd, userptr_t buf, size_t size, enum uio_rw rw, int badaccmode,
+	int32_t *retval)
+{
+	struct openfile *file;
+	struct iovec iov;
+	struct uio useruio;
+	struct stat st;
+	bool seekable;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+
+	if (file->of_accmode == badaccmode) {
+		openfile_decref(file);
+		return EBADF;
+	}
+
+	seekable = VOP_ISSEEKABLE(file->of_vnode);
+	if (seekable) {
+		lock_acquire(file->of_offsetlock);
+	}
+
+	/* In append mode every write starts at the current end of file. */
+	if (seekable && rw == UIO_WRITE && file->of_append) {
+		result = VOP_STAT(file->of_vnode, &st);
+		if (result) {
+			lock_release(file->of_offsetlock);
+			openfile_decref(file);
+			return result;
+		}
+		file->of_offset = st.st_size;
+	}
+
+	uio_uinit(&iov, &useruio, buf, size,
+		  seekable ? file->of_offset : 0, rw);
+	if (rw == UIO_READ) {
+		result = VOP_READ(file->of_vnode, &useruio);
+	}
+	else {
+		result = VOP_WRITE(file->of_vnode, &useruio);
+	}
+
+	if (seekable) {
+		if (result == 0) {
+			file->of_offset = useruio.uio_offset;
+		}
+		lock_release(file->of_offsetlock);
+	}
+	openfile_decref(file);
+
+	if (result) {
+		return result;
+	}
+	*retval = size - useruio.uio_resid;
+	return 0;
+}
+
+/*
+ * read()
+ */
+int
+sys_read(int fd, userptr_t buf, size_t size, int32_t *retval)
+{
+	return file_rw(fd, buf, size, UIO_READ, O_WRONLY, retval);
+}
+
+/*
+ * write()
+ */
+int
+sys_write(int fd, userptr_t buf, size_t size, int32_t *retval)
+{
+	return file_rw(fd, buf, size, UIO_WRITE, O_RDONLY, retval);
+}
+
+/*
+ * close()
+ */
+int
+sys_close(int fd)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_remove(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+	openfile_decref(file);
+	return 0;
+}
+
+/*
+ * pipe()
+ */
+int
+sys_pipe(userptr_t fdsptr, int32_t *retval)
+{
+	struct filetable *ft = curproc->p_filetable;
+	struct vnode *readvn, *writevn;
+	struct openfile *readfile, *writefile, *junk;
+	int fds[2];
+	int result;
+
+	result = pipe_create(&readvn, &writevn);
+	if (result) {
+		return result;
+	}
+
+	/* These consume the vnode references even if they fail. */
+	result = openfile_fromvnode(readvn, O_RDONLY, &readfile);
+	if (result) {
+		vfs_close(writevn);
+		return result;
+	}
+	result = openfile_fromvnode(writevn, O_WRONLY, &writefile);
+	if (result) {
+		openfile_decref(readfile);
+		return result;
+	}
+
+	result = filetable_place(ft, readfile, &fds[0]);
+	if (result) {
+		openfile_decref(readfile);
+		openfile_decref(writefile);
+		return result;
+	}
+	result = filetable_place(ft, writefile, &fds[1]);
+	if (result) {
+		if (filetable_remove(ft, fds[0], &junk) == 0) {
+			openfile_decref(junk);
+		}
+		openfile_decref(writefile);
+		return result;
+	}
+
+	result = copyout(fds, fdsptr, sizeof(fds));
+	if (result) {
+		if (filetable_remove(ft, fds[0], &junk) == 0) {
+			openfile_decref(junk);
+		}
+		if (filetable_remove(ft, fds[1], &junk) == 0) {
+			openfile_decref(junk);
+		}
+		return result;
+	}
+
+	*retval = 0;
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * The futex system call.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <lib.h>
+#include <clock.h>
+#include <copyinout.h>
+#include <futex.h>
+#include <syscall.h>
+
+/*
+ * futex()
+ *
+ * For FUTEX_WAIT, TIMEOUT (if not NULL) is a relative time, rounded
+ * up to whole ticks as for nanosleep. For FUTEX_WAKE, VAL is the most
+ * threads to wake and the return value is how many were.
+ */
+int
+sys_futex(userptr_t uaddr, int op, int val, const_userptr_t timeout,
+	  int32_t *retval)
+{
+	struct timespec ts;
+	unsigned ticks, woken;
+	int result;
+
+	switch (op) {
+	    case FUTEX_WAIT:
+		ticks = 0;
+		if (timeout != NULL) {
+			result = copyin(timeout, &ts, sizeof(ts));
+			if (result) {
+				return result;
+			}
+			if (ts.tv_sec < 0 || ts.tv_nsec < 0 ||
+			    ts.tv_nsec >= 1000000000) {
+				return EINVAL;
+			}
+			if (ts.tv_sec > 86400) {
+				ts.tv_sec = 86400;
+			}
+			/* The extra tick covers the current partial one. */
+			ticks = (unsigned)ts.tv_sec * HZ +
+				DIVROUNDUP((unsigned)ts.tv_nsec,
+					   1000000000 / HZ) + 1;
+		}
+		result = futex_wait(uaddr, val, ticks);
+		if (result) {
+			return result;
+		}
+		*retval = 0;
+		return 0;
+
+	    case FUTEX_WAKE:
+		if (val < 0) {
+			return EINVAL;
+		}
+		result = futex_wake(uaddr, val, &woken);
+		if (result) {
+			return result;
+		}
+		*retval = woken;
+		return 0;
+	}
+	return EINVAL;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Memory-mapping system calls: mmap, munmap, msync.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/mman.h>
+#include <lib.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <vnode.h>
+#include <file.h>
+#include <syscall.h>
+
+/*
+ * mmap()
+ *
+ * ADDR is only a hint, and we don't take hints: the kernel always
+ * picks the address.
+ */
+int
+sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd,
+	 off_t offset, int32_t *retval)
+{
+	struct openfile *file;
+	struct addrspace *as;
+	vaddr_t base;
+	int result;
+
+	(void)addr;
+
+	if (len == 0 || offset < 0 || offset % PAGE_SIZE != 0) {
+		return EINVAL;
+	}
+	if (flags != MAP_SHARED && flags != MAP_PRIVATE) {
+		return EINVAL;
+	}
+	if ((prot & ~(PROT_READ | PROT_WRITE | PROT_EXEC)) != 0) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EINVAL;
+	}
+
+	result = filetable_get(curproc->p_filetable, fd, &file);
+	if (result) {
+		return result;
+	}
+
+	/* Need to be able to read it, and to write it for shared writes */
+	if (file->of_accmode == O_WRONLY ||
+	    (flags == MAP_SHARED && (prot & PROT_WRITE) != 0 &&
+	     file->of_accmode != O_RDWR)) {
+		openfile_decref(file);
+		return EACCES;
+	}
+
+	/* Ask the file system whether it can be mapped. */
+	result = VOP_MMAP(file->of_vnode);
+	if (result) {
+		openfile_decref(file);
+		return result;
+	}
+
+	/* The mapping takes its own reference to the vnode. */
+	result = as_mmap(as, len, prot, flags, file->of_vnode, offset, &base);
+	openfile_decref(file);
+	if (result) {
+		return result;
+	}
+
+	*retval = (int32_t)base;
+	return 0;
+}
+
+/*
+ * munmap()
+ */
+int
+sys_munmap(userptr_t addr, size_t len)
+{
+	struct addrspace *as;
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EINVAL;
+	}
+	return as_munmap(as, (vaddr_t)addr, len);
+}
+
+/*
+ * msync()
+ *
+ * Writes always complete before we return, so MS_ASYNC is the same
+ * as MS_SYNC; and mappings of a file always share the page cache, so
+ * there is nothing for MS_INVALIDATE to do.
+ */
+int
+sys_msync(userptr_t addr, size_t len, int flags)
+{
+	struct addrspace *as;
+
+	if ((flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)) != 0 ||
+	    (flags & (MS_ASYNC | MS_SYNC)) == (MS_ASYNC | MS_SYNC)) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EINVAL;
+	}
+	return as_msync(as, (vaddr_t)addr, len);
+}
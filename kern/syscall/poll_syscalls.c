@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * poll() and select(). Both are thin wrappers around poll_kern.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/poll.h>
+#include <kern/time.h>
+#include <limits.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <poll.h>
+#include <syscall.h>
+
+/* Largest timeout we can express in milliseconds as an int */
+#define POLL_MAXSECS	(0x7fffffff / 1000 - 1)
+
+/*
+ * poll()
+ */
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout, int32_t *retval)
+{
+	struct pollfd *fds;
+	unsigned nready;
+	int result;
+
+	if (nfds > OPEN_MAX) {
+		return EINVAL;
+	}
+
+	fds = NULL;
+	if (nfds > 0) {
+		fds = kmalloc(nfds * sizeof(fds[0]));
+		if (fds == NULL) {
+			return ENOMEM;
+		}
+		result = copyin(ufds, fds, nfds * sizeof(fds[0]));
+		if (result) {
+			kfree(fds);
+			return result;
+		}
+	}
+
+	result = poll_kern(fds, nfds, timeout < 0 ? -1 : timeout, &nready);
+	if (result == 0 && nfds > 0) {
+		result = copyout(fds, ufds, nfds * sizeof(fds[0]));
+	}
+	kfree(fds);
+	if (result) {
+		return result;
+	}
+
+	*retval = nready;
+	return 0;
+}
+
+/*
+ * select() helpers.
+ */
+
+static
+bool
+fdset_isset(const struct __fd_set *set, int fd)
+{
+	return (set->__fds_bits[fd / __NFDBITS] &
+		((__u32)1 << (fd % __NFDBITS))) != 0;
+}
+
+static
+void
+fdset_set(struct __fd_set *set, int fd)
+{
+	set->__fds_bits[fd / __NFDBITS] |= (__u32)1 << (fd % __NFDBITS);
+}
+
+/*
+ * Copy in one of select's descriptor sets, which may be NULL.
+ */
+static
+int
+fdset_copyin(userptr_t uset, struct __fd_set *set)
+{
+	if (uset == NULL) {
+		bzero(set, sizeof(*set));
+		return 0;
+	}
+	return copyin(uset, set, sizeof(*set));
+}
+
+/*
+ * Convert select's timeout to milliseconds. NULL means forever.
+ */
+static
+int
+select_gettimeout(userptr_t utv, int *ret)
+{
+	struct timeval tv;
+	int result;
+
+	if (utv == NULL) {
+		*ret = -1;
+		return 0;
+	}
+	result = copyin(utv, &tv, sizeof(tv));
+	if (result) {
+		return result;
+	}
+	if (tv.tv_sec < 0 || tv.tv_usec < 0 || tv.tv_usec >= 1000000) {
+		return EINVAL;
+	}
+	if (tv.tv_sec > POLL_MAXSECS) {
+		tv.tv_sec = POLL_MAXSECS;
+	}
+	*ret = tv.tv_sec * 1000 + DIVROUNDUP(tv.tv_usec, 1000);
+	return 0;
+}
+
+/*
+ * select()
+ *
+ * The sets are translated into a pollfd array holding only the file
+ * handles that appear in at least one set, so the work done depends
+ * on how many handles are being watched, not on NFDS.
+ */
+int
+sys_select(int nfds, userptr_t ureadfds, userptr_t uwritefds,
+	   userptr_t uexceptfds, userptr_t utimeout, int32_t *retval)
+{
+	struct __fd_set in[3], out[3];
+	userptr_t usets[3];
+	struct pollfd *fds;
+	unsigned n, i, nready;
+	int timeout, fd, count;
+	int result;
+
+	if (nfds < 0 || nfds > __FD_SETSIZE) {
+		return EINVAL;
+	}
+
+	usets[0] = ureadfds;
+	usets[1] = uwritefds;
+	usets[2] = uexceptfds;
+	for (i=0; i<3; i++) {
+		result = fdset_copyin(usets[i], &in[i]);
+		if (result) {
+			return result;
+		}
+		bzero(&out[i], sizeof(out[i]));
+	}
+	result = select_gettimeout(utimeout, &timeout);
+	if (result) {
+		return result;
+	}
+
+	fds = NULL;
+	if (nfds > 0) {
+		fds = kmalloc(nfds * sizeof(fds[0]));
+		if (fds == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	n = 0;
+	for (fd=0; fd<nfds; fd++) {
+		short events = 0;
+
+		if (fdset_isset(&in[0], fd)) {
+			events |= POLLIN;
+		}
+		if (fdset_isset(&in[1], fd)) {
+			events |= POLLOUT;
+		}
+		if (fdset_isset(&in[2], fd)) {
+			events |= POLLPRI;
+		}
+		if (events != 0) {
+			fds[n].fd = fd;
+			fds[n].events = events;
+			fds[n].revents = 0;
+			n++;
+		}
+	}
+
+	result = poll_kern(fds, n, timeout, &nready);
+	if (result) {
+		kfree(fds);
+		return result;
+	}
+
+	/*
+	 * Unlike poll, select fails outright on a bad handle. Errors
+	 * and hangups count as readable and writable, so the caller's
+	 * next read or write reports them.
+	 */
+	count = 0;
+	for (i=0; i<n; i++) {
+		short rev = fds[i].revents;
+
+		if (rev & POLLNVAL) {
+			kfree(fds);
+			return EBADF;
+		}
+		if ((fds[i].events & POLLIN) &&
+		    (rev & (POLLIN | POLLHUP | POLLERR))) {
+			fdset_set(&out[0], fds[i].fd);
+			count++;
+		}
+		if ((fds[i].events & POLLOUT) && (rev & (POLLOUT | POLLERR))) {
+			fdset_set(&out[1], fds[i].fd);
+			count++;
+		}
+		if ((fds[i].events & POLLPRI) && (rev & POLLPRI)) {
+			fdset_set(&out[2], fds[i].fd);
+			count++;
+		}
+	}
+	kfree(fds);
+
+	for (i=0; i<3; i++) {
+		if (usets[i] != NULL) {
+			result = copyout(&out[i], usets[i], sizeof(out[i]));
+			if (result) {
+				return result;
+			}
+		}
+	}
+
+	*retval = count;
+	return 0;
+}
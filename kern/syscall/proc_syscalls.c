@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Process-related system calls: fork, vfork, execv, waitpid, _exit,
+ * getpid, getrusage.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/wait.h>
+#include <lib.h>
+#include <mips/trapframe.h>
+#include <thread.h>
+#include <synch.h>
+#include <current.h>
+#include <proc.h>
+#include <pid.h>
+#include <acct.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <vfs.h>
+#include <copyinout.h>
+#include <argbuf.h>
+#include <syscall.h>
+
+////////////////////////////////////////////////////////////
+// fork
+
+/*
+ * Entry point for the child's thread. DATA1 is the parent's
+ * trapframe, copied into the heap; enter_forked_process moves it
+ * onto our own stack and frees it.
+ */
+static
+void
+fork_child(void *data1, unsigned long data2)
+{
+	(void)data2;
+	enter_forked_process(data1);
+}
+
+/*
+ * Common code for fork and vfork. For vfork, VFORKSEM is where we
+ * wait for the child to give our address space back.
+ */
+static
+int
+dofork(struct trapframe *tf, struct semaphore *vforksem, int32_t *retval)
+{
+	struct trapframe *childtf;
+	struct proc *newproc;
+	pid_t pid;
+	int result;
+
+	/*
+	 * The only copy of the trapframe made here; the child copies
+	 * it once more onto its own stack, as mips_usermode requires.
+	 */
+	childtf = kmalloc(sizeof(*childtf));
+	if (childtf == NULL) {
+		return ENOMEM;
+	}
+	*childtf = *tf;
+
+	result = proc_fork(vforksem, &newproc);
+	if (result) {
+		kfree(childtf);
+		return result;
+	}
+
+	/* The child may run, and even exit, before thread_fork returns. */
+	pid = newproc->p_pid;
+
+	result = thread_fork(curthread->t_name, newproc,
+			     fork_child, childtf, 0);
+	if (result) {
+		proc_destroy(newproc);
+		kfree(childtf);
+		return result;
+	}
+
+	if (vforksem != NULL) {
+		/* Sleep until the child execs or exits */
+		P(vforksem);
+	}
+
+	*retval = pid;
+	return 0;
+}
+
+int
+sys_fork(struct trapframe *tf, int32_t *retval)
+{
+	return dofork(tf, NULL, retval);
+}
+
+/*
+ * vfork: like fork, but the child runs in our address space instead
+ * of a copy, and we don't return until it is done with it. This
+ * makes the usual fork-then-exec pattern skip as_copy entirely.
+ */
+int
+sys_vfork(struct trapframe *tf, int32_t *retval)
+{
+	struct semaphore *sem;
+	int result;
+
+	sem = sem_create("vfork", 0);
+	if (sem == NULL) {
+		return ENOMEM;
+	}
+	result = dofork(tf, sem, retval);
+	sem_destroy(sem);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// execv
+
+/*
+ * The arguments go through a struct argbuf (see argbuf.h): copied in
+ * once, straight into their final layout, and copied out to the new
+ * stack in a single block.
+ */
+int
+sys_execv(const_userptr_t uprogram, userptr_t uargv)
+{
+	struct argbuf *ab;
+	struct addrspace *oldas, *newas;
+	struct vnode *vn;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argvptr;
+	int argc;
+	int result;
+
+	result = argbuf_get(&ab);
+	if (result) {
+		return result;
+	}
+
+	result = copyinstr(uprogram, ab->ab_progname,
+			   sizeof(ab->ab_progname), NULL);
+	if (result) {
+		goto fail_args;
+	}
+
+	result = argbuf_copyin(ab, uargv);
+	if (result) {
+		goto fail_args;
+	}
+
+	result = vfs_open(ab->ab_progname, O_RDONLY, 0, &vn);
+	if (result) {
+		goto fail_args;
+	}
+
+	newas = as_create();
+	if (newas == NULL) {
+		vfs_close(vn);
+		result = ENOMEM;
+		goto fail_args;
+	}
+
+	/* Switch to the new address space; keep the old one until done */
+	oldas = proc_setas(newas);
+	as_activate();
+
+	result = load_elf(vn, &entrypoint);
+	vfs_close(vn);
+	if (result) {
+		goto fail_as;
+	}
+
+	result = as_define_stack(newas, &stackptr);
+	if (result) {
+		goto fail_as;
+	}
+
+	result = argbuf_copyout(ab, &stackptr, &argvptr);
+	if (result) {
+		goto fail_as;
+	}
+
+	/* No going back now */
+	argc = ab->ab_argc;
+	argbuf_put(ab);
+	if (!proc_vforkdone() && oldas != NULL) {
+		as_destroy(oldas);
+	}
+
+	enter_new_process(argc, argvptr, NULL /*env*/,
+			  stackptr, entrypoint);
+
+	/* enter_new_process does not return. */
+	panic("enter_new_process returned\n");
+	return EINVAL;
+
+ fail_as:
+	proc_setas(oldas);
+	as_activate();
+	as_destroy(newas);
+ fail_args:
+	argbuf_put(ab);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// waitpid, _exit, getpid, getrusage
+
+int
+sys_waitpid(pid_t pid, userptr_t ustatus, int options, int32_t *retval)
+{
+	struct acct acct;
+	pid_t ret;
+	int status;
+	int result;
+
+	/*
+	 * Check the status pointer before reaping the child: once
+	 * pid_wait returns its slot is gone, so a fault after that
+	 * would lose its exit status for good.
+	 */
+	if (ustatus != NULL) {
+		status = 0;
+		result = copyout(&status, ustatus, sizeof(status));
+		if (result) {
+			return result;
+		}
+	}
+
+	result = pid_wait(pid, curproc->p_pid, options, &status, &acct, &ret);
+	if (result) {
+		return result;
+	}
+
+	if (ret != 0) {
+		spinlock_acquire(&curproc->p_lock);
+		acct_add(&curproc->p_acctchildren, &acct);
+		spinlock_release(&curproc->p_lock);
+	}
+
+	if (ret != 0 && ustatus != NULL) {
+		/* Checked above; fails only if it was unmapped meanwhile. */
+		result = copyout(&status, ustatus, sizeof(status));
+		if (result) {
+			return result;
+		}
+	}
+
+	*retval = ret;
+	return 0;
+}
+
+__DEAD void
+sys__exit(int exitcode)
+{
+	proc_exit(_MKWAIT_EXIT(exitcode));
+}
+
+int
+sys_getpid(int32_t *retval)
+{
+	*retval = curproc->p_pid;
+	return 0;
+}
+
+int
+sys_getrusage(int who, userptr_t uusage)
+{
+	struct acct acct;
+	struct rusage ru;
+
+	switch (who) {
+	    case RUSAGE_SELF:
+		proc_getacct(curproc, &acct);
+		break;
+	    case RUSAGE_CHILDREN:
+		spinlock_acquire(&curproc->p_lock);
+		acct = curproc->p_acctchildren;
+		spinlock_release(&curproc->p_lock);
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	acct_torusage(&acct, &ru);
+	return copyout(&ru, uusage, sizeof(ru));
+}
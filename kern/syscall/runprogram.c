@@ -42,36 +42,63 @@
 #include <addrspace.h>
 #include <vm.h>
 #include <vfs.h>
+#include <file.h>
+#include <argbuf.h>
 #include <syscall.h>
 #include <test.h>
 
 /*
- * Load program "progname" and start running it in usermode.
+ * Load program "progname" and start running it in usermode, with
+ * the NARGS strings in ARGS as its argv.
  * Does not return except on error.
  *
  * Calls vfs_open on progname and thus may destroy it.
  */
 int
-runprogram(char *progname)
+runprogram(char *progname, char **args, int nargs)
 {
+	struct argbuf *ab;
 	struct addrspace *as;
 	struct vnode *v;
 	vaddr_t entrypoint, stackptr;
+	userptr_t argvptr;
+	int argc;
 	int result;
 
+	/* Lay out the arguments before anything else can fail. */
+	result = argbuf_get(&ab);
+	if (result) {
+		return result;
+	}
+	result = argbuf_fromkernel(ab, args, nargs);
+	if (result) {
+		argbuf_put(ab);
+		return result;
+	}
+
 	/* Open the file. */
 	result = vfs_open(progname, O_RDONLY, 0, &v);
 	if (result) {
+		argbuf_put(ab);
 		return result;
 	}
 
 	/* We should be a new process. */
 	KASSERT(proc_getas() == NULL);
 
+	/* Set up stdin, stdout, and stderr. */
+	result = filetable_openstd(curproc->p_filetable);
+	if (result) {
+		vfs_close(v);
+		argbuf_put(ab);
+		return result;
+	}
+
 	/* Create a new address space. */
 	as = as_create();
 	if (as == NULL) {
 		vfs_close(v);
+		argbuf_put(ab);
 		return ENOMEM;
 	}
 
@@ -84,6 +111,7 @@ runprogram(char *progname)
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
 		vfs_close(v);
+		argbuf_put(ab);
 		return result;
 	}
 
@@ -94,11 +122,20 @@ runprogram(char *progname)
 	result = as_define_stack(as, &stackptr);
 	if (result) {
 		/* p_addrspace will go away when curproc is destroyed */
+		argbuf_put(ab);
+		return result;
+	}
+
+	/* Put the arguments on the stack. */
+	result = argbuf_copyout(ab, &stackptr, &argvptr);
+	argc = ab->ab_argc;
+	argbuf_put(ab);
+	if (result) {
 		return result;
 	}
 
 	/* Warp to user mode. */
-	enter_new_process(0 /*argc*/, NULL /*userspace addr of argv*/,
+	enter_new_process(argc, argvptr,
 			  NULL /*userspace addr of environment*/,
 			  stackptr, entrypoint);
 
@@ -28,6 +28,8 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
 #include <clock.h>
 #include <copyinout.h>
 #include <syscall.h>
@@ -56,3 +58,46 @@ sys___time(userptr_t user_seconds_ptr, userptr_t user_nanoseconds_ptr)
 
 	return 0;
 }
+
+/*
+ * Sleep for the requested time, rounded up to whole hardclock ticks.
+ * Nothing can interrupt the sleep, so the remaining time (if asked
+ * for) is always zero.
+ */
+int
+sys_nanosleep(const_userptr_t user_req, userptr_t user_rem)
+{
+	struct timespec ts;
+	unsigned ticks;
+	int result;
+
+	result = copyin(user_req, &ts, sizeof(ts));
+	if (result) {
+		return result;
+	}
+	if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000) {
+		return EINVAL;
+	}
+
+	/* Don't let the tick count wrap; a day is long enough. */
+	if (ts.tv_sec > 86400) {
+		ts.tv_sec = 86400;
+	}
+	ticks = (unsigned)ts.tv_sec * HZ +
+		DIVROUNDUP((unsigned)ts.tv_nsec, 1000000000 / HZ);
+
+	/* The current tick is already partly over; sleep at least TS. */
+	if (ticks > 0) {
+		clocksleep_ticks(ticks + 1);
+	}
+
+	if (user_rem != NULL) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 0;
+		result = copyout(&ts, user_rem, sizeof(ts));
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Per-cpu counter test.
+ *
+ * Threads spread over the cpus bump a shared counter, yielding now
+ * and then so they move around. Since every cpu has its own slot
+ * and the adds are atomic, the sum must come out exact. Also checks
+ * that registering twice is harmless and compares the cost of a
+ * counter_inc with a spinlock-protected increment.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <spinlock.h>
+#include <counter.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define PCNT_THREADS	16
+#define PCNT_LOOPS	10000
+#define PCNT_YIELD	1000
+
+static struct counter pcnt_counter = COUNTER_INITIALIZER("pcnt");
+static struct spinlock pcnt_lock = SPINLOCK_INITIALIZER;
+static volatile unsigned pcnt_locked;
+static struct semaphore *pcnt_donesem;
+
+static
+void
+pcnt_thread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<PCNT_LOOPS; i++) {
+		counter_inc(&pcnt_counter);
+		if (i % PCNT_YIELD == 0) {
+			thread_yield();
+		}
+	}
+	V(pcnt_donesem);
+}
+
+static
+void
+pcnt_locked_thread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<PCNT_LOOPS; i++) {
+		spinlock_acquire(&pcnt_lock);
+		pcnt_locked++;
+		spinlock_release(&pcnt_lock);
+		if (i % PCNT_YIELD == 0) {
+			thread_yield();
+		}
+	}
+	V(pcnt_donesem);
+}
+
+/*
+ * Run PCNT_THREADS copies of FUNC and return how long it took, in
+ * microseconds.
+ */
+static
+unsigned
+pcnt_run(void (*func)(void *, unsigned long))
+{
+	struct timespec start, end, diff;
+	unsigned i;
+	int result;
+
+	gettime(&start);
+	for (i=0; i<PCNT_THREADS; i++) {
+		result = thread_fork("pcnt", NULL, func, NULL, i);
+		if (result) {
+			panic("pcnt: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<PCNT_THREADS; i++) {
+		P(pcnt_donesem);
+	}
+	gettime(&end);
+	timespec_sub(&end, &start, &diff);
+	return diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+}
+
+int
+counttest(int nargs, char **args)
+{
+	unsigned before, after, slot, us, lockedus;
+	bool failed = false;
+
+	(void)nargs;
+	(void)args;
+
+	pcnt_donesem = sem_create("pcnt", 0);
+	if (pcnt_donesem == NULL) {
+		panic("pcnt: sem_create failed\n");
+	}
+
+	kprintf_n("Starting pcnt...\n");
+
+	slot = counter_register(&pcnt_counter);
+	if (counter_register(&pcnt_counter) != slot) {
+		kprintf_n("pcnt: registering again changed the slot\n");
+		failed = true;
+	}
+
+	before = counter_read(&pcnt_counter);
+	us = pcnt_run(pcnt_thread);
+	after = counter_read(&pcnt_counter);
+	if (after - before != PCNT_THREADS * PCNT_LOOPS) {
+		kprintf_n("pcnt: counted %u, expected %u\n", after - before,
+			  PCNT_THREADS * PCNT_LOOPS);
+		failed = true;
+	}
+
+	pcnt_locked = 0;
+	lockedus = pcnt_run(pcnt_locked_thread);
+	if (pcnt_locked != PCNT_THREADS * PCNT_LOOPS) {
+		kprintf_n("pcnt: locked count %u, expected %u\n",
+			  pcnt_locked, PCNT_THREADS * PCNT_LOOPS);
+		failed = true;
+	}
+
+	kprintf_n("pcnt: %u increments: per-cpu counter %u us, "
+		  "spinlock %u us\n", PCNT_THREADS * PCNT_LOOPS, us, lockedus);
+
+	sem_destroy(pcnt_donesem);
+	pcnt_donesem = NULL;
+
+	success(failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "pcnt");
+	return 0;
+}
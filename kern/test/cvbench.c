@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * CV broadcast benchmark.
+ *
+ * A group of threads wait on one CV; a controller broadcasts, and
+ * each waiter wakes, does a short stretch of work holding the lock,
+ * and waits again. We report how many times each waiter went off the
+ * cpu per broadcast (one, for the wait itself, is the minimum) and
+ * how long a round took. Waiters that wake only to find the lock
+ * taken show up as extra switches. It runs once with the lock in
+ * normal mode and once in handoff mode (see lock_sethandoff).
+ *
+ * Usage: cvb [nthreads [rounds]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define CVB_THREADS	16
+#define CVB_ROUNDS	100
+#define CVB_HOLDSPIN	32
+#define CVB_MAXTHREADS	64
+
+static struct lock *cvb_lock;
+static struct cv *cvb_cv;		/* waiters wait here */
+static struct cv *cvb_readycv;		/* controller waits here */
+static struct semaphore *cvb_donesem;
+static unsigned cvb_nthreads;
+static unsigned cvb_gen;
+static unsigned cvb_nwaiting;
+static bool cvb_done;
+static unsigned cvb_switches;
+static unsigned cvb_wakeups;
+
+static
+void
+cvb_waiter(void *junk, unsigned long num)
+{
+	unsigned seen, switches;
+
+	(void)junk;
+	(void)num;
+
+	lock_acquire(cvb_lock);
+	seen = cvb_gen;
+	switches = curthread->t_nswitches;
+	while (!cvb_done) {
+		cvb_nwaiting++;
+		if (cvb_nwaiting == cvb_nthreads) {
+			cv_signal(cvb_readycv, cvb_lock);
+		}
+		while (cvb_gen == seen) {
+			cv_wait(cvb_cv, cvb_lock);
+		}
+		seen = cvb_gen;
+		cvb_wakeups++;
+		random_spinner(CVB_HOLDSPIN);
+	}
+	cvb_switches += curthread->t_nswitches - switches;
+	lock_release(cvb_lock);
+
+	V(cvb_donesem);
+}
+
+/*
+ * One pass. Returns nonzero if some waiter missed a broadcast.
+ */
+static
+int
+cvb_run(unsigned nthreads, unsigned rounds, bool handoff)
+{
+	struct timespec before, after, diff;
+	uint64_t ns;
+	unsigned i, per;
+	int result;
+
+	lock_sethandoff(cvb_lock, handoff);
+	cvb_nthreads = nthreads;
+	cvb_gen = 0;
+	cvb_nwaiting = 0;
+	cvb_done = false;
+	cvb_switches = 0;
+	cvb_wakeups = 0;
+
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("cvb", NULL, cvb_waiter, NULL, i);
+		if (result) {
+			panic("cvb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&before);
+	lock_acquire(cvb_lock);
+	for (i=0; i<rounds; i++) {
+		while (cvb_nwaiting < nthreads) {
+			cv_wait(cvb_readycv, cvb_lock);
+		}
+		cvb_nwaiting = 0;
+		cvb_gen++;
+		if (i == rounds - 1) {
+			cvb_done = true;
+		}
+		cv_broadcast(cvb_cv, cvb_lock);
+	}
+	lock_release(cvb_lock);
+	for (i=0; i<nthreads; i++) {
+		P(cvb_donesem);
+	}
+	gettime(&after);
+	timespec_sub(&after, &before, &diff);
+	ns = (uint64_t)diff.tv_sec * 1000000000ULL + diff.tv_nsec;
+
+	/* Each waiter's total includes its startup and exit. */
+	per = cvb_switches * 100 / (nthreads * rounds);
+	kprintf_n("cvb: handoff %s: %u.%02u switches per waiter per "
+		  "broadcast, %llu us per round\n",
+		  handoff ? "on " : "off", per / 100, per % 100,
+		  ns / rounds / 1000);
+
+	if (cvb_wakeups != nthreads * rounds) {
+		kprintf_n("cvb: %u wakeups, expected %u\n",
+			  cvb_wakeups, nthreads * rounds);
+		return 1;
+	}
+	return 0;
+}
+
+int
+cvbench(int nargs, char **args)
+{
+	unsigned nthreads, rounds;
+	int status = TEST161_SUCCESS;
+
+	nthreads = CVB_THREADS;
+	rounds = CVB_ROUNDS;
+	if (nargs > 1) {
+		nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		rounds = atoi(args[2]);
+	}
+	if (nthreads < 1 || nthreads > CVB_MAXTHREADS || rounds < 1) {
+		kprintf("Usage: cvb [nthreads [rounds]]\n");
+		kprintf("nthreads must be between 1 and %u\n", CVB_MAXTHREADS);
+		return EINVAL;
+	}
+
+	cvb_lock = lock_create("cvb");
+	cvb_cv = cv_create("cvb");
+	cvb_readycv = cv_create("cvbready");
+	cvb_donesem = sem_create("cvbdone", 0);
+	if (cvb_lock == NULL || cvb_cv == NULL || cvb_readycv == NULL ||
+	    cvb_donesem == NULL) {
+		panic("cvb: out of memory\n");
+	}
+
+	kprintf_n("Starting cvb: %u threads, %u broadcasts...\n",
+		  nthreads, rounds);
+	if (cvb_run(nthreads, rounds, false)) {
+		status = TEST161_FAIL;
+	}
+	if (cvb_run(nthreads, rounds, true)) {
+		status = TEST161_FAIL;
+	}
+
+	sem_destroy(cvb_donesem);
+	cv_destroy(cvb_readycv);
+	cv_destroy(cvb_cv);
+	lock_destroy(cvb_lock);
+	cvb_donesem = NULL;
+	cvb_readycv = NULL;
+	cvb_cv = NULL;
+	cvb_lock = NULL;
+
+	success(status, SECRET, "cvb");
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Lock contention benchmark.
+ *
+ * A group of threads hammer on a single lock, holding it for a short
+ * randomized stretch of busy work each time, and we report how long
+ * lock_acquire took on average and at worst and how many times each
+ * acquire went off the cpu. Run it with several cpus to see what
+ * adaptive spinning buys over going straight to sleep.
+ *
+ * Usage: lkb [nthreads [holdspin]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+#include <spinlock.h>
+
+#define LKB_THREADS	8
+#define LKB_LOOPS	200
+#define LKB_HOLDSPIN	64
+#define LKB_MAXTHREADS	64
+
+static struct lock *lkb_lock;
+static struct semaphore *lkb_donesem;
+static struct spinlock lkb_statlock;
+static unsigned lkb_holdspin;
+static volatile unsigned long lkb_counter;
+
+static uint64_t lkb_totalns;
+static uint64_t lkb_maxns;
+static unsigned lkb_switches;
+
+static
+uint64_t
+lkb_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static
+void
+lkb_thread(void *junk, unsigned long num)
+{
+	struct timespec before, after;
+	uint64_t ns, total = 0, max = 0;
+	unsigned switches, i;
+
+	(void)junk;
+	(void)num;
+
+	switches = curthread->t_nswitches;
+	for (i=0; i<LKB_LOOPS; i++) {
+		gettime(&before);
+		lock_acquire(lkb_lock);
+		gettime(&after);
+
+		lkb_counter++;
+		random_spinner(lkb_holdspin);
+		lock_release(lkb_lock);
+
+		ns = lkb_ns(&after) - lkb_ns(&before);
+		total += ns;
+		if (ns > max) {
+			max = ns;
+		}
+
+		/* Do some work outside the lock too. */
+		random_spinner(lkb_holdspin);
+	}
+	switches = curthread->t_nswitches - switches;
+
+	spinlock_acquire(&lkb_statlock);
+	lkb_totalns += total;
+	if (max > lkb_maxns) {
+		lkb_maxns = max;
+	}
+	lkb_switches += switches;
+	spinlock_release(&lkb_statlock);
+
+	V(lkb_donesem);
+}
+
+int
+lockbench(int nargs, char **args)
+{
+	unsigned nthreads, nacquires, i;
+	int status = TEST161_SUCCESS;
+	int result;
+
+	nthreads = LKB_THREADS;
+	lkb_holdspin = LKB_HOLDSPIN;
+	if (nargs > 1) {
+		nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		lkb_holdspin = atoi(args[2]);
+	}
+	if (nthreads < 1 || nthreads > LKB_MAXTHREADS || lkb_holdspin < 1) {
+		kprintf("Usage: lkb [nthreads [holdspin]]\n");
+		kprintf("nthreads must be between 1 and %u\n", LKB_MAXTHREADS);
+		return EINVAL;
+	}
+
+	lkb_lock = lock_create("lkb");
+	if (lkb_lock == NULL) {
+		panic("lkb: lock_create failed\n");
+	}
+	lkb_donesem = sem_create("lkbdone", 0);
+	if (lkb_donesem == NULL) {
+		panic("lkb: sem_create failed\n");
+	}
+	spinlock_init(&lkb_statlock);
+	lkb_counter = 0;
+	lkb_totalns = 0;
+	lkb_maxns = 0;
+	lkb_switches = 0;
+
+	kprintf_n("Starting lkb: %u threads, hold spin %u...\n",
+		  nthreads, lkb_holdspin);
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("lkb", NULL, lkb_thread, NULL, i);
+		if (result) {
+			panic("lkb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<nthreads; i++) {
+		P(lkb_donesem);
+	}
+
+	nacquires = nthreads * LKB_LOOPS;
+	if (lkb_counter != nacquires) {
+		kprintf_n("lkb: counter is %lu, expected %u\n",
+			  lkb_counter, nacquires);
+		status = TEST161_FAIL;
+	}
+
+	kprintf_n("lkb: %u acquires, avg latency %llu ns, max %llu ns\n",
+		  nacquires, lkb_totalns / nacquires, lkb_maxns);
+	kprintf_n("lkb: %u context switches, %u.%02u per acquire\n",
+		  lkb_switches, lkb_switches / nacquires,
+		  (lkb_switches % nacquires) * 100 / nacquires);
+
+	lock_destroy(lkb_lock);
+	sem_destroy(lkb_donesem);
+	spinlock_cleanup(&lkb_statlock);
+	lkb_lock = NULL;
+	lkb_donesem = NULL;
+
+	success(status, SECRET, "lkb");
+	return 0;
+}
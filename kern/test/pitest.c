@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Priority inversion test.
+ *
+ * A low priority thread holds lock 1; another low priority thread
+ * holds lock 2 and is asleep waiting for lock 1. Medium priority
+ * threads then hog every cpu, and a high priority thread asks for
+ * lock 2. Without priority inheritance the low priority threads never
+ * get to run until the hogs finish, so the high priority thread waits
+ * for all of that. With it, the high priority thread's priority is
+ * passed down the chain to the first low priority thread, which
+ * finishes its work and lets go. We measure how long the high
+ * priority thread waited, and check that the boosts were undone.
+ *
+ * The threads get going in the right order because the main thread
+ * runs at top priority while setting up, so each new thread only
+ * runs when the main thread waits for it.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define PIT_LOW		4
+#define PIT_MED		20
+#define PIT_HIGH	28
+
+#define PIT_WORK	10	/* cpu ticks lock 1 is held for */
+#define PIT_HOGTIME	200	/* ticks the hogs run for */
+
+static struct lock *pit_lock1;
+static struct lock *pit_lock2;
+static struct semaphore *pit_ready;
+static struct semaphore *pit_go;
+static struct semaphore *pit_done;
+static volatile unsigned pit_hogend;
+static volatile unsigned pit_waited;
+static volatile bool pit_failed;
+
+/*
+ * Spin until this thread has been on a cpu for TICKS hardclocks.
+ */
+static
+void
+pit_work(unsigned ticks)
+{
+	unsigned seen, last;
+
+	seen = 0;
+	last = curcpu->c_hardclocks;
+	while (seen < ticks) {
+		if (curcpu->c_hardclocks != last) {
+			last = curcpu->c_hardclocks;
+			seen++;
+		}
+	}
+}
+
+static
+void
+pit_checkpri(const char *who, int pri)
+{
+	if (curthread->t_pri != pri) {
+		kprintf_n("pit: %s has priority %d, expected %d\n",
+			  who, curthread->t_pri, pri);
+		pit_failed = true;
+	}
+}
+
+static
+void
+pit_low(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PIT_LOW);
+	lock_acquire(pit_lock1);
+	V(pit_ready);
+	P(pit_go);
+	pit_work(PIT_WORK);
+	lock_release(pit_lock1);
+	pit_checkpri("low thread", PIT_LOW);
+	V(pit_done);
+}
+
+static
+void
+pit_mid(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PIT_LOW);
+	lock_acquire(pit_lock2);
+	V(pit_ready);
+	lock_acquire(pit_lock1);
+	lock_release(pit_lock1);
+	lock_release(pit_lock2);
+	pit_checkpri("middle thread", PIT_LOW);
+	V(pit_done);
+}
+
+static
+void
+pit_hog(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PIT_MED);
+	V(pit_ready);
+	while ((int)(pit_hogend - clock_getticks()) > 0) {
+		/* spin */
+	}
+	V(pit_done);
+}
+
+static
+void
+pit_high(void *junk, unsigned long num)
+{
+	unsigned start;
+
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PIT_HIGH);
+	start = clock_getticks();
+	V(pit_go);
+	lock_acquire(pit_lock2);
+	pit_waited = clock_getticks() - start;
+	lock_release(pit_lock2);
+	pit_checkpri("high thread", PIT_HIGH);
+	V(pit_done);
+}
+
+static
+void
+pit_fork(const char *name, void (*func)(void *, unsigned long))
+{
+	int result;
+
+	result = thread_fork(name, NULL, func, NULL, 0);
+	if (result) {
+		panic("pit: thread_fork failed: %s\n", strerror(result));
+	}
+}
+
+int
+pitest(int nargs, char **args)
+{
+	unsigned nhogs, i;
+	int oldpri;
+
+	(void)nargs;
+	(void)args;
+
+	pit_lock1 = lock_create("pit1");
+	pit_lock2 = lock_create("pit2");
+	pit_ready = sem_create("pitready", 0);
+	pit_go = sem_create("pitgo", 0);
+	pit_done = sem_create("pitdone", 0);
+	if (pit_lock1 == NULL || pit_lock2 == NULL || pit_ready == NULL ||
+	    pit_go == NULL || pit_done == NULL) {
+		panic("pit: out of memory\n");
+	}
+	pit_waited = 0;
+	pit_failed = false;
+	nhogs = num_cpus;
+
+	kprintf_n("Starting pit: %u hogs...\n", nhogs);
+	oldpri = curthread->t_basepri;
+	thread_setpriority(PRI_MAX);
+
+	pit_fork("pitlow", pit_low);
+	P(pit_ready);
+	pit_fork("pitmid", pit_mid);
+	P(pit_ready);
+	/* Let the middle thread go to sleep on lock 1. */
+	clocksleep_ticks(2);
+
+	pit_hogend = clock_getticks() + PIT_HOGTIME;
+	for (i=0; i<nhogs; i++) {
+		pit_fork("pithog", pit_hog);
+		P(pit_ready);
+	}
+	pit_fork("pithigh", pit_high);
+
+	for (i=0; i<nhogs + 3; i++) {
+		P(pit_done);
+	}
+	thread_setpriority(oldpri);
+
+	kprintf_n("pit: high priority thread waited %u ticks "
+		  "(lock held for %u, hogs ran for %u)\n",
+		  pit_waited, PIT_WORK, PIT_HOGTIME);
+	if (pit_waited >= PIT_HOGTIME / 2) {
+		kprintf_n("pit: priority was not inherited\n");
+		pit_failed = true;
+	}
+
+	sem_destroy(pit_done);
+	sem_destroy(pit_go);
+	sem_destroy(pit_ready);
+	lock_destroy(pit_lock2);
+	lock_destroy(pit_lock1);
+	pit_done = pit_go = pit_ready = NULL;
+	pit_lock2 = pit_lock1 = NULL;
+
+	success(pit_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "pit");
+	return 0;
+}
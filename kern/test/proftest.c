@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Sampling profiler test.
+ *
+ * Spin in one small function for a while with the profiler on, and
+ * check that most of this cpu's samples landed in it. Then check
+ * that a reset empties the profile.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <prof.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define PROFT_TICKS	50	/* how long to spin */
+#define PROFT_INNER	1000	/* iterations between clock checks */
+#define PROFT_SPAN	256	/* bytes of proft_spin to look at */
+
+static
+void
+proft_spin(unsigned ticks)
+{
+	volatile unsigned x = 0;
+	unsigned end, i;
+
+	end = clock_getticks() + ticks;
+	while (clock_getticks() < end) {
+		for (i=0; i<PROFT_INNER; i++) {
+			x += i;
+		}
+	}
+}
+
+int
+proftest(int nargs, char **args)
+{
+	vaddr_t spin;
+	unsigned inspin, total;
+	bool failed = false;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting proft...\n");
+
+	prof_reset();
+	result = prof_start();
+	if (result) {
+		kprintf_n("proft: prof_start: %s\n", strerror(result));
+		success(TEST161_FAIL, SECRET, "proft");
+		return 0;
+	}
+	proft_spin(PROFT_TICKS);
+	prof_stop();
+
+	spin = (vaddr_t)proft_spin;
+	inspin = prof_count(spin, spin + PROFT_SPAN);
+	total = prof_count(0, (vaddr_t)-1);
+	kprintf_n("proft: %u of %u kernel samples in proft_spin\n",
+		  inspin, total);
+	if (inspin < PROFT_TICKS / 2) {
+		kprintf_n("proft: expected at least %u\n", PROFT_TICKS / 2);
+		failed = true;
+	}
+
+	prof_reset();
+	total = prof_count(0, (vaddr_t)-1);
+	if (total != 0) {
+		kprintf_n("proft: %u samples left after reset\n", total);
+		failed = true;
+	}
+
+	success(failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "proft");
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * RCU test.
+ *
+ * Reader threads keep looking at a published object while a writer
+ * keeps replacing it and retiring the old ones with rcu_call (and
+ * now and then rcu_synchronize). The retire callback poisons the
+ * object before freeing it, so a reader that can still see a retired
+ * object notices.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <synch.h>
+#include <spinlock.h>
+#include <rcu.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define RCUT_READLOOPS	2000
+#define RCUT_UPDATES	200
+#define RCUT_SPIN	32
+
+#define RCUT_LIVE	0x1ee7c0de
+#define RCUT_DEAD	0xdeadbeef
+
+struct rcut_obj {
+	struct rcu_head ro_head;
+	unsigned ro_magic;
+	unsigned ro_a;
+	unsigned ro_b;
+};
+
+static struct rcut_obj *rcut_cur;
+static struct semaphore *rcut_donesem;
+static struct spinlock rcut_lock;
+static unsigned rcut_retired;
+static volatile bool rcut_failed;
+
+static
+void
+rcut_free(struct rcu_head *head)
+{
+	struct rcut_obj *obj = (struct rcut_obj *)head;
+
+	obj->ro_magic = RCUT_DEAD;
+	kfree(obj);
+
+	spinlock_acquire(&rcut_lock);
+	rcut_retired++;
+	spinlock_release(&rcut_lock);
+}
+
+static
+void
+rcut_reader(void *junk, unsigned long num)
+{
+	struct rcut_obj *obj;
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<RCUT_READLOOPS; i++) {
+		rcu_read_lock();
+		obj = rcu_dereference(rcut_cur);
+		random_spinner(RCUT_SPIN);
+		if (obj->ro_magic != RCUT_LIVE || obj->ro_b != obj->ro_a * 2) {
+			rcut_failed = true;
+		}
+		rcu_read_unlock();
+	}
+	V(rcut_donesem);
+}
+
+static
+void
+rcut_writer(void *junk, unsigned long num)
+{
+	struct rcut_obj *obj, *old;
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<RCUT_UPDATES; i++) {
+		obj = kmalloc(sizeof(*obj));
+		if (obj == NULL) {
+			panic("rcut: Out of memory\n");
+		}
+		obj->ro_magic = RCUT_LIVE;
+		obj->ro_a = i;
+		obj->ro_b = i * 2;
+
+		old = rcut_cur;
+		rcu_assign_pointer(rcut_cur, obj);
+		if (i % 16 == 0) {
+			rcu_synchronize();
+			rcut_free(&old->ro_head);
+		}
+		else {
+			rcu_call(&old->ro_head, rcut_free);
+		}
+		thread_yield();
+	}
+	V(rcut_donesem);
+}
+
+int
+rcutest(int nargs, char **args)
+{
+	unsigned nreaders, i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	rcut_donesem = sem_create("rcutdone", 0);
+	if (rcut_donesem == NULL) {
+		panic("rcut: sem_create failed\n");
+	}
+	spinlock_init(&rcut_lock);
+	rcut_retired = 0;
+	rcut_failed = false;
+
+	rcut_cur = kmalloc(sizeof(*rcut_cur));
+	if (rcut_cur == NULL) {
+		panic("rcut: Out of memory\n");
+	}
+	rcut_cur->ro_magic = RCUT_LIVE;
+	rcut_cur->ro_a = 0;
+	rcut_cur->ro_b = 0;
+
+	nreaders = num_cpus * 2;
+	kprintf_n("Starting rcut: %u readers, 1 writer...\n", nreaders);
+	result = thread_fork("rcutwriter", NULL, rcut_writer, NULL, 0);
+	if (result) {
+		panic("rcut: thread_fork failed: %s\n", strerror(result));
+	}
+	for (i=0; i<nreaders; i++) {
+		result = thread_fork("rcutreader", NULL, rcut_reader, NULL, i);
+		if (result) {
+			panic("rcut: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<nreaders + 1; i++) {
+		P(rcut_donesem);
+	}
+
+	/* Wait for the rcu thread to run the last callbacks. */
+	while (1) {
+		spinlock_acquire(&rcut_lock);
+		i = rcut_retired;
+		spinlock_release(&rcut_lock);
+		if (i == RCUT_UPDATES) {
+			break;
+		}
+		rcu_synchronize();
+		thread_yield();
+	}
+
+	kfree(rcut_cur);
+	rcut_cur = NULL;
+	spinlock_cleanup(&rcut_lock);
+	sem_destroy(rcut_donesem);
+	rcut_donesem = NULL;
+
+	if (rcut_failed) {
+		kprintf_n("rcut: a reader saw a retired object\n");
+	}
+	success(rcut_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "rcut");
+	return 0;
+}
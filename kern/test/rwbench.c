@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Reader-writer lock scaling benchmark.
+ *
+ * Runs 1, 2, 4, ... reader threads (up to twice the number of cpus)
+ * against one rwlock, with one occasional writer thrown in, and
+ * reports read acquires per millisecond at each step. With a
+ * scalable read side the rate should grow with the number of cpus
+ * rather than flatten out.
+ *
+ * Usage: rwb [loops]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+#include <spinlock.h>
+
+#define RWB_LOOPS	500
+#define RWB_WRITEEVERY	64	/* One write per this many reads */
+#define RWB_SPIN	16
+
+static struct rwlock *rwb_rw;
+static struct semaphore *rwb_donesem;
+static unsigned rwb_loops;
+static volatile unsigned long rwb_value;
+static volatile bool rwb_failed;
+
+static
+void
+rwb_reader(void *junk, unsigned long num)
+{
+	unsigned long v1, v2;
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<rwb_loops; i++) {
+		rwlock_acquire_read(rwb_rw);
+		v1 = rwb_value;
+		random_spinner(RWB_SPIN);
+		v2 = rwb_value;
+		rwlock_release_read(rwb_rw);
+		if (v1 != v2) {
+			rwb_failed = true;
+		}
+	}
+	V(rwb_donesem);
+}
+
+static
+void
+rwb_writer(void *junk, unsigned long nwrites)
+{
+	unsigned long i;
+
+	(void)junk;
+
+	for (i=0; i<nwrites; i++) {
+		rwlock_acquire_write(rwb_rw);
+		rwb_value++;
+		random_spinner(RWB_SPIN);
+		rwlock_release_write(rwb_rw);
+		random_spinner(RWB_SPIN * RWB_WRITEEVERY);
+	}
+	V(rwb_donesem);
+}
+
+static
+uint64_t
+rwb_elapsedus(const struct timespec *start)
+{
+	struct timespec now, diff;
+
+	gettime(&now);
+	timespec_sub(&now, start, &diff);
+	return (uint64_t)diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+}
+
+int
+rwbench(int nargs, char **args)
+{
+	struct timespec start;
+	unsigned nreaders, maxreaders, i;
+	unsigned long nwrites;
+	uint64_t us, rate;
+	int result;
+
+	rwb_loops = RWB_LOOPS;
+	if (nargs > 1) {
+		rwb_loops = atoi(args[1]);
+	}
+	if (nargs > 2 || rwb_loops < 1) {
+		kprintf("Usage: rwb [loops]\n");
+		return EINVAL;
+	}
+
+	rwb_rw = rwlock_create("rwb");
+	if (rwb_rw == NULL) {
+		panic("rwb: rwlock_create failed\n");
+	}
+	rwb_donesem = sem_create("rwbdone", 0);
+	if (rwb_donesem == NULL) {
+		panic("rwb: sem_create failed\n");
+	}
+	rwb_failed = false;
+
+	maxreaders = num_cpus * 2;
+	kprintf_n("%8s %10s %12s\n", "readers", "time(us)", "reads/ms");
+	for (nreaders = 1; nreaders <= maxreaders; nreaders *= 2) {
+		nwrites = (unsigned long)nreaders * rwb_loops / RWB_WRITEEVERY;
+
+		gettime(&start);
+		result = thread_fork("rwbwriter", NULL, rwb_writer,
+				     NULL, nwrites);
+		if (result) {
+			panic("rwb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+		for (i=0; i<nreaders; i++) {
+			result = thread_fork("rwbreader", NULL, rwb_reader,
+					     NULL, i);
+			if (result) {
+				panic("rwb: thread_fork failed: %s\n",
+				      strerror(result));
+			}
+		}
+		for (i=0; i<nreaders + 1; i++) {
+			P(rwb_donesem);
+		}
+		us = rwb_elapsedus(&start);
+		if (us == 0) {
+			us = 1;
+		}
+
+		rate = (uint64_t)nreaders * rwb_loops * 1000 / us;
+		kprintf_n("%8u %10u %12u\n", nreaders, (unsigned)us,
+			  (unsigned)rate);
+	}
+
+	rwlock_destroy(rwb_rw);
+	sem_destroy(rwb_donesem);
+	rwb_rw = NULL;
+	rwb_donesem = NULL;
+
+	if (rwb_failed) {
+		kprintf_n("rwb: a reader saw a write in progress\n");
+	}
+	success(rwb_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "rwb");
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Spinlock stress test.
+ *
+ * One thread per cpu hammers on a single spinlock for a few seconds.
+ * Afterwards we check that the lock kept the shared counter straight
+ * and report throughput plus how evenly the acquisitions were spread
+ * across cpus (Jain's fairness index: 1.000 means perfectly even).
+ *
+ * Usage: spt [seconds]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <membar.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+#include <spinlock.h>
+
+#define SPT_SECONDS	2
+#define SPT_MAXCPUS	32
+#define SPT_HOLDSPIN	16
+
+static struct spinlock spt_lock;
+static struct semaphore *spt_donesem;
+static volatile bool spt_stop;
+static volatile unsigned long spt_shared;
+static unsigned long spt_percpu[SPT_MAXCPUS];
+
+static
+void
+spt_thread(void *junk, unsigned long num)
+{
+	unsigned cpunum;
+
+	(void)junk;
+	(void)num;
+
+	while (!spt_stop) {
+		spinlock_acquire(&spt_lock);
+		cpunum = curcpu->c_number;
+		if (cpunum < SPT_MAXCPUS) {
+			spt_percpu[cpunum]++;
+		}
+		spt_shared++;
+		random_spinner(SPT_HOLDSPIN);
+		spinlock_release(&spt_lock);
+
+		random_spinner(SPT_HOLDSPIN);
+	}
+	V(spt_donesem);
+}
+
+int
+spinlocktest(int nargs, char **args)
+{
+	unsigned nthreads, ncpus, i;
+	int seconds, result;
+	unsigned long total, min, max;
+	uint64_t sumsq, fairness;
+	int status = TEST161_SUCCESS;
+
+	seconds = SPT_SECONDS;
+	if (nargs > 1) {
+		seconds = atoi(args[1]);
+	}
+	if (seconds < 1) {
+		kprintf("Usage: spt [seconds]\n");
+		return EINVAL;
+	}
+
+	ncpus = num_cpus < SPT_MAXCPUS ? num_cpus : SPT_MAXCPUS;
+	nthreads = ncpus;
+
+	spinlock_init(&spt_lock);
+	spt_donesem = sem_create("sptdone", 0);
+	if (spt_donesem == NULL) {
+		panic("spt: sem_create failed\n");
+	}
+	spt_stop = false;
+	spt_shared = 0;
+	for (i=0; i<SPT_MAXCPUS; i++) {
+		spt_percpu[i] = 0;
+	}
+
+	kprintf_n("Starting spt: %u threads for %d seconds...\n",
+		  nthreads, seconds);
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("spt", NULL, spt_thread, NULL, i);
+		if (result) {
+			panic("spt: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	clocksleep(seconds);
+	spt_stop = true;
+	membar_store_any();
+	for (i=0; i<nthreads; i++) {
+		P(spt_donesem);
+	}
+
+	total = 0;
+	sumsq = 0;
+	min = max = spt_percpu[0];
+	for (i=0; i<ncpus; i++) {
+		kprintf_n("spt: cpu%u: %lu acquires\n", i, spt_percpu[i]);
+		total += spt_percpu[i];
+		sumsq += (uint64_t)spt_percpu[i] * spt_percpu[i];
+		if (spt_percpu[i] < min) {
+			min = spt_percpu[i];
+		}
+		if (spt_percpu[i] > max) {
+			max = spt_percpu[i];
+		}
+	}
+	if (total != spt_shared) {
+		kprintf_n("spt: counter is %lu, expected %lu\n",
+			  spt_shared, total);
+		status = TEST161_FAIL;
+	}
+
+	fairness = sumsq == 0 ? 0 :
+		(uint64_t)total * total * 1000 / (ncpus * sumsq);
+	kprintf_n("spt: %lu acquires, %lu per second\n",
+		  total, total / seconds);
+	kprintf_n("spt: per-cpu min %lu max %lu, fairness %u.%03u\n",
+		  min, max, (unsigned)(fairness / 1000),
+		  (unsigned)(fairness % 1000));
+
+	spinlock_cleanup(&spt_lock);
+	sem_destroy(spt_donesem);
+	spt_donesem = NULL;
+
+	success(status, SECRET, "spt");
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Thread create+exit benchmark.
+ *
+ * Forks batches of threads that exit as soon as they start, waiting
+ * for each batch to finish before starting the next, and reports how
+ * many threads were created and destroyed per second. Small batches
+ * are what the per-cpu thread cache (see exorcise) is for: most forks
+ * should be hits. Also reports the cache hit and miss counts.
+ *
+ * Usage: tfb [nthreads [batch]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define TFB_THREADS	2000
+#define TFB_BATCH	4
+
+static struct semaphore *tfb_donesem;
+
+static
+void
+tfb_thread(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	V(tfb_donesem);
+}
+
+int
+threadbench(int nargs, char **args)
+{
+	struct timespec before, after, diff;
+	unsigned nthreads, batch, i, j;
+	unsigned hits, misses, hits2, misses2;
+	uint64_t ns;
+	int result;
+
+	nthreads = TFB_THREADS;
+	batch = TFB_BATCH;
+	if (nargs > 1) {
+		nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		batch = atoi(args[2]);
+	}
+	if (nthreads < 1 || batch < 1) {
+		kprintf("Usage: tfb [nthreads [batch]]\n");
+		return EINVAL;
+	}
+
+	tfb_donesem = sem_create("tfb", 0);
+	if (tfb_donesem == NULL) {
+		panic("tfb: sem_create failed\n");
+	}
+
+	kprintf_n("Starting tfb: %u threads in batches of %u...\n",
+		  nthreads, batch);
+
+	thread_cachestats(&hits, &misses);
+	gettime(&before);
+	for (i=0; i<nthreads; i+=batch) {
+		for (j=0; j<batch && i+j<nthreads; j++) {
+			result = thread_fork("tfb", NULL, tfb_thread, NULL, j);
+			if (result) {
+				panic("tfb: thread_fork failed: %s\n",
+				      strerror(result));
+			}
+		}
+		for (j=0; j<batch && i+j<nthreads; j++) {
+			P(tfb_donesem);
+		}
+	}
+	gettime(&after);
+	thread_cachestats(&hits2, &misses2);
+
+	timespec_sub(&after, &before, &diff);
+	ns = (uint64_t)diff.tv_sec * 1000000000ULL + diff.tv_nsec;
+	if (ns == 0) {
+		ns = 1;
+	}
+	kprintf_n("tfb: %llu threads/sec, %llu us per thread\n",
+		  (uint64_t)nthreads * 1000000000ULL / ns,
+		  ns / nthreads / 1000);
+	kprintf_n("tfb: thread cache: %u hits, %u misses\n",
+		  hits2 - hits, misses2 - misses);
+
+	sem_destroy(tfb_donesem);
+	tfb_donesem = NULL;
+
+	success(TEST161_SUCCESS, SECRET, "tfb");
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Timed wait test.
+ *
+ * Several threads wait on the same CV with different timeouts and
+ * nobody signals it, so each must wake up on its own, on time, with
+ * ETIMEDOUT. One timeout is long enough to go through the outer
+ * timer wheel. Another thread waits with a long timeout on a second
+ * CV that does get signaled, and must come back early with 0.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define TMT_NWAITERS	8
+#define TMT_STEP	7	/* ticks between successive timeouts */
+#define TMT_LONG	300	/* past the inner wheel */
+#define TMT_SLACK	5	/* how late a wakeup may be, in ticks */
+#define TMT_SIGDELAY	10
+#define TMT_SIGWAIT	(10 * HZ)
+
+static struct lock *tmt_lock;
+static struct cv *tmt_cv;
+static struct cv *tmt_sigcv;
+static struct semaphore *tmt_donesem;
+static bool tmt_signaled;
+static volatile bool tmt_failed;
+static volatile unsigned tmt_maxlate;
+
+static
+void
+tmt_waiter(void *junk, unsigned long ticks)
+{
+	unsigned start, elapsed;
+	int result;
+
+	(void)junk;
+
+	lock_acquire(tmt_lock);
+	start = clock_getticks();
+	result = cv_wait_timeout(tmt_cv, tmt_lock, ticks);
+	elapsed = clock_getticks() - start;
+	if (result != ETIMEDOUT) {
+		kprintf_n("tmt: %lu-tick wait returned %d\n", ticks, result);
+		tmt_failed = true;
+	}
+	else if (elapsed < ticks || elapsed > ticks + TMT_SLACK) {
+		kprintf_n("tmt: %lu-tick wait took %u ticks\n", ticks,
+			  elapsed);
+		tmt_failed = true;
+	}
+	else if (elapsed - ticks > tmt_maxlate) {
+		tmt_maxlate = elapsed - ticks;
+	}
+	lock_release(tmt_lock);
+	V(tmt_donesem);
+}
+
+static
+void
+tmt_sigwaiter(void *junk, unsigned long num)
+{
+	unsigned start, elapsed;
+	int result;
+
+	(void)junk;
+	(void)num;
+
+	lock_acquire(tmt_lock);
+	start = clock_getticks();
+	result = 0;
+	while (!tmt_signaled && result == 0) {
+		result = cv_wait_timeout(tmt_sigcv, tmt_lock, TMT_SIGWAIT);
+	}
+	elapsed = clock_getticks() - start;
+	if (result != 0 || elapsed >= TMT_SIGWAIT) {
+		kprintf_n("tmt: signaled wait returned %d after %u ticks\n",
+			  result, elapsed);
+		tmt_failed = true;
+	}
+	lock_release(tmt_lock);
+	V(tmt_donesem);
+}
+
+static
+void
+tmt_fork(const char *name,
+	 void (*func)(void *, unsigned long), unsigned long arg)
+{
+	int result;
+
+	result = thread_fork(name, NULL, func, NULL, arg);
+	if (result) {
+		panic("tmt: thread_fork failed: %s\n", strerror(result));
+	}
+}
+
+int
+timertest(int nargs, char **args)
+{
+	unsigned i;
+
+	(void)nargs;
+	(void)args;
+
+	tmt_lock = lock_create("tmt");
+	tmt_cv = cv_create("tmt");
+	tmt_sigcv = cv_create("tmtsig");
+	tmt_donesem = sem_create("tmtdone", 0);
+	if (tmt_lock == NULL || tmt_cv == NULL || tmt_sigcv == NULL ||
+	    tmt_donesem == NULL) {
+		panic("tmt: out of memory\n");
+	}
+	tmt_signaled = false;
+	tmt_failed = false;
+	tmt_maxlate = 0;
+
+	kprintf_n("Starting tmt: %u timed waiters...\n", TMT_NWAITERS + 1);
+	for (i=0; i<TMT_NWAITERS; i++) {
+		tmt_fork("tmtwaiter", tmt_waiter, 1 + i * TMT_STEP);
+	}
+	tmt_fork("tmtwaiter", tmt_waiter, TMT_LONG);
+	tmt_fork("tmtsigwaiter", tmt_sigwaiter, 0);
+
+	clocksleep_ticks(TMT_SIGDELAY);
+	lock_acquire(tmt_lock);
+	tmt_signaled = true;
+	cv_signal(tmt_sigcv, tmt_lock);
+	lock_release(tmt_lock);
+
+	for (i=0; i<TMT_NWAITERS + 2; i++) {
+		P(tmt_donesem);
+	}
+
+	kprintf_n("tmt: latest wakeup was %u ticks late\n", tmt_maxlate);
+
+	sem_destroy(tmt_donesem);
+	cv_destroy(tmt_sigcv);
+	cv_destroy(tmt_cv);
+	lock_destroy(tmt_lock);
+	tmt_donesem = NULL;
+	tmt_sigcv = NULL;
+	tmt_cv = NULL;
+	tmt_lock = NULL;
+
+	success(tmt_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "tmt");
+	return 0;
+}
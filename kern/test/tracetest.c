@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Event trace test.
+ *
+ * Trace two threads playing ping-pong with semaphores and a burst of
+ * kmallocs, and check that the switches, sleeps, wakeups, and
+ * allocations all show up in the rings.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <thread.h>
+#include <synch.h>
+#include <trace.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define TRT_ROUNDS	10
+#define TRT_ALLOCS	20
+
+static struct semaphore *trt_ping;
+static struct semaphore *trt_pong;
+
+static
+void
+trt_thread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<TRT_ROUNDS; i++) {
+		P(trt_ping);
+		V(trt_pong);
+	}
+}
+
+/*
+ * Check that at least MIN records of EVENT were taken.
+ */
+static
+bool
+trt_check(unsigned event, const char *name, unsigned min)
+{
+	unsigned count;
+
+	count = trace_count(event);
+	kprintf_n("trt: %u %s records\n", count, name);
+	if (count < min) {
+		kprintf_n("trt: expected at least %u\n", min);
+		return false;
+	}
+	return true;
+}
+
+int
+tracetest(int nargs, char **args)
+{
+	unsigned i;
+	void *p;
+	bool ok = true;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting trt...\n");
+
+	trt_ping = sem_create("trt_ping", 0);
+	trt_pong = sem_create("trt_pong", 0);
+	if (trt_ping == NULL || trt_pong == NULL) {
+		panic("trt: sem_create failed\n");
+	}
+
+	trace_stop();
+	trace_reset();
+	result = trace_start();
+	if (result) {
+		kprintf_n("trt: trace_start: %s\n", strerror(result));
+		success(TEST161_FAIL, SECRET, "trt");
+		return 0;
+	}
+
+	result = thread_fork("trt", NULL, trt_thread, NULL, 0);
+	if (result) {
+		panic("trt: thread_fork failed: %s\n", strerror(result));
+	}
+	for (i=0; i<TRT_ROUNDS; i++) {
+		V(trt_ping);
+		P(trt_pong);
+	}
+	for (i=0; i<TRT_ALLOCS; i++) {
+		p = kmalloc(16);
+		kfree(p);
+	}
+
+	trace_stop();
+
+	ok = trt_check(TRACE_SWITCH, "switch", 1) && ok;
+	ok = trt_check(TRACE_SLEEP, "sleep", 1) && ok;
+	ok = trt_check(TRACE_WAKE, "wake", 1) && ok;
+	ok = trt_check(TRACE_KMALLOC, "kmalloc", TRT_ALLOCS) && ok;
+	trace_reset();
+	if (trace_count(TRACE_KMALLOC) != 0) {
+		kprintf_n("trt: records left after reset\n");
+		ok = false;
+	}
+
+	sem_destroy(trt_ping);
+	sem_destroy(trt_pong);
+	trt_ping = trt_pong = NULL;
+
+	success(ok ? TEST161_SUCCESS : TEST161_FAIL, SECRET, "trt");
+	return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Workqueue test.
+ *
+ * Several threads each queue a batch of work items at splhigh,
+ * noting which cpu they were on, and each item checks that it runs
+ * on that cpu. work_flush must not return until all of them have
+ * run. Then some delayed items must each wait out their delay, a
+ * cancelled one must never run, and queueing an item that is still
+ * pending must be refused.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <workqueue.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define WQT_NTHREADS	8
+#define WQT_PERTHREAD	32
+#define WQT_NDELAYED	4
+#define WQT_STEP	5	/* ticks between successive delays */
+#define WQT_LONG	(10 * HZ)
+
+struct wqt_item {
+	struct work wi_work;
+	struct cpu *wi_cpu;		/* cpu it was queued on */
+	unsigned wi_queued;		/* tick it was queued at */
+	unsigned wi_delay;
+	volatile bool wi_ran;
+};
+
+static struct wqt_item wqt_items[WQT_NTHREADS * WQT_PERTHREAD];
+static struct wqt_item wqt_delayed[WQT_NDELAYED];
+static struct wqt_item wqt_cancelled;
+static struct semaphore *wqt_startsem;
+static struct semaphore *wqt_delaysem;
+static volatile bool wqt_failed;
+
+static
+void
+wqt_work(void *data)
+{
+	struct wqt_item *wi = data;
+
+	if (curcpu != wi->wi_cpu) {
+		kprintf_n("wqt: work queued on cpu %u ran on cpu %u\n",
+			  wi->wi_cpu->c_number, curcpu->c_number);
+		wqt_failed = true;
+	}
+	wi->wi_ran = true;
+}
+
+static
+void
+wqt_delaywork(void *data)
+{
+	struct wqt_item *wi = data;
+	unsigned elapsed;
+
+	elapsed = clock_getticks() - wi->wi_queued;
+	if (elapsed < wi->wi_delay) {
+		kprintf_n("wqt: %u-tick delayed work ran after %u ticks\n",
+			  wi->wi_delay, elapsed);
+		wqt_failed = true;
+	}
+	wi->wi_ran = true;
+	V(wqt_delaysem);
+}
+
+static
+void
+wqt_submitter(void *junk, unsigned long num)
+{
+	struct wqt_item *wi;
+	unsigned i;
+	int spl;
+
+	(void)junk;
+
+	for (i=0; i<WQT_PERTHREAD; i++) {
+		wi = &wqt_items[num * WQT_PERTHREAD + i];
+		/* Stay on one cpu between noting it and queueing. */
+		spl = splhigh();
+		wi->wi_cpu = curcpu;
+		if (!work_queue(&wi->wi_work)) {
+			kprintf_n("wqt: idle work item refused\n");
+			wqt_failed = true;
+		}
+		splx(spl);
+		if (i % 4 == 0) {
+			thread_yield();
+		}
+	}
+	V(wqt_startsem);
+}
+
+int
+workqtest(int nargs, char **args)
+{
+	struct wqt_item *wi;
+	unsigned i, n;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	wqt_startsem = sem_create("wqtstart", 0);
+	wqt_delaysem = sem_create("wqtdelay", 0);
+	if (wqt_startsem == NULL || wqt_delaysem == NULL) {
+		panic("wqt: sem_create failed\n");
+	}
+	wqt_failed = false;
+
+	n = WQT_NTHREADS * WQT_PERTHREAD;
+	for (i=0; i<n; i++) {
+		wi = &wqt_items[i];
+		work_init(&wi->wi_work, wqt_work, wi);
+		wi->wi_ran = false;
+	}
+
+	kprintf_n("Starting wqt: %u threads queueing %u items each...\n",
+		  WQT_NTHREADS, WQT_PERTHREAD);
+	for (i=0; i<WQT_NTHREADS; i++) {
+		result = thread_fork("wqtsubmit", NULL, wqt_submitter, NULL, i);
+		if (result) {
+			panic("wqt: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<WQT_NTHREADS; i++) {
+		P(wqt_startsem);
+	}
+	work_flush();
+	for (i=0; i<n; i++) {
+		if (!wqt_items[i].wi_ran) {
+			kprintf_n("wqt: item %u hadn't run after flush\n", i);
+			wqt_failed = true;
+		}
+	}
+
+	kprintf_n("wqt: delayed and cancelled work...\n");
+	work_init(&wqt_cancelled.wi_work, wqt_delaywork, &wqt_cancelled);
+	wqt_cancelled.wi_ran = false;
+	work_queue_delayed(&wqt_cancelled.wi_work, WQT_LONG);
+
+	for (i=0; i<WQT_NDELAYED; i++) {
+		wi = &wqt_delayed[i];
+		work_init(&wi->wi_work, wqt_delaywork, wi);
+		wi->wi_ran = false;
+		wi->wi_delay = 1 + i * WQT_STEP;
+		wi->wi_queued = clock_getticks();
+		if (!work_queue_delayed(&wi->wi_work, wi->wi_delay)) {
+			kprintf_n("wqt: idle delayed item refused\n");
+			wqt_failed = true;
+		}
+	}
+	if (work_queue(&wqt_delayed[WQT_NDELAYED - 1].wi_work)) {
+		kprintf_n("wqt: pending item queued twice\n");
+		wqt_failed = true;
+	}
+	for (i=0; i<WQT_NDELAYED; i++) {
+		P(wqt_delaysem);
+	}
+
+	if (!work_cancel(&wqt_cancelled.wi_work)) {
+		kprintf_n("wqt: work_cancel failed on a waiting item\n");
+		wqt_failed = true;
+	}
+	if (work_cancel(&wqt_cancelled.wi_work)) {
+		kprintf_n("wqt: work_cancel succeeded twice\n");
+		wqt_failed = true;
+	}
+	work_flush();
+	if (wqt_cancelled.wi_ran) {
+		kprintf_n("wqt: cancelled work ran\n");
+		wqt_failed = true;
+	}
+
+	sem_destroy(wqt_delaysem);
+	sem_destroy(wqt_startsem);
+	wqt_delaysem = NULL;
+	wqt_startsem = NULL;
+
+	success(wqt_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "wqt");
+	return 0;
+}
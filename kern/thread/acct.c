@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Resource accounting. See acct.h.
+ */
+
+#include <types.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <lib.h>
+#include <spl.h>
+#include <thread.h>
+#include <current.h>
+#include <mainbus.h>
+#include <acct.h>
+
+/* Set once the clock exists; until then nothing is charged. */
+static bool acct_running;
+
+/*
+ * The time on this cpu, in cycles.
+ */
+static
+uint64_t
+acct_now(void)
+{
+	return mainbus_cycles();
+}
+
+/*
+ * Charge the current thread for the time since it was last charged.
+ */
+static
+void
+acct_charge(void)
+{
+	struct thread *cur = curthread;
+	uint64_t now, ns;
+
+	if (!acct_running) {
+		return;
+	}
+	now = acct_now();
+	ns = mainbus_cycles_to_ns(now - cur->t_acct_since);
+	if (cur->t_acct_user) {
+		cur->t_acct.ac_utime += ns;
+	}
+	else {
+		cur->t_acct.ac_stime += ns;
+	}
+	cur->t_acct_since = now;
+}
+
+void
+acct_bootstrap(void)
+{
+	int spl;
+
+	/*
+	 * Only this cpu is running yet, and other threads restart
+	 * the clock when they are next switched in.
+	 */
+	spl = splhigh();
+	curthread->t_acct_since = acct_now();
+	acct_running = true;
+	splx(spl);
+}
+
+void
+acct_kernelentry(void)
+{
+	acct_charge();
+	curthread->t_acct_user = false;
+}
+
+void
+acct_kernelexit(void)
+{
+	acct_charge();
+	curthread->t_acct_user = true;
+}
+
+void
+acct_switchout(void)
+{
+	acct_charge();
+}
+
+void
+acct_switchin(void)
+{
+	if (acct_running) {
+		curthread->t_acct_since = acct_now();
+	}
+}
+
+void
+acct_sync(void)
+{
+	int spl;
+
+	/* Keep a timer interrupt from switching us out halfway */
+	spl = splhigh();
+	acct_charge();
+	splx(spl);
+}
+
+void
+acct_add(struct acct *to, const struct acct *from)
+{
+	to->ac_utime += from->ac_utime;
+	to->ac_stime += from->ac_stime;
+	to->ac_nvcsw += from->ac_nvcsw;
+	to->ac_nivcsw += from->ac_nivcsw;
+	to->ac_minflt += from->ac_minflt;
+	to->ac_majflt += from->ac_majflt;
+}
+
+/*
+ * Convert nanoseconds to a timeval.
+ */
+static
+void
+acct_totimeval(uint64_t ns, struct timeval *tv)
+{
+	tv->tv_sec = ns / 1000000000;
+	tv->tv_usec = (ns % 1000000000) / 1000;
+}
+
+void
+acct_torusage(const struct acct *ac, struct rusage *ru)
+{
+	bzero(ru, sizeof(*ru));
+	acct_totimeval(ac->ac_utime, &ru->ru_utime);
+	acct_totimeval(ac->ac_stime, &ru->ru_stime);
+	ru->ru_minflt = ac->ac_minflt;
+	ru->ru_majflt = ac->ac_majflt;
+	ru->ru_nvcsw = ac->ac_nvcsw;
+	ru->ru_nivcsw = ac->ac_nivcsw;
+}
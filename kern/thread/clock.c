@@ -34,13 +34,15 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <rcu.h>
+#include <timer.h>
+#include <prof.h>
 
 /*
  * Time handling.
  *
- * This is pretty primitive. A real kernel will typically have some
- * kind of support for scheduling callbacks to happen at specific
- * points in the future, usually with more resolution than one second.
+ * Callbacks at specific points in the future are handled by the
+ * timer wheels in timer.c, which hardclock drives.
  *
  * A real kernel also has to maintain the time of day; in OS/161 we
  * skimp on that because we have a known-good hardware clock.
@@ -54,11 +56,18 @@
 #define MIGRATE_HARDCLOCKS	16	/* Migrate every 16 hardclocks. */
 
 /*
- * Once a second, everything waiting on lbolt is awakened by CPU 0.
+ * Threads in clocksleep wait here, each on its own timer, so nothing
+ * ever does a wakeall on it.
  */
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * Count of hardclocks on CPU 0 since boot; a monotonic tick count for
+ * timeouts finer than a second. Only CPU 0 writes it.
+ */
+static volatile unsigned clock_ticks;
+
 /*
  * Setup.
  */
@@ -74,15 +83,11 @@ hardclock_bootstrap(void)
 
 /*
  * This is called once per second, on one processor, by the timer
- * code.
+ * code. Timed sleeps no longer depend on it; see timer.c.
  */
 void
 timerclock(void)
 {
-	/* Just broadcast on lbolt */
-	spinlock_acquire(&lbolt_lock);
-	wchan_wakeall(lbolt, &lbolt_lock);
-	spinlock_release(&lbolt_lock);
 }
 
 /*
@@ -97,6 +102,21 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	if (curcpu->c_number == 0) {
+		clock_ticks++;
+	}
+	prof_hardclock();
+	timer_hardclock();
+
+	/*
+	 * Don't preempt a thread in an RCU read-side section. If
+	 * we're not in one, this cpu is quiescent.
+	 */
+	if (curthread->t_rcudepth > 0) {
+		return;
+	}
+	rcu_quiescent();
+
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
@@ -107,15 +127,38 @@ hardclock(void)
 }
 
 /*
- * Suspend execution for n seconds.
+ * Return the number of hardclock ticks since boot. This wraps; compare
+ * tick values by subtraction.
+ */
+unsigned
+clock_getticks(void)
+{
+	return clock_ticks;
+}
+
+/*
+ * Suspend execution for TICKS hardclock ticks.
  */
 void
-clocksleep(int num_secs)
+clocksleep_ticks(unsigned ticks)
 {
+	unsigned deadline, now;
+
+	deadline = clock_getticks() + ticks;
 	spinlock_acquire(&lbolt_lock);
-	while (num_secs > 0) {
-		wchan_sleep(lbolt, &lbolt_lock);
-		num_secs--;
+	while ((int)(deadline - (now = clock_getticks())) > 0) {
+		wchan_sleep_timeout(lbolt, &lbolt_lock, deadline - now);
 	}
 	spinlock_release(&lbolt_lock);
 }
+
+/*
+ * Suspend execution for n seconds.
+ */
+void
+clocksleep(int num_secs)
+{
+	if (num_secs > 0) {
+		clocksleep_ticks((unsigned)num_secs * HZ);
+	}
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Per-cpu event counters. See counter.h.
+ */
+
+#define COUNTER_INLINE	/* empty */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <current.h>
+#include <counter.h>
+
+#define COUNTER_MAXCPUS		32
+
+/* Slot 0 means unregistered; slot 1 collects the overflow. */
+#define COUNTER_NOSLOT		0
+#define COUNTER_OVERFLOW	1
+
+static struct counter counter_overflow =
+	{ "(overflow)", COUNTER_OVERFLOW };
+
+/*
+ * The registry. Counters are only ever added, so a slot number, once
+ * handed out, stays good without locking.
+ */
+static struct spinlock counter_lock = SPINLOCK_INITIALIZER;
+static struct counter *counter_table[COUNTER_MAX] = {
+	[COUNTER_OVERFLOW] = &counter_overflow,
+};
+static unsigned counter_num = COUNTER_OVERFLOW + 1;
+
+/* Per-cpu slot arrays, indexed by cpu number, for reading. */
+static volatile spinlock_data_t *counter_percpu[COUNTER_MAXCPUS];
+
+/*
+ * Set up the slots for a new cpu. If we can't get memory, events on
+ * that cpu just aren't counted.
+ */
+void
+counter_cpuinit(struct cpu *c)
+{
+	volatile spinlock_data_t *slots;
+	unsigned i;
+
+	slots = kmalloc(COUNTER_MAX * sizeof(*slots));
+	if (slots != NULL) {
+		for (i=0; i<COUNTER_MAX; i++) {
+			spinlock_data_set(&slots[i], 0);
+		}
+	}
+	c->c_counters = slots;
+	if (c->c_number < COUNTER_MAXCPUS) {
+		counter_percpu[c->c_number] = slots;
+	}
+}
+
+unsigned
+counter_register(struct counter *cn)
+{
+	unsigned slot;
+
+	spinlock_acquire(&counter_lock);
+	slot = cn->cn_slot;
+	if (slot == COUNTER_NOSLOT) {
+		if (counter_num < COUNTER_MAX) {
+			slot = counter_num++;
+			counter_table[slot] = cn;
+		}
+		else {
+			slot = COUNTER_OVERFLOW;
+		}
+		cn->cn_slot = slot;
+	}
+	spinlock_release(&counter_lock);
+	return slot;
+}
+
+/*
+ * Sum slot SLOT over all cpus. Other cpus may be adding to it while
+ * we look, which is fine.
+ */
+static
+unsigned
+counter_sum(unsigned slot)
+{
+	unsigned i, total;
+
+	total = 0;
+	for (i=0; i<COUNTER_MAXCPUS; i++) {
+		if (counter_percpu[i] != NULL) {
+			total += spinlock_data_get(&counter_percpu[i][slot]);
+		}
+	}
+	return total;
+}
+
+unsigned
+counter_read(struct counter *cn)
+{
+	if (cn->cn_slot == COUNTER_NOSLOT) {
+		return 0;
+	}
+	return counter_sum(cn->cn_slot);
+}
+
+void
+counter_dump(void)
+{
+	unsigned num, slot, i, total;
+
+	num = counter_num;
+	kprintf("%-24s %10s   per cpu\n", "counter", "total");
+	for (slot = COUNTER_OVERFLOW; slot < num; slot++) {
+		total = counter_sum(slot);
+		if (total == 0) {
+			continue;
+		}
+		kprintf("%-24s %10u  ", counter_table[slot]->cn_name, total);
+		for (i=0; i<COUNTER_MAXCPUS; i++) {
+			if (counter_percpu[i] != NULL) {
+				kprintf(" %u", spinlock_data_get(
+					&counter_percpu[i][slot]));
+			}
+		}
+		kprintf("\n");
+	}
+	kprintf("%u of %u counters registered\n", num - COUNTER_OVERFLOW - 1,
+		COUNTER_MAX - COUNTER_OVERFLOW - 1);
+}
+
+/*
+ * Zero everything. Like counter_dump this races with other cpus, so
+ * a few concurrent events may survive.
+ */
+void
+counter_reset(void)
+{
+	unsigned i, slot;
+
+	for (i=0; i<COUNTER_MAXCPUS; i++) {
+		if (counter_percpu[i] == NULL) {
+			continue;
+		}
+		for (slot = 0; slot < COUNTER_MAX; slot++) {
+			spinlock_data_set(&counter_percpu[i][slot], 0);
+		}
+	}
+}
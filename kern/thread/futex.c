@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Futexes. See futex.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <futex.h>
+
+#define FUTEX_HASHSIZE 64
+
+/*
+ * One sleeping (or about to sleep) thread. These live on the
+ * sleeper's stack.
+ */
+struct futex_waiter {
+	paddr_t fw_key;			/* physical address of the word */
+	struct thread *fw_thread;	/* who's waiting */
+	bool fw_woken;			/* taken off the list by a wake */
+	struct futex_waiter *fw_next;	/* next in bucket, oldest first */
+};
+
+/*
+ * A hash bucket. fb_lock protects the list, and is the lock the
+ * sleepers in the bucket sleep with on fb_wchan. futex_wake picks
+ * out the sleepers it wants, so words that share a bucket don't wake
+ * each other's sleepers.
+ */
+struct futex_bucket {
+	struct spinlock fb_lock;
+	struct wchan *fb_wchan;
+	struct futex_waiter *fb_waiters;
+};
+
+static struct futex_bucket futex_table[FUTEX_HASHSIZE];
+
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_HASHSIZE; i++) {
+		spinlock_init(&futex_table[i].fb_lock);
+		futex_table[i].fb_wchan = wchan_create("futex");
+		if (futex_table[i].fb_wchan == NULL) {
+			panic("futex_bootstrap: Out of memory\n");
+		}
+		futex_table[i].fb_waiters = NULL;
+	}
+}
+
+/*
+ * Find the key and the bucket for the word at UADDR. This may sleep
+ * faulting the page in.
+ */
+static
+int
+futex_lookup(userptr_t uaddr, paddr_t *key, struct futex_bucket **fb)
+{
+	struct addrspace *as;
+	int result;
+
+	if ((vaddr_t)uaddr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+	if ((vaddr_t)uaddr >= USERSPACETOP) {
+		return EFAULT;
+	}
+	as = proc_getas();
+	if (as == NULL) {
+		return EFAULT;
+	}
+	result = as_translate(as, (vaddr_t)uaddr, key);
+	if (result) {
+		return result;
+	}
+	*fb = &futex_table[(*key / sizeof(int)) % FUTEX_HASHSIZE];
+	return 0;
+}
+
+/* Call with the bucket locked. */
+static
+void
+futex_unlink(struct futex_bucket *fb, struct futex_waiter *fw)
+{
+	struct futex_waiter **pp;
+
+	for (pp = &fb->fb_waiters; *pp != fw; pp = &(*pp)->fw_next) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = fw->fw_next;
+}
+
+int
+futex_wait(userptr_t uaddr, int val, unsigned ticks)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter fw, **pp;
+	int cur, result;
+
+	result = futex_lookup(uaddr, &fw.fw_key, &fb);
+	if (result) {
+		return result;
+	}
+	fw.fw_thread = curthread;
+	fw.fw_woken = false;
+	fw.fw_next = NULL;
+
+	spinlock_acquire(&fb->fb_lock);
+	for (pp = &fb->fb_waiters; *pp != NULL; pp = &(*pp)->fw_next) {
+		/* nothing */
+	}
+	*pp = &fw;
+	spinlock_release(&fb->fb_lock);
+
+	/*
+	 * We're on the list now, so anyone who changes the word and
+	 * then calls futex_wake will find us. That means we can look
+	 * at the word without holding the bucket lock, which we
+	 * couldn't do anyway because copyin might fault.
+	 */
+	result = copyin((const_userptr_t)uaddr, &cur, sizeof(cur));
+	if (result == 0 && cur != val) {
+		result = EAGAIN;
+	}
+
+	spinlock_acquire(&fb->fb_lock);
+	if (result == 0 && !fw.fw_woken) {
+		if (ticks > 0) {
+			result = wchan_sleep_timeout(fb->fb_wchan,
+						     &fb->fb_lock, ticks);
+		}
+		else {
+			wchan_sleep(fb->fb_wchan, &fb->fb_lock);
+		}
+	}
+	if (fw.fw_woken) {
+		/*
+		 * A wake that finds us counts, even if the word had
+		 * already changed or the time was running out; the
+		 * waker has told its caller it woke someone.
+		 */
+		if (result == EAGAIN || result == ETIMEDOUT) {
+			result = 0;
+		}
+	}
+	else {
+		futex_unlink(fb, &fw);
+	}
+	spinlock_release(&fb->fb_lock);
+	return result;
+}
+
+int
+futex_wake(userptr_t uaddr, unsigned max, unsigned *ret)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter *fw, **pp;
+	paddr_t key;
+	unsigned count;
+	int result;
+
+	result = futex_lookup(uaddr, &key, &fb);
+	if (result) {
+		return result;
+	}
+
+	count = 0;
+	spinlock_acquire(&fb->fb_lock);
+	pp = &fb->fb_waiters;
+	while (count < max && *pp != NULL) {
+		fw = *pp;
+		if (fw->fw_key != key) {
+			pp = &fw->fw_next;
+			continue;
+		}
+		*pp = fw->fw_next;
+		fw->fw_woken = true;
+		/* It might not have gone to sleep yet, or timed out. */
+		if (fw->fw_thread->t_wchan == fb->fb_wchan) {
+			wchan_wakethread(fb->fb_wchan, &fb->fb_lock,
+					 fw->fw_thread);
+		}
+		count++;
+	}
+	spinlock_release(&fb->fb_lock);
+
+	*ret = count;
+	return 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Lock contention statistics. See lockstat.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <current.h>
+#include <lockstat.h>
+
+#define LOCKSTAT_NAMELEN	24
+#define LOCKSTAT_MAXCPUS	32
+#define LOCKSTAT_DEFAULTTOP	10
+
+struct lockstat_class {
+	unsigned lc_kind;		/* LOCKSTAT_SPINLOCK etc. */
+	const void *lc_addr;		/* Address key, or NULL if named */
+	char lc_name[LOCKSTAT_NAMELEN];	/* Name (possibly truncated) */
+};
+
+static const char *const lockstat_kindnames[] = {
+	"spinlock",
+	"lock",
+	"cv",
+	"rwlock",
+};
+
+/*
+ * The class table. Classes are only ever added, so once a lock has
+ * a class number it stays valid and can be used without locking.
+ *
+ * Registering a class happens inside spinlock_init and
+ * spinlock_acquire, so the table can't be protected with a struct
+ * spinlock without recursing; use a bare test-and-set word instead.
+ */
+static struct lockstat_class lockstat_classes[LOCKSTAT_MAXCLASSES] = {
+	[LOCKSTAT_NOCLASS] = { LOCKSTAT_SPINLOCK, NULL, "(unclassified)" },
+	[LOCKSTAT_OVERFLOW] = { LOCKSTAT_SPINLOCK, NULL, "(overflow)" },
+};
+static unsigned lockstat_numclasses = LOCKSTAT_OVERFLOW + 1;
+static volatile spinlock_data_t lockstat_classlock;
+
+/* Per-cpu counter arrays, indexed by cpu number, for dumping. */
+static struct lockstat_counters *lockstat_percpu[LOCKSTAT_MAXCPUS];
+
+/*
+ * Lock and unlock the class table.
+ */
+static
+int
+lockstat_lock(void)
+{
+	int spl;
+
+	spl = splhigh();
+	while (spinlock_data_get(&lockstat_classlock) != 0 ||
+	       spinlock_data_testandset(&lockstat_classlock) != 0) {
+		/* spin */
+	}
+	membar_store_any();
+	return spl;
+}
+
+static
+void
+lockstat_unlock(int spl)
+{
+	membar_any_store();
+	spinlock_data_set(&lockstat_classlock, 0);
+	splx(spl);
+}
+
+/*
+ * Find or add a class. NAME is ignored if ADDR is not NULL.
+ */
+static
+unsigned
+lockstat_class(unsigned kind, const void *addr, const char *name)
+{
+	char buf[LOCKSTAT_NAMELEN];
+	struct lockstat_class *lc;
+	unsigned i, ret;
+	int spl;
+
+	if (addr != NULL) {
+		snprintf(buf, sizeof(buf), "%p", addr);
+	}
+	else {
+		snprintf(buf, sizeof(buf), "%s", name);
+	}
+
+	spl = lockstat_lock();
+	ret = LOCKSTAT_OVERFLOW;
+	for (i = LOCKSTAT_OVERFLOW + 1; i < lockstat_numclasses; i++) {
+		lc = &lockstat_classes[i];
+		if (lc->lc_kind == kind && lc->lc_addr == addr &&
+		    !strcmp(lc->lc_name, buf)) {
+			ret = i;
+			break;
+		}
+	}
+	if (i == lockstat_numclasses &&
+	    lockstat_numclasses < LOCKSTAT_MAXCLASSES) {
+		lc = &lockstat_classes[lockstat_numclasses];
+		lc->lc_kind = kind;
+		lc->lc_addr = addr;
+		strcpy(lc->lc_name, buf);
+		ret = lockstat_numclasses++;
+	}
+	lockstat_unlock(spl);
+
+	return ret;
+}
+
+unsigned
+lockstat_class_named(unsigned kind, const char *name)
+{
+	return lockstat_class(kind, NULL, name);
+}
+
+unsigned
+lockstat_class_addr(unsigned kind, const void *addr)
+{
+	KASSERT(addr != NULL);
+	return lockstat_class(kind, addr, NULL);
+}
+
+/*
+ * Set up the counters for a new cpu. If we can't get memory, stats
+ * are just not collected on that cpu.
+ */
+void
+lockstat_cpuinit(struct cpu *c)
+{
+	struct lockstat_counters *lsc;
+	size_t size;
+
+	size = LOCKSTAT_MAXCLASSES * sizeof(*lsc);
+	lsc = kmalloc(size);
+	if (lsc != NULL) {
+		bzero(lsc, size);
+	}
+	c->c_lockstat = lsc;
+	if (c->c_number < LOCKSTAT_MAXCPUS) {
+		lockstat_percpu[c->c_number] = lsc;
+	}
+}
+
+/*
+ * Time how long an acquire spends asleep.
+ */
+static
+uint64_t
+lockstat_nowns(void)
+{
+	struct timespec ts;
+
+	gettime(&ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+lockstat_sleepstart(struct lockstat_sample *s)
+{
+	s->lss_sleepstart = lockstat_nowns();
+}
+
+void
+lockstat_sleepend(struct lockstat_sample *s)
+{
+	s->lss_sleepus += (lockstat_nowns() - s->lss_sleepstart) / 1000;
+}
+
+/*
+ * Charge an acquire to class CLS on the current cpu. Interrupts go
+ * off so we can't be preempted or migrated halfway through.
+ */
+void
+lockstat_record(unsigned cls, const struct lockstat_sample *s)
+{
+	struct lockstat_counters *lsc;
+	int spl;
+
+	if (!CURCPU_EXISTS() || cls >= LOCKSTAT_MAXCLASSES) {
+		return;
+	}
+
+	spl = splhigh();
+	lsc = curcpu->c_lockstat;
+	if (lsc != NULL) {
+		lsc += cls;
+		lsc->lsc_acquires++;
+		if (s->lss_contended) {
+			lsc->lsc_contended++;
+		}
+		lsc->lsc_spins += s->lss_spins;
+		lsc->lsc_sleepus += s->lss_sleepus;
+	}
+	splx(spl);
+}
+
+/*
+ * Print the TOPN classes with the most contended acquires, summed
+ * over all cpus. Other cpus may be updating their counters while we
+ * read them, so the numbers are approximate.
+ */
+void
+lockstat_dump(unsigned topn)
+{
+	struct lockstat_counters *totals, *t;
+	const struct lockstat_counters *lsc;
+	struct lockstat_class *lc;
+	unsigned numclasses, i, j, best, shown;
+	bool *done;
+
+	if (topn == 0) {
+		topn = LOCKSTAT_DEFAULTTOP;
+	}
+
+	numclasses = lockstat_numclasses;
+	totals = kmalloc(numclasses * sizeof(*totals));
+	done = kmalloc(numclasses * sizeof(*done));
+	if (totals == NULL || done == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		kfree(totals);
+		kfree(done);
+		return;
+	}
+	bzero(totals, numclasses * sizeof(*totals));
+
+	for (i=0; i<LOCKSTAT_MAXCPUS; i++) {
+		if (lockstat_percpu[i] == NULL) {
+			continue;
+		}
+		for (j=0; j<numclasses; j++) {
+			lsc = &lockstat_percpu[i][j];
+			t = &totals[j];
+			t->lsc_acquires += lsc->lsc_acquires;
+			t->lsc_contended += lsc->lsc_contended;
+			t->lsc_spins += lsc->lsc_spins;
+			t->lsc_sleepus += lsc->lsc_sleepus;
+		}
+	}
+	for (j=0; j<numclasses; j++) {
+		done[j] = totals[j].lsc_acquires == 0;
+	}
+
+	kprintf("%-24s %-8s %10s %10s %10s %10s\n", "class", "kind",
+		"acquires", "contended", "spins", "sleep(us)");
+	for (shown = 0; shown < topn; shown++) {
+		best = numclasses;
+		for (j=0; j<numclasses; j++) {
+			if (done[j]) {
+				continue;
+			}
+			if (best == numclasses ||
+			    totals[j].lsc_contended >
+			    totals[best].lsc_contended ||
+			    (totals[j].lsc_contended ==
+			     totals[best].lsc_contended &&
+			     totals[j].lsc_acquires >
+			     totals[best].lsc_acquires)) {
+				best = j;
+			}
+		}
+		if (best == numclasses) {
+			break;
+		}
+		done[best] = true;
+
+		lc = &lockstat_classes[best];
+		t = &totals[best];
+		kprintf("%-24s %-8s %10u %10u %10u %10u\n", lc->lc_name,
+			lockstat_kindnames[lc->lc_kind], t->lsc_acquires,
+			t->lsc_contended, t->lsc_spins, t->lsc_sleepus);
+	}
+	kprintf("%u of %u classes in use\n", numclasses,
+		LOCKSTAT_MAXCLASSES);
+
+	kfree(totals);
+	kfree(done);
+}
+
+/*
+ * Zero all the counters. Like lockstat_dump this races with other
+ * cpus, so a few concurrent updates may survive.
+ */
+void
+lockstat_reset(void)
+{
+	unsigned i;
+
+	for (i=0; i<LOCKSTAT_MAXCPUS; i++) {
+		if (lockstat_percpu[i] != NULL) {
+			bzero(lockstat_percpu[i],
+			      LOCKSTAT_MAXCLASSES *
+			      sizeof(struct lockstat_counters));
+		}
+	}
+}
@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Kernel sampling profiler. See prof.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <cpu.h>
+#include <current.h>
+#include <membar.h>
+#include <uio.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <elf.h>
+#include <vm.h>
+#include <prof.h>
+#include <lamebus/ltrace.h>
+
+#define PROF_MAXCPUS	32
+
+/* Each histogram bucket covers 2^PROF_SHIFT bytes (8 instructions). */
+#define PROF_SHIFT	5
+
+/* Symbols read from the kernel image at a time. */
+#define PROF_SYMCHUNK	64
+
+/* Longest function name printed. */
+#define PROF_NAMELEN	48
+
+/* Kernel text bounds, from the linker script. */
+extern char _stext[], _etext[];
+
+#define PROF_TEXTSTART	((vaddr_t)_stext)
+#define PROF_TEXTEND	((vaddr_t)_etext)
+
+/*
+ * Per-cpu sample counts. Only the owning cpu writes them (from
+ * hardclock, with interrupts off), so they need no locking; readers
+ * may see a sample or two go by while adding up.
+ */
+struct prof_cpu {
+	unsigned *pc_hist;	/* kernel samples per text bucket */
+	unsigned pc_user;	/* samples taken in user mode */
+	unsigned pc_other;	/* kernel samples outside the text */
+};
+
+static struct prof_cpu prof_cpus[PROF_MAXCPUS];
+static unsigned prof_nbuckets;
+static volatile bool prof_running;
+
+/*
+ * A function from the kernel symbol table, and the samples that
+ * landed in it.
+ */
+struct prof_func {
+	vaddr_t pf_addr;
+	uint32_t pf_name;	/* offset in the string table */
+	unsigned pf_samples;
+};
+
+////////////////////////////////////////////////////////////
+// sampling
+
+void
+prof_hardclock(void)
+{
+	struct prof_cpu *pc;
+	vaddr_t addr;
+
+	if (!prof_running || curcpu->c_number >= PROF_MAXCPUS) {
+		return;
+	}
+	pc = &prof_cpus[curcpu->c_number];
+	if (pc->pc_hist == NULL) {
+		/* This cpu came up after prof_start. */
+		return;
+	}
+
+	addr = curcpu->c_intrpc;
+	if (addr < USERSPACETOP) {
+		pc->pc_user++;
+	}
+	else if (addr >= PROF_TEXTSTART && addr < PROF_TEXTEND) {
+		pc->pc_hist[(addr - PROF_TEXTSTART) >> PROF_SHIFT]++;
+	}
+	else {
+		pc->pc_other++;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// control
+
+int
+prof_start(void)
+{
+	unsigned *hist;
+	unsigned i, j;
+
+	prof_nbuckets = ((PROF_TEXTEND - PROF_TEXTSTART) >> PROF_SHIFT) + 1;
+
+	for (i=0; i<num_cpus && i<PROF_MAXCPUS; i++) {
+		if (prof_cpus[i].pc_hist != NULL) {
+			continue;
+		}
+		hist = kmalloc(prof_nbuckets * sizeof(hist[0]));
+		if (hist == NULL) {
+			return ENOMEM;
+		}
+		for (j=0; j<prof_nbuckets; j++) {
+			hist[j] = 0;
+		}
+		prof_cpus[i].pc_hist = hist;
+	}
+
+	/* Make sure the histograms are there before anyone samples. */
+	membar_store_store();
+	prof_running = true;
+	ltrace_setprof(1);
+	return 0;
+}
+
+void
+prof_stop(void)
+{
+	prof_running = false;
+	ltrace_setprof(0);
+}
+
+void
+prof_reset(void)
+{
+	struct prof_cpu *pc;
+	unsigned i, j;
+
+	for (i=0; i<PROF_MAXCPUS; i++) {
+		pc = &prof_cpus[i];
+		if (pc->pc_hist == NULL) {
+			continue;
+		}
+		for (j=0; j<prof_nbuckets; j++) {
+			pc->pc_hist[j] = 0;
+		}
+		pc->pc_user = 0;
+		pc->pc_other = 0;
+	}
+	ltrace_eraseprof();
+}
+
+/*
+ * Samples in bucket B, over all cpus.
+ */
+static
+unsigned
+prof_bucket(unsigned b)
+{
+	unsigned i, total;
+
+	total = 0;
+	for (i=0; i<PROF_MAXCPUS; i++) {
+		if (prof_cpus[i].pc_hist != NULL) {
+			total += prof_cpus[i].pc_hist[b];
+		}
+	}
+	return total;
+}
+
+unsigned
+prof_count(vaddr_t start, vaddr_t end)
+{
+	unsigned b, total;
+	vaddr_t addr;
+
+	total = 0;
+	for (b=0; b<prof_nbuckets; b++) {
+		addr = PROF_TEXTSTART + (b << PROF_SHIFT);
+		if (addr >= start && addr < end) {
+			total += prof_bucket(b);
+		}
+	}
+	return total;
+}
+
+////////////////////////////////////////////////////////////
+// symbols
+
+/*
+ * Read exactly LEN bytes at offset OFF of V.
+ */
+static
+int
+prof_read(struct vnode *v, off_t off, void *buf, size_t len)
+{
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, buf, len, off, UIO_READ);
+	result = VOP_READ(v, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid != 0) {
+		return ENOEXEC;
+	}
+	return 0;
+}
+
+/*
+ * Read the name at offset NAME in the string table at STROFF into
+ * BUF. Names that run past the end of the file or BUF get cut off.
+ */
+static
+void
+prof_readname(struct vnode *v, off_t stroff, uint32_t name,
+	      char *buf, size_t len)
+{
+	struct iovec iov;
+	struct uio ku;
+
+	uio_kinit(&iov, &ku, buf, len - 1, stroff + name, UIO_READ);
+	if (VOP_READ(v, &ku)) {
+		strcpy(buf, "???");
+		return;
+	}
+	buf[len - 1 - ku.uio_resid] = 0;
+}
+
+/*
+ * Sort functions by address. Shellsort: there are a few thousand and
+ * this runs once per report.
+ */
+static
+void
+prof_sortfuncs(struct prof_func *funcs, unsigned num)
+{
+	struct prof_func tmp;
+	unsigned gap, i, j;
+
+	for (gap = num/2; gap > 0; gap /= 2) {
+		for (i=gap; i<num; i++) {
+			tmp = funcs[i];
+			for (j=i; j>=gap && funcs[j-gap].pf_addr > tmp.pf_addr;
+			     j-=gap) {
+				funcs[j] = funcs[j-gap];
+			}
+			funcs[j] = tmp;
+		}
+	}
+}
+
+/*
+ * Load the functions in the kernel text from the symbol table of the
+ * ELF image V. Returns the functions sorted by address, and the file
+ * offset of the string table their names are in.
+ */
+static
+int
+prof_loadsyms(struct vnode *v, struct prof_func **funcs_ret,
+	      unsigned *num_ret, off_t *stroff_ret)
+{
+	Elf_Ehdr eh;
+	Elf_Shdr sh, strsh;
+	Elf_Sym *syms;
+	struct prof_func *funcs;
+	unsigned i, j, n, nsyms, num;
+	off_t off;
+	int result;
+
+	result = prof_read(v, 0, &eh, sizeof(eh));
+	if (result) {
+		return result;
+	}
+	if (eh.e_ident[EI_MAG0] != ELFMAG0 ||
+	    eh.e_ident[EI_MAG1] != ELFMAG1 ||
+	    eh.e_ident[EI_MAG2] != ELFMAG2 ||
+	    eh.e_ident[EI_MAG3] != ELFMAG3 ||
+	    eh.e_ident[EI_CLASS] != ELFCLASS32 ||
+	    eh.e_shentsize != sizeof(Elf_Shdr)) {
+		return ENOEXEC;
+	}
+
+	/* Find the symbol table, and the string table that goes with it. */
+	for (i=0; i<eh.e_shnum; i++) {
+		off = eh.e_shoff + i * sizeof(Elf_Shdr);
+		result = prof_read(v, off, &sh, sizeof(sh));
+		if (result) {
+			return result;
+		}
+		if (sh.sh_type == SHT_SYMTAB) {
+			break;
+		}
+	}
+	if (i == eh.e_shnum || sh.sh_link >= eh.e_shnum) {
+		/* stripped */
+		return ENOENT;
+	}
+	off = eh.e_shoff + sh.sh_link * sizeof(Elf_Shdr);
+	result = prof_read(v, off, &strsh, sizeof(strsh));
+	if (result) {
+		return result;
+	}
+
+	nsyms = sh.sh_size / sizeof(Elf_Sym);
+	funcs = kmalloc(nsyms * sizeof(*funcs));
+	syms = kmalloc(PROF_SYMCHUNK * sizeof(*syms));
+	if (funcs == NULL || syms == NULL) {
+		kfree(funcs);
+		kfree(syms);
+		return ENOMEM;
+	}
+
+	num = 0;
+	for (i=0; i<nsyms; i+=n) {
+		n = nsyms - i;
+		if (n > PROF_SYMCHUNK) {
+			n = PROF_SYMCHUNK;
+		}
+		result = prof_read(v, sh.sh_offset + i * sizeof(Elf_Sym),
+				   syms, n * sizeof(Elf_Sym));
+		if (result) {
+			kfree(funcs);
+			kfree(syms);
+			return result;
+		}
+		for (j=0; j<n; j++) {
+			if (ELF32_ST_TYPE(syms[j].st_info) != STT_FUNC ||
+			    syms[j].st_value < PROF_TEXTSTART ||
+			    syms[j].st_value >= PROF_TEXTEND) {
+				continue;
+			}
+			funcs[num].pf_addr = syms[j].st_value;
+			funcs[num].pf_name = syms[j].st_name;
+			funcs[num].pf_samples = 0;
+			num++;
+		}
+	}
+	kfree(syms);
+
+	prof_sortfuncs(funcs, num);
+
+	*funcs_ret = funcs;
+	*num_ret = num;
+	*stroff_ret = strsh.sh_offset;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// report
+
+/*
+ * Print a line of the report: COUNT out of TOTAL samples.
+ */
+static
+void
+prof_printline(unsigned count, unsigned total, const char *what)
+{
+	unsigned permille;
+
+	permille = total > 0 ? (unsigned)((uint64_t)count * 1000 / total) : 0;
+	kprintf("%9u %3u.%u%%  %s\n", count, permille / 10, permille % 10,
+		what);
+}
+
+/*
+ * Report by function. Each bucket goes to the function its first
+ * byte is in; a bucket that straddles the end of a function is
+ * counted entirely against it, which is close enough at this grain.
+ */
+static
+int
+prof_dumpfuncs(struct vnode *v, const unsigned *totals, unsigned total,
+	       unsigned topn)
+{
+	struct prof_func *funcs;
+	unsigned num, b, f, best, i;
+	vaddr_t addr;
+	off_t stroff;
+	char name[PROF_NAMELEN];
+	int result;
+
+	result = prof_loadsyms(v, &funcs, &num, &stroff);
+	if (result) {
+		return result;
+	}
+
+	/* Both are in address order; walk them together. */
+	f = 0;
+	for (b=0; b<prof_nbuckets && num > 0; b++) {
+		addr = PROF_TEXTSTART + (b << PROF_SHIFT);
+		while (f+1 < num && funcs[f+1].pf_addr <= addr) {
+			f++;
+		}
+		if (funcs[f].pf_addr <= addr) {
+			funcs[f].pf_samples += totals[b];
+		}
+	}
+
+	for (i=0; i<topn; i++) {
+		best = 0;
+		for (f=1; f<num; f++) {
+			if (funcs[f].pf_samples > funcs[best].pf_samples) {
+				best = f;
+			}
+		}
+		if (num == 0 || funcs[best].pf_samples == 0) {
+			break;
+		}
+		prof_readname(v, stroff, funcs[best].pf_name,
+			      name, sizeof(name));
+		prof_printline(funcs[best].pf_samples, total, name);
+		funcs[best].pf_samples = 0;
+	}
+
+	kfree(funcs);
+	return 0;
+}
+
+/*
+ * Report by raw address, for when there are no symbols.
+ */
+static
+void
+prof_dumpbuckets(unsigned *totals, unsigned total, unsigned topn)
+{
+	unsigned b, best, i;
+	char name[PROF_NAMELEN];
+
+	for (i=0; i<topn; i++) {
+		best = 0;
+		for (b=1; b<prof_nbuckets; b++) {
+			if (totals[b] > totals[best]) {
+				best = b;
+			}
+		}
+		if (totals[best] == 0) {
+			break;
+		}
+		snprintf(name, sizeof(name), "0x%08lx",
+			 (unsigned long)(PROF_TEXTSTART + (best << PROF_SHIFT)));
+		prof_printline(totals[best], total, name);
+		totals[best] = 0;
+	}
+}
+
+void
+prof_dump(unsigned topn, const char *kernelpath)
+{
+	struct prof_cpu *pc;
+	struct vnode *v;
+	unsigned *totals;
+	unsigned i, b, user, other, kern, cpukern, total;
+	char *path;
+	int result;
+
+	if (prof_nbuckets == 0) {
+		kprintf("prof: no profile; use prof start\n");
+		return;
+	}
+
+	totals = kmalloc(prof_nbuckets * sizeof(totals[0]));
+	if (totals == NULL) {
+		kprintf("prof: out of memory\n");
+		return;
+	}
+	for (b=0; b<prof_nbuckets; b++) {
+		totals[b] = 0;
+	}
+
+	user = other = kern = 0;
+	for (i=0; i<PROF_MAXCPUS; i++) {
+		pc = &prof_cpus[i];
+		if (pc->pc_hist == NULL) {
+			continue;
+		}
+		cpukern = 0;
+		for (b=0; b<prof_nbuckets; b++) {
+			totals[b] += pc->pc_hist[b];
+			cpukern += pc->pc_hist[b];
+		}
+		kprintf("prof: cpu%u: %u kernel, %u user, %u other\n",
+			i, cpukern, pc->pc_user, pc->pc_other);
+		kern += cpukern;
+		user += pc->pc_user;
+		other += pc->pc_other;
+	}
+	total = kern + user + other;
+	kprintf("prof: %u samples%s\n", total,
+		prof_running ? " (still running)" : "");
+	if (total == 0) {
+		kfree(totals);
+		return;
+	}
+	prof_printline(user, total, "(user)");
+	prof_printline(other, total, "(other)");
+
+	if (kernelpath == NULL) {
+		kernelpath = PROF_KERNEL;
+	}
+	path = kstrdup(kernelpath);
+	if (path == NULL) {
+		result = ENOMEM;
+	}
+	else {
+		/* vfs_open destroys the string it's passed. */
+		result = vfs_open(path, O_RDONLY, 0, &v);
+		kfree(path);
+	}
+	if (!result) {
+		result = prof_dumpfuncs(v, totals, total, topn);
+		vfs_close(v);
+	}
+	if (result) {
+		kprintf("prof: no symbols from %s: %s\n", kernelpath,
+			strerror(result));
+		prof_dumpbuckets(totals, total, topn);
+	}
+
+	kfree(totals);
+}
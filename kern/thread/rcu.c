@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Read-copy-update. See rcu.h.
+ *
+ * Grace periods are numbered. rcu_gen is the most recently started
+ * one and rcu_completed the most recently finished one; they are
+ * equal when no grace period is in progress. Starting one sets
+ * rcu_pending to the number of cpus, and each cpu counts it down the
+ * first time it passes through a quiescent state with c_rcu_gen
+ * behind rcu_gen. The cpu that brings it to zero completes the grace
+ * period and wakes up everyone waiting for it.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <rcu.h>
+
+/* Compare grace period numbers, which may wrap. */
+#define GEN_BEFORE(a, b)	((int)((a) - (b)) < 0)
+
+static struct spinlock rcu_lock = SPINLOCK_INITIALIZER;
+static struct wchan *rcu_wchan;
+static volatile unsigned rcu_gen;
+static volatile unsigned rcu_completed;
+static unsigned rcu_pending;
+
+/* Callbacks waiting to be run, and the thread that runs them. */
+static struct spinlock rcu_cblock = SPINLOCK_INITIALIZER;
+static struct wchan *rcu_cbwchan;
+static struct rcu_head *rcu_cbhead;
+static struct rcu_head **rcu_cbtail = &rcu_cbhead;
+
+/*
+ * Record that the current cpu has been through a quiescent state.
+ * Call with rcu_lock held.
+ */
+static
+void
+rcu_report(void)
+{
+	KASSERT(spinlock_do_i_hold(&rcu_lock));
+
+	if (curcpu->c_rcu_gen == rcu_gen) {
+		return;
+	}
+	curcpu->c_rcu_gen = rcu_gen;
+	KASSERT(rcu_pending > 0);
+	rcu_pending--;
+	if (rcu_pending == 0) {
+		rcu_completed = rcu_gen;
+		wchan_wakeall(rcu_wchan, &rcu_lock);
+	}
+}
+
+/*
+ * Called from thread_switch and hardclock, with interrupts off,
+ * whenever no read-side section can be running on this cpu.
+ */
+void
+rcu_quiescent(void)
+{
+	/* Quick check without the lock: nothing for us to report. */
+	if (curcpu->c_rcu_gen == rcu_gen) {
+		return;
+	}
+	/* rcu_synchronize sleeps holding rcu_lock. */
+	if (spinlock_do_i_hold(&rcu_lock)) {
+		return;
+	}
+
+	spinlock_acquire(&rcu_lock);
+	rcu_report();
+	spinlock_release(&rcu_lock);
+}
+
+void
+rcu_read_lock(void)
+{
+	curthread->t_rcudepth++;
+}
+
+void
+rcu_read_unlock(void)
+{
+	KASSERT(curthread->t_rcudepth > 0);
+	curthread->t_rcudepth--;
+}
+
+/*
+ * Wait until every read-side section that might have started before
+ * we were called has finished. A grace period already in progress
+ * may have started before our caller unpublished anything, so we
+ * wait for the next one to start and finish.
+ */
+void
+rcu_synchronize(void)
+{
+	unsigned target;
+
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(curthread->t_rcudepth == 0);
+
+	spinlock_acquire(&rcu_lock);
+	target = rcu_gen + 1;
+	while (GEN_BEFORE(rcu_completed, target)) {
+		if (rcu_completed == rcu_gen) {
+			rcu_gen++;
+			rcu_pending = num_cpus > 0 ? num_cpus : 1;
+		}
+		/* We aren't in a read-side section, so neither is our cpu. */
+		rcu_report();
+		if (!GEN_BEFORE(rcu_completed, target)) {
+			break;
+		}
+		wchan_sleep(rcu_wchan, &rcu_lock);
+	}
+	spinlock_release(&rcu_lock);
+}
+
+/*
+ * Queue HEAD to have FUNC called on it after a grace period.
+ */
+void
+rcu_call(struct rcu_head *head, void (*func)(struct rcu_head *))
+{
+	head->rh_next = NULL;
+	head->rh_func = func;
+
+	spinlock_acquire(&rcu_cblock);
+	*rcu_cbtail = head;
+	rcu_cbtail = &head->rh_next;
+	wchan_wakeone(rcu_cbwchan, &rcu_cblock);
+	spinlock_release(&rcu_cblock);
+}
+
+/*
+ * The rcu thread: take everything queued so far, wait out one grace
+ * period for the whole batch, then run the callbacks.
+ */
+static
+void
+rcu_thread(void *junk1, unsigned long junk2)
+{
+	struct rcu_head *batch, *next;
+
+	(void)junk1;
+	(void)junk2;
+
+	while (1) {
+		spinlock_acquire(&rcu_cblock);
+		while (rcu_cbhead == NULL) {
+			wchan_sleep(rcu_cbwchan, &rcu_cblock);
+		}
+		batch = rcu_cbhead;
+		rcu_cbhead = NULL;
+		rcu_cbtail = &rcu_cbhead;
+		spinlock_release(&rcu_cblock);
+
+		rcu_synchronize();
+
+		while (batch != NULL) {
+			next = batch->rh_next;
+			batch->rh_func(batch);
+			batch = next;
+		}
+	}
+}
+
+/*
+ * Set up a new cpu. It has no readers yet, so it starts out caught
+ * up with whatever grace period is current.
+ */
+void
+rcu_cpuinit(struct cpu *c)
+{
+	c->c_rcu_gen = rcu_gen;
+}
+
+void
+rcu_bootstrap(void)
+{
+	int result;
+
+	rcu_wchan = wchan_create("rcu");
+	rcu_cbwchan = wchan_create("rcucb");
+	if (rcu_wchan == NULL || rcu_cbwchan == NULL) {
+		panic("rcu_bootstrap: Out of memory\n");
+	}
+
+	result = thread_fork("rcu", NULL, rcu_thread, NULL, 0);
+	if (result) {
+		panic("rcu_bootstrap: thread_fork: %s\n", strerror(result));
+	}
+}
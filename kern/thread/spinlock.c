@@ -50,8 +50,11 @@
 void
 spinlock_init(struct spinlock *splk)
 {
-	spinlock_data_set(&splk->splk_lock, 0);
+	spinlock_data_set(&splk->splk_next, 0);
+	spinlock_data_set(&splk->splk_owner, 0);
 	splk->splk_holder = NULL;
+	LOCKSTAT_SETCLASS_ADDR(splk->splk_lsclass, LOCKSTAT_SPINLOCK,
+			       __builtin_return_address(0));
 	HANGMAN_LOCKABLEINIT(&splk->splk_hangman, "spinlock");
 }
 
@@ -62,7 +65,8 @@ void
 spinlock_cleanup(struct spinlock *splk)
 {
 	KASSERT(splk->splk_holder == NULL);
-	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+	KASSERT(spinlock_data_get(&splk->splk_next) ==
+		spinlock_data_get(&splk->splk_owner));
 }
 
 /*
@@ -70,12 +74,14 @@ spinlock_cleanup(struct spinlock *splk)
  *
  * First disable interrupts (otherwise, if we get a timer interrupt we
  * might come back to this lock and deadlock), then use a machine-level
- * atomic operation to wait for the lock to be free.
+ * atomic operation to take a ticket and wait for it to be served.
  */
 void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t ticket;
+	LOCKSTAT_SAMPLE(sample);
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -93,24 +99,18 @@ spinlock_acquire(struct spinlock *splk)
 		mycpu = NULL;
 	}
 
-	while (1) {
-		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
-		 */
-		if (spinlock_data_get(&splk->splk_lock) != 0) {
-			continue;
-		}
-		if (spinlock_data_testandset(&splk->splk_lock) != 0) {
-			continue;
-		}
-		break;
+	/*
+	 * Fetch-and-add is a machine-level atomic operation that
+	 * returns the old value; that is our ticket. Then we only
+	 * have to read splk_owner until the holder ahead of us
+	 * advances it to our number.
+	 */
+	ticket = spinlock_data_fetchadd(&splk->splk_next, 1);
+	if (spinlock_data_get(&splk->splk_owner) != ticket) {
+		LOCKSTAT_CONTENDED(sample);
+	}
+	while (spinlock_data_get(&splk->splk_owner) != ticket) {
+		LOCKSTAT_SPINS(sample, 1);
 	}
 
 	membar_store_any();
@@ -118,6 +118,14 @@ spinlock_acquire(struct spinlock *splk)
 
 	if (CURCPU_EXISTS()) {
 		HANGMAN_ACQUIRE(&curcpu->c_hangman, &splk->splk_hangman);
+#if OPT_LOCKSTAT
+		if (splk->splk_lsclass == LOCKSTAT_NOCLASS) {
+			/* Statically initialized; class it by address. */
+			splk->splk_lsclass =
+				lockstat_class_addr(LOCKSTAT_SPINLOCK, splk);
+		}
+#endif
+		LOCKSTAT_RECORD(splk->splk_lsclass, sample);
 	}
 }
 
@@ -137,7 +145,9 @@ spinlock_release(struct spinlock *splk)
 
 	splk->splk_holder = NULL;
 	membar_any_store();
-	spinlock_data_set(&splk->splk_lock, 0);
+	/* Only the holder writes splk_owner, so no atomic op is needed. */
+	spinlock_data_set(&splk->splk_owner,
+			  spinlock_data_get(&splk->splk_owner) + 1);
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -33,10 +33,12 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <spinlock.h>
 #include <wchan.h>
 #include <thread.h>
+#include <cpu.h>
 #include <current.h>
 #include <synch.h>
 
@@ -167,6 +169,10 @@ lock_create(const char *name)
 	spinlock_init(&lock->lk_lock);
 	lock->lk_locked = false;
 	lock->lk_holder = NULL;
+	lock->lk_handoff = false;
+	lock->lk_piwaiters = NULL;
+	lock->lk_heldnext = NULL;
+	LOCKSTAT_SETCLASS(lock->lk_lsclass, LOCKSTAT_LOCK, name);
 	
 	return lock;
 }
@@ -177,6 +183,7 @@ lock_destroy(struct lock *lock)
 	KASSERT(lock != NULL);
 	KASSERT(lock->lk_locked == false);
 	KASSERT(lock->lk_holder == NULL);
+	KASSERT(lock->lk_piwaiters == NULL);
 
 	// add stuff here as needed
 	spinlock_cleanup(&lock->lk_lock);
@@ -185,6 +192,262 @@ lock_destroy(struct lock *lock)
 	kfree(lock);
 }
 
+/*
+ * Maximum number of times lock_acquire polls a lock whose holder is
+ * running on another cpu before it gives up and sleeps.
+ */
+#define LOCK_SPINMAX	1000
+
+/*
+ * Check if OWNER is currently running on a cpu other than ours.
+ *
+ * This is called without the lock's spinlock held, so OWNER may have
+ * released the lock and even exited by the time we look; thread
+ * structures live in kernel memory that stays mapped, so at worst we
+ * read a stale state and make a bad guess about spinning.
+ */
+static
+bool
+lock_owner_oncpu(struct thread *owner)
+{
+	volatile struct thread *t = owner;
+
+	return t->t_state == S_RUN && t->t_cpu != curcpu->c_self;
+}
+
+/*
+ * Priority inheritance.
+ *
+ * A thread about to sleep in lock_acquire puts itself on the lock's
+ * lk_piwaiters list and donates its priority to the holder; if the
+ * holder is itself asleep on a lock, the donation carries on to that
+ * lock's holder, and so on. A thread that gets a lock some sleepers
+ * are still waiting for takes on their priority. On release, the
+ * holder recomputes its priority from the locks it still holds.
+ *
+ * All of this is under pi_lock, which is only taken when a lock has
+ * sleepers; uncontended locks never touch it. Lock ordering: lk_lock,
+ * then pi_lock, then the runqueue locks.
+ *
+ * A holder further down a chain is found through lk_holder without
+ * that lock's lk_lock. That's safe because a release of a lock with
+ * sleepers recomputes the holder's priority under pi_lock after
+ * changing lk_holder, so a boost given to a thread that was just
+ * letting go is taken back again.
+ */
+static struct spinlock pi_lock = SPINLOCK_INITIALIZER;
+
+/* Longest chain of blocked lock holders we follow */
+#define PI_MAXDEPTH	16
+
+/*
+ * Highest priority among the threads asleep on LOCK, or -1.
+ */
+static
+int
+lock_pi_waitpri(struct lock *lock)
+{
+	struct thread *t;
+	int pri = -1;
+
+	KASSERT(spinlock_do_i_hold(&pi_lock));
+	for (t = lock->lk_piwaiters; t != NULL; t = t->t_pinext) {
+		if (t->t_pri > pri) {
+			pri = t->t_pri;
+		}
+	}
+	return pri;
+}
+
+/*
+ * Raise T to at least PRI, and pass it on down the chain of locks T
+ * is blocked on.
+ */
+static
+void
+lock_pi_donate(struct thread *t, int pri)
+{
+	unsigned depth;
+
+	KASSERT(spinlock_do_i_hold(&pi_lock));
+	for (depth = 0; t != NULL && depth < PI_MAXDEPTH; depth++) {
+		if (t->t_pri >= pri) {
+			break;
+		}
+		t->t_pri = pri;
+		thread_reprioritize(t);
+		if (t->t_waitlock == NULL) {
+			break;
+		}
+		t = t->t_waitlock->lk_holder;
+	}
+}
+
+/*
+ * Set curthread's priority from its base priority and the sleepers on
+ * the locks it holds.
+ */
+static
+void
+lock_pi_recompute(void)
+{
+	struct lock *lk;
+	int pri, waitpri;
+
+	KASSERT(spinlock_do_i_hold(&pi_lock));
+	pri = curthread->t_basepri;
+	for (lk = curthread->t_heldlocks; lk != NULL; lk = lk->lk_heldnext) {
+		waitpri = lock_pi_waitpri(lk);
+		if (waitpri > pri) {
+			pri = waitpri;
+		}
+	}
+	curthread->t_pri = pri;
+}
+
+void
+lock_pi_update(void)
+{
+	spinlock_acquire(&pi_lock);
+	lock_pi_recompute();
+	spinlock_release(&pi_lock);
+}
+
+/*
+ * We're about to sleep on LOCK for the first time. Call with lk_lock
+ * held.
+ */
+static
+void
+lock_pi_block(struct lock *lock)
+{
+	spinlock_acquire(&pi_lock);
+	curthread->t_waitlock = lock;
+	curthread->t_pinext = lock->lk_piwaiters;
+	lock->lk_piwaiters = curthread;
+	lock_pi_donate(lock->lk_holder, curthread->t_pri);
+	spinlock_release(&pi_lock);
+}
+
+/*
+ * cv_wake has just moved T from a CV onto LOCK's wait channel, and
+ * we hold LOCK. Make T a sleeper on LOCK as lock_pi_block would, so
+ * it donates its priority to us and lock_release picks it in
+ * priority order. Call with lk_lock held.
+ */
+static
+void
+lock_pi_requeued(struct lock *lock, struct thread *t)
+{
+	KASSERT(lock->lk_holder == curthread);
+
+	spinlock_acquire(&pi_lock);
+	KASSERT(t->t_waitlock == NULL);
+	t->t_waitlock = lock;
+	t->t_pinext = lock->lk_piwaiters;
+	lock->lk_piwaiters = t;
+	lock_pi_donate(curthread, t->t_pri);
+	spinlock_release(&pi_lock);
+}
+
+/*
+ * We have LOCK. Stop waiting for it if we were, and take on the
+ * priority of whoever still is. Call with lk_lock held.
+ */
+static
+void
+lock_pi_acquired(struct lock *lock)
+{
+	struct thread **tp;
+
+	spinlock_acquire(&pi_lock);
+	if (curthread->t_waitlock == lock) {
+		for (tp = &lock->lk_piwaiters; *tp != curthread;
+		     tp = &(*tp)->t_pinext) {
+			KASSERT(*tp != NULL);
+		}
+		*tp = curthread->t_pinext;
+		curthread->t_pinext = NULL;
+		curthread->t_waitlock = NULL;
+	}
+	lock_pi_donate(curthread, lock_pi_waitpri(lock));
+	spinlock_release(&pi_lock);
+}
+
+/*
+ * Pick the sleeper lock_release should wake: the highest priority
+ * thread still asleep on the lock. Call with lk_lock and pi_lock held.
+ */
+static
+struct thread *
+lock_pi_pick(struct lock *lock)
+{
+	struct thread *t, *best;
+
+	best = wchan_peek(lock->lk_wchan, &lock->lk_lock);
+	for (t = lock->lk_piwaiters; t != NULL; t = t->t_pinext) {
+		/* Skip threads already woken but not yet running. */
+		if (t->t_wchan == lock->lk_wchan &&
+		    (best == NULL || t->t_pri > best->t_pri)) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+/*
+ * Wait for LOCK to be free and take it, or for lock_release to hand
+ * it to us. Call with lk_lock held and HANGMAN_WAIT done.
+ */
+static
+void
+lock_wait(struct lock *lock)
+{
+	struct thread *owner;
+	unsigned spins = 0;
+	LOCKSTAT_SAMPLE(sample);
+
+	while (lock->lk_locked && lock->lk_holder != curthread) {
+		LOCKSTAT_CONTENDED(sample);
+		owner = lock->lk_holder;
+		if (spins < LOCK_SPINMAX && lock_owner_oncpu(owner)) {
+			/*
+			 * The holder is running elsewhere and will
+			 * probably let go soon; poll without the
+			 * spinlock until it does, stops running, or
+			 * we run out of patience.
+			 */
+			spinlock_release(&lock->lk_lock);
+			while (spins < LOCK_SPINMAX &&
+			       lock->lk_locked &&
+			       lock->lk_holder == owner &&
+			       lock_owner_oncpu(owner)) {
+				spins++;
+			}
+			spinlock_acquire(&lock->lk_lock);
+			continue;
+		}
+		// put the thread in the wait queue of the lock
+		if (curthread->t_waitlock != lock) {
+			lock_pi_block(lock);
+		}
+		LOCKSTAT_SLEEPSTART(sample);
+		wchan_sleep(lock->lk_wchan, &lock->lk_lock);
+		LOCKSTAT_SLEEPEND(sample);
+	}
+	lock->lk_locked = true;
+	lock->lk_holder = curthread;
+	lock->lk_heldnext = curthread->t_heldlocks;
+	curthread->t_heldlocks = lock;
+	if (curthread->t_waitlock == lock || lock->lk_piwaiters != NULL) {
+		lock_pi_acquired(lock);
+	}
+	LOCKSTAT_SPINS(sample, spins);
+	LOCKSTAT_RECORD(lock->lk_lsclass, sample);
+	/* Call this (atomically) once the lock is acquired */
+	HANGMAN_ACQUIRE(&curthread->t_hangman, &lock->lk_hangman);
+}
+
 void
 lock_acquire(struct lock *lock)
 {
@@ -199,40 +462,93 @@ lock_acquire(struct lock *lock)
 	if (lock->lk_holder == curthread) {
 			panic("Deadlock on lock %p\n", lock);
 	}
-	
-	while (lock->lk_locked) {
-		// put the thread in the wait queue of the lock
-		wchan_sleep(lock->lk_wchan, &lock->lk_lock);
-	}
-	KASSERT(!lock->lk_locked);
-	lock->lk_locked = true;
-	lock->lk_holder = curthread;
-	/* Call this (atomically) once the lock is acquired */
-	HANGMAN_ACQUIRE(&curthread->t_hangman, &lock->lk_hangman);
+	lock_wait(lock);
 	spinlock_release(&lock->lk_lock);
 
 	// (void)lock;  // suppress warning until code gets written
 
 }
 
+/*
+ * Get LOCK back after a CV wait. If we were moved onto the lock's
+ * wait channel, lock_release may already have handed it to us.
+ */
+static
+void
+lock_reacquire(struct lock *lock)
+{
+	HANGMAN_WAIT(&curthread->t_hangman, &lock->lk_hangman);
+	spinlock_acquire(&lock->lk_lock);
+	lock_wait(lock);
+	spinlock_release(&lock->lk_lock);
+}
+
 void
 lock_release(struct lock *lock)
 {
+	struct lock **lp;
+	struct thread *next;
+	bool pi;
+	int oldpri;
+
 	KASSERT(lock != NULL);
 	KASSERT(lock_do_i_hold(lock));
 
 	spinlock_acquire(&lock->lk_lock);	
-	lock->lk_locked = false;
-	lock->lk_holder = NULL;
-	wchan_wakeone(lock->lk_wchan, &lock->lk_lock);
+	for (lp = &curthread->t_heldlocks; *lp != lock;
+	     lp = &(*lp)->lk_heldnext) {
+		KASSERT(*lp != NULL);
+	}
+	*lp = lock->lk_heldnext;
+	lock->lk_heldnext = NULL;
+
+	pi = lock->lk_piwaiters != NULL;
+	if (pi) {
+		spinlock_acquire(&pi_lock);
+		next = lock_pi_pick(lock);
+	}
+	else {
+		next = wchan_peek(lock->lk_wchan, &lock->lk_lock);
+	}
+	if (next != NULL && lock->lk_handoff) {
+		/* Still locked; the thread we wake owns it now. */
+		lock->lk_holder = next;
+	}
+	else {
+		lock->lk_locked = false;
+		lock->lk_holder = NULL;
+	}
+	if (next != NULL) {
+		wchan_wakethread(lock->lk_wchan, &lock->lk_lock, next);
+	}
+
+	oldpri = curthread->t_pri;
+	if (pi) {
+		/* Give back what this lock's sleepers donated. */
+		lock_pi_recompute();
+		spinlock_release(&pi_lock);
+	}
 	/* Call this (atomically) when the lock is released */
 	HANGMAN_RELEASE(&curthread->t_hangman, &lock->lk_hangman);
 	spinlock_release(&lock->lk_lock);
+
+	/* If we were boosted, let whoever we were holding up run. */
+	if (curthread->t_pri < oldpri && curcpu->c_spinlocks == 0) {
+		thread_yield();
+	}
 	// Write this
 
 	// (void)lock;  // suppress warning until code gets written
 }
 
+void
+lock_sethandoff(struct lock *lock, bool handoff)
+{
+	spinlock_acquire(&lock->lk_lock);
+	lock->lk_handoff = handoff;
+	spinlock_release(&lock->lk_lock);
+}
+
 bool
 lock_do_i_hold(struct lock *lock)
 {
@@ -273,6 +589,8 @@ cv_create(const char *name)
 	}
 
 	spinlock_init(&cv->cv_lock);
+	cv->cv_waitlock = NULL;
+	LOCKSTAT_SETCLASS(cv->cv_lsclass, LOCKSTAT_CV, name);
 
 	return cv;
 }
@@ -288,24 +606,115 @@ cv_destroy(struct cv *cv)
 	kfree(cv);
 }
 
+/*
+ * Record the lock the threads sleeping on CV are holding. Call with
+ * cv_lock held, before going to sleep. If sleepers use different
+ * locks, forget it until the CV empties again; cv_wake then just
+ * wakes them.
+ */
+static
+void
+cv_setwaitlock(struct cv *cv, struct lock *lock)
+{
+	if (wchan_peek(cv->cv_wchan, &cv->cv_lock) == NULL) {
+		cv->cv_waitlock = lock;
+	}
+	else if (cv->cv_waitlock != lock) {
+		cv->cv_waitlock = NULL;
+	}
+}
+
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
+	LOCKSTAT_SAMPLE(sample);
+
 	// Write this
 	KASSERT(cv != NULL && lock != NULL);
 	KASSERT(curthread->t_in_interrupt == false);	
 	KASSERT(lock_do_i_hold(lock));
 
 	spinlock_acquire(&cv->cv_lock);
+	cv_setwaitlock(cv, lock);
 	lock_release(lock);
+	LOCKSTAT_CONTENDED(sample);
+	LOCKSTAT_SLEEPSTART(sample);
 	wchan_sleep(cv->cv_wchan, &cv->cv_lock);
+	LOCKSTAT_SLEEPEND(sample);
+	LOCKSTAT_RECORD(cv->cv_lsclass, sample);
 	spinlock_release(&cv->cv_lock);
 	
-	lock_acquire(lock);
+	lock_reacquire(lock);
 	//(void)cv;    // suppress warning until code gets written
 	//(void)lock;  // suppress warning until code gets written
 }
 
+int
+cv_wait_timeout(struct cv *cv, struct lock *lock, unsigned ticks)
+{
+	int result;
+	LOCKSTAT_SAMPLE(sample);
+
+	KASSERT(cv != NULL && lock != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(lock_do_i_hold(lock));
+
+	if (ticks == 0) {
+		return ETIMEDOUT;
+	}
+
+	spinlock_acquire(&cv->cv_lock);
+	cv_setwaitlock(cv, lock);
+	lock_release(lock);
+	LOCKSTAT_CONTENDED(sample);
+	LOCKSTAT_SLEEPSTART(sample);
+	result = wchan_sleep_timeout(cv->cv_wchan, &cv->cv_lock, ticks);
+	LOCKSTAT_SLEEPEND(sample);
+	LOCKSTAT_RECORD(cv->cv_lsclass, sample);
+	spinlock_release(&cv->cv_lock);
+
+	lock_reacquire(lock);
+	return result;
+}
+
+/*
+ * Wake up to MAX threads sleeping on CV. If they're waiting with
+ * LOCK, which we hold, they'd only block on it again; move them to
+ * the lock's wait channel instead, so lock_release wakes them one by
+ * one. Once moved, a timed wait can no longer time out, which is
+ * right: it has been signaled. Moved threads are lock sleepers for
+ * priority inheritance too.
+ */
+static
+void
+cv_wake(struct cv *cv, struct lock *lock, unsigned max)
+{
+	struct thread *t;
+	unsigned i;
+
+	spinlock_acquire(&cv->cv_lock);
+	if (cv->cv_waitlock == lock) {
+		spinlock_acquire(&lock->lk_lock);
+		for (i = 0; i < max; i++) {
+			t = wchan_peek(cv->cv_wchan, &cv->cv_lock);
+			if (t == NULL) {
+				break;
+			}
+			wchan_requeue(cv->cv_wchan, &cv->cv_lock,
+				      lock->lk_wchan, &lock->lk_lock, 1);
+			lock_pi_requeued(lock, t);
+		}
+		spinlock_release(&lock->lk_lock);
+	}
+	else if (max == 1) {
+		wchan_wakeone(cv->cv_wchan, &cv->cv_lock);
+	}
+	else {
+		wchan_wakeall(cv->cv_wchan, &cv->cv_lock);
+	}
+	spinlock_release(&cv->cv_lock);
+}
+
 void
 cv_signal(struct cv *cv, struct lock *lock)
 {
@@ -314,9 +723,7 @@ cv_signal(struct cv *cv, struct lock *lock)
 	KASSERT(curthread->t_in_interrupt == false);
 	KASSERT(lock_do_i_hold(lock));
 
-	spinlock_acquire(&cv->cv_lock);
-	wchan_wakeone(cv->cv_wchan, &cv->cv_lock);
-	spinlock_release(&cv->cv_lock);
+	cv_wake(cv, lock, 1);
 	// (void)cv;    // suppress warning until code gets written
 	// (void)lock;  // suppress warning until code gets written
 }
@@ -329,9 +736,7 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 	KASSERT(curthread->t_in_interrupt == false);
 	KASSERT(lock_do_i_hold(lock));
 
-	spinlock_acquire(&cv->cv_lock);
-	wchan_wakeall(cv->cv_wchan, &cv->cv_lock);
-	spinlock_release(&cv->cv_lock);
+	cv_wake(cv, lock, (unsigned)-1);
 	// (void)cv;    // suppress warning until code gets written
 	// (void)lock;  // suppress warning until code gets written
 }
@@ -340,6 +745,47 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 //
 // RW lock
 
+/*
+ * Atomically apply a change to the state word.
+ */
+static
+void
+rwlock_setbits(struct rwlock *rwlock, spinlock_data_t clear,
+	       spinlock_data_t set)
+{
+	spinlock_data_t old;
+
+	do {
+		old = spinlock_data_get(&rwlock->rw_state);
+	} while (!spinlock_data_cas(&rwlock->rw_state, old,
+				    (old & ~clear) | set));
+}
+
+static
+void
+rwlock_addreaders(struct rwlock *rwlock, int delta)
+{
+	spinlock_data_t old;
+
+	do {
+		old = spinlock_data_get(&rwlock->rw_state);
+	} while (!spinlock_data_cas(&rwlock->rw_state, old, old + delta));
+}
+
+/*
+ * Clear RW_WAITERS if nobody is waiting any more. Call with rw_lk
+ * held.
+ */
+static
+void
+rwlock_checkwaiters(struct rwlock *rwlock)
+{
+	KASSERT(spinlock_do_i_hold(&rwlock->rw_lk));
+	if (rwlock->rw_nrwait == 0 && rwlock->rw_nwwait == 0) {
+		rwlock_setbits(rwlock, RW_WAITERS, 0);
+	}
+}
+
 struct rwlock *
 rwlock_create(const char *name)
 {
@@ -354,35 +800,29 @@ rwlock_create(const char *name)
 		return NULL;
 	}
 
-	rwlock->rw_lock = lock_create(rwlock->rw_name);
-	if (rwlock->rw_lock == NULL) {
+	rwlock->rw_rwchan = wchan_create(rwlock->rw_name);
+	if (rwlock->rw_rwchan == NULL) {
 		kfree(rwlock->rw_name);
 		kfree(rwlock);
 		return NULL;
 	}
 
-	rwlock->rw_cvread = cv_create(rwlock->rw_name);
-	if (rwlock->rw_cvread == NULL) {
-		lock_destroy(rwlock->rw_lock);
+	rwlock->rw_wwchan = wchan_create(rwlock->rw_name);
+	if (rwlock->rw_wwchan == NULL) {
+		wchan_destroy(rwlock->rw_rwchan);
 		kfree(rwlock->rw_name);
 		kfree(rwlock);
 		return NULL;
 	}
 
-	rwlock->rw_cvwrite = cv_create(rwlock->rw_name);
-	if (rwlock->rw_cvwrite == NULL) {
-		lock_destroy(rwlock->rw_lock);
-		cv_destroy(rwlock->rw_cvwrite);
-		kfree(rwlock->rw_name);
-		kfree(rwlock);
-		return NULL;
-	}
-
-	rwlock->rw_readin = 0u;
-	rwlock->rw_writein = 0u;
-	rwlock->rw_readwt = 0u;
-	rwlock->rw_writewt = 0u;
-	rwlock->rw_wturnin = random() % RWHASHVAL;
+	spinlock_data_set(&rwlock->rw_state, 0);
+	rwlock->rw_writer = NULL;
+	spinlock_init(&rwlock->rw_lk);
+	rwlock->rw_nrwait = 0;
+	rwlock->rw_nwwait = 0;
+	rwlock->rw_readadmit = 0;
+	rwlock->rw_wstreak = 0;
+	LOCKSTAT_SETCLASS(rwlock->rw_lsclass, LOCKSTAT_RWLOCK, name);
 
 	return rwlock;
 }
@@ -391,106 +831,142 @@ void
 rwlock_destroy(struct rwlock *rwlock)
 {
 	KASSERT(rwlock != NULL);
-	KASSERT(rwlock->rw_writein == 0u);
-	KASSERT(rwlock->rw_readin == 0u);
-
-	lock_destroy(rwlock->rw_lock);
-	cv_destroy(rwlock->rw_cvread);
-	cv_destroy(rwlock->rw_cvwrite);
+	KASSERT(spinlock_data_get(&rwlock->rw_state) == 0);
+	KASSERT(rwlock->rw_writer == NULL);
+
+	spinlock_cleanup(&rwlock->rw_lk);
+	wchan_destroy(rwlock->rw_rwchan);
+	wchan_destroy(rwlock->rw_wwchan);
+	kfree(rwlock->rw_name);
+	kfree(rwlock);
 }
 
 void
 rwlock_acquire_read(struct rwlock *rwlock)
 {
+	spinlock_data_t old;
+	LOCKSTAT_SAMPLE(sample);
+
 	KASSERT(rwlock != NULL);
-	lock_acquire(rwlock->rw_lock);
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(rwlock->rw_writer != curthread);
+
+	/* Fast path: no writer and nobody waiting. */
+	old = spinlock_data_get(&rwlock->rw_state);
+	if ((old & (RW_WRITER | RW_WAITERS)) == 0 &&
+	    spinlock_data_cas(&rwlock->rw_state, old, old + 1)) {
+		LOCKSTAT_RECORD(rwlock->rw_lsclass, sample);
+		return;
+	}
 
-	rwlock->rw_readwt++;
-	while (rwlock->rw_writein == 1u ||
-			(rwlock->rw_wturnin == 0u && rwlock->rw_writewt > 0u))
-		cv_wait(rwlock->rw_cvread, rwlock->rw_lock);
-	rwlock->rw_readwt--;
-	rwlock->rw_readin++;
-	if (rwlock->rw_wturnin > 0u)
-		rwlock->rw_wturnin--;
-		
-	lock_release(rwlock->rw_lock);
+	spinlock_acquire(&rwlock->rw_lk);
+	rwlock->rw_nrwait++;
+	rwlock_setbits(rwlock, 0, RW_WAITERS);
+	while ((spinlock_data_get(&rwlock->rw_state) & RW_WRITER) ||
+	       (rwlock->rw_nwwait > 0 && rwlock->rw_readadmit == 0)) {
+		LOCKSTAT_CONTENDED(sample);
+		LOCKSTAT_SLEEPSTART(sample);
+		wchan_sleep(rwlock->rw_rwchan, &rwlock->rw_lk);
+		LOCKSTAT_SLEEPEND(sample);
+	}
+	rwlock->rw_nrwait--;
+	if (rwlock->rw_readadmit > 0) {
+		rwlock->rw_readadmit--;
+	}
+	rwlock_addreaders(rwlock, 1);
+	rwlock_checkwaiters(rwlock);
+	LOCKSTAT_RECORD(rwlock->rw_lsclass, sample);
+	spinlock_release(&rwlock->rw_lk);
 }
 
 void
 rwlock_release_read(struct rwlock *rwlock)
 {
-	KASSERT(rwlock != NULL);
-	KASSERT(rwlock->rw_readin > 0u);
-	KASSERT(rwlock->rw_writein == 0u);
+	spinlock_data_t old;
 
-	lock_acquire(rwlock->rw_lock);
+	KASSERT(rwlock != NULL);
 
-	rwlock->rw_readin--;
-	if (rwlock->rw_readin > 0u) {
-		/*
-		 * Readers are still executing
-		 * Do nothing!!
-		 */
-	} else if (rwlock->rw_writewt > 0u && rwlock->rw_wturnin == 0) {
-		/*
-		 * Last reader executed, It is the turn of the
-		 * writer to execute.
-		 */
-		cv_signal(rwlock->rw_cvwrite, rwlock->rw_lock);
-	} else if (rwlock->rw_writewt > 0u && rwlock->rw_wturnin > 0) {
-		/*
-		 * Writers are waiting, but it is not
-		 * the turn of writer to execute
-		 * Let the readers and writers compete evenly.
-		 */
-		cv_signal(rwlock->rw_cvread, rwlock->rw_lock);
-		cv_signal(rwlock->rw_cvwrite, rwlock->rw_lock);
+	/* Fast path: nobody waiting. */
+	old = spinlock_data_get(&rwlock->rw_state);
+	KASSERT((old & RW_READERS) > 0);
+	KASSERT((old & RW_WRITER) == 0);
+	if ((old & RW_WAITERS) == 0 &&
+	    spinlock_data_cas(&rwlock->rw_state, old, old - 1)) {
+		return;
 	}
-	else {
-		/*
-		 * No writers are waiting
-		 * Execute a reader
-		 */
-		if (rwlock->rw_wturnin == 0u) 	// If it is the writers turn, and no writer is present, allow one reader to execute
-			rwlock->rw_wturnin++;
-		cv_broadcast(rwlock->rw_cvread, rwlock->rw_lock);
+
+	spinlock_acquire(&rwlock->rw_lk);
+	rwlock_addreaders(rwlock, -1);
+	if ((spinlock_data_get(&rwlock->rw_state) & RW_READERS) == 0 &&
+	    rwlock->rw_nwwait > 0 && rwlock->rw_readadmit == 0) {
+		/* Last reader out; let a writer in. */
+		wchan_wakeone(rwlock->rw_wwchan, &rwlock->rw_lk);
 	}
-		
-	lock_release(rwlock->rw_lock);
+	rwlock_checkwaiters(rwlock);
+	spinlock_release(&rwlock->rw_lk);
 }
 
 void
 rwlock_acquire_write(struct rwlock *rwlock)
 {
+	LOCKSTAT_SAMPLE(sample);
+
 	KASSERT(rwlock != NULL);
-	
-	lock_acquire(rwlock->rw_lock);
-	
-	rwlock->rw_writewt++;
-	while (rwlock->rw_readin > 0u || rwlock->rw_writein == 1u ||
-		(rwlock->rw_wturnin > 0u && rwlock->rw_readwt > 0u))
-		cv_wait(rwlock->rw_cvwrite, rwlock->rw_lock);
-	rwlock->rw_writewt--;
-	rwlock->rw_writein++;
+	KASSERT(curthread->t_in_interrupt == false);
+	KASSERT(rwlock->rw_writer != curthread);
+
+	/* Fast path: completely free. */
+	if (spinlock_data_cas(&rwlock->rw_state, 0, RW_WRITER)) {
+		rwlock->rw_writer = curthread;
+		LOCKSTAT_RECORD(rwlock->rw_lsclass, sample);
+		return;
+	}
 
-	lock_release(rwlock->rw_lock);
+	spinlock_acquire(&rwlock->rw_lk);
+	rwlock->rw_nwwait++;
+	rwlock_setbits(rwlock, 0, RW_WAITERS);
+	while ((spinlock_data_get(&rwlock->rw_state) &
+		(RW_WRITER | RW_READERS)) != 0 ||
+	       rwlock->rw_readadmit > 0) {
+		LOCKSTAT_CONTENDED(sample);
+		LOCKSTAT_SLEEPSTART(sample);
+		wchan_sleep(rwlock->rw_wwchan, &rwlock->rw_lk);
+		LOCKSTAT_SLEEPEND(sample);
+	}
+	rwlock->rw_nwwait--;
+	rwlock_setbits(rwlock, 0, RW_WRITER);
+	rwlock_checkwaiters(rwlock);
+	rwlock->rw_writer = curthread;
+	LOCKSTAT_RECORD(rwlock->rw_lsclass, sample);
+	spinlock_release(&rwlock->rw_lk);
 }
 
 void
 rwlock_release_write(struct rwlock *rwlock)
 {
 	KASSERT(rwlock != NULL);
-	KASSERT(rwlock->rw_writein == 1u);
-	KASSERT(rwlock->rw_readin == 0u);
+	KASSERT(rwlock->rw_writer == curthread);
 
-	lock_acquire(rwlock->rw_lock);
-	
-	rwlock->rw_writein--;
-	uint32_t rand = random() % RWHASHVAL;
-	rwlock->rw_wturnin = rand;
-	cv_signal(rwlock->rw_cvread, rwlock->rw_lock);
-	cv_signal(rwlock->rw_cvwrite, rwlock->rw_lock);
+	rwlock->rw_writer = NULL;
+
+	/* Fast path: nobody waiting. */
+	if (spinlock_data_cas(&rwlock->rw_state, RW_WRITER, 0)) {
+		return;
+	}
 
-	lock_release(rwlock->rw_lock);
+	spinlock_acquire(&rwlock->rw_lk);
+	rwlock_setbits(rwlock, RW_WRITER, 0);
+	if (rwlock->rw_nrwait > 0 &&
+	    (rwlock->rw_nwwait == 0 ||
+	     ++rwlock->rw_wstreak >= RW_WRITEBATCH)) {
+		/* Let in the readers that are waiting now. */
+		rwlock->rw_wstreak = 0;
+		rwlock->rw_readadmit = rwlock->rw_nrwait;
+		wchan_wakeall(rwlock->rw_rwchan, &rwlock->rw_lk);
+	}
+	else if (rwlock->rw_nwwait > 0) {
+		wchan_wakeone(rwlock->rw_wwchan, &rwlock->rw_lk);
+	}
+	rwlock_checkwaiters(rwlock);
+	spinlock_release(&rwlock->rw_lk);
 }
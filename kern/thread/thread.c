@@ -47,6 +47,12 @@
 #include <proc.h>
 #include <current.h>
 #include <synch.h>
+#include <lockstat.h>
+#include <rcu.h>
+#include <timer.h>
+#include <counter.h>
+#include <workqueue.h>
+#include <trace.h>
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
@@ -55,6 +61,9 @@
 /* Magic number used as a guard value on kernel thread stacks. */
 #define THREAD_STACK_MAGIC 0xbaadf00d
 
+/* Exited threads (with their stacks) each cpu keeps for thread_fork. */
+#define THREAD_CACHE_MAX 8
+
 /* Wait channel. A wchan is protected by an associated, passed-in spinlock. */
 struct wchan {
 	const char *wc_name;		/* name for this channel */
@@ -65,6 +74,15 @@ struct wchan {
 DECLARRAY(cpu, static __UNUSED inline);
 DEFARRAY(cpu, static __UNUSED inline);
 static struct cpuarray allcpus;
+
+static struct counter switch_counter = COUNTER_INITIALIZER("context_switches");
+static struct counter ipi_counter = COUNTER_INITIALIZER("ipis");
+static struct counter shootdown_overflow_counter =
+	COUNTER_INITIALIZER("tlbshootdown_overflows");
+static struct counter threadcache_hit_counter =
+	COUNTER_INITIALIZER("threadcache_hits");
+static struct counter threadcache_miss_counter =
+	COUNTER_INITIALIZER("threadcache_misses");
 unsigned num_cpus;
 
 /* Used to wait for secondary CPUs to come online. */
@@ -115,28 +133,17 @@ thread_checkstack(struct thread *thread)
 }
 
 /*
- * Create a thread. This is used both to create a first thread
- * for each CPU and to create subsequent forked threads.
+ * Set up the fields of a new thread, or of a cached one being reused.
  */
 static
-struct thread *
-thread_create(const char *name)
+void
+thread_init(struct thread *thread, const char *name)
 {
-	struct thread *thread;
-
-	DEBUGASSERT(name != NULL);
-	if (strlen(name) > MAX_NAME_LENGTH) {
-		return NULL;
-	}
-
-	thread = kmalloc(sizeof(*thread));
-	if (thread == NULL) {
-		return NULL;
-	}
-
 	strcpy(thread->t_name, name);
 	thread->t_wchan_name = "NEW";
+	thread->t_wchan = NULL;
 	thread->t_state = S_READY;
+	thread->t_nswitches = 0;
 
 	/* Thread subsystem fields */
 	thread_machdep_init(&thread->t_machdep);
@@ -144,16 +151,91 @@ thread_create(const char *name)
 	thread->t_stack = NULL;
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
+	thread->t_bound = false;
 	thread->t_proc = NULL;
+	thread->t_procnext = NULL;
 	HANGMAN_ACTORINIT(&thread->t_hangman, thread->t_name);
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+	thread->t_rcudepth = 0;
+
+	/* Priority fields */
+	thread->t_basepri = PRI_DEFAULT;
+	thread->t_pri = PRI_DEFAULT;
+	thread->t_waitlock = NULL;
+	thread->t_pinext = NULL;
+	thread->t_heldlocks = NULL;
+
+	/* Accounting fields */
+	bzero(&thread->t_acct, sizeof(thread->t_acct));
+	thread->t_acct_since = 0;
+	thread->t_acct_user = false;
 
 	/* If you add to struct thread, be sure to initialize here */
+}
+
+/*
+ * Create a thread. This is used both to create a first thread
+ * for each CPU and to create subsequent forked threads.
+ */
+static
+struct thread *
+thread_create(const char *name)
+{
+	struct thread *thread;
 
+	DEBUGASSERT(name != NULL);
+	if (strlen(name) > MAX_NAME_LENGTH) {
+		return NULL;
+	}
+
+	thread = kmalloc(sizeof(*thread));
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	thread_init(thread, name);
+	return thread;
+}
+
+/*
+ * Take a thread, stack and all, from this cpu's cache and set it up
+ * afresh as NAME. Returns NULL if the cache is empty.
+ *
+ * The stack's guard band was checked when the thread went into the
+ * cache, so it doesn't need setting again.
+ */
+static
+struct thread *
+thread_fromcache(const char *name)
+{
+	struct thread *thread;
+	struct cpu *c;
+	void *stack;
+
+	DEBUGASSERT(name != NULL);
+	if (strlen(name) > MAX_NAME_LENGTH) {
+		return NULL;
+	}
+
+	/* If we migrate after reading curcpu, we just use the old cpu's */
+	c = curcpu;
+	spinlock_acquire(&c->c_threadcache_lock);
+	thread = threadlist_remhead(&c->c_threadcache);
+	spinlock_release(&c->c_threadcache_lock);
+
+	if (thread == NULL) {
+		counter_inc(&threadcache_miss_counter);
+		return NULL;
+	}
+	counter_inc(&threadcache_hit_counter);
+
+	stack = thread->t_stack;
+	thread_init(thread, name);
+	thread->t_stack = stack;
 	return thread;
 }
 
@@ -182,8 +264,11 @@ cpu_create(unsigned hardware_number)
 
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
+	threadlist_init(&c->c_threadcache);
+	spinlock_init(&c->c_threadcache_lock);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	c->c_intrpc = 0;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -197,6 +282,13 @@ cpu_create(unsigned hardware_number)
 	if (result != 0) {
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
+#if OPT_LOCKSTAT
+	lockstat_cpuinit(c);
+#endif
+	rcu_cpuinit(c);
+	timer_cpuinit(c);
+	counter_cpuinit(c);
+	workqueue_cpuinit(c);
 
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
@@ -289,11 +381,76 @@ thread_destroy(struct thread *thread)
 	kfree(thread);
 }
 
+/*
+ * Put an exited thread in this cpu's cache for thread_fork to reuse,
+ * rather than freeing it and its stack. Returns false, leaving the
+ * thread alone, if the cache is full.
+ */
+static
+bool
+thread_recycle(struct thread *thread)
+{
+	struct cpu *c = curcpu;
+	bool room;
+
+	KASSERT(thread != curthread);
+	KASSERT(thread->t_state != S_RUN);
+	KASSERT(thread->t_proc == NULL);
+	KASSERT(thread->t_stack != NULL);
+
+	thread_checkstack(thread);
+	thread->t_wchan_name = "CACHED";
+
+	spinlock_acquire(&c->c_threadcache_lock);
+	room = c->c_threadcache.tl_count < THREAD_CACHE_MAX;
+	if (room) {
+		/* Most recently used first, as its stack may be cached */
+		threadlist_addhead(&c->c_threadcache, thread);
+	}
+	spinlock_release(&c->c_threadcache_lock);
+
+	if (room) {
+		thread_machdep_cleanup(&thread->t_machdep);
+	}
+	return room;
+}
+
+/*
+ * Free every cpu's cached threads, so the kernel heap only holds what
+ * is actually in use. Called before measuring the heap (the khu menu
+ * command), since otherwise the threads a test leaves behind in the
+ * caches look like a leak.
+ */
+void
+thread_cache_drain(void)
+{
+	struct threadlist drained;
+	struct thread *t;
+	struct cpu *c;
+	unsigned i;
+
+	threadlist_init(&drained);
+	for (i=0; i<cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		spinlock_acquire(&c->c_threadcache_lock);
+		while ((t = threadlist_remhead(&c->c_threadcache)) != NULL) {
+			threadlist_addtail(&drained, t);
+		}
+		spinlock_release(&c->c_threadcache_lock);
+	}
+
+	while ((t = threadlist_remhead(&drained)) != NULL) {
+		thread_destroy(t);
+	}
+	threadlist_cleanup(&drained);
+}
+
 /*
  * Clean up zombies. (Zombies are threads that have exited but still
- * need to have thread_destroy called on them.)
+ * need to have thread_destroy called on them.) Up to
+ * THREAD_CACHE_MAX of them are kept for reuse instead.
  *
- * The list of zombies is per-cpu.
+ * The list of zombies is per-cpu, as is the cache.
  */
 static
 void
@@ -304,7 +461,9 @@ exorcise(void)
 	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
-		thread_destroy(z);
+		if (z->t_stack == NULL || !thread_recycle(z)) {
+			thread_destroy(z);
+		}
 	}
 }
 
@@ -413,6 +572,9 @@ cpu_hatch(unsigned software_number)
 	KASSERT(curthread != NULL);
 	KASSERT(curcpu->c_number == software_number);
 
+	/* Start our clock; we didn't come through thread_startup. */
+	acct_switchin();
+
 	spl0();
 	cpu_identify(buf, sizeof(buf));
 
@@ -455,6 +617,28 @@ thread_start_cpus(void)
 	thread_count = 1;
 }
 
+/*
+ * Add T to TL, which is kept sorted by priority, behind every thread
+ * of the same or higher priority so that equals stay FIFO. Searching
+ * from the tail finds the spot right away when priorities are equal,
+ * which is nearly always.
+ */
+static
+void
+thread_listadd(struct threadlist *tl, struct thread *t)
+{
+	struct threadlistnode *tln;
+
+	for (tln = tl->tl_tail.tln_prev; tln->tln_self != NULL;
+	     tln = tln->tln_prev) {
+		if (tln->tln_self->t_pri >= t->t_pri) {
+			threadlist_insertafter(tl, tln->tln_self, t);
+			return;
+		}
+	}
+	threadlist_addhead(tl, t);
+}
+
 /*
  * Make a thread runnable.
  *
@@ -479,7 +663,7 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 
 	/* Target thread is now ready to run; put it on the run queue. */
 	target->t_state = S_READY;
-	threadlist_addtail(&targetcpu->c_runqueue, target);
+	thread_listadd(&targetcpu->c_runqueue, target);
 
 	if (targetcpu->c_isidle && targetcpu != curcpu->c_self) {
 		/*
@@ -501,37 +685,51 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
  * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
  *
  * The new thread is created in the process P. If P is null, the
- * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * process is inherited from the caller. If BINDCPU is null it will
+ * start on the same CPU as the caller, unless the scheduler
+ * intervenes first; otherwise it runs only on BINDCPU.
  */
+static
 int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+thread_fork_common(const char *name,
+		   struct proc *proc,
+		   struct cpu *bindcpu,
+		   void (*entrypoint)(void *data1, unsigned long data2),
+		   void *data1, unsigned long data2)
 {
 	struct thread *newthread;
 	int result;
 
-	newthread = thread_create(name);
+	newthread = thread_fromcache(name);
 	if (newthread == NULL) {
-		return ENOMEM;
-	}
+		newthread = thread_create(name);
+		if (newthread == NULL) {
+			return ENOMEM;
+		}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
-	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
+		/* Allocate a stack */
+		newthread->t_stack = kmalloc(STACK_SIZE);
+		if (newthread->t_stack == NULL) {
+			thread_destroy(newthread);
+			return ENOMEM;
+		}
+		thread_checkstack_init(newthread);
 	}
-	thread_checkstack_init(newthread);
 
 	/*
 	 * Now we clone various fields from the parent thread.
 	 */
 
 	/* Thread subsystem fields */
-	newthread->t_cpu = curthread->t_cpu;
+	if (bindcpu != NULL) {
+		newthread->t_cpu = bindcpu;
+		newthread->t_bound = true;
+	}
+	else {
+		newthread->t_cpu = curthread->t_cpu;
+	}
+	newthread->t_basepri = curthread->t_basepri;
+	newthread->t_pri = curthread->t_basepri;
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -559,12 +757,39 @@ thread_fork(const char *name,
 	/* Set up the switchframe so entrypoint() gets called */
 	switchframe_init(newthread, entrypoint, data1, data2);
 
-	/* Lock the current cpu's run queue and make the new thread runnable */
+	/* Lock its cpu's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
 	return 0;
 }
 
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	return thread_fork_common(name, proc, NULL, entrypoint, data1, data2);
+}
+
+int
+thread_fork_bound(const char *name,
+		  struct proc *proc,
+		  struct cpu *c,
+		  void (*entrypoint)(void *data1, unsigned long data2),
+		  void *data1, unsigned long data2)
+{
+	KASSERT(c != NULL);
+	return thread_fork_common(name, proc, c, entrypoint, data1, data2);
+}
+
+void
+thread_cachestats(unsigned *hits, unsigned *misses)
+{
+	*hits = counter_read(&threadcache_hit_counter);
+	*misses = counter_read(&threadcache_miss_counter);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -602,6 +827,13 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	/* Check the stack guard band. */
 	thread_checkstack(cur);
 
+	/*
+	 * No RCU read-side section can span a context switch, so
+	 * this is a quiescent state.
+	 */
+	KASSERT(cur->t_rcudepth == 0);
+	rcu_quiescent();
+
 	/* Lock the run queue. */
 	spinlock_acquire(&curcpu->c_runqueue_lock);
 
@@ -621,6 +853,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		break;
 	    case S_SLEEP:
 		cur->t_wchan_name = wc->wc_name;
+		cur->t_wchan = wc;
 		/*
 		 * Add the thread to the list in the wait channel, and
 		 * unlock same. To avoid a race with someone else
@@ -629,7 +862,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		 * caller of wchan_sleep locked it until the thread is
 		 * on the list.
 		 */
-		threadlist_addtail(&wc->wc_threads, cur);
+		thread_listadd(&wc->wc_threads, cur);
 		spinlock_release(lk);
 		break;
 	    case S_ZOMBIE:
@@ -638,6 +871,21 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		break;
 	}
 	cur->t_state = newstate;
+	cur->t_nswitches++;
+	counter_inc(&switch_counter);
+
+	/*
+	 * A yield from an interrupt handler is the timer preempting
+	 * us; anything else the thread asked for. Exiting doesn't
+	 * count.
+	 */
+	if (newstate == S_READY && cur->t_in_interrupt) {
+		cur->t_acct.ac_nivcsw++;
+	}
+	else if (newstate != S_ZOMBIE) {
+		cur->t_acct.ac_nvcsw++;
+	}
+	acct_switchout();
 
 	/*
 	 * Get the next thread. While there isn't one, call cpu_idle().
@@ -668,6 +916,8 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	} while (next == NULL);
 	curcpu->c_isidle = false;
 
+	tracepoint(TRACE_SWITCH, (uintptr_t)next, newstate);
+
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
 	 * curthread and it may not be, depending on how curthread and
@@ -732,6 +982,9 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Restart our clock. */
+	acct_switchin();
+
 	/* Unlock the run queue. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
@@ -765,6 +1018,9 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Start our clock. */
+	acct_switchin();
+
 	/* Release the runqueue lock acquired in thread_switch. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
@@ -808,10 +1064,11 @@ thread_exit(void)
 	cur = curthread;
 
 	/*
-	 * Detach from our process. You might need to move this action
-	 * around, depending on how your wait/exit works.
+	 * Detach from our process, unless proc_exit already did.
 	 */
-	proc_remthread(cur);
+	if (cur->t_proc != NULL) {
+		proc_remthread(cur);
+	}
 
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
@@ -842,22 +1099,61 @@ thread_yield(void)
 	thread_switch(S_READY, NULL, NULL);
 }
 
+/*
+ * Set the current thread's base priority. Its effective priority may
+ * stay higher if it holds locks higher priority threads are waiting
+ * for. Yield in case something else should now run first.
+ */
+void
+thread_setpriority(int pri)
+{
+	KASSERT(pri >= PRI_MIN && pri <= PRI_MAX);
+
+	curthread->t_basepri = pri;
+	lock_pi_update();
+	thread_yield();
+}
+
+/*
+ * T's t_pri has changed. If T is on a run queue, move it to its new
+ * place. We have to look for it: a ready thread can be briefly off
+ * every run queue while it's being migrated.
+ */
+void
+thread_reprioritize(struct thread *t)
+{
+	struct threadlistnode *tln;
+	struct cpu *c;
+
+	c = t->t_cpu;
+	spinlock_acquire(&c->c_runqueue_lock);
+	if (t->t_cpu == c && t->t_state == S_READY) {
+		for (tln = c->c_runqueue.tl_head.tln_next;
+		     tln->tln_self != NULL; tln = tln->tln_next) {
+			if (tln->tln_self == t) {
+				threadlist_remove(&c->c_runqueue, t);
+				thread_listadd(&c->c_runqueue, t);
+				break;
+			}
+		}
+	}
+	spinlock_release(&c->c_runqueue_lock);
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
  * Scheduler.
  *
- * This is called periodically from hardclock(). It should reshuffle
- * the current CPU's run queue by job priority.
+ * This is called periodically from hardclock(). Run queues are kept
+ * sorted by priority as threads are added (see thread_listadd), and
+ * threads of equal priority take turns as hardclock yields, so there
+ * is nothing to reshuffle here.
  */
 
 void
 schedule(void)
 {
-	/*
-	 * You can write this. If we do nothing, threads will run in
-	 * round-robin fashion.
-	 */
 }
 
 /*
@@ -941,15 +1237,17 @@ thread_consider_migration(void)
 			 * the list and decrement to_send in order to
 			 * skip it. Then it goes back on our own run
 			 * queue below.
+			 *
+			 * Bound threads are skipped the same way.
 			 */
-			if (t == curthread) {
+			if (t == curthread || t->t_bound) {
 				threadlist_addtail(&victims, t);
 				to_send--;
 				continue;
 			}
 
 			t->t_cpu = c;
-			threadlist_addtail(&c->c_runqueue, t);
+			thread_listadd(&c->c_runqueue, t);
 			DEBUG(DB_THREADS,
 			      "Migrated thread %s: cpu %u -> %u",
 			      t->t_name, curcpu->c_number, c->c_number);
@@ -973,7 +1271,7 @@ thread_consider_migration(void)
 	if (!threadlist_isempty(&victims)) {
 		spinlock_acquire(&curcpu->c_runqueue_lock);
 		while ((t = threadlist_remhead(&victims)) != NULL) {
-			threadlist_addtail(&curcpu->c_runqueue, t);
+			thread_listadd(&curcpu->c_runqueue, t);
 		}
 		spinlock_release(&curcpu->c_runqueue_lock);
 	}
@@ -1041,8 +1339,85 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 	/* must not hold other spinlocks */
 	KASSERT(curcpu->c_spinlocks == 1);
 
+	tracepoint(TRACE_SLEEP, (uintptr_t)wc, 0);
+	thread_switch(S_SLEEP, wc, lk);
+	spinlock_acquire(lk);
+}
+
+/*
+ * State shared between wchan_sleep_timeout and its timer callback.
+ */
+struct wchan_timeout {
+	struct thread *wt_thread;
+	struct wchan *wt_wc;
+	struct spinlock *wt_lk;
+	bool wt_expired;
+};
+
+/*
+ * Timer callback for wchan_sleep_timeout: if the thread is still
+ * asleep on the channel, take it off and wake it. Only that thread
+ * is woken; the other sleepers are left alone.
+ */
+static
+void
+wchan_timeout(void *data)
+{
+	struct wchan_timeout *wt = data;
+	struct thread *target = wt->wt_thread;
+
+	spinlock_acquire(wt->wt_lk);
+	if (target->t_wchan == wt->wt_wc) {
+		threadlist_remove(&wt->wt_wc->wc_threads, target);
+		target->t_wchan = NULL;
+		wt->wt_expired = true;
+		thread_make_runnable(target, false);
+	}
+	spinlock_release(wt->wt_lk);
+}
+
+/*
+ * Like wchan_sleep, but give up after TICKS hardclock ticks. Returns
+ * 0 if woken by wchan_wake*, or ETIMEDOUT if the time ran out first.
+ * As with wchan_sleep, the caller must recheck its condition either
+ * way.
+ */
+int
+wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk, unsigned ticks)
+{
+	struct wchan_timeout wt;
+	struct timer tm;
+
+	KASSERT(!curthread->t_in_interrupt);
+	KASSERT(spinlock_do_i_hold(lk));
+	KASSERT(curcpu->c_spinlocks == 1);
+
+	if (ticks == 0) {
+		return ETIMEDOUT;
+	}
+
+	wt.wt_thread = curthread;
+	wt.wt_wc = wc;
+	wt.wt_lk = lk;
+	wt.wt_expired = false;
+
+	/*
+	 * Start the timer while holding LK; the callback takes LK, so
+	 * it can't look for us before we're on the channel.
+	 */
+	timer_init(&tm, wchan_timeout, &wt);
+	timer_start(&tm, ticks);
+	tracepoint(TRACE_SLEEP, (uintptr_t)wc, ticks);
 	thread_switch(S_SLEEP, wc, lk);
+
+	/*
+	 * Stop the timer before relocking, since the callback may be
+	 * waiting for LK on another cpu. After this it's done with WT.
+	 */
+	timer_stop(&tm);
 	spinlock_acquire(lk);
+
+	return wt.wt_expired ? ETIMEDOUT : 0;
 }
 
 /*
@@ -1062,6 +1437,8 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 		/* Nobody was sleeping. */
 		return;
 	}
+	target->t_wchan = NULL;
+	tracepoint(TRACE_WAKE, (uintptr_t)wc, (uintptr_t)target);
 
 	/*
 	 * Note that thread_make_runnable acquires a runqueue lock
@@ -1092,6 +1469,8 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	 * private list.
 	 */
 	while ((target = threadlist_remhead(&wc->wc_threads)) != NULL) {
+		target->t_wchan = NULL;
+		tracepoint(TRACE_WAKE, (uintptr_t)wc, (uintptr_t)target);
 		threadlist_addtail(&list, target);
 	}
 
@@ -1107,6 +1486,65 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	threadlist_cleanup(&list);
 }
 
+/*
+ * Return the thread at the head of the channel, which is the one
+ * wchan_wakeone would take.
+ */
+struct thread *
+wchan_peek(struct wchan *wc, struct spinlock *lk)
+{
+	struct threadlistnode *tln;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	if (threadlist_isempty(&wc->wc_threads)) {
+		return NULL;
+	}
+	tln = wc->wc_threads.tl_head.tln_next;
+	return tln->tln_self;
+}
+
+/*
+ * Wake up thread T, which must be sleeping on WC.
+ */
+void
+wchan_wakethread(struct wchan *wc, struct spinlock *lk, struct thread *t)
+{
+	KASSERT(spinlock_do_i_hold(lk));
+	KASSERT(t->t_wchan == wc);
+
+	threadlist_remove(&wc->wc_threads, t);
+	t->t_wchan = NULL;
+	tracepoint(TRACE_WAKE, (uintptr_t)wc, (uintptr_t)t);
+	thread_make_runnable(t, false);
+}
+
+/*
+ * Move up to MAX threads sleeping on FROM onto TO. They were put to
+ * sleep with FROMLK, and will relock it when they wake, but from now
+ * on they are woken by whoever wakes TO.
+ */
+unsigned
+wchan_requeue(struct wchan *from, struct spinlock *fromlk,
+	      struct wchan *to, struct spinlock *tolk, unsigned max)
+{
+	struct thread *target;
+	unsigned count = 0;
+
+	KASSERT(spinlock_do_i_hold(fromlk));
+	KASSERT(spinlock_do_i_hold(tolk));
+
+	while (count < max &&
+	       (target = threadlist_remhead(&from->wc_threads)) != NULL) {
+		KASSERT(target->t_wchan == from);
+		target->t_wchan = to;
+		target->t_wchan_name = to->wc_name;
+		thread_listadd(&to->wc_threads, target);
+		count++;
+	}
+	return count;
+}
+
 /*
  * Return nonzero if there are no threads sleeping on the channel.
  * This is meant to be used only for diagnostic purposes.
@@ -1160,36 +1598,71 @@ ipi_broadcast(int code)
 }
 
 /*
- * Send a TLB shootdown IPI to the specified CPU.
+ * Queue N TLB shootdowns on the specified CPU and poke it.
+ *
+ * If the queue would overflow, collapse it to a full flush instead;
+ * flushing the whole TLB is always a correct (if blunt) substitute
+ * for any set of individual invalidations. Only send the IPI if none
+ * is already pending; the one in flight will pick up the new
+ * requests, since the handler drains the queue under the same lock.
  */
 void
-ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
+ipi_tlbshootdown_batch(struct cpu *target,
+		       const struct tlbshootdown *mappings, unsigned n)
 {
-	unsigned n;
+	unsigned i, num;
+	bool send;
 
 	spinlock_acquire(&target->c_ipi_lock);
 
-	n = target->c_numshootdown;
-	if (n == TLBSHOOTDOWN_MAX) {
-		/*
-		 * If you have problems with this panic going off,
-		 * consider: (1) increasing the maximum, (2) putting
-		 * logic here to sleep until space appears (may
-		 * interact awkwardly with VM system locking), (3)
-		 * putting logic here to coalesce requests together,
-		 * and/or (4) improving VM system state tracking to
-		 * reduce the number of unnecessary shootdowns.
-		 */
-		panic("ipi_tlbshootdown: Too many shootdowns queued\n");
+	num = target->c_numshootdown;
+	if (num == TLBSHOOTDOWN_ALL) {
+		/* Already flushing everything; nothing to add. */
+	}
+	else if (n > TLBSHOOTDOWN_MAX - num) {
+		target->c_numshootdown = TLBSHOOTDOWN_ALL;
+		counter_inc(&shootdown_overflow_counter);
 	}
 	else {
-		target->c_shootdown[n] = *mapping;
-		target->c_numshootdown = n+1;
+		for (i=0; i<n; i++) {
+			target->c_shootdown[num + i] = mappings[i];
+		}
+		target->c_numshootdown = num + n;
 	}
 
+	send = (target->c_ipi_pending == 0);
 	target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
-	mainbus_send_ipi(target);
+	if (send) {
+		mainbus_send_ipi(target);
+	}
+
+	spinlock_release(&target->c_ipi_lock);
+}
+
+/*
+ * Send a TLB shootdown IPI to the specified CPU.
+ */
+void
+ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
+{
+	ipi_tlbshootdown_batch(target, mapping, 1);
+}
+
+/*
+ * Ask the specified CPU to flush its entire TLB.
+ */
+void
+ipi_tlbshootdown_all(struct cpu *target)
+{
+	bool send;
 
+	spinlock_acquire(&target->c_ipi_lock);
+	target->c_numshootdown = TLBSHOOTDOWN_ALL;
+	send = (target->c_ipi_pending == 0);
+	target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
+	if (send) {
+		mainbus_send_ipi(target);
+	}
 	spinlock_release(&target->c_ipi_lock);
 }
 
@@ -1202,6 +1675,8 @@ interprocessor_interrupt(void)
 	uint32_t bits;
 	unsigned i;
 
+	counter_inc(&ipi_counter);
+
 	spinlock_acquire(&curcpu->c_ipi_lock);
 	bits = curcpu->c_ipi_pending;
 
@@ -1233,8 +1708,13 @@ interprocessor_interrupt(void)
 		 * need to release the ipi lock while calling
 		 * vm_tlbshootdown.
 		 */
-		for (i=0; i<curcpu->c_numshootdown; i++) {
-			vm_tlbshootdown(&curcpu->c_shootdown[i]);
+		if (curcpu->c_numshootdown == TLBSHOOTDOWN_ALL) {
+			vm_tlbshootdown_all();
+		}
+		else {
+			for (i=0; i<curcpu->c_numshootdown; i++) {
+				vm_tlbshootdown(&curcpu->c_shootdown[i]);
+			}
 		}
 		curcpu->c_numshootdown = 0;
 	}
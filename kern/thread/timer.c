@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Kernel timers. See timer.h.
+ *
+ * Each cpu has a two-level hierarchical timer wheel. The inner wheel
+ * has one slot per tick for the next WHEEL0_SIZE ticks, hashed by the
+ * low bits of the deadline; the outer wheel has one slot per
+ * WHEEL0_SIZE ticks beyond that. Starting and stopping a timer is
+ * constant time. Each tick, hardclock expires one inner slot, and
+ * every WHEEL0_SIZE ticks it cascades the next outer slot down into
+ * the inner wheel. Timers further out than the outer wheel reaches
+ * are parked in its last slot and re-sorted when it cascades.
+ *
+ * tw_now is the last tick processed. A wheel is driven by the global
+ * tick count (clock_getticks), not by its own cpu's hardclocks, so if
+ * a cpu falls behind it catches up on its next hardclock.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <clock.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <current.h>
+#include <timer.h>
+
+#define WHEEL0_BITS	8
+#define WHEEL0_SIZE	(1U << WHEEL0_BITS)	/* 2.56 seconds at HZ=100 */
+#define WHEEL0_MASK	(WHEEL0_SIZE - 1)
+#define WHEEL1_BITS	6
+#define WHEEL1_SIZE	(1U << WHEEL1_BITS)	/* about 2.7 minutes */
+#define WHEEL1_MASK	(WHEEL1_SIZE - 1)
+
+/* Furthest deadline the outer wheel can hold without aliasing */
+#define WHEEL_SPAN	((WHEEL1_SIZE - 1) << WHEEL0_BITS)
+
+struct timerwheel {
+	struct spinlock tw_lock;
+	unsigned tw_now;			/* last tick processed */
+	struct timer *volatile tw_running;	/* callback in progress */
+	struct timer *tw_wheel0[WHEEL0_SIZE];
+	struct timer *tw_wheel1[WHEEL1_SIZE];
+};
+
+/*
+ * Link TM onto the right slot of TW for its deadline.
+ */
+static
+void
+timer_link(struct timerwheel *tw, struct timer *tm)
+{
+	struct timer **slot;
+	unsigned expires, delta;
+
+	KASSERT(spinlock_do_i_hold(&tw->tw_lock));
+
+	expires = tm->tm_expires;
+	delta = expires - tw->tw_now;
+	if ((int)delta <= 0) {
+		/* Already due; fire on the next tick processed. */
+		slot = &tw->tw_wheel0[(tw->tw_now + 1) & WHEEL0_MASK];
+	}
+	else if (delta < WHEEL0_SIZE) {
+		slot = &tw->tw_wheel0[expires & WHEEL0_MASK];
+	}
+	else {
+		if (delta > WHEEL_SPAN) {
+			expires = tw->tw_now + WHEEL_SPAN;
+		}
+		slot = &tw->tw_wheel1[(expires >> WHEEL0_BITS) & WHEEL1_MASK];
+	}
+
+	tm->tm_next = *slot;
+	if (*slot != NULL) {
+		(*slot)->tm_prevp = &tm->tm_next;
+	}
+	tm->tm_prevp = slot;
+	*slot = tm;
+	tm->tm_pending = true;
+}
+
+static
+void
+timer_unlink(struct timer *tm)
+{
+	KASSERT(tm->tm_pending);
+
+	*tm->tm_prevp = tm->tm_next;
+	if (tm->tm_next != NULL) {
+		tm->tm_next->tm_prevp = tm->tm_prevp;
+	}
+	tm->tm_next = NULL;
+	tm->tm_prevp = NULL;
+	tm->tm_pending = false;
+}
+
+void
+timer_init(struct timer *tm, void (*func)(void *), void *data)
+{
+	tm->tm_next = NULL;
+	tm->tm_prevp = NULL;
+	tm->tm_wheel = NULL;
+	tm->tm_pending = false;
+	tm->tm_expires = 0;
+	tm->tm_func = func;
+	tm->tm_data = data;
+}
+
+void
+timer_start(struct timer *tm, unsigned ticks)
+{
+	struct timerwheel *tw;
+	int spl;
+
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	/* Take it off whatever wheel it's on now. */
+	timer_stop(tm);
+
+	/* Stay on this cpu until the timer is on its wheel. */
+	spl = splhigh();
+	tw = curcpu->c_timers;
+	spinlock_acquire(&tw->tw_lock);
+	tm->tm_wheel = tw;
+	tm->tm_expires = clock_getticks() + ticks;
+	timer_link(tw, tm);
+	spinlock_release(&tw->tw_lock);
+	splx(spl);
+}
+
+bool
+timer_stop(struct timer *tm)
+{
+	struct timerwheel *tw;
+	bool wasarmed;
+
+	tw = tm->tm_wheel;
+	if (tw == NULL) {
+		/* Never started */
+		return false;
+	}
+
+	spinlock_acquire(&tw->tw_lock);
+	wasarmed = tm->tm_pending;
+	if (wasarmed) {
+		timer_unlink(tm);
+	}
+	else if (tw != curcpu->c_timers) {
+		/*
+		 * If the callback is running on the wheel's cpu, wait
+		 * for it. (On our own cpu it can't be running unless
+		 * we're it, in which case we mustn't wait.)
+		 */
+		while (tw->tw_running == tm) {
+			spinlock_release(&tw->tw_lock);
+			while (tw->tw_running == tm) {
+				/* spin */
+			}
+			spinlock_acquire(&tw->tw_lock);
+		}
+	}
+	spinlock_release(&tw->tw_lock);
+	return wasarmed;
+}
+
+/*
+ * Move everything in outer slot SLOT down to where it now belongs.
+ */
+static
+void
+timer_cascade(struct timerwheel *tw, unsigned slot)
+{
+	struct timer *tm, *next;
+
+	tm = tw->tw_wheel1[slot];
+	tw->tw_wheel1[slot] = NULL;
+	while (tm != NULL) {
+		next = tm->tm_next;
+		timer_link(tw, tm);
+		tm = next;
+	}
+}
+
+/*
+ * Run the timers in the inner slot for tick tw_now. Each callback is
+ * called with the wheel unlocked, so it may restart its own timer or
+ * take locks that are held around timer_start.
+ */
+static
+void
+timer_expire(struct timerwheel *tw)
+{
+	struct timer **slot, *tm, *later;
+
+	slot = &tw->tw_wheel0[tw->tw_now & WHEEL0_MASK];
+	later = NULL;
+	while ((tm = *slot) != NULL) {
+		timer_unlink(tm);
+		if ((int)(tm->tm_expires - tw->tw_now) > 0) {
+			/* Hashed here but not due yet; put back after. */
+			tm->tm_next = later;
+			later = tm;
+			continue;
+		}
+
+		tw->tw_running = tm;
+		spinlock_release(&tw->tw_lock);
+		tm->tm_func(tm->tm_data);
+		spinlock_acquire(&tw->tw_lock);
+		tw->tw_running = NULL;
+	}
+	while (later != NULL) {
+		tm = later;
+		later = tm->tm_next;
+		timer_link(tw, tm);
+	}
+}
+
+/*
+ * Called from hardclock on every cpu.
+ */
+void
+timer_hardclock(void)
+{
+	struct timerwheel *tw = curcpu->c_timers;
+	unsigned now;
+
+	now = clock_getticks();
+	if (tw->tw_now == now) {
+		return;
+	}
+
+	spinlock_acquire(&tw->tw_lock);
+	while ((int)(now - tw->tw_now) > 0) {
+		tw->tw_now++;
+		if ((tw->tw_now & WHEEL0_MASK) == 0) {
+			timer_cascade(tw,
+			     (tw->tw_now >> WHEEL0_BITS) & WHEEL1_MASK);
+		}
+		timer_expire(tw);
+	}
+	spinlock_release(&tw->tw_lock);
+}
+
+void
+timer_cpuinit(struct cpu *c)
+{
+	struct timerwheel *tw;
+	unsigned i;
+
+	tw = kmalloc(sizeof(*tw));
+	if (tw == NULL) {
+		panic("timer_cpuinit: Out of memory\n");
+	}
+	spinlock_init(&tw->tw_lock);
+	tw->tw_now = clock_getticks();
+	tw->tw_running = NULL;
+	for (i=0; i<WHEEL0_SIZE; i++) {
+		tw->tw_wheel0[i] = NULL;
+	}
+	for (i=0; i<WHEEL1_SIZE; i++) {
+		tw->tw_wheel1[i] = NULL;
+	}
+	c->c_timers = tw;
+}
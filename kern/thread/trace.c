@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * In-kernel event tracing. See trace.h.
+ */
+
+#define TRACE_INLINE	/* empty */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <spl.h>
+#include <current.h>
+#include <membar.h>
+#include <uio.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <trace.h>
+
+#define TRACE_MAXCPUS	32
+
+/* Records per cpu. Keep it a power of 2 so the index math is cheap. */
+#define TRACE_NRECORDS	1024
+
+/*
+ * A cpu's ring. tr_head counts every record ever written, so the
+ * live ones are the last TRACE_NRECORDS (or fewer) before it.
+ */
+struct trace_ring {
+	struct trace_record *tr_records;
+	unsigned tr_head;
+};
+
+static struct trace_ring trace_rings[TRACE_MAXCPUS];
+volatile bool trace_enabled;
+
+static const char *const trace_names[TRACE_NEVENTS] = {
+	[TRACE_SWITCH] = "switch",
+	[TRACE_SLEEP] = "sleep",
+	[TRACE_WAKE] = "wake",
+	[TRACE_SYSCALL] = "syscall",
+	[TRACE_SYSRET] = "sysret",
+	[TRACE_VMFAULT] = "vmfault",
+	[TRACE_DISKIO] = "diskio",
+	[TRACE_DISKDONE] = "diskdone",
+	[TRACE_KMALLOC] = "kmalloc",
+};
+
+void
+trace_record(unsigned event, uint32_t arg0, uint32_t arg1)
+{
+	struct trace_ring *ring;
+	struct trace_record *rec;
+	struct timespec ts;
+	unsigned num;
+	int spl;
+
+	if (!CURCPU_EXISTS()) {
+		return;
+	}
+
+	/* Interrupts off, so curcpu holds still and nothing nests. */
+	spl = splhigh();
+
+	num = curcpu->c_number;
+	ring = num < TRACE_MAXCPUS ? &trace_rings[num] : NULL;
+	if (ring == NULL || ring->tr_records == NULL) {
+		/* This cpu came up after trace_start. */
+		splx(spl);
+		return;
+	}
+
+	rec = &ring->tr_records[ring->tr_head % TRACE_NRECORDS];
+	ring->tr_head++;
+
+	gettime(&ts);
+	rec->tr_sec = ts.tv_sec;
+	rec->tr_nsec = ts.tv_nsec;
+	rec->tr_event = event;
+	rec->tr_cpu = num;
+	rec->tr_thread = (uint32_t)(uintptr_t)curthread;
+	rec->tr_arg0 = arg0;
+	rec->tr_arg1 = arg1;
+
+	splx(spl);
+}
+
+////////////////////////////////////////////////////////////
+// control
+
+int
+trace_start(void)
+{
+	struct trace_record *records;
+	unsigned i;
+
+	for (i=0; i<num_cpus && i<TRACE_MAXCPUS; i++) {
+		if (trace_rings[i].tr_records != NULL) {
+			continue;
+		}
+		records = kmalloc(TRACE_NRECORDS * sizeof(*records));
+		if (records == NULL) {
+			return ENOMEM;
+		}
+		trace_rings[i].tr_records = records;
+	}
+
+	/* Make sure the rings are there before anyone records. */
+	membar_store_store();
+	trace_enabled = true;
+	return 0;
+}
+
+void
+trace_stop(void)
+{
+	trace_enabled = false;
+}
+
+void
+trace_reset(void)
+{
+	unsigned i;
+
+	for (i=0; i<TRACE_MAXCPUS; i++) {
+		trace_rings[i].tr_head = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// reading
+
+/*
+ * Index (in tr_head terms) of the oldest record still in RING.
+ */
+static
+unsigned
+trace_oldest(const struct trace_ring *ring)
+{
+	if (ring->tr_records == NULL || ring->tr_head < TRACE_NRECORDS) {
+		return 0;
+	}
+	return ring->tr_head - TRACE_NRECORDS;
+}
+
+static
+bool
+trace_before(const struct trace_record *a, const struct trace_record *b)
+{
+	if (a->tr_sec != b->tr_sec) {
+		return a->tr_sec < b->tr_sec;
+	}
+	return a->tr_nsec < b->tr_nsec;
+}
+
+/*
+ * Both readers turn recording off while they look, so the rings
+ * hold still. (A tracepoint already past the flag check on another
+ * cpu can still land one record; that can garble at most the oldest
+ * record in that ring.)
+ */
+void
+trace_dump(unsigned num)
+{
+	unsigned cur[TRACE_MAXCPUS];
+	struct trace_ring *ring;
+	struct trace_record *rec, *best;
+	struct timespec start, ts, diff;
+	unsigned i, bestcpu, total, skip;
+	const char *name;
+	bool was, first;
+
+	was = trace_enabled;
+	trace_enabled = false;
+
+	total = 0;
+	for (i=0; i<TRACE_MAXCPUS; i++) {
+		cur[i] = trace_oldest(&trace_rings[i]);
+		total += trace_rings[i].tr_head - cur[i];
+	}
+	skip = total > num ? total - num : 0;
+	kprintf("trace: %u records, showing %u\n", total, total - skip);
+
+	/* Merge the rings in time order. */
+	first = true;
+	start.tv_sec = 0;
+	start.tv_nsec = 0;
+	while (1) {
+		best = NULL;
+		bestcpu = 0;
+		for (i=0; i<TRACE_MAXCPUS; i++) {
+			ring = &trace_rings[i];
+			if (ring->tr_records == NULL || cur[i] == ring->tr_head) {
+				continue;
+			}
+			rec = &ring->tr_records[cur[i] % TRACE_NRECORDS];
+			if (best == NULL || trace_before(rec, best)) {
+				best = rec;
+				bestcpu = i;
+			}
+		}
+		if (best == NULL) {
+			break;
+		}
+		cur[bestcpu]++;
+		if (skip > 0) {
+			skip--;
+			continue;
+		}
+
+		ts.tv_sec = best->tr_sec;
+		ts.tv_nsec = best->tr_nsec;
+		if (first) {
+			start = ts;
+			first = false;
+		}
+		timespec_sub(&ts, &start, &diff);
+
+		name = best->tr_event < TRACE_NEVENTS ?
+			trace_names[best->tr_event] : NULL;
+		kprintf("%4llu.%06lu cpu%u %08x %-8s %08x %08x\n",
+			(unsigned long long)diff.tv_sec,
+			(unsigned long)(diff.tv_nsec / 1000),
+			best->tr_cpu, best->tr_thread,
+			name != NULL ? name : "?",
+			best->tr_arg0, best->tr_arg1);
+	}
+
+	trace_enabled = was;
+}
+
+unsigned
+trace_count(unsigned event)
+{
+	struct trace_ring *ring;
+	unsigned i, j, count;
+
+	count = 0;
+	for (i=0; i<TRACE_MAXCPUS; i++) {
+		ring = &trace_rings[i];
+		for (j=trace_oldest(ring); j<ring->tr_head; j++) {
+			if (ring->tr_records[j % TRACE_NRECORDS].tr_event ==
+			    event) {
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/*
+ * Write LEN bytes from BUF at *OFFSET in V, advancing *OFFSET.
+ */
+static
+int
+trace_write(struct vnode *v, off_t *offset, const void *buf, size_t len)
+{
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, (void *)buf, len, *offset, UIO_WRITE);
+	result = VOP_WRITE(v, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid != 0) {
+		return ENOSPC;
+	}
+	*offset = ku.uio_offset;
+	return 0;
+}
+
+int
+trace_save(const char *path)
+{
+	struct trace_header th;
+	struct trace_ring *ring;
+	struct vnode *v;
+	unsigned i, oldest, from, to;
+	off_t offset;
+	char *pathcopy;
+	bool was;
+	int result;
+
+	pathcopy = kstrdup(path);
+	if (pathcopy == NULL) {
+		return ENOMEM;
+	}
+	/* vfs_open destroys the string it's passed. */
+	result = vfs_open(pathcopy, O_WRONLY|O_CREAT|O_TRUNC, 0664, &v);
+	kfree(pathcopy);
+	if (result) {
+		return result;
+	}
+
+	was = trace_enabled;
+	trace_enabled = false;
+
+	th.th_magic = TRACE_MAGIC;
+	th.th_ncpus = num_cpus;
+	th.th_nrecords = 0;
+	th.th_dropped = 0;
+	for (i=0; i<TRACE_MAXCPUS; i++) {
+		oldest = trace_oldest(&trace_rings[i]);
+		th.th_nrecords += trace_rings[i].tr_head - oldest;
+		th.th_dropped += oldest;
+	}
+
+	offset = 0;
+	result = trace_write(v, &offset, &th, sizeof(th));
+
+	/* Each ring is oldest..end of array, then start of array..head. */
+	for (i=0; i<TRACE_MAXCPUS && !result; i++) {
+		ring = &trace_rings[i];
+		oldest = trace_oldest(ring);
+		if (oldest == ring->tr_head) {
+			continue;
+		}
+		from = oldest % TRACE_NRECORDS;
+		to = ring->tr_head % TRACE_NRECORDS;
+		if (from >= to) {
+			result = trace_write(v, &offset, &ring->tr_records[from],
+				(TRACE_NRECORDS - from) * sizeof(struct trace_record));
+			from = 0;
+		}
+		if (!result && from < to) {
+			result = trace_write(v, &offset, &ring->tr_records[from],
+				(to - from) * sizeof(struct trace_record));
+		}
+	}
+
+	trace_enabled = was;
+	vfs_close(v);
+	return result;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Deferred work. See workqueue.h.
+ *
+ * Each cpu has a FIFO of pending work and WORKQ_NTHREADS worker
+ * threads, bound to that cpu, that sleep on wq_wchan until something
+ * is queued. Items get a sequence number from their queue as they
+ * are added; work_flush snapshots the next number on every queue and
+ * waits until nothing older than that is queued or running.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <counter.h>
+#include <workqueue.h>
+
+#define WORKQ_MAXCPUS	32
+#define WORKQ_NTHREADS	2	/* workers per cpu */
+
+struct workqueue {
+	struct spinlock wq_lock;
+	struct work *wq_head;		/* next to run */
+	struct work **wq_tailp;		/* where to link the next one */
+	unsigned wq_nextseq;		/* seq for the next item queued */
+	bool wq_busy[WORKQ_NTHREADS];	/* worker is running an item */
+	unsigned wq_running[WORKQ_NTHREADS]; /* ...with this seq */
+	unsigned wq_nflushers;		/* threads in work_flush */
+	struct wchan *wq_wchan;		/* idle workers sleep here */
+	struct wchan *wq_flushwchan;	/* work_flush sleeps here */
+	struct cpu *wq_cpu;
+};
+
+/* Indexed by c_number; cpus past the end share cpu 0's queue. */
+static struct workqueue *workqueues[WORKQ_MAXCPUS];
+
+static struct counter work_counter = COUNTER_INITIALIZER("work_items");
+
+/*
+ * The queue for the current cpu.
+ */
+static
+struct workqueue *
+workqueue_mine(void)
+{
+	unsigned num;
+
+	num = curcpu->c_number;
+	if (num >= WORKQ_MAXCPUS || workqueues[num] == NULL) {
+		num = 0;
+	}
+	return workqueues[num];
+}
+
+/*
+ * Append WK, which the caller has already marked pending, to WQ and
+ * wake a worker.
+ */
+static
+void
+workqueue_add(struct workqueue *wq, struct work *wk)
+{
+	KASSERT(wq != NULL);
+
+	spinlock_acquire(&wq->wq_lock);
+	wk->wk_next = NULL;
+	wk->wk_seq = wq->wq_nextseq++;
+	*wq->wq_tailp = wk;
+	wq->wq_tailp = &wk->wk_next;
+	wchan_wakeone(wq->wq_wchan, &wq->wq_lock);
+	spinlock_release(&wq->wq_lock);
+}
+
+/*
+ * Timer callback for work_queue_delayed. Runs in hardclock on the
+ * cpu that started the timer, so the work lands on that cpu too.
+ */
+static
+void
+work_timeout(void *data)
+{
+	struct work *wk = data;
+
+	workqueue_add(workqueue_mine(), wk);
+}
+
+void
+work_init(struct work *wk, void (*func)(void *), void *data)
+{
+	wk->wk_next = NULL;
+	spinlock_data_set(&wk->wk_pending, 0);
+	wk->wk_seq = 0;
+	timer_init(&wk->wk_timer, work_timeout, wk);
+	wk->wk_func = func;
+	wk->wk_data = data;
+}
+
+/*
+ * Mark WK pending; false if it already was. Not testandset: that
+ * returns nonzero when the SC fails spuriously, which would drop the
+ * work on the floor.
+ */
+static
+bool
+work_claim(struct work *wk)
+{
+	while (!spinlock_data_cas(&wk->wk_pending, 0, 1)) {
+		if (spinlock_data_get(&wk->wk_pending) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+work_queue(struct work *wk)
+{
+	if (!work_claim(wk)) {
+		return false;
+	}
+	workqueue_add(workqueue_mine(), wk);
+	return true;
+}
+
+bool
+work_queue_delayed(struct work *wk, unsigned ticks)
+{
+	KASSERT(ticks > 0);
+
+	if (!work_claim(wk)) {
+		return false;
+	}
+	timer_start(&wk->wk_timer, ticks);
+	return true;
+}
+
+bool
+work_cancel(struct work *wk)
+{
+	if (!timer_stop(&wk->wk_timer)) {
+		return false;
+	}
+	spinlock_data_set(&wk->wk_pending, 0);
+	return true;
+}
+
+/*
+ * Check whether everything queued on WQ before SEQ has finished.
+ * Sequence numbers wrap, so compare by difference.
+ */
+static
+bool
+workqueue_doneupto(struct workqueue *wq, unsigned seq)
+{
+	unsigned i;
+
+	KASSERT(spinlock_do_i_hold(&wq->wq_lock));
+
+	if (wq->wq_head != NULL && (int)(wq->wq_head->wk_seq - seq) < 0) {
+		return false;
+	}
+	for (i=0; i<WORKQ_NTHREADS; i++) {
+		if (wq->wq_busy[i] && (int)(wq->wq_running[i] - seq) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+work_flush(void)
+{
+	unsigned seqs[WORKQ_MAXCPUS];
+	struct workqueue *wq;
+	unsigned i;
+
+	KASSERT(!curthread->t_in_interrupt);
+
+	/* Take all the snapshots first so later work can't hold us up. */
+	for (i=0; i<WORKQ_MAXCPUS; i++) {
+		wq = workqueues[i];
+		if (wq == NULL) {
+			continue;
+		}
+		spinlock_acquire(&wq->wq_lock);
+		seqs[i] = wq->wq_nextseq;
+		spinlock_release(&wq->wq_lock);
+	}
+
+	for (i=0; i<WORKQ_MAXCPUS; i++) {
+		wq = workqueues[i];
+		if (wq == NULL) {
+			continue;
+		}
+		spinlock_acquire(&wq->wq_lock);
+		wq->wq_nflushers++;
+		while (!workqueue_doneupto(wq, seqs[i])) {
+			wchan_sleep(wq->wq_flushwchan, &wq->wq_lock);
+		}
+		wq->wq_nflushers--;
+		spinlock_release(&wq->wq_lock);
+	}
+}
+
+/*
+ * Worker thread. NUM is its index among its cpu's workers.
+ */
+static
+void
+workqueue_thread(void *data, unsigned long num)
+{
+	struct workqueue *wq = data;
+	struct work *wk;
+	void (*func)(void *);
+	void *arg;
+
+	KASSERT(num < WORKQ_NTHREADS);
+
+	spinlock_acquire(&wq->wq_lock);
+	while (1) {
+		while (wq->wq_head == NULL) {
+			wchan_sleep(wq->wq_wchan, &wq->wq_lock);
+		}
+		wk = wq->wq_head;
+		wq->wq_head = wk->wk_next;
+		if (wq->wq_head == NULL) {
+			wq->wq_tailp = &wq->wq_head;
+		}
+		wq->wq_busy[num] = true;
+		wq->wq_running[num] = wk->wk_seq;
+
+		/*
+		 * Copy out what we need and clear pending before the
+		 * call, so the function can requeue or free the item.
+		 */
+		func = wk->wk_func;
+		arg = wk->wk_data;
+		spinlock_data_set(&wk->wk_pending, 0);
+		spinlock_release(&wq->wq_lock);
+
+		func(arg);
+		counter_inc(&work_counter);
+
+		spinlock_acquire(&wq->wq_lock);
+		wq->wq_busy[num] = false;
+		if (wq->wq_nflushers > 0) {
+			wchan_wakeall(wq->wq_flushwchan, &wq->wq_lock);
+		}
+	}
+}
+
+/*
+ * Set up the queue for cpu C. Called from cpu_create; the workers
+ * can't be started until the scheduler is up.
+ */
+void
+workqueue_cpuinit(struct cpu *c)
+{
+	struct workqueue *wq;
+	unsigned i;
+
+	if (c->c_number >= WORKQ_MAXCPUS) {
+		return;
+	}
+
+	wq = kmalloc(sizeof(*wq));
+	if (wq == NULL) {
+		panic("workqueue_cpuinit: Out of memory\n");
+	}
+	spinlock_init(&wq->wq_lock);
+	wq->wq_head = NULL;
+	wq->wq_tailp = &wq->wq_head;
+	wq->wq_nextseq = 0;
+	for (i=0; i<WORKQ_NTHREADS; i++) {
+		wq->wq_busy[i] = false;
+		wq->wq_running[i] = 0;
+	}
+	wq->wq_nflushers = 0;
+	wq->wq_wchan = wchan_create("workq");
+	wq->wq_flushwchan = wchan_create("workflush");
+	if (wq->wq_wchan == NULL || wq->wq_flushwchan == NULL) {
+		panic("workqueue_cpuinit: Out of memory\n");
+	}
+	wq->wq_cpu = c;
+	workqueues[c->c_number] = wq;
+}
+
+/*
+ * Start the workers. Work queued before this just waits.
+ */
+void
+workqueue_bootstrap(void)
+{
+	struct workqueue *wq;
+	char name[16];
+	unsigned i, j;
+	int result;
+
+	for (i=0; i<WORKQ_MAXCPUS; i++) {
+		wq = workqueues[i];
+		if (wq == NULL) {
+			continue;
+		}
+		for (j=0; j<WORKQ_NTHREADS; j++) {
+			snprintf(name, sizeof(name), "work%u.%u", i, j);
+			result = thread_fork_bound(name, NULL, wq->wq_cpu,
+						   workqueue_thread, wq, j);
+			if (result) {
+				panic("workqueue_bootstrap: thread_fork: %s\n",
+				      strerror(result));
+			}
+		}
+	}
+}
@@ -225,6 +225,22 @@ dev_isseekable(struct vnode *v)
 	return true;
 }
 
+/*
+ * Called for poll. Hand off to DEVOP_POLL if the device has one;
+ * otherwise the device never blocks and is always ready.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, struct pollset *ps)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_ops->devop_poll == NULL) {
+		return vnode_pollready(v, events, ps);
+	}
+	return DEVOP_POLL(d, events, ps);
+}
+
 /*
  * For fsync() - meaningless, do nothing.
  */
@@ -237,15 +253,16 @@ null_fsync(struct vnode *v)
 }
 
 /*
- * For mmap. If you want this to do anything, you have to write it
- * yourself. Some devices may not make sense to map. Others do.
+ * For mmap. Mappings are backed by the page cache, which reads and
+ * writes whole pages at file offsets; that doesn't make sense for
+ * the devices we have, so refuse.
  */
 static
 int
-dev_mmap(struct vnode *v  /* add stuff as needed */)
+dev_mmap(struct vnode *v)
 {
 	(void)v;
-	return ENOSYS;
+	return ENODEV;
 }
 
 /*
@@ -335,6 +352,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_stat = dev_stat,
 	.vop_gettype = dev_gettype,
 	.vop_isseekable = dev_isseekable,
+	.vop_poll = dev_poll,
 	.vop_fsync = null_fsync,
 	.vop_mmap = dev_mmap,
 	.vop_truncate = dev_truncate,
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Anonymous pipes.
+ *
+ * A pipe is a ring buffer plus two vnodes, one per end, that are
+ * embedded in the pipe structure. Each end is reclaimed separately
+ * when its last reference goes away; the pipe itself is freed when
+ * both ends are gone.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/poll.h>
+#include <limits.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <vnode.h>
+#include <poll.h>
+#include <pipe.h>
+
+/* Buffer size; must be at least PIPE_BUF so small writes are atomic. */
+#define PIPE_BUFSIZE	(2 * PIPE_BUF)
+
+struct pipe {
+	struct lock *pp_lock;		/* protects everything below */
+	struct cv *pp_readcv;		/* readers wait for data here */
+	struct cv *pp_writecv;		/* writers wait for space here */
+	char *pp_buf;			/* ring buffer, PIPE_BUFSIZE bytes */
+	unsigned pp_head;		/* next byte to read */
+	unsigned pp_count;		/* bytes in the buffer */
+	bool pp_readeropen;		/* read end still exists */
+	bool pp_writeropen;		/* write end still exists */
+	struct pollq pp_pollq;		/* pollers on either end */
+
+	struct vnode pp_readvn;
+	struct vnode pp_writevn;
+};
+
+static
+void
+pipe_destroy(struct pipe *pp)
+{
+	pollq_cleanup(&pp->pp_pollq);
+	cv_destroy(pp->pp_writecv);
+	cv_destroy(pp->pp_readcv);
+	lock_destroy(pp->pp_lock);
+	kfree(pp->pp_buf);
+	kfree(pp);
+}
+
+////////////////////////////////////////////////////////////
+// vnode ops
+
+static
+bool
+pipe_isreadend(struct vnode *v)
+{
+	struct pipe *pp = v->vn_data;
+
+	return v == &pp->pp_readvn;
+}
+
+/*
+ * Pipes are only created by pipe(), never opened by name.
+ */
+static
+int
+pipe_eachopen(struct vnode *v, int openflags)
+{
+	(void)v;
+	(void)openflags;
+	return EINVAL;
+}
+
+/*
+ * Called when the last reference to one end goes away. Wake up
+ * anyone waiting on the other end so they see EOF or EPIPE.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *pp = v->vn_data;
+	bool destroy;
+
+	lock_acquire(pp->pp_lock);
+	if (pipe_isreadend(v)) {
+		KASSERT(pp->pp_readeropen);
+		pp->pp_readeropen = false;
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+		pollq_wakeup(&pp->pp_pollq, POLLERR);
+	}
+	else {
+		KASSERT(pp->pp_writeropen);
+		pp->pp_writeropen = false;
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+		pollq_wakeup(&pp->pp_pollq, POLLHUP);
+	}
+	vnode_cleanup(v);
+	destroy = !pp->pp_readeropen && !pp->pp_writeropen;
+	lock_release(pp->pp_lock);
+
+	if (destroy) {
+		pipe_destroy(pp);
+	}
+	return 0;
+}
+
+/*
+ * Read. Wait until there's data or the write end is closed, then
+ * take as much as is available, up to the size of the request.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	size_t oldcount, len;
+	int result;
+
+	if (!pipe_isreadend(v)) {
+		return EBADF;
+	}
+
+	lock_acquire(pp->pp_lock);
+	while (pp->pp_count == 0 && pp->pp_writeropen) {
+		cv_wait(pp->pp_readcv, pp->pp_lock);
+	}
+
+	oldcount = pp->pp_count;
+	result = 0;
+	while (pp->pp_count > 0 && uio->uio_resid > 0) {
+		/* Copy out the contiguous piece at the head */
+		len = PIPE_BUFSIZE - pp->pp_head;
+		if (len > pp->pp_count) {
+			len = pp->pp_count;
+		}
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		result = uiomove(pp->pp_buf + pp->pp_head, len, uio);
+		if (result) {
+			break;
+		}
+		pp->pp_head = (pp->pp_head + len) % PIPE_BUFSIZE;
+		pp->pp_count -= len;
+	}
+
+	if (pp->pp_count < oldcount) {
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+	}
+	/* Pollers only care when the pipe turns writable (see pipe_poll) */
+	if (PIPE_BUFSIZE - oldcount < PIPE_BUF &&
+	    PIPE_BUFSIZE - pp->pp_count >= PIPE_BUF) {
+		pollq_wakeup(&pp->pp_pollq, POLLOUT);
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+/*
+ * Write. A write of PIPE_BUF bytes or less waits until it can go in
+ * all at once; larger writes go in as space becomes available.
+ */
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	size_t needed, space, tail, len;
+	bool wrote;
+	int result;
+
+	if (pipe_isreadend(v)) {
+		return EBADF;
+	}
+
+	needed = uio->uio_resid <= PIPE_BUF ? uio->uio_resid : 1;
+	wrote = false;
+	result = 0;
+
+	lock_acquire(pp->pp_lock);
+	while (uio->uio_resid > 0) {
+		if (!pp->pp_readeropen) {
+			/* Report a short write if we got anything in */
+			result = wrote ? 0 : EPIPE;
+			break;
+		}
+		space = PIPE_BUFSIZE - pp->pp_count;
+		if (space < needed) {
+			cv_wait(pp->pp_writecv, pp->pp_lock);
+			continue;
+		}
+
+		tail = (pp->pp_head + pp->pp_count) % PIPE_BUFSIZE;
+		len = PIPE_BUFSIZE - tail;
+		if (len > space) {
+			len = space;
+		}
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		result = uiomove(pp->pp_buf + tail, len, uio);
+		if (result) {
+			break;
+		}
+		pp->pp_count += len;
+		wrote = true;
+
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+		pollq_wakeup(&pp->pp_pollq, POLLIN);
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *pp = v->vn_data;
+
+	bzero(statbuf, sizeof(*statbuf));
+	statbuf->st_mode = S_IFIFO | 0600;
+	statbuf->st_nlink = 1;
+	statbuf->st_blksize = PIPE_BUF;
+
+	lock_acquire(pp->pp_lock);
+	statbuf->st_size = pp->pp_count;
+	lock_release(pp->pp_lock);
+
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *v)
+{
+	(void)v;
+	return false;
+}
+
+/*
+ * Poll. The read end is readable when there's data and hung up when
+ * the writer is gone; the write end is writable when a PIPE_BUF
+ * write wouldn't block, and in error when the reader is gone.
+ */
+static
+int
+pipe_poll(struct vnode *v, int events, struct pollset *ps)
+{
+	struct pipe *pp = v->vn_data;
+	int revents;
+
+	if (ps != NULL) {
+		pollq_register(&pp->pp_pollq, ps);
+	}
+
+	revents = 0;
+	lock_acquire(pp->pp_lock);
+	if (pipe_isreadend(v)) {
+		if (pp->pp_count > 0) {
+			revents |= POLLIN;
+		}
+		if (!pp->pp_writeropen) {
+			revents |= POLLHUP;
+		}
+	}
+	else {
+		if (PIPE_BUFSIZE - pp->pp_count >= PIPE_BUF) {
+			revents |= POLLOUT;
+		}
+		if (!pp->pp_readeropen) {
+			revents |= POLLERR;
+		}
+	}
+	lock_release(pp->pp_lock);
+
+	return revents & (events | POLLERR | POLLHUP);
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return EINVAL;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_poll = pipe_poll,
+	.vop_fsync = pipe_fsync,
+	.vop_mmap = vopfail_mmap_nosys,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_nosys,
+
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+// creation
+
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *pp;
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		goto fail_return;
+	}
+	pp->pp_buf = kmalloc(PIPE_BUFSIZE);
+	if (pp->pp_buf == NULL) {
+		goto fail_pipe;
+	}
+	pp->pp_lock = lock_create("pipe");
+	if (pp->pp_lock == NULL) {
+		goto fail_buf;
+	}
+	pp->pp_readcv = cv_create("pipe-read");
+	if (pp->pp_readcv == NULL) {
+		goto fail_lock;
+	}
+	pp->pp_writecv = cv_create("pipe-write");
+	if (pp->pp_writecv == NULL) {
+		goto fail_readcv;
+	}
+	pp->pp_head = 0;
+	pp->pp_count = 0;
+	pp->pp_readeropen = true;
+	pp->pp_writeropen = true;
+	pollq_init(&pp->pp_pollq);
+
+	/* vnode_init can't fail */
+	vnode_init(&pp->pp_readvn, &pipe_vnode_ops, NULL, pp);
+	vnode_init(&pp->pp_writevn, &pipe_vnode_ops, NULL, pp);
+
+	*readvn = &pp->pp_readvn;
+	*writevn = &pp->pp_writevn;
+	return 0;
+
+ fail_readcv:
+	cv_destroy(pp->pp_readcv);
+ fail_lock:
+	lock_destroy(pp->pp_lock);
+ fail_buf:
+	kfree(pp->pp_buf);
+ fail_pipe:
+	kfree(pp);
+ fail_return:
+	return ENOMEM;
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Readiness notification for poll() and select().
+ *
+ * A call to poll_kern builds a pollset with one pollent per file
+ * handle. On the first scan each object is asked for its state with
+ * VOP_POLL, which also links the pollent onto the object's pollq.
+ * If nothing is ready, the caller sleeps on the pollset's wchan.
+ *
+ * pollq_wakeup puts each matching pollent on its pollset's ready
+ * list before waking the poller, so on wakeup only the objects on the
+ * ready list are polled again. A wakeup is only a hint (another
+ * thread may have consumed the data first), so entries that turn out
+ * not to be ready stay registered and we go back to sleep.
+ *
+ * A timeout is a timer (see timer.h) that sets ps_timedout and wakes
+ * the poller.
+ *
+ * Lock ordering: pq_lock, then ps_lock.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <timer.h>
+#include <wchan.h>
+#include <current.h>
+#include <proc.h>
+#include <vnode.h>
+#include <file.h>
+#include <poll.h>
+
+/*
+ * One file handle in one pollset.
+ */
+struct pollent {
+	/* Linkage on the pollq; protected by pq_lock */
+	struct pollent *pe_next;
+	struct pollent *pe_prev;
+	struct pollq *pe_q;		/* pollq we're on, or NULL */
+
+	/* Ready list linkage; protected by ps_lock */
+	struct pollent *pe_readynext;
+	bool pe_queued;			/* on the ready list */
+
+	/* Private to the polling thread */
+	struct pollent *pe_scannext;
+	struct pollset *pe_set;
+	struct openfile *pe_file;	/* NULL if not polled */
+	int pe_events;			/* events requested */
+};
+
+/*
+ * State of one poll() call.
+ */
+struct pollset {
+	struct spinlock ps_lock;	/* protects the next three */
+	struct wchan *ps_wchan;		/* poller sleeps here */
+	struct pollent *ps_ready;	/* entries that were signaled */
+	bool ps_timedout;		/* deadline passed */
+
+	struct timer ps_timer;		/* sets ps_timedout */
+
+	struct pollent *ps_cur;		/* entry being registered */
+	unsigned ps_nents;
+	struct pollent *ps_ents;
+};
+
+////////////////////////////////////////////////////////////
+// pollq
+
+void
+pollq_init(struct pollq *pq)
+{
+	spinlock_init(&pq->pq_lock);
+	pq->pq_head = NULL;
+}
+
+void
+pollq_cleanup(struct pollq *pq)
+{
+	KASSERT(pq->pq_head == NULL);
+	spinlock_cleanup(&pq->pq_lock);
+}
+
+/*
+ * Register the pollset's current entry on PQ. Called from VOP_POLL.
+ * Registering the same entry on the same pollq again is a no-op.
+ */
+void
+pollq_register(struct pollq *pq, struct pollset *ps)
+{
+	struct pollent *pe;
+
+	pe = ps->ps_cur;
+	KASSERT(pe != NULL);
+
+	spinlock_acquire(&pq->pq_lock);
+	if (pe->pe_q == pq) {
+		spinlock_release(&pq->pq_lock);
+		return;
+	}
+	KASSERT(pe->pe_q == NULL);
+	pe->pe_q = pq;
+	pe->pe_prev = NULL;
+	pe->pe_next = pq->pq_head;
+	if (pq->pq_head != NULL) {
+		pq->pq_head->pe_prev = pe;
+	}
+	pq->pq_head = pe;
+	spinlock_release(&pq->pq_lock);
+}
+
+/*
+ * Take an entry back off its pollq.
+ */
+static
+void
+pollq_unregister(struct pollent *pe)
+{
+	struct pollq *pq = pe->pe_q;
+
+	spinlock_acquire(&pq->pq_lock);
+	if (pe->pe_prev != NULL) {
+		pe->pe_prev->pe_next = pe->pe_next;
+	}
+	else {
+		KASSERT(pq->pq_head == pe);
+		pq->pq_head = pe->pe_next;
+	}
+	if (pe->pe_next != NULL) {
+		pe->pe_next->pe_prev = pe->pe_prev;
+	}
+	spinlock_release(&pq->pq_lock);
+
+	pe->pe_next = pe->pe_prev = NULL;
+	pe->pe_q = NULL;
+}
+
+/*
+ * Report that EVENTS may now be true of the object that owns PQ.
+ * Errors and hangups are always of interest, whether requested or not.
+ */
+void
+pollq_wakeup(struct pollq *pq, int events)
+{
+	struct pollent *pe;
+	struct pollset *ps;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pe = pq->pq_head; pe != NULL; pe = pe->pe_next) {
+		if (((pe->pe_events | POLLERR | POLLHUP) & events) == 0) {
+			continue;
+		}
+		ps = pe->pe_set;
+		spinlock_acquire(&ps->ps_lock);
+		if (!pe->pe_queued) {
+			pe->pe_queued = true;
+			pe->pe_readynext = ps->ps_ready;
+			ps->ps_ready = pe;
+			wchan_wakeone(ps->ps_wchan, &ps->ps_lock);
+		}
+		spinlock_release(&ps->ps_lock);
+	}
+	spinlock_release(&pq->pq_lock);
+}
+
+////////////////////////////////////////////////////////////
+// timeouts
+
+/*
+ * Timer callback: the deadline passed.
+ */
+static
+void
+poll_timeout(void *data)
+{
+	struct pollset *ps = data;
+
+	spinlock_acquire(&ps->ps_lock);
+	ps->ps_timedout = true;
+	wchan_wakeone(ps->ps_wchan, &ps->ps_lock);
+	spinlock_release(&ps->ps_lock);
+}
+
+////////////////////////////////////////////////////////////
+// poll
+
+/*
+ * Poll one entry; return the revents bits for it.
+ */
+static
+int
+pollent_check(struct pollent *pe, struct pollset *ps)
+{
+	int revents;
+
+	revents = VOP_POLL(pe->pe_file->of_vnode, pe->pe_events, ps);
+	return revents & (pe->pe_events | POLLERR | POLLHUP);
+}
+
+/*
+ * Sleep until something is signaled or the timeout expires. Returns
+ * the list (via pe_scannext) of signaled entries, and sets *TIMEDOUT.
+ */
+static
+struct pollent *
+pollset_wait(struct pollset *ps, bool *timedout)
+{
+	struct pollent *pe, *scan;
+
+	spinlock_acquire(&ps->ps_lock);
+	while (ps->ps_ready == NULL && !ps->ps_timedout) {
+		wchan_sleep(ps->ps_wchan, &ps->ps_lock);
+	}
+
+	/*
+	 * Detach the ready list. Once pe_queued is cleared the entry
+	 * can be requeued, which overwrites pe_readynext, so build
+	 * the scan list in a separate field.
+	 */
+	scan = NULL;
+	while (ps->ps_ready != NULL) {
+		pe = ps->ps_ready;
+		ps->ps_ready = pe->pe_readynext;
+		pe->pe_readynext = NULL;
+		pe->pe_queued = false;
+		pe->pe_scannext = scan;
+		scan = pe;
+	}
+	*timedout = ps->ps_timedout;
+	spinlock_release(&ps->ps_lock);
+
+	return scan;
+}
+
+static
+void
+pollset_destroy(struct pollset *ps)
+{
+	struct pollent *pe;
+	unsigned i;
+
+	timer_stop(&ps->ps_timer);
+
+	for (i=0; i<ps->ps_nents; i++) {
+		pe = &ps->ps_ents[i];
+		if (pe->pe_q != NULL) {
+			pollq_unregister(pe);
+		}
+		if (pe->pe_file != NULL) {
+			openfile_decref(pe->pe_file);
+		}
+	}
+
+	/*
+	 * Now nobody else can find the pollset; it's safe to free.
+	 */
+	wchan_destroy(ps->ps_wchan);
+	spinlock_cleanup(&ps->ps_lock);
+	kfree(ps->ps_ents);
+	kfree(ps);
+}
+
+static
+struct pollset *
+pollset_create(unsigned nents)
+{
+	struct pollset *ps;
+	unsigned i;
+
+	ps = kmalloc(sizeof(*ps));
+	if (ps == NULL) {
+		return NULL;
+	}
+	ps->ps_ents = NULL;
+	if (nents > 0) {
+		ps->ps_ents = kmalloc(nents * sizeof(ps->ps_ents[0]));
+		if (ps->ps_ents == NULL) {
+			kfree(ps);
+			return NULL;
+		}
+	}
+	ps->ps_wchan = wchan_create("poll");
+	if (ps->ps_wchan == NULL) {
+		kfree(ps->ps_ents);
+		kfree(ps);
+		return NULL;
+	}
+	spinlock_init(&ps->ps_lock);
+	ps->ps_ready = NULL;
+	ps->ps_timedout = false;
+	timer_init(&ps->ps_timer, poll_timeout, ps);
+	ps->ps_cur = NULL;
+	ps->ps_nents = nents;
+
+	for (i=0; i<nents; i++) {
+		ps->ps_ents[i].pe_next = NULL;
+		ps->ps_ents[i].pe_prev = NULL;
+		ps->ps_ents[i].pe_q = NULL;
+		ps->ps_ents[i].pe_readynext = NULL;
+		ps->ps_ents[i].pe_queued = false;
+		ps->ps_ents[i].pe_scannext = NULL;
+		ps->ps_ents[i].pe_set = ps;
+		ps->ps_ents[i].pe_file = NULL;
+		ps->ps_ents[i].pe_events = 0;
+	}
+	return ps;
+}
+
+int
+poll_kern(struct pollfd *fds, unsigned nfds, int timeout_ms, unsigned *nready)
+{
+	struct filetable *ft = curproc->p_filetable;
+	struct pollset *ps;
+	struct pollent *pe;
+	unsigned i, count;
+	bool timedout;
+	int result;
+
+	KASSERT(ft != NULL);
+
+	ps = pollset_create(nfds);
+	if (ps == NULL) {
+		return ENOMEM;
+	}
+
+	/*
+	 * First pass: check everything, registering as we go. Once
+	 * something is ready we won't sleep, so stop registering.
+	 */
+	count = 0;
+	for (i=0; i<nfds; i++) {
+		pe = &ps->ps_ents[i];
+		fds[i].revents = 0;
+		if (fds[i].fd < 0) {
+			continue;
+		}
+		result = filetable_get(ft, fds[i].fd, &pe->pe_file);
+		if (result) {
+			fds[i].revents = POLLNVAL;
+			count++;
+			continue;
+		}
+		pe->pe_events = fds[i].events;
+		ps->ps_cur = pe;
+		fds[i].revents = pollent_check(pe,
+				(count == 0 && timeout_ms != 0) ? ps : NULL);
+		ps->ps_cur = NULL;
+		if (fds[i].revents != 0) {
+			count++;
+		}
+	}
+
+	if (count == 0 && timeout_ms > 0) {
+		timer_start(&ps->ps_timer, TIMER_MSTOTICKS(timeout_ms));
+	}
+
+	/*
+	 * Sleep until something we're registered on says it's ready,
+	 * and recheck only those things.
+	 */
+	while (count == 0 && timeout_ms != 0) {
+		pe = pollset_wait(ps, &timedout);
+		for (; pe != NULL; pe = pe->pe_scannext) {
+			i = pe - ps->ps_ents;
+			KASSERT(fds[i].revents == 0);
+			fds[i].revents = pollent_check(pe, NULL);
+			if (fds[i].revents != 0) {
+				count++;
+			}
+		}
+		if (timedout) {
+			break;
+		}
+	}
+
+	pollset_destroy(ps);
+	*nready = count;
+	return 0;
+}
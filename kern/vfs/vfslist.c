@@ -39,6 +39,7 @@
 #include <lib.h>
 #include <array.h>
 #include <synch.h>
+#include <rcu.h>
 #include <vfs.h>
 #include <fs.h>
 #include <vnode.h>
@@ -88,6 +89,12 @@ struct knowndev {
 DECLARRAY(knowndev, static __UNUSED inline);
 DEFARRAY(knowndev, static __UNUSED inline);
 
+/*
+ * Everything that changes knowndevs or a kd_fs holds vfs_biglock,
+ * and so do most readers. vfs_getdevname instead reads them under
+ * RCU, so the array is never changed in place: adding a device
+ * publishes a new copy and frees the old one after a grace period.
+ */
 static struct knowndevarray *knowndevs;
 
 /* The big lock for all FS ops. Remove for filesystem assignment. */
@@ -166,6 +173,59 @@ vfs_biglock_do_i_hold(void)
 	return lock_do_i_hold(vfs_biglock);
 }
 
+/*
+ * Change the filesystem attached to a known device.
+ */
+static
+void
+knowndev_setfs(struct knowndev *kd, struct fs *fs)
+{
+	KASSERT(vfs_biglock_do_i_hold());
+
+	rcu_assign_pointer(kd->kd_fs, fs);
+}
+
+/*
+ * Add a known device by publishing a copy of knowndevs with it on
+ * the end.
+ */
+static
+int
+knowndevs_add(struct knowndev *kd, unsigned *index_ret)
+{
+	struct knowndevarray *old, *new;
+	unsigned i, num;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	old = knowndevs;
+	num = knowndevarray_num(old);
+
+	new = knowndevarray_create();
+	if (new == NULL) {
+		return ENOMEM;
+	}
+	result = knowndevarray_setsize(new, num + 1);
+	if (result) {
+		knowndevarray_destroy(new);
+		return result;
+	}
+	for (i=0; i<num; i++) {
+		knowndevarray_set(new, i, knowndevarray_get(old, i));
+	}
+	knowndevarray_set(new, num, kd);
+
+	rcu_assign_pointer(knowndevs, new);
+	rcu_synchronize();
+
+	knowndevarray_setsize(old, 0);
+	knowndevarray_destroy(old);
+
+	*index_ret = num;
+	return 0;
+}
+
 /*
  * Global sync function - call FSOP_SYNC on all devices.
  */
@@ -276,27 +336,30 @@ vfs_getroot(const char *devname, struct vnode **ret)
 const char *
 vfs_getdevname(struct fs *fs)
 {
+	struct knowndevarray *devs;
 	struct knowndev *kd;
 	unsigned i, num;
 
 	KASSERT(fs != NULL);
 
-	KASSERT(vfs_biglock_do_i_hold());
-
-	num = knowndevarray_num(knowndevs);
+	rcu_read_lock();
+	devs = rcu_dereference(knowndevs);
+	num = knowndevarray_num(devs);
 	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
+		kd = knowndevarray_get(devs, i);
 
-		if (kd->kd_fs == fs) {
+		if (rcu_dereference(kd->kd_fs) == fs) {
 			/*
 			 * This is not a race condition: as long as the
 			 * guy calling us holds a reference to the fs,
 			 * the fs cannot go away, and the device can't
 			 * go away until the fs goes away.
 			 */
+			rcu_read_unlock();
 			return kd->kd_name;
 		}
 	}
+	rcu_read_unlock();
 
 	return NULL;
 }
@@ -443,7 +506,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		goto fail;
 	}
 
-	result = knowndevarray_add(knowndevs, kd, &index);
+	result = knowndevs_add(kd, &index);
 	if (result) {
 		goto fail;
 	}
@@ -567,7 +630,7 @@ vfs_mount(const char *devname, void *data,
 	KASSERT(fs != NULL);
 	KASSERT(fs != SWAP_FS); 
 
-	kd->kd_fs = fs;
+	knowndev_setfs(kd, fs);
 
 	volname = FSOP_GETVOLNAME(fs);
 	kprintf("vfs: Mounted %s: on %s\n",
@@ -617,7 +680,7 @@ vfs_swapon(const char *devname, struct vnode **ret)
 
 	kprintf("vfs: Swap attached to %s\n", kd->kd_name);
 
-	kd->kd_fs = SWAP_FS;
+	knowndev_setfs(kd, SWAP_FS);
 	VOP_INCREF(kd->kd_vnode);
 	*ret = kd->kd_vnode;
 
@@ -668,7 +731,7 @@ vfs_unmount(const char *devname)
 	kprintf("vfs: Unmounted %s:\n", kd->kd_name);
 
 	/* now drop the filesystem */
-	kd->kd_fs = NULL;
+	knowndev_setfs(kd, NULL);
 
 	KASSERT(result==0);
 
@@ -705,7 +768,7 @@ vfs_swapoff(const char *devname)
 	kprintf("vfs: Swap detached from %s:\n", kd->kd_name);
 
 	/* drop it */
-	kd->kd_fs = NULL;
+	knowndev_setfs(kd, NULL);
 
 	KASSERT(result==0);
 
@@ -739,7 +802,7 @@ vfs_unmountall(void)
 		}
 		if (dev->kd_fs == SWAP_FS) {
 			/* just drop it */
-			dev->kd_fs = NULL;
+			knowndev_setfs(dev, NULL);
 			continue;
 		}
 
@@ -777,7 +840,7 @@ vfs_unmountall(void)
 		}
 
 		/* now drop the filesystem */
-		dev->kd_fs = NULL;
+		knowndev_setfs(dev, NULL);
 	}
 
 	vfs_biglock_release();
@@ -180,3 +180,65 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+
+/*
+ * mmap support. The bookkeeping in mmap.c and the page cache can be
+ * reused; what's needed here is choosing where mappings go and
+ * calling mmap_fault from vm_fault. See dumbvm.c for an example.
+ */
+int
+as_mmap(struct addrspace *as, size_t len, int prot, int flags,
+	struct vnode *vn, off_t offset, vaddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)len;
+	(void)prot;
+	(void)flags;
+	(void)vn;
+	(void)offset;
+	(void)ret;
+	return ENOSYS;
+}
+
+int
+as_munmap(struct addrspace *as, vaddr_t addr, size_t len)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)addr;
+	(void)len;
+	return ENOSYS;
+}
+
+int
+as_msync(struct addrspace *as, vaddr_t addr, size_t len)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)addr;
+	(void)len;
+	return ENOSYS;
+}
+
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)ret;
+	return ENOSYS;
+}
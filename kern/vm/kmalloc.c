@@ -33,11 +33,14 @@
 #include <vm.h>
 #include <kern/test161.h>
 #include <test.h>
+#include <counter.h>
+#include <trace.h>
 
 /*
  * Kernel malloc.
  */
 
+static struct counter kmalloc_counter = COUNTER_INITIALIZER("kmallocs");
 
 /*
  * Fill a block with 0xdeadbeef.
@@ -1218,6 +1221,7 @@ void *
 kmalloc(size_t sz)
 {
 	size_t checksz;
+	void *ptr;
 #ifdef LABELS
 	vaddr_t label;
 #endif
@@ -1230,6 +1234,8 @@ kmalloc(size_t sz)
 #endif /* __GNUC__ */
 #endif /* LABELS */
 
+	counter_inc(&kmalloc_counter);
+
 	checksz = sz + GUARD_OVERHEAD + LABEL_OVERHEAD;
 	if (checksz >= LARGEST_SUBPAGE_SIZE) {
 		unsigned long npages;
@@ -1238,19 +1244,19 @@ kmalloc(size_t sz)
 		/* Round up to a whole number of pages. */
 		npages = (sz + PAGE_SIZE - 1)/PAGE_SIZE;
 		address = alloc_kpages(npages);
-		if (address==0) {
-			return NULL;
-		}
 		KASSERT(address % PAGE_SIZE == 0);
-
-		return (void *)address;
+		ptr = (void *)address;
 	}
-
+	else {
 #ifdef LABELS
-	return subpage_kmalloc(sz, label);
+		ptr = subpage_kmalloc(sz, label);
 #else
-	return subpage_kmalloc(sz);
+		ptr = subpage_kmalloc(sz);
 #endif
+	}
+
+	tracepoint(TRACE_KMALLOC, sz, (uintptr_t)ptr);
+	return ptr;
 }
 
 /*
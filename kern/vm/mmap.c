@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File mappings within an address space. See mmap.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/mman.h>
+#include <lib.h>
+#include <vnode.h>
+#include <vm.h>
+#include <pagecache.h>
+#include <mmap.h>
+
+/*
+ * Address spaces are single-threaded (vfork children run only while
+ * the parent sleeps), so none of this needs locking of its own.
+ */
+
+static
+vaddr_t
+mmap_top(struct mmapping *mm)
+{
+	return mm->mm_base + mm->mm_npages * PAGE_SIZE;
+}
+
+/*
+ * Give up one page's memory: write back and release a shared page,
+ * release or free a private one.
+ */
+static
+void
+mmap_droppage(struct mmapping *mm, struct mmpage *mp)
+{
+	bool cleaned;
+
+	if (mp->mp_private != 0) {
+		free_kpages(PADDR_TO_KVADDR(mp->mp_private));
+		mp->mp_private = 0;
+	}
+	if (mp->mp_cached != NULL) {
+		if (mm->mm_flags == MAP_SHARED) {
+			/* Errors have nowhere to go; munmap can't fail. */
+			(void)pagecache_sync(mp->mp_cached, &cleaned);
+		}
+		pagecache_release(mp->mp_cached);
+		mp->mp_cached = NULL;
+	}
+}
+
+static
+void
+mmap_destroy(struct mmapping *mm)
+{
+	unsigned i;
+
+	for (i=0; i<mm->mm_npages; i++) {
+		mmap_droppage(mm, &mm->mm_pages[i]);
+	}
+	VOP_DECREF(mm->mm_vnode);
+	kfree(mm->mm_pages);
+	kfree(mm);
+}
+
+/*
+ * Allocate a mapping with all pages empty. Takes a new reference to
+ * VN.
+ */
+static
+struct mmapping *
+mmap_alloc(vaddr_t base, unsigned npages, int prot, int flags,
+	   struct vnode *vn, off_t offset)
+{
+	struct mmapping *mm;
+	unsigned i;
+
+	mm = kmalloc(sizeof(*mm));
+	if (mm == NULL) {
+		return NULL;
+	}
+	mm->mm_pages = kmalloc(npages * sizeof(mm->mm_pages[0]));
+	if (mm->mm_pages == NULL) {
+		kfree(mm);
+		return NULL;
+	}
+	for (i=0; i<npages; i++) {
+		mm->mm_pages[i].mp_cached = NULL;
+		mm->mm_pages[i].mp_private = 0;
+	}
+	mm->mm_base = base;
+	mm->mm_npages = npages;
+	mm->mm_prot = prot;
+	mm->mm_flags = flags;
+	VOP_INCREF(vn);
+	mm->mm_vnode = vn;
+	mm->mm_offset = offset;
+	mm->mm_next = NULL;
+	return mm;
+}
+
+int
+mmap_create(struct mmapping **list, vaddr_t lo, vaddr_t hi, size_t len,
+	    int prot, int flags, struct vnode *vn, off_t offset,
+	    vaddr_t *ret)
+{
+	struct mmapping *mm, **pp, **where;
+	vaddr_t gapbottom, base;
+	size_t size;
+
+	KASSERT(len > 0);
+	KASSERT(offset % PAGE_SIZE == 0);
+
+	size = ROUNDUP(len, PAGE_SIZE);
+	if (size < len || hi < lo || size > hi - lo) {
+		return ENOMEM;
+	}
+
+	/*
+	 * Find the highest gap that fits, so mappings grow down from
+	 * the stack and stay out of the way of anything growing up.
+	 * The list is sorted, so the last fit we see is the highest.
+	 */
+	base = 0;
+	where = NULL;
+	gapbottom = lo;
+	for (pp = list; ; pp = &(*pp)->mm_next) {
+		vaddr_t gaptop = (*pp == NULL) ? hi : (*pp)->mm_base;
+
+		if (gaptop >= gapbottom && gaptop - gapbottom >= size) {
+			base = gaptop - size;
+			where = pp;
+		}
+		if (*pp == NULL) {
+			break;
+		}
+		gapbottom = mmap_top(*pp);
+	}
+	if (where == NULL) {
+		return ENOMEM;
+	}
+
+	mm = mmap_alloc(base, size / PAGE_SIZE, prot, flags, vn, offset);
+	if (mm == NULL) {
+		return ENOMEM;
+	}
+	mm->mm_next = *where;
+	*where = mm;
+
+	*ret = base;
+	return 0;
+}
+
+int
+mmap_remove(struct mmapping **list, vaddr_t addr, size_t len)
+{
+	struct mmapping *mm, **pp;
+	vaddr_t end;
+
+	if (addr % PAGE_SIZE != 0 || len == 0) {
+		return EINVAL;
+	}
+	end = addr + ROUNDUP(len, PAGE_SIZE);
+	if (end <= addr) {
+		return EINVAL;
+	}
+
+	/* Check first, so that we either unmap everything or nothing */
+	for (mm = *list; mm != NULL; mm = mm->mm_next) {
+		if (mmap_top(mm) <= addr || mm->mm_base >= end) {
+			continue;
+		}
+		if (mm->mm_base < addr || mmap_top(mm) > end) {
+			/* Splitting mappings is not supported. */
+			return EINVAL;
+		}
+	}
+
+	pp = list;
+	while (*pp != NULL) {
+		mm = *pp;
+		if (mm->mm_base >= addr && mmap_top(mm) <= end) {
+			*pp = mm->mm_next;
+			mmap_destroy(mm);
+		}
+		else {
+			pp = &mm->mm_next;
+		}
+	}
+	return 0;
+}
+
+int
+mmap_sync(struct mmapping *list, vaddr_t addr, size_t len, bool *flush)
+{
+	struct mmapping *mm;
+	struct mmpage *mp;
+	vaddr_t end, va;
+	bool cleaned;
+	int result, ret;
+
+	if (addr % PAGE_SIZE != 0) {
+		return EINVAL;
+	}
+	end = addr + ROUNDUP(len, PAGE_SIZE);
+
+	*flush = false;
+	ret = 0;
+	for (mm = list; mm != NULL; mm = mm->mm_next) {
+		if (mm->mm_flags != MAP_SHARED) {
+			continue;
+		}
+		for (va = mm->mm_base; va < mmap_top(mm); va += PAGE_SIZE) {
+			if (va < addr || va >= end) {
+				continue;
+			}
+			mp = &mm->mm_pages[(va - mm->mm_base) / PAGE_SIZE];
+			if (mp->mp_cached == NULL) {
+				continue;
+			}
+			result = pagecache_sync(mp->mp_cached, &cleaned);
+			if (result && ret == 0) {
+				/* Keep going, but report the first error */
+				ret = result;
+			}
+			if (cleaned) {
+				*flush = true;
+			}
+		}
+	}
+	return ret;
+}
+
+int
+mmap_fault(struct mmapping *list, vaddr_t vaddr, int faulttype,
+	   paddr_t *paddr_ret, bool *writable_ret)
+{
+	struct mmapping *mm;
+	struct mmpage *mp;
+	struct pcpage *pg;
+	vaddr_t kva;
+	unsigned pageno;
+	bool write;
+	int result;
+
+	for (mm = list; mm != NULL; mm = mm->mm_next) {
+		if (vaddr >= mm->mm_base && vaddr < mmap_top(mm)) {
+			break;
+		}
+	}
+	if (mm == NULL) {
+		return EFAULT;
+	}
+
+	write = (faulttype != VM_FAULT_READ);
+	if (mm->mm_prot == PROT_NONE ||
+	    (write && (mm->mm_prot & PROT_WRITE) == 0)) {
+		return EFAULT;
+	}
+
+	pageno = (vaddr - mm->mm_base) / PAGE_SIZE;
+	mp = &mm->mm_pages[pageno];
+
+	if (mp->mp_private != 0) {
+		*paddr_ret = mp->mp_private;
+		*writable_ret = (mm->mm_prot & PROT_WRITE) != 0;
+		return 0;
+	}
+
+	if (mp->mp_cached == NULL) {
+		result = pagecache_get(mm->mm_vnode,
+				       mm->mm_offset + pageno * PAGE_SIZE,
+				       &mp->mp_cached);
+		if (result) {
+			return result;
+		}
+	}
+	pg = mp->mp_cached;
+
+	if (!write) {
+		/*
+		 * Map it read-only unless it is a shared page that's
+		 * already dirty, so that the first write to a page
+		 * faults and we find out about it. (Reading pc_dirty
+		 * unlocked is harmless: at worst we take one more
+		 * fault.)
+		 */
+		*paddr_ret = pg->pc_paddr;
+		*writable_ret = mm->mm_flags == MAP_SHARED &&
+			(mm->mm_prot & PROT_WRITE) != 0 && pg->pc_dirty;
+		return 0;
+	}
+
+	if (mm->mm_flags == MAP_SHARED) {
+		pagecache_markdirty(pg);
+		*paddr_ret = pg->pc_paddr;
+		*writable_ret = true;
+		return 0;
+	}
+
+	/* First write to a private page: copy it. */
+	kva = alloc_kpages(1);
+	if (kva == 0) {
+		return ENOMEM;
+	}
+	memcpy((void *)kva, (void *)PADDR_TO_KVADDR(pg->pc_paddr), PAGE_SIZE);
+	mp->mp_private = KVADDR_TO_PADDR(kva);
+	mp->mp_cached = NULL;
+	pagecache_release(pg);
+
+	*paddr_ret = mp->mp_private;
+	*writable_ret = true;
+	return 0;
+}
+
+int
+mmap_copy(struct mmapping *old, struct mmapping **ret)
+{
+	struct mmapping *newlist, **tail, *mm;
+	struct mmpage *from, *to;
+	vaddr_t kva;
+	unsigned i;
+
+	newlist = NULL;
+	tail = &newlist;
+	for (; old != NULL; old = old->mm_next) {
+		mm = mmap_alloc(old->mm_base, old->mm_npages, old->mm_prot,
+				old->mm_flags, old->mm_vnode, old->mm_offset);
+		if (mm == NULL) {
+			mmap_destroyall(&newlist);
+			return ENOMEM;
+		}
+		*tail = mm;
+		tail = &mm->mm_next;
+
+		for (i=0; i<old->mm_npages; i++) {
+			from = &old->mm_pages[i];
+			to = &mm->mm_pages[i];
+			if (from->mp_private != 0) {
+				kva = alloc_kpages(1);
+				if (kva == 0) {
+					mmap_destroyall(&newlist);
+					return ENOMEM;
+				}
+				memcpy((void *)kva,
+				       (void *)PADDR_TO_KVADDR(from->mp_private),
+				       PAGE_SIZE);
+				to->mp_private = KVADDR_TO_PADDR(kva);
+			}
+			else if (from->mp_cached != NULL) {
+				pagecache_incref(from->mp_cached);
+				to->mp_cached = from->mp_cached;
+			}
+		}
+	}
+
+	*ret = newlist;
+	return 0;
+}
+
+void
+mmap_destroyall(struct mmapping **list)
+{
+	struct mmapping *mm;
+
+	while (*list != NULL) {
+		mm = *list;
+		*list = mm->mm_next;
+		mmap_destroy(mm);
+	}
+}
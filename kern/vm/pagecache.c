@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Page cache for mapped files. See pagecache.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <uio.h>
+#include <vnode.h>
+#include <vm.h>
+#include <pagecache.h>
+
+#define PC_HASHSIZE 64
+#define PC_FLUSHBATCH 16	/* pages per pagecache_flush */
+
+/*
+ * pc_lock protects the hash table and every page's refcount, busy,
+ * and dirty fields. It is not held across I/O: a page being read in
+ * (or written back for the last time) is marked busy instead, and
+ * anyone who wants it waits on pc_cv.
+ */
+static struct lock *pc_lock;
+static struct cv *pc_cv;
+static struct pcpage *pc_table[PC_HASHSIZE];
+static unsigned pc_ndirty;
+
+void
+pagecache_bootstrap(void)
+{
+	pc_lock = lock_create("pagecache");
+	if (pc_lock == NULL) {
+		panic("pagecache_bootstrap: Out of memory\n");
+	}
+	pc_cv = cv_create("pagecache");
+	if (pc_cv == NULL) {
+		panic("pagecache_bootstrap: Out of memory\n");
+	}
+}
+
+static
+unsigned
+pagecache_hash(struct vnode *vn, off_t offset)
+{
+	return ((uintptr_t)vn / sizeof(void *) +
+		(unsigned)(offset / PAGE_SIZE)) % PC_HASHSIZE;
+}
+
+/* Call with pc_lock held. */
+static
+struct pcpage *
+pagecache_lookup(struct vnode *vn, off_t offset)
+{
+	struct pcpage *pg;
+
+	for (pg = pc_table[pagecache_hash(vn, offset)]; pg != NULL;
+	     pg = pg->pc_next) {
+		if (pg->pc_vnode == vn && pg->pc_offset == offset) {
+			return pg;
+		}
+	}
+	return NULL;
+}
+
+/* Call with pc_lock held. */
+static
+void
+pagecache_unlink(struct pcpage *pg)
+{
+	struct pcpage **pp;
+
+	pp = &pc_table[pagecache_hash(pg->pc_vnode, pg->pc_offset)];
+	while (*pp != pg) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->pc_next;
+	}
+	*pp = pg->pc_next;
+	pg->pc_next = NULL;
+}
+
+static
+void
+pagecache_free(struct pcpage *pg)
+{
+	VOP_DECREF(pg->pc_vnode);
+	free_kpages(PADDR_TO_KVADDR(pg->pc_paddr));
+	kfree(pg);
+}
+
+/*
+ * Read a page in. Whatever lies past EOF reads as zeros.
+ */
+static
+int
+pagecache_readin(struct pcpage *pg)
+{
+	struct iovec iov;
+	struct uio ku;
+	char *kva;
+	int result;
+
+	kva = (char *)PADDR_TO_KVADDR(pg->pc_paddr);
+	uio_kinit(&iov, &ku, kva, PAGE_SIZE, pg->pc_offset, UIO_READ);
+	result = VOP_READ(pg->pc_vnode, &ku);
+	if (result) {
+		return result;
+	}
+	bzero(kva + PAGE_SIZE - ku.uio_resid, ku.uio_resid);
+
+	/* Charge the I/O to whoever faulted on the page. */
+	curthread->t_acct.ac_majflt++;
+	return 0;
+}
+
+/*
+ * Write a page back. Only the part inside the file is written: a
+ * mapping can't be used to extend a file.
+ */
+static
+int
+pagecache_writeback(struct pcpage *pg)
+{
+	struct iovec iov;
+	struct uio ku;
+	struct stat st;
+	size_t len;
+	int result;
+
+	result = VOP_STAT(pg->pc_vnode, &st);
+	if (result) {
+		return result;
+	}
+	if (st.st_size <= pg->pc_offset) {
+		return 0;
+	}
+	len = PAGE_SIZE;
+	if (st.st_size - pg->pc_offset < PAGE_SIZE) {
+		len = st.st_size - pg->pc_offset;
+	}
+
+	uio_kinit(&iov, &ku, (void *)PADDR_TO_KVADDR(pg->pc_paddr), len,
+		  pg->pc_offset, UIO_WRITE);
+	return VOP_WRITE(pg->pc_vnode, &ku);
+}
+
+int
+pagecache_get(struct vnode *vn, off_t offset, struct pcpage **ret)
+{
+	struct pcpage *pg;
+	vaddr_t kva;
+	int result;
+
+	KASSERT(offset % PAGE_SIZE == 0);
+
+	lock_acquire(pc_lock);
+	while (1) {
+		pg = pagecache_lookup(vn, offset);
+		if (pg == NULL) {
+			break;
+		}
+		if (!pg->pc_busy) {
+			pg->pc_refcount++;
+			lock_release(pc_lock);
+			*ret = pg;
+			return 0;
+		}
+		cv_wait(pc_cv, pc_lock);
+	}
+
+	/* Not cached; put in a busy placeholder and read it in. */
+	pg = kmalloc(sizeof(*pg));
+	if (pg == NULL) {
+		lock_release(pc_lock);
+		return ENOMEM;
+	}
+	kva = alloc_kpages(1);
+	if (kva == 0) {
+		kfree(pg);
+		lock_release(pc_lock);
+		return ENOMEM;
+	}
+	VOP_INCREF(vn);
+	pg->pc_vnode = vn;
+	pg->pc_offset = offset;
+	pg->pc_paddr = KVADDR_TO_PADDR(kva);
+	pg->pc_refcount = 1;
+	pg->pc_busy = true;
+	pg->pc_dirty = false;
+	pg->pc_dirtytime = 0;
+	pg->pc_next = pc_table[pagecache_hash(vn, offset)];
+	pc_table[pagecache_hash(vn, offset)] = pg;
+	lock_release(pc_lock);
+
+	result = pagecache_readin(pg);
+
+	lock_acquire(pc_lock);
+	pg->pc_busy = false;
+	if (result) {
+		pagecache_unlink(pg);
+	}
+	cv_broadcast(pc_cv, pc_lock);
+	lock_release(pc_lock);
+
+	if (result) {
+		pagecache_free(pg);
+		return result;
+	}
+	*ret = pg;
+	return 0;
+}
+
+void
+pagecache_incref(struct pcpage *pg)
+{
+	lock_acquire(pc_lock);
+	KASSERT(pg->pc_refcount > 0);
+	pg->pc_refcount++;
+	lock_release(pc_lock);
+}
+
+void
+pagecache_release(struct pcpage *pg)
+{
+	bool dirty;
+
+	lock_acquire(pc_lock);
+	KASSERT(pg->pc_refcount > 0);
+	pg->pc_refcount--;
+	if (pg->pc_refcount > 0) {
+		lock_release(pc_lock);
+		return;
+	}
+
+	/*
+	 * Keep the page in the table, busy, until it's written back,
+	 * so nobody can read a stale copy from the file meanwhile.
+	 */
+	dirty = pg->pc_dirty;
+	if (dirty) {
+		pc_ndirty--;
+	}
+	pg->pc_busy = true;
+	lock_release(pc_lock);
+
+	if (dirty) {
+		/* Nobody is left to report an error to. */
+		(void)pagecache_writeback(pg);
+	}
+
+	lock_acquire(pc_lock);
+	pagecache_unlink(pg);
+	cv_broadcast(pc_cv, pc_lock);
+	lock_release(pc_lock);
+
+	pagecache_free(pg);
+}
+
+void
+pagecache_markdirty(struct pcpage *pg)
+{
+	lock_acquire(pc_lock);
+	if (!pg->pc_dirty) {
+		pg->pc_dirty = true;
+		pg->pc_dirtytime = clock_getticks();
+		pc_ndirty++;
+	}
+	lock_release(pc_lock);
+}
+
+int
+pagecache_sync(struct pcpage *pg, bool *cleaned)
+{
+	bool dirty, clean;
+	int result;
+
+	lock_acquire(pc_lock);
+	dirty = pg->pc_dirty;
+	clean = dirty && pg->pc_refcount == 1;
+	if (clean) {
+		pg->pc_dirty = false;
+		pc_ndirty--;
+	}
+	lock_release(pc_lock);
+
+	*cleaned = false;
+	if (!dirty) {
+		return 0;
+	}
+
+	result = pagecache_writeback(pg);
+	if (result) {
+		if (clean) {
+			pagecache_markdirty(pg);
+		}
+		return result;
+	}
+	*cleaned = clean;
+	return 0;
+}
+
+/*
+ * Insert PG into BATCH, which holds *N pages sorted oldest first and
+ * has room for PC_FLUSHBATCH. If it is full, the newest page loses.
+ * Call with pc_lock held.
+ */
+static
+void
+pagecache_flushpick(struct pcpage **batch, unsigned *n, struct pcpage *pg)
+{
+	unsigned i, now;
+
+	now = clock_getticks();
+	if (*n == PC_FLUSHBATCH) {
+		if (now - pg->pc_dirtytime <=
+		    now - batch[*n - 1]->pc_dirtytime) {
+			return;
+		}
+		--*n;
+	}
+	for (i = *n; i > 0; i--) {
+		if (now - batch[i-1]->pc_dirtytime >= now - pg->pc_dirtytime) {
+			break;
+		}
+		batch[i] = batch[i-1];
+	}
+	batch[i] = pg;
+	++*n;
+}
+
+/*
+ * Order for writing: by file, then by offset, so each file's pages
+ * go out in one ascending run.
+ */
+static
+bool
+pagecache_flushbefore(struct pcpage *a, struct pcpage *b)
+{
+	if (a->pc_vnode != b->pc_vnode) {
+		return (uintptr_t)a->pc_vnode < (uintptr_t)b->pc_vnode;
+	}
+	return a->pc_offset < b->pc_offset;
+}
+
+unsigned
+pagecache_flush(unsigned expire)
+{
+	struct pcpage *batch[PC_FLUSHBATCH];
+	struct pcpage *pg;
+	unsigned i, j, n, now;
+
+	/* Pick the oldest dirty pages and hold them. */
+	n = 0;
+	lock_acquire(pc_lock);
+	now = clock_getticks();
+	for (i=0; i<PC_HASHSIZE; i++) {
+		for (pg = pc_table[i]; pg != NULL; pg = pg->pc_next) {
+			if (pg->pc_dirty && !pg->pc_busy &&
+			    now - pg->pc_dirtytime >= expire) {
+				pagecache_flushpick(batch, &n, pg);
+			}
+		}
+	}
+	for (i=0; i<n; i++) {
+		batch[i]->pc_refcount++;
+	}
+	lock_release(pc_lock);
+
+	for (i=1; i<n; i++) {
+		pg = batch[i];
+		for (j=i; j>0 && pagecache_flushbefore(pg, batch[j-1]); j--) {
+			batch[j] = batch[j-1];
+		}
+		batch[j] = pg;
+	}
+
+	for (i=0; i<n; i++) {
+		/* Nobody is waiting to hear about errors; try again later. */
+		(void)pagecache_writeback(batch[i]);
+		lock_acquire(pc_lock);
+		batch[i]->pc_dirtytime = clock_getticks();
+		lock_release(pc_lock);
+		pagecache_release(batch[i]);
+	}
+	return n;
+}
+
+unsigned
+pagecache_ndirty(void)
+{
+	return pc_ndirty;
+}
@@ -0,0 +1,13 @@
+---
+name: "CV Broadcast Benchmark"
+description:
+  Measures context switches per waiter per cv_broadcast, with the
+  lock in normal and in handoff mode.
+tags: [synch, cvs, kleaks]
+depends: [boot, semaphores, lt1, cvt1]
+sys161:
+  cpus: 8
+---
+khu
+cvb
+khu
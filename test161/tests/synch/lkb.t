@@ -0,0 +1,13 @@
+---
+name: "Lock Contention Benchmark"
+description:
+  Measures lock acquire latency and context switches per acquire
+  with many threads contending for one lock.
+tags: [synch, locks, kleaks]
+depends: [boot, semaphores, lt1]
+sys161:
+  cpus: 8
+---
+khu
+lkb
+khu
@@ -0,0 +1,13 @@
+---
+name: "Per-CPU Counter Test"
+description:
+  Threads on all cpus bump one per-cpu counter; the summed value must
+  be exact. Also times it against a spinlock-protected counter.
+tags: [synch, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+pcnt
+khu
@@ -0,0 +1,14 @@
+---
+name: "Priority Inversion Test"
+description:
+  A high priority thread waits for a lock held, through a chain of
+  two locks, by a low priority thread while medium priority threads
+  hog the cpu. Priority inheritance must get it the lock quickly.
+tags: [synch, locks, kleaks]
+depends: [boot, semaphores, lt1]
+sys161:
+  cpus: 1
+---
+khu
+pit
+khu
@@ -0,0 +1,11 @@
+---
+name: "Sampling Profiler Test"
+description:
+  Spins in one function with the profiler on and checks that most
+  samples are attributed to it, then that a reset clears them.
+tags: [synch]
+depends: [boot]
+sys161:
+  cpus: 2
+---
+proft
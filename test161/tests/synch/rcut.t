@@ -0,0 +1,13 @@
+---
+name: "RCU Test"
+description:
+  Readers look up a published object without locks while a writer
+  replaces it and retires old versions after a grace period.
+tags: [synch, rcu, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+rcut
+khu
@@ -0,0 +1,13 @@
+---
+name: "RW Lock Reader Scaling"
+description:
+  Measures read acquire throughput on one rwlock as the number of
+  readers grows, with an occasional writer.
+tags: [synch, rwlocks, kleaks]
+depends: [boot, semaphores, rwt1]
+sys161:
+  cpus: 8
+---
+khu
+rwb
+khu
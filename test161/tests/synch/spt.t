@@ -0,0 +1,13 @@
+---
+name: "Spinlock Stress Test"
+description:
+  Hammers one spinlock from every cpu and checks mutual exclusion,
+  reporting throughput and per-cpu fairness.
+tags: [synch, spinlocks, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+spt
+khu
@@ -0,0 +1,13 @@
+---
+name: "Timed Wait Test"
+description:
+  Threads wait on a CV with staggered timeouts and must each wake up
+  on time with ETIMEDOUT; a signaled waiter must return early.
+tags: [synch, timers, kleaks]
+depends: [boot, semaphores, locks, cvs]
+sys161:
+  cpus: 8
+---
+khu
+tmt
+khu
@@ -0,0 +1,11 @@
+---
+name: "Event Trace Test"
+description:
+  Traces a semaphore ping-pong and some kmallocs, and checks that the
+  switch, sleep, wakeup and kmalloc tracepoints recorded them.
+tags: [synch]
+depends: [boot, semaphores]
+sys161:
+  cpus: 1
+---
+trt
@@ -0,0 +1,14 @@
+---
+name: "Workqueue Test"
+description:
+  Threads queue work from every cpu; each item must run on the cpu
+  that queued it, work_flush must wait for all of them, and delayed
+  work must wait out its delay unless cancelled.
+tags: [synch, timers, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 4
+---
+khu
+wqt
+khu
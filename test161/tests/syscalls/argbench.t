@@ -0,0 +1,11 @@
+---
+name: "Exec Argument Latency Benchmark"
+description: >
+  Measures execv latency as the number and size of arguments grow,
+  up to nearly ARG_MAX, checking that every argument arrives intact.
+tags: [sys_execv,sys_vfork,sys_waitpid,procsyscalls,syscalls,benchmark]
+depends: [console,sys_fork]
+sys161:
+  ram: 16M
+---
+p /testbin/argbench
@@ -0,0 +1,12 @@
+---
+name: "Fork/Exec Latency Benchmark"
+description: >
+  Measures fork+exit+waitpid and fork+execv+waitpid latency over many
+  iterations, reaping each child before the next fork so that PIDs
+  must be recycled.
+tags: [sys_fork,sys_execv,sys_waitpid,procsyscalls,syscalls,benchmark]
+depends: [console,sys_fork]
+sys161:
+  ram: 16M
+---
+p /testbin/forkexecbench
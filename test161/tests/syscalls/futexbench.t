@@ -0,0 +1,12 @@
+---
+name: "Futex Benchmark"
+description: >
+  Compares futex-based mutexes and semaphores in shared memory with
+  semfs semaphores, uncontended and contended between processes, and
+  checks that the mutexes actually exclude each other.
+tags: [sys_futex,sys_mmap,sys_fork,syscalls,benchmark]
+depends: [console,sys_fork]
+sys161:
+  ram: 16M
+---
+p /testbin/futexbench
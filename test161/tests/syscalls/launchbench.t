@@ -0,0 +1,12 @@
+---
+name: "Command Launch Rate Benchmark"
+description: >
+  Launches /bin/true through system(), directly and via sh -c, with
+  fork and with vfork, and reports launches per second. Also checks
+  that a vfork child shares the parent's address space.
+tags: [sys_vfork,sys_fork,sys_execv,sys_waitpid,procsyscalls,syscalls,benchmark]
+depends: [console,sys_fork]
+sys161:
+  ram: 16M
+---
+p /testbin/launchbench
@@ -0,0 +1,13 @@
+---
+name: "Mmap Test"
+description: >
+  Tests sys_mmap, sys_munmap, and sys_msync on a regular file: shared
+  write-through, private copy-on-write, inheritance across fork, and
+  argument checking. Also compares scanning a file with read() and
+  through a mapping.
+tags: [sys_mmap,sys_munmap,sys_msync,vmsyscalls,syscalls]
+depends: [console,sys_fork]
+sys161:
+  ram: 4M
+---
+p /testbin/mmaptest
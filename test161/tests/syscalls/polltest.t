@@ -0,0 +1,11 @@
+---
+name: "Poll Test"
+description: >
+  Tests sys_poll and sys_select on pipes: readiness, hangup, timeouts,
+  and bad file handles.
+tags: [sys_poll,sys_select,filesyscalls,syscalls]
+depends: [console,sys_close]
+sys161:
+  ram: 512K
+---
+p /testbin/polltest
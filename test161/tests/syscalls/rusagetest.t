@@ -0,0 +1,12 @@
+---
+name: "Resource Usage Test"
+description: >
+  Tests sys_getrusage: user and system time, fault and context switch
+  counts, children's usage collected through waitpid, and argument
+  checking.
+tags: [sys_getrusage,syscalls]
+depends: [console,sys_fork]
+sys161:
+  ram: 4M
+---
+p /testbin/rusagetest
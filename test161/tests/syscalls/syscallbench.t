@@ -0,0 +1,11 @@
+---
+name: "System Call Benchmark"
+description: >
+  Times null system calls: getpid and __time, which take the fast
+  path, and close(-1) and getrusage, which take the full one.
+tags: [syscalls,benchmark]
+depends: [console]
+sys161:
+  ram: 4M
+---
+p /testbin/syscallbench
@@ -0,0 +1,9 @@
+---
+name: "Thread Create+Exit Benchmark"
+description:
+  Measures thread_fork and thread_exit throughput, and how often the
+  per-cpu thread cache supplies the new thread.
+tags: [threads]
+depends: [boot]
+---
+tfb
@@ -31,8 +31,10 @@
  * sh - shell
  *
  * Usage:
- *     sh
- *     sh -c command
+ *     sh [-v]
+ *     sh [-v] -c command
+ *
+ * -v starts commands with vfork() instead of fork().
  */
 
 #include <sys/types.h>
@@ -69,6 +71,9 @@ struct exitinfo {
 /* set to nonzero if __time syscall seems to work */
 static int timing = 0;
 
+/* set to nonzero (by -v) to start commands with vfork */
+static int usevfork = 0;
+
 /* array of backgrounded jobs (allows "foregrounding") */
 #define MAXBG 128
 static pid_t bgpids[MAXBG];
@@ -355,6 +360,44 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * spawn
+ * forks and runs the command in ARGS in the child; returns the child's
+ * pid, or -1 on error. The child only execs or exits, so with vfork it
+ * can run in our address space and save the cost of copying it. This
+ * is kept apart from docommand so that none of docommand's locals are
+ * live across vfork.
+ */
+static
+pid_t
+spawn(char **args)
+{
+	pid_t pid;
+
+	pid = usevfork ? vfork() : fork();
+	switch (pid) {
+		case -1:
+			/* error */
+			warn(usevfork ? "vfork" : "fork");
+			return -1;
+		case 0:
+			/* child */
+			execvp(args[0], args);
+			warn("%s", args[0]);
+			/*
+			 * Use _exit() instead of exit() in the child
+			 * process to avoid calling atexit() functions,
+			 * which would cause hostcompat (if present) to
+			 * reset the tty state and mess up our input
+			 * handling.
+			 */
+			_exit(1);
+		default:
+			break;
+	}
+	return pid;
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
@@ -421,27 +464,10 @@ docommand(char *buf, struct exitinfo *ei)
 		__time(&startsecs, &startnsecs);
 	}
 
-	pid = fork();
-	switch (pid) {
-		case -1:
-			/* error */
-			warn("fork");
-			exitinfo_exit(ei, 255);
-			return;
-		case 0:
-			/* child */
-			execvp(args[0], args);
-			warn("%s", args[0]);
-			/*
-			 * Use _exit() instead of exit() in the child
-			 * process to avoid calling atexit() functions,
-			 * which would cause hostcompat (if present) to
-			 * reset the tty state and mess up our input
-			 * handling.
-			 */
-			_exit(1);
-		default:
-			break;
+	pid = spawn(args);
+	if (pid < 0) {
+		exitinfo_exit(ei, 255);
+		return;
 	}
 
 	/* parent */
@@ -569,6 +595,12 @@ main(int argc, char *argv[])
 #endif
 	check_timing();
 
+	if (argc > 1 && !strcmp(argv[1], "-v")) {
+		usevfork = 1;
+		argc--;
+		argv++;
+	}
+
 	/*
 	 * Allow argc to be 0 in case we're running on a broken kernel,
 	 * or one that doesn't set argv when starting the first shell.
@@ -585,7 +617,7 @@ main(int argc, char *argv[])
 		}
 	}
 	else {
-		errx(1, "Usage: sh [-c command]");
+		errx(1, "Usage: sh [-v] [-c command]");
 	}
 	return 0;
 }
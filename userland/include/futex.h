@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <time.h>	/* for struct timespec */
+
+/*
+ * Get the FUTEX_* operations from the kernel.
+ */
+#include <kern/futex.h>
+
+/*
+ * The system call. FUTEX_WAIT sleeps as long as *ADDR == VAL, for at
+ * most TIMEOUT if that isn't NULL. FUTEX_WAKE wakes up to VAL
+ * sleepers and returns how many it woke.
+ */
+int futex(volatile int *addr, int op, int val, const struct timespec *timeout);
+
+/*
+ * Mutexes and semaphores built on futex(). Taking a free mutex, or
+ * doing P on a semaphore whose count is above zero, never enters the
+ * kernel; neither does letting go when nobody is waiting.
+ *
+ * They can be shared between processes by putting them in memory
+ * mapped MAP_SHARED; initialize them before forking.
+ */
+
+struct fmutex {
+	volatile int fm_state;	/* 0 free, 1 held, 2 held with sleepers */
+};
+
+struct fsem {
+	volatile int fs_count;		/* current count */
+	volatile int fs_sleepers;	/* threads in or near futex() */
+};
+
+void fmutex_init(struct fmutex *fm);
+void fmutex_lock(struct fmutex *fm);
+int fmutex_trylock(struct fmutex *fm);	/* nonzero if it got the lock */
+void fmutex_unlock(struct fmutex *fm);
+
+void fsem_init(struct fsem *fs, unsigned count);
+void fsem_P(struct fsem *fs);
+void fsem_V(struct fsem *fs);
+
+
+#endif /* _FUTEX_H_ */
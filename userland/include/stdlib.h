@@ -61,6 +61,12 @@ char *getenv(const char *var);
  */
 int system(const char *command);
 
+/*
+ * If set nonzero, system() starts the command with vfork() rather
+ * than fork(). (OS/161 extension; off by default.)
+ */
+extern int __system_vfork;
+
 /*
  * Pseudo-random number generator.
  */
@@ -57,6 +57,8 @@
  *     fstat:    sys/stat.h
  *     lstat:    sys/stat.h
  *     mkdir:    sys/stat.h
+ *     poll:     poll.h
+ *     select:   sys/select.h
  *
  * If this were standard Unix, more prototypes would go in other
  * header files as well, as follows:
@@ -140,6 +142,7 @@ int link(const char *oldfile, const char *newfile);
 int chdir(const char *path);
 
 /* Optional. */
+pid_t vfork(void);
 void *sbrk(__intptr_t change);
 ssize_t getdirentry(int filehandle, char *buf, size_t buflen);
 int symlink(const char *target, const char *linkname);
@@ -147,6 +150,7 @@ ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
+int nanosleep(const struct timespec *req, struct timespec *rem);
 ssize_t __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
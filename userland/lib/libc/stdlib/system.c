@@ -41,6 +41,12 @@
 #define MAXCMDSIZE 2048
 #define MAXARGS    128
 
+/*
+ * Use vfork() instead of fork(). The child only execs or exits, so
+ * it need not have its own copy of the address space.
+ */
+int __system_vfork;
+
 int
 system(const char *cmd)
 {
@@ -74,7 +80,7 @@ system(const char *cmd)
 
 	argv[nargs] = NULL;
 
-	pid = fork();
+	pid = __system_vfork ? vfork() : fork();
 	switch (pid) {
 	    case -1:
 		return -1;
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <futex.h>
+
+/*
+ * Mutexes and semaphores on top of futex().
+ *
+ * The mutex is the usual three-state one: 0 is free, 1 is held, and
+ * 2 is held with (possibly) someone asleep. Only a thread that finds
+ * the mutex busy moves it to 2, and only unlocking from 2 makes a
+ * system call, so the uncontended path is one atomic operation each
+ * way.
+ *
+ * The semaphore keeps a count, plus a count of threads that have
+ * found it at zero and may be about to sleep. V only calls into the
+ * kernel if there are any of those.
+ */
+
+/* In arch/mips/futex-mips.S. */
+int __futex_cas(volatile int *p, int old, int new);
+int __futex_swap(volatile int *p, int new);
+int __futex_add(volatile int *p, int delta);
+
+/*
+ * Sleep while *ADDR is VAL. Getting EAGAIN just means it changed
+ * before we got to sleep; anything else means the word is bad, and
+ * since the caller would otherwise spin forever, give up.
+ */
+static
+void
+futex_sleep(volatile int *addr, int val)
+{
+	if (futex(addr, FUTEX_WAIT, val, NULL) < 0 && errno != EAGAIN) {
+		abort();
+	}
+}
+
+static
+void
+futex_wakeone(volatile int *addr)
+{
+	if (futex(addr, FUTEX_WAKE, 1, NULL) < 0) {
+		abort();
+	}
+}
+
+void
+fmutex_init(struct fmutex *fm)
+{
+	fm->fm_state = 0;
+}
+
+void
+fmutex_lock(struct fmutex *fm)
+{
+	int c;
+
+	c = __futex_cas(&fm->fm_state, 0, 1);
+	if (c == 0) {
+		return;
+	}
+
+	/*
+	 * Busy. Mark it contended and sleep until we are the one who
+	 * moves it from 0. We don't know whether anyone else is still
+	 * asleep, so we take it as 2; that costs at most one extra
+	 * wakeup at unlock time.
+	 */
+	if (c != 2) {
+		c = __futex_swap(&fm->fm_state, 2);
+	}
+	while (c != 0) {
+		futex_sleep(&fm->fm_state, 2);
+		c = __futex_swap(&fm->fm_state, 2);
+	}
+}
+
+int
+fmutex_trylock(struct fmutex *fm)
+{
+	return __futex_cas(&fm->fm_state, 0, 1) == 0;
+}
+
+void
+fmutex_unlock(struct fmutex *fm)
+{
+	if (__futex_add(&fm->fm_state, -1) != 1) {
+		/* It was 2: free it and wake a sleeper. */
+		fm->fm_state = 0;
+		futex_wakeone(&fm->fm_state);
+	}
+}
+
+void
+fsem_init(struct fsem *fs, unsigned count)
+{
+	fs->fs_count = count;
+	fs->fs_sleepers = 0;
+}
+
+void
+fsem_P(struct fsem *fs)
+{
+	int c;
+
+	while (1) {
+		c = fs->fs_count;
+		if (c > 0) {
+			if (__futex_cas(&fs->fs_count, c, c - 1) == c) {
+				return;
+			}
+			continue;
+		}
+		/*
+		 * Announce ourselves before sleeping, so a V that
+		 * comes along after we looked will call futex_wake.
+		 * If the V got in first, futex_sleep sees the count
+		 * has changed and returns at once.
+		 */
+		__futex_add(&fs->fs_sleepers, 1);
+		futex_sleep(&fs->fs_count, 0);
+		__futex_add(&fs->fs_sleepers, -1);
+	}
+}
+
+void
+fsem_V(struct fsem *fs)
+{
+	__futex_add(&fs->fs_count, 1);
+	if (fs->fs_sleepers > 0) {
+		futex_wakeone(&fs->fs_count);
+	}
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * tracedump - print a kernel event trace (see <kern/trace.h>) as a
+ * timeline.
+ *
+ * The kernel's "trace save FILE" menu command writes the file. This
+ * is mostly meant to be run on the host, as hostbin/host-tracedump,
+ * but builds for OS/161 too.
+ *
+ * The records from all the cpus are merged in time order and printed
+ * one per line, with times relative to the first record. System calls
+ * and disk I/Os also show how long they took. A count of each kind of
+ * event follows.
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#include "kern/trace.h"
+
+#ifdef HOST
+/*
+ * OS/161 runs natively on a big-endian platform, so we can
+ * conveniently use the byteswapping functions for network byte order.
+ */
+#include <netinet/in.h> // for arpa/inet.h
+#include <arpa/inet.h>  // for ntohl
+#include "hostcompat.h"
+#define SWAP32(x) ntohl(x)
+#define SWAP16(x) ntohs(x)
+
+extern const char *hostcompat_progname;
+
+#else
+
+#define SWAP32(x) (x)
+#define SWAP16(x) (x)
+
+#endif
+
+#define ARRAYCOUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/* How many threads we track open syscalls and disk I/Os for. */
+#define MAXPENDING 256
+
+static const char *const eventnames[TRACE_NEVENTS] = {
+	[TRACE_SWITCH] = "switch",
+	[TRACE_SLEEP] = "sleep",
+	[TRACE_WAKE] = "wake",
+	[TRACE_SYSCALL] = "syscall",
+	[TRACE_SYSRET] = "sysret",
+	[TRACE_VMFAULT] = "vmfault",
+	[TRACE_DISKIO] = "diskio",
+	[TRACE_DISKDONE] = "diskdone",
+	[TRACE_KMALLOC] = "kmalloc",
+};
+
+/* Kernel thread states (threadstate_t), for TRACE_SWITCH. */
+static const char *const statenames[] = {
+	"run", "ready", "sleep", "zombie",
+};
+
+/* Kernel fault types (VM_FAULT_*), for TRACE_VMFAULT. */
+static const char *const faultnames[] = {
+	"read", "write", "readonly",
+};
+
+/*
+ * A syscall or disk I/O that has started but not finished, by thread.
+ */
+struct pending {
+	uint32_t thread;
+	uint16_t event;
+	uint64_t start;
+};
+
+static struct pending pending[MAXPENDING];
+static unsigned npending;
+
+static unsigned counts[TRACE_NEVENTS + 1];
+
+////////////////////////////////////////////////////////////
+// reading
+
+static
+void
+doread(int fd, void *buf, size_t len, const char *file)
+{
+	char *p = buf;
+	ssize_t r;
+
+	while (len > 0) {
+		r = read(fd, p, len);
+		if (r < 0) {
+			err(1, "%s", file);
+		}
+		if (r == 0) {
+			errx(1, "%s: Unexpected end of file", file);
+		}
+		p += r;
+		len -= r;
+	}
+}
+
+static
+void
+swaprecord(struct trace_record *tr)
+{
+	tr->tr_sec = SWAP32(tr->tr_sec);
+	tr->tr_nsec = SWAP32(tr->tr_nsec);
+	tr->tr_event = SWAP16(tr->tr_event);
+	tr->tr_cpu = SWAP16(tr->tr_cpu);
+	tr->tr_thread = SWAP32(tr->tr_thread);
+	tr->tr_arg0 = SWAP32(tr->tr_arg0);
+	tr->tr_arg1 = SWAP32(tr->tr_arg1);
+}
+
+static
+uint64_t
+recordtime(const struct trace_record *tr)
+{
+	return (uint64_t)tr->tr_sec * 1000000000ULL + tr->tr_nsec;
+}
+
+static
+int
+recordcmp(const void *av, const void *bv)
+{
+	const struct trace_record *a = av;
+	const struct trace_record *b = bv;
+	uint64_t at, bt;
+
+	at = recordtime(a);
+	bt = recordtime(b);
+	if (at != bt) {
+		return at < bt ? -1 : 1;
+	}
+	if (a->tr_cpu != b->tr_cpu) {
+		return a->tr_cpu < b->tr_cpu ? -1 : 1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// pending operations
+
+static
+void
+startop(const struct trace_record *tr)
+{
+	unsigned i;
+
+	for (i=0; i<npending; i++) {
+		if (pending[i].thread == tr->tr_thread &&
+		    pending[i].event == tr->tr_event) {
+			break;
+		}
+	}
+	if (i == npending) {
+		if (npending == MAXPENDING) {
+			/* Too many; lose this one. */
+			return;
+		}
+		npending++;
+	}
+	pending[i].thread = tr->tr_thread;
+	pending[i].event = tr->tr_event;
+	pending[i].start = recordtime(tr);
+}
+
+/*
+ * Find the STARTEVENT for the thread that logged TR and return how
+ * long ago it was, in ns; or return 0 if we didn't see it.
+ */
+static
+uint64_t
+finishop(const struct trace_record *tr, unsigned startevent)
+{
+	uint64_t start;
+	unsigned i;
+
+	for (i=0; i<npending; i++) {
+		if (pending[i].thread == tr->tr_thread &&
+		    pending[i].event == startevent) {
+			start = pending[i].start;
+			pending[i] = pending[--npending];
+			return recordtime(tr) - start;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// printing
+
+static
+void
+printdetail(const struct trace_record *tr)
+{
+	uint64_t took;
+
+	switch (tr->tr_event) {
+	    case TRACE_SWITCH:
+		printf("-> %08x, old thread %s",
+		       (unsigned)tr->tr_arg0,
+		       tr->tr_arg1 < ARRAYCOUNT(statenames) ?
+		       statenames[tr->tr_arg1] : "?");
+		break;
+	    case TRACE_SLEEP:
+		printf("wchan %08x", (unsigned)tr->tr_arg0);
+		if (tr->tr_arg1 != 0) {
+			printf(", timeout %u ticks", (unsigned)tr->tr_arg1);
+		}
+		break;
+	    case TRACE_WAKE:
+		printf("wchan %08x, thread %08x",
+		       (unsigned)tr->tr_arg0, (unsigned)tr->tr_arg1);
+		break;
+	    case TRACE_SYSCALL:
+		printf("call %u", (unsigned)tr->tr_arg0);
+		startop(tr);
+		break;
+	    case TRACE_SYSRET:
+		printf("call %u", (unsigned)tr->tr_arg0);
+		if (tr->tr_arg1 != 0) {
+			printf(", error %u", (unsigned)tr->tr_arg1);
+		}
+		took = finishop(tr, TRACE_SYSCALL);
+		if (took > 0) {
+			printf(", %llu us", (unsigned long long)(took / 1000));
+		}
+		break;
+	    case TRACE_VMFAULT:
+		printf("%s at 0x%08x",
+		       tr->tr_arg0 < ARRAYCOUNT(faultnames) ?
+		       faultnames[tr->tr_arg0] : "?",
+		       (unsigned)tr->tr_arg1);
+		break;
+	    case TRACE_DISKIO:
+		printf("%s sector %u", tr->tr_arg1 ? "write" : "read",
+		       (unsigned)tr->tr_arg0);
+		startop(tr);
+		break;
+	    case TRACE_DISKDONE:
+		printf("sector %u", (unsigned)tr->tr_arg0);
+		if (tr->tr_arg1 != 0) {
+			printf(", error %u", (unsigned)tr->tr_arg1);
+		}
+		took = finishop(tr, TRACE_DISKIO);
+		if (took > 0) {
+			printf(", %llu us", (unsigned long long)(took / 1000));
+		}
+		break;
+	    case TRACE_KMALLOC:
+		printf("%u bytes at %08x",
+		       (unsigned)tr->tr_arg0, (unsigned)tr->tr_arg1);
+		break;
+	    default:
+		printf("%08x %08x",
+		       (unsigned)tr->tr_arg0, (unsigned)tr->tr_arg1);
+		break;
+	}
+}
+
+static
+void
+printrecord(const struct trace_record *tr, uint64_t base)
+{
+	uint64_t t;
+	const char *name;
+
+	t = recordtime(tr) - base;
+	name = tr->tr_event < TRACE_NEVENTS ? eventnames[tr->tr_event] : NULL;
+	printf("%6llu.%06llu cpu%-2u %08x %-8s ",
+	       (unsigned long long)(t / 1000000000ULL),
+	       (unsigned long long)((t % 1000000000ULL) / 1000),
+	       (unsigned)tr->tr_cpu, (unsigned)tr->tr_thread,
+	       name != NULL ? name : "?");
+	printdetail(tr);
+	printf("\n");
+}
+
+////////////////////////////////////////////////////////////
+// main
+
+static
+void
+usage(void)
+{
+	warnx("Usage: tracedump [-s] tracefile");
+	errx(1, "   -s: print only the event counts");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct trace_header th;
+	struct trace_record *records;
+	const char *file = NULL;
+	bool summary = false;
+	unsigned i, ev;
+	int fd;
+
+#ifdef HOST
+	/* Don't do this; it frobs the tty and you can't pipe to less */
+	/*hostcompat_init(argc, argv);*/
+	hostcompat_progname = argv[0];
+#endif
+
+	for (i=1; i<(unsigned)argc; i++) {
+		if (!strcmp(argv[i], "-s")) {
+			summary = true;
+		}
+		else if (argv[i][0] == '-' || file != NULL) {
+			usage();
+		}
+		else {
+			file = argv[i];
+		}
+	}
+	if (file == NULL) {
+		usage();
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	doread(fd, &th, sizeof(th), file);
+	if (SWAP32(th.th_magic) != TRACE_MAGIC) {
+		errx(1, "%s: Not a kernel trace file", file);
+	}
+	th.th_ncpus = SWAP32(th.th_ncpus);
+	th.th_nrecords = SWAP32(th.th_nrecords);
+	th.th_dropped = SWAP32(th.th_dropped);
+
+	records = malloc(th.th_nrecords * sizeof(*records) + 1);
+	if (records == NULL) {
+		errx(1, "Out of memory");
+	}
+	doread(fd, records, th.th_nrecords * sizeof(*records), file);
+	close(fd);
+
+	for (i=0; i<th.th_nrecords; i++) {
+		swaprecord(&records[i]);
+	}
+	qsort(records, th.th_nrecords, sizeof(*records), recordcmp);
+
+	for (i=0; i<th.th_nrecords; i++) {
+		if (!summary) {
+			printrecord(&records[i], recordtime(&records[0]));
+		}
+		ev = records[i].tr_event;
+		counts[ev < TRACE_NEVENTS ? ev : TRACE_NEVENTS]++;
+	}
+
+	printf("%u records from %u cpus, %u overwritten before saving\n",
+	       (unsigned)th.th_nrecords, (unsigned)th.th_ncpus,
+	       (unsigned)th.th_dropped);
+	for (ev=1; ev<=TRACE_NEVENTS; ev++) {
+		if (counts[ev] > 0) {
+			printf("%10u %s\n", counts[ev],
+			       ev < TRACE_NEVENTS ? eventnames[ev] : "(unknown)");
+		}
+	}
+
+	free(records);
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * argbench - measure execv latency as the argument list grows.
+ *
+ * For a range of argument counts and sizes, repeatedly vforks a child
+ * that execs this program with that argument list, and reports the
+ * mean time from vfork to reaping the child. The exec'd copy checks
+ * that every argument arrived intact and exits.
+ *
+ * vfork keeps address-space copying out of the measurement, so what
+ * is left is mostly exec itself: loading the program and marshalling
+ * the arguments.
+ *
+ * Usage: argbench [iterations]
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define _PATH_MYSELF "/testbin/argbench"
+#define CHILDFLAG "-child"
+
+#define DEFAULT_ITERS 5
+
+/*
+ * Argument lists to try: COUNT arguments of LEN characters each.
+ * COUNT must be at least 2 (see buildargs).
+ * With argv[0], the flag, and 4-byte pointers, the largest is just
+ * under ARG_MAX.
+ */
+static const struct {
+	int count;
+	int len;
+} configs[] = {
+	{ 2,    8 },
+	{ 64,   8 },
+	{ 1024, 8 },
+	{ 4096, 8 },
+	{ 8,    1024 },
+	{ 64,   900 },
+	{ 15,   4050 },
+};
+#define NCONFIGS (sizeof(configs) / sizeof(configs[0]))
+
+#define MAXARGS 4096
+
+/* Shared with the vfork child, which execs with them. */
+static char *args[MAXARGS + 3];
+static char strings[ARG_MAX];
+
+static
+unsigned long long
+now_us(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000 + ns / 1000;
+}
+
+/*
+ * Argument I is LEN copies of one letter, so a corrupted or
+ * misplaced argument is easy to spot.
+ */
+static
+char
+argchar(int i)
+{
+	return 'a' + i % 26;
+}
+
+/*
+ * In the exec'd copy: argv[2..] should be COUNT arguments of LEN
+ * characters, as passed after the flag.
+ */
+static
+int
+checkargs(int argc, char **argv)
+{
+	int count, len, i, j;
+
+	if (argc < 4) {
+		return 1;
+	}
+	count = atoi(argv[2]);
+	len = atoi(argv[3]);
+	if (argc != count + 2 || argv[argc] != NULL) {
+		return 1;
+	}
+	for (i=2; i<argc; i++) {
+		/* argv[2] and argv[3] double as the first two args */
+		if (i < 4) {
+			continue;
+		}
+		if ((int)strlen(argv[i]) != len) {
+			return 1;
+		}
+		for (j=0; j<len; j++) {
+			if (argv[i][j] != argchar(i)) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Build the argument list: argv[0], the flag, then COUNT arguments
+ * of LEN bytes, except that the first two say what COUNT and LEN are
+ * so the child can check the rest.
+ */
+static
+void
+buildargs(int count, int len)
+{
+	char *s = strings;
+	int i;
+
+	args[0] = (char *)"argbench";
+	args[1] = (char *)CHILDFLAG;
+	for (i=2; i<count+2; i++) {
+		args[i] = s;
+		if (i == 2) {
+			snprintf(s, len + 1, "%d", count);
+		}
+		else if (i == 3) {
+			snprintf(s, len + 1, "%d", len);
+		}
+		else {
+			memset(s, argchar(i), len);
+			s[len] = 0;
+		}
+		s += strlen(s) + 1;
+	}
+	args[i] = NULL;
+}
+
+static
+void
+run(int count, int len, int iters)
+{
+	unsigned long long start, total;
+	pid_t pid;
+	int i, status;
+
+	buildargs(count, len);
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		pid = vfork();
+		if (pid < 0) {
+			err(1, "vfork");
+		}
+		if (pid == 0) {
+			execv(_PATH_MYSELF, args);
+			_exit(255);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "%d args of %d bytes: exit status 0x%x",
+			     count, len, status);
+		}
+	}
+	total = now_us() - start;
+
+	tprintf("argc %5d x %5d bytes: %8llu us/exec (%d iters)\n",
+		count, len, total / iters, iters);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned i;
+	int iters;
+
+	if (argc > 1 && !strcmp(argv[1], CHILDFLAG)) {
+		_exit(checkargs(argc, argv));
+	}
+
+	iters = DEFAULT_ITERS;
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+		if (iters <= 0) {
+			errx(1, "Usage: argbench [iterations]");
+		}
+	}
+
+	for (i=0; i<NCONFIGS; i++) {
+		run(configs[i].count, configs[i].len, iters);
+	}
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/argbench");
+	return 0;
+}
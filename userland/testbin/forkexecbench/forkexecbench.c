@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * forkexecbench - measure process lifecycle latency.
+ *
+ * Times three loops: fork + _exit + waitpid, fork + execv of
+ * /bin/true + waitpid, and (as a baseline) getpid. Reports the mean
+ * time per iteration in microseconds.
+ *
+ * Because every child is reaped before the next fork, this also
+ * checks that PIDs are recycled: the run fails if any fork does.
+ *
+ * Usage: forkexecbench [iterations]
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define DEFAULT_ITERS 10
+
+static
+unsigned long long
+now_us(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000 + ns / 1000;
+}
+
+/*
+ * Fork a child that runs CHILD (or just exits if it returns), then
+ * wait for it and check that it exited with status 0.
+ */
+static
+void
+spawn_and_wait(void (*child)(void))
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		if (child != NULL) {
+			child();
+		}
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "pid %d: unexpected exit status 0x%x", pid, status);
+	}
+}
+
+static
+void
+exec_true(void)
+{
+	char *args[2];
+
+	args[0] = (char *)"true";
+	args[1] = NULL;
+	execv("/bin/true", args);
+	err(1, "/bin/true");
+}
+
+static
+void
+report(const char *what, unsigned long long start, int iters)
+{
+	unsigned long long total = now_us() - start;
+
+	tprintf("%-24s %8llu us/iter (%d iters)\n", what,
+		total / iters, iters);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long long start;
+	int iters, i;
+
+	iters = DEFAULT_ITERS;
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+		if (iters <= 0) {
+			errx(1, "Usage: forkexecbench [iterations]");
+		}
+	}
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		(void)getpid();
+	}
+	report("getpid", start, iters);
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		spawn_and_wait(NULL);
+	}
+	report("fork+exit+wait", start, iters);
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		spawn_and_wait(exec_true);
+	}
+	report("fork+execv+wait", start, iters);
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/forkexecbench");
+	return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * futexbench - compare futex-based locks with semfs semaphores.
+ *
+ * Times P/V and lock/unlock with nobody else around, then two kinds
+ * of contention between processes: a ping-pong where each side waits
+ * for the other through a pair of semaphores, and several processes
+ * hammering one mutex to bump a shared counter (which is checked).
+ * Each is done with the libc futex locks, kept in a MAP_SHARED
+ * mapping, and with semfs ("sem:") semaphores, which cost a read or
+ * write system call per operation. Reports operations per second.
+ *
+ * Usage: futexbench [iterations]
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <futex.h>
+#include <test161/test161.h>
+
+#define DEFAULT_ITERS	2000
+#define NHAMMER		4	/* processes in the mutex test */
+#define PAGE		4096
+
+static const char *path = "futexbench.tmp";
+
+/* What lives in the shared page. */
+struct shared {
+	struct fmutex mutex;
+	struct fsem ping;
+	struct fsem pong;
+	volatile unsigned counter;
+};
+
+static struct shared *sh;
+
+static
+unsigned long long
+now_us(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000 + ns / 1000;
+}
+
+static
+void
+report(const char *what, unsigned long long start, unsigned ops)
+{
+	unsigned long long total = now_us() - start;
+
+	if (total == 0) {
+		total = 1;
+	}
+	tprintf("%-28s %10llu ops/sec (%u ops)\n", what,
+		(unsigned long long)ops * 1000000 / total, ops);
+}
+
+////////////////////////////////////////////////////////////
+// semfs semaphores
+
+static
+int
+semfs_create(const char *name, unsigned count)
+{
+	char c = 0;
+	unsigned i;
+	int fd;
+
+	fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", name);
+	}
+	for (i=0; i<count; i++) {
+		if (write(fd, &c, 1) != 1) {
+			err(1, "%s: write", name);
+		}
+	}
+	return fd;
+}
+
+static
+void
+semfs_P(int fd)
+{
+	char c;
+
+	if (read(fd, &c, 1) != 1) {
+		err(1, "semfs: read");
+	}
+}
+
+static
+void
+semfs_V(int fd)
+{
+	char c = 0;
+
+	if (write(fd, &c, 1) != 1) {
+		err(1, "semfs: write");
+	}
+}
+
+static
+void
+semfs_destroy(const char *name, int fd)
+{
+	close(fd);
+	(void)remove(name);
+}
+
+////////////////////////////////////////////////////////////
+// process handling
+
+static
+void
+dowait(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "pid %d: unexpected exit status 0x%x", pid, status);
+	}
+}
+
+static
+pid_t
+dofork(void)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	return pid;
+}
+
+////////////////////////////////////////////////////////////
+// tests
+
+static
+void
+uncontended(unsigned iters)
+{
+	unsigned long long start;
+	unsigned i;
+	int fd;
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		fmutex_lock(&sh->mutex);
+		fmutex_unlock(&sh->mutex);
+	}
+	report("fmutex lock+unlock", start, iters);
+
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		fsem_V(&sh->ping);
+		fsem_P(&sh->ping);
+	}
+	report("fsem V+P", start, iters);
+
+	fd = semfs_create("sem:futexbench.u", 0);
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		semfs_V(fd);
+		semfs_P(fd);
+	}
+	report("semfs V+P", start, iters);
+	semfs_destroy("sem:futexbench.u", fd);
+}
+
+static
+void
+pingpong(unsigned iters)
+{
+	unsigned long long start;
+	unsigned i;
+	int pingfd, pongfd;
+	pid_t pid;
+
+	fsem_init(&sh->ping, 0);
+	fsem_init(&sh->pong, 0);
+	start = now_us();
+	pid = dofork();
+	if (pid == 0) {
+		for (i=0; i<iters; i++) {
+			fsem_P(&sh->ping);
+			fsem_V(&sh->pong);
+		}
+		_exit(0);
+	}
+	for (i=0; i<iters; i++) {
+		fsem_V(&sh->ping);
+		fsem_P(&sh->pong);
+	}
+	dowait(pid);
+	report("fsem ping-pong round trips", start, iters);
+
+	pingfd = semfs_create("sem:futexbench.ping", 0);
+	pongfd = semfs_create("sem:futexbench.pong", 0);
+	start = now_us();
+	pid = dofork();
+	if (pid == 0) {
+		for (i=0; i<iters; i++) {
+			semfs_P(pingfd);
+			semfs_V(pongfd);
+		}
+		_exit(0);
+	}
+	for (i=0; i<iters; i++) {
+		semfs_V(pingfd);
+		semfs_P(pongfd);
+	}
+	dowait(pid);
+	report("semfs ping-pong round trips", start, iters);
+	semfs_destroy("sem:futexbench.ping", pingfd);
+	semfs_destroy("sem:futexbench.pong", pongfd);
+}
+
+static
+void
+hammer(unsigned iters)
+{
+	unsigned long long start;
+	pid_t pids[NHAMMER];
+	unsigned i, j;
+	int fd;
+
+	fmutex_init(&sh->mutex);
+	sh->counter = 0;
+	start = now_us();
+	for (j=0; j<NHAMMER; j++) {
+		pids[j] = dofork();
+		if (pids[j] == 0) {
+			for (i=0; i<iters; i++) {
+				fmutex_lock(&sh->mutex);
+				sh->counter++;
+				fmutex_unlock(&sh->mutex);
+			}
+			_exit(0);
+		}
+	}
+	for (j=0; j<NHAMMER; j++) {
+		dowait(pids[j]);
+	}
+	report("fmutex contended", start, NHAMMER * iters);
+	if (sh->counter != NHAMMER * iters) {
+		errx(1, "fmutex: counter is %u, expected %u",
+		     sh->counter, NHAMMER * iters);
+	}
+
+	sh->counter = 0;
+	fd = semfs_create("sem:futexbench.m", 1);
+	start = now_us();
+	for (j=0; j<NHAMMER; j++) {
+		pids[j] = dofork();
+		if (pids[j] == 0) {
+			for (i=0; i<iters; i++) {
+				semfs_P(fd);
+				sh->counter++;
+				semfs_V(fd);
+			}
+			_exit(0);
+		}
+	}
+	for (j=0; j<NHAMMER; j++) {
+		dowait(pids[j]);
+	}
+	report("semfs contended", start, NHAMMER * iters);
+	if (sh->counter != NHAMMER * iters) {
+		errx(1, "semfs: counter is %u, expected %u",
+		     sh->counter, NHAMMER * iters);
+	}
+	semfs_destroy("sem:futexbench.m", fd);
+}
+
+int
+main(int argc, char **argv)
+{
+	static char zeros[PAGE];
+	unsigned iters;
+	void *p;
+	int fd;
+
+	iters = DEFAULT_ITERS;
+	if (argc > 1) {
+		if (atoi(argv[1]) <= 0) {
+			errx(1, "Usage: futexbench [iterations]");
+		}
+		iters = atoi(argv[1]);
+	}
+
+	fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", path);
+	}
+	if (write(fd, zeros, PAGE) != PAGE) {
+		err(1, "%s: write", path);
+	}
+	p = mmap(NULL, PAGE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		err(1, "%s: mmap", path);
+	}
+	close(fd);
+	sh = p;
+	fmutex_init(&sh->mutex);
+	fsem_init(&sh->ping, 0);
+	fsem_init(&sh->pong, 0);
+
+	uncontended(iters);
+	pingpong(iters);
+	hammer(iters);
+
+	munmap(p, PAGE);
+	(void)remove(path);
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/futexbench");
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * launchbench - measure command launch rate with fork and vfork.
+ *
+ * Runs /bin/true many times through system(), first directly and
+ * then through the shell (sh -c), once with fork and once with
+ * vfork, and reports launches per second for each.
+ *
+ * Before timing anything, checks that a vfork child really does run
+ * in the parent's address space and that the parent waits for it.
+ *
+ * Usage: launchbench [iterations]
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define DEFAULT_ITERS 10
+
+/* Written by the vfork child; volatile so the parent rereads it. */
+static volatile int shared;
+
+static
+unsigned long long
+now_us(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000 + ns / 1000;
+}
+
+static
+void
+check_vfork(void)
+{
+	pid_t pid;
+	int status;
+
+	shared = 0;
+	pid = vfork();
+	if (pid < 0) {
+		err(1, "vfork");
+	}
+	if (pid == 0) {
+		shared = 1;
+		_exit(0);
+	}
+
+	/* The child has exited, so its store must be visible. */
+	if (shared != 1) {
+		errx(1, "vfork child did not share the address space");
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "pid %d: unexpected exit status 0x%x", pid, status);
+	}
+}
+
+static
+void
+launch(const char *what, const char *cmd, int usevfork, int iters)
+{
+	unsigned long long start, total;
+	int i, status;
+
+	__system_vfork = usevfork;
+	start = now_us();
+	for (i=0; i<iters; i++) {
+		status = system(cmd);
+		if (status < 0) {
+			err(1, "%s", cmd);
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "%s: unexpected exit status 0x%x",
+			     cmd, status);
+		}
+	}
+	total = now_us() - start;
+	if (total == 0) {
+		total = 1;
+	}
+
+	tprintf("%-20s %8llu us/launch %6llu launches/sec (%d iters)\n",
+		what, total / iters, iters * 1000000ULL / total, iters);
+}
+
+int
+main(int argc, char **argv)
+{
+	int iters;
+
+	iters = DEFAULT_ITERS;
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+		if (iters <= 0) {
+			errx(1, "Usage: launchbench [iterations]");
+		}
+	}
+
+	check_vfork();
+
+	launch("fork true", "/bin/true", 0, iters);
+	launch("vfork true", "/bin/true", 1, iters);
+	launch("fork sh -c true", "/bin/sh -c /bin/true", 0, iters);
+	launch("vfork sh -v -c true", "/bin/sh -v -c /bin/true", 1, iters);
+
+	__system_vfork = 0;
+	success(TEST161_SUCCESS, SECRET, "/testbin/launchbench");
+	return 0;
+}
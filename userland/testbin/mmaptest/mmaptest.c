@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * mmaptest.c
+ *
+ * 	Tests mmap, munmap, and msync on a regular file: shared
+ * 	mappings write through to the file, private mappings copy on
+ * 	write, both behave correctly across fork, and bad arguments
+ * 	are rejected. Then compares scanning the file with read()
+ * 	against scanning a mapping of it.
+ *
+ * This should run correctly when open, read, write, lseek, close,
+ * fork, waitpid, mmap, munmap, and msync are implemented correctly.
+ *
+ * Usage: mmaptest [file]
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define PAGE 4096
+/* Three and a bit pages, so the last page is partly past EOF */
+#define FILESIZE (3 * PAGE + 100)
+
+#define SCANSIZE (16 * PAGE)
+#define SCANITERS 16
+
+static const char *path = "mmaptest.tmp";
+static unsigned char buf[SCANSIZE];
+
+static
+unsigned char
+pattern(unsigned i)
+{
+	return (i * 7 + i / PAGE) & 0xff;
+}
+
+static
+unsigned long long
+now_us(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000 + ns / 1000;
+}
+
+/* Create PATH with SIZE bytes of the test pattern. */
+static
+void
+makefile(size_t size)
+{
+	unsigned i;
+	int fd;
+
+	for (i=0; i<size; i++) {
+		buf[i] = pattern(i);
+	}
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s: open", path);
+	}
+	if (write(fd, buf, size) != (ssize_t)size) {
+		err(1, "%s: write", path);
+	}
+	close(fd);
+}
+
+/* Read the byte at OFFSET in PATH with read(). */
+static
+unsigned char
+filebyte(off_t offset)
+{
+	unsigned char c;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s: open", path);
+	}
+	if (lseek(fd, offset, SEEK_SET) < 0) {
+		err(1, "%s: lseek", path);
+	}
+	if (read(fd, &c, 1) != 1) {
+		err(1, "%s: read", path);
+	}
+	close(fd);
+	return c;
+}
+
+static
+off_t
+filesize(void)
+{
+	off_t size;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s: open", path);
+	}
+	size = lseek(fd, 0, SEEK_END);
+	close(fd);
+	return size;
+}
+
+static
+unsigned char *
+domap(int fd, size_t len, int prot, int flags)
+{
+	void *p;
+
+	p = mmap(NULL, len, prot, flags, fd, 0);
+	if (p == MAP_FAILED) {
+		err(1, "mmap");
+	}
+	return p;
+}
+
+static
+void
+dowait(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+}
+
+static
+void
+test_contents(int fd)
+{
+	unsigned char *p;
+	unsigned i;
+
+	p = domap(fd, FILESIZE, PROT_READ, MAP_PRIVATE);
+	for (i=0; i<FILESIZE; i++) {
+		if (p[i] != pattern(i)) {
+			errx(1, "mapping: byte %u is %u, expected %u",
+			     i, p[i], pattern(i));
+		}
+	}
+	/* The rest of the last page reads as zeros */
+	for (; i<4 * PAGE; i++) {
+		if (p[i] != 0) {
+			errx(1, "mapping: byte %u past EOF is %u", i, p[i]);
+		}
+	}
+	if (munmap(p, FILESIZE) < 0) {
+		err(1, "munmap");
+	}
+	tprintf("contents ok\n");
+}
+
+static
+void
+test_shared(int fd)
+{
+	unsigned char *p;
+
+	p = domap(fd, FILESIZE, PROT_READ|PROT_WRITE, MAP_SHARED);
+	p[10] = 0xa5;
+	p[2 * PAGE + 1] = 0x5a;
+	/* Past EOF: must not extend the file */
+	p[FILESIZE + 1] = 1;
+
+	if (msync(p, FILESIZE, MS_SYNC) < 0) {
+		err(1, "msync");
+	}
+	if (filebyte(10) != 0xa5 || filebyte(2 * PAGE + 1) != 0x5a) {
+		errx(1, "shared: write not in file after msync");
+	}
+
+	/* Write again after msync; munmap must write it back too */
+	p[11] = 0x3c;
+	if (munmap(p, FILESIZE) < 0) {
+		err(1, "munmap");
+	}
+	if (filebyte(11) != 0x3c) {
+		errx(1, "shared: write not in file after munmap");
+	}
+	if (filesize() != FILESIZE) {
+		errx(1, "shared: file size changed to %ld",
+		     (long)filesize());
+	}
+	tprintf("shared ok\n");
+}
+
+static
+void
+test_private(int fd)
+{
+	unsigned char *priv, *shared;
+	unsigned char before;
+
+	before = filebyte(PAGE + 5);
+	priv = domap(fd, FILESIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE);
+	shared = domap(fd, FILESIZE, PROT_READ, MAP_SHARED);
+
+	priv[PAGE + 5] = before + 1;
+	if (shared[PAGE + 5] != before) {
+		errx(1, "private: write visible through shared mapping");
+	}
+	if (munmap(priv, FILESIZE) < 0 || munmap(shared, FILESIZE) < 0) {
+		err(1, "munmap");
+	}
+	if (filebyte(PAGE + 5) != before) {
+		errx(1, "private: write reached the file");
+	}
+	tprintf("private ok\n");
+}
+
+static
+void
+test_fork(int fd)
+{
+	unsigned char *priv, *shared;
+	pid_t pid;
+
+	shared = domap(fd, FILESIZE, PROT_READ|PROT_WRITE, MAP_SHARED);
+	priv = domap(fd, FILESIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE);
+	shared[20] = 1;
+	priv[20] = 2;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		if (shared[20] != 1 || priv[20] != 2) {
+			_exit(1);
+		}
+		shared[21] = 3;
+		priv[20] = 4;
+		_exit(0);
+	}
+	dowait(pid);
+
+	if (shared[21] != 3) {
+		errx(1, "fork: child's shared write not seen");
+	}
+	if (priv[20] != 2) {
+		errx(1, "fork: child's private write seen");
+	}
+	if (munmap(shared, FILESIZE) < 0 || munmap(priv, FILESIZE) < 0) {
+		err(1, "munmap");
+	}
+	tprintf("fork ok\n");
+}
+
+static
+void
+expect_error(void *p, int expected, const char *what)
+{
+	if (p != MAP_FAILED) {
+		errx(1, "%s: mmap succeeded", what);
+	}
+	if (errno != expected) {
+		err(1, "%s: wrong error", what);
+	}
+}
+
+static
+void
+test_errors(int fd)
+{
+	unsigned char *p;
+	int rofd;
+
+	expect_error(mmap(NULL, 0, PROT_READ, MAP_SHARED, fd, 0),
+		     EINVAL, "zero length");
+	expect_error(mmap(NULL, PAGE, PROT_READ, MAP_SHARED, fd, 1),
+		     EINVAL, "unaligned offset");
+	expect_error(mmap(NULL, PAGE, PROT_READ, MAP_SHARED|MAP_PRIVATE,
+			  fd, 0),
+		     EINVAL, "bad flags");
+	expect_error(mmap(NULL, PAGE, PROT_READ, MAP_SHARED, -1, 0),
+		     EBADF, "bad fd");
+
+	rofd = open(path, O_RDONLY);
+	if (rofd < 0) {
+		err(1, "%s: open", path);
+	}
+	expect_error(mmap(NULL, PAGE, PROT_READ|PROT_WRITE, MAP_SHARED,
+			  rofd, 0),
+		     EACCES, "shared write on read-only file");
+	/* A private writable mapping of a read-only file is fine */
+	p = domap(rofd, PAGE, PROT_READ|PROT_WRITE, MAP_PRIVATE);
+	p[0]++;
+	if (munmap(p, PAGE) < 0) {
+		err(1, "munmap");
+	}
+	close(rofd);
+
+	/* Can't unmap part of a mapping */
+	p = domap(fd, 2 * PAGE, PROT_READ, MAP_SHARED);
+	if (munmap(p, PAGE) == 0 || errno != EINVAL) {
+		errx(1, "partial munmap did not fail with EINVAL");
+	}
+	if (munmap(p, 2 * PAGE) < 0) {
+		err(1, "munmap");
+	}
+	tprintf("errors ok\n");
+}
+
+static
+void
+bench(void)
+{
+	unsigned long long start, readtime, maptime;
+	unsigned long sum1, sum2;
+	unsigned char *p;
+	unsigned i, j;
+	int fd;
+
+	makefile(SCANSIZE);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s: open", path);
+	}
+
+	sum1 = 0;
+	start = now_us();
+	for (i=0; i<SCANITERS; i++) {
+		if (lseek(fd, 0, SEEK_SET) < 0) {
+			err(1, "lseek");
+		}
+		if (read(fd, buf, SCANSIZE) != SCANSIZE) {
+			err(1, "read");
+		}
+		for (j=0; j<SCANSIZE; j++) {
+			sum1 += buf[j];
+		}
+	}
+	readtime = now_us() - start;
+
+	sum2 = 0;
+	start = now_us();
+	for (i=0; i<SCANITERS; i++) {
+		p = domap(fd, SCANSIZE, PROT_READ, MAP_PRIVATE);
+		for (j=0; j<SCANSIZE; j++) {
+			sum2 += p[j];
+		}
+		if (munmap(p, SCANSIZE) < 0) {
+			err(1, "munmap");
+		}
+	}
+	maptime = now_us() - start;
+	close(fd);
+
+	if (sum1 != sum2) {
+		errx(1, "bench: checksums differ");
+	}
+	tprintf("scan %d bytes: read %llu us, mmap %llu us (%d iters)\n",
+		SCANSIZE, readtime / SCANITERS, maptime / SCANITERS,
+		SCANITERS);
+}
+
+int
+main(int argc, char **argv)
+{
+	int fd;
+
+	if (argc > 1) {
+		path = argv[1];
+	}
+
+	makefile(FILESIZE);
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		err(1, "%s: open", path);
+	}
+
+	test_contents(fd);
+	test_shared(fd);
+	test_private(fd);
+	test_fork(fd);
+	test_errors(fd);
+	close(fd);
+
+	bench();
+	remove(path);
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/mmaptest");
+	return 0;
+}
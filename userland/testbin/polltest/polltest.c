@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * polltest.c
+ *
+ * 	Tests poll() and select() on pipes: readiness, hangup, timeouts,
+ * 	and bad file handles.
+ *
+ * This should run correctly when pipe, read, write, close, poll, and
+ * select are implemented correctly.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define TIMEOUT_MS 200
+
+/* Milliseconds since some point in the past. */
+static
+unsigned long long
+now_ms(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000 + ns / 1000000;
+}
+
+/* Poll a single handle and return its revents. */
+static
+int
+poll1(int fd, int events, int timeout, int expectready)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	ret = poll(&pfd, 1, timeout);
+	if (ret < 0) {
+		err(1, "poll");
+	}
+	if (ret != expectready) {
+		errx(1, "poll on fd %d returned %d, expected %d",
+		     fd, ret, expectready);
+	}
+	return pfd.revents;
+}
+
+static
+void
+test_poll(int rfd, int wfd)
+{
+	char buf[16];
+	unsigned long long start, elapsed;
+	int rev;
+
+	/* Empty pipe: not readable, but writable */
+	rev = poll1(rfd, POLLIN, 0, 0);
+	rev = poll1(wfd, POLLOUT, 0, 1);
+	if (rev != POLLOUT) {
+		errx(1, "Empty pipe write end: revents 0x%x", rev);
+	}
+
+	/* Timeout should expire, and not much early */
+	start = now_ms();
+	poll1(rfd, POLLIN, TIMEOUT_MS, 0);
+	elapsed = now_ms() - start;
+	if (elapsed < TIMEOUT_MS / 2) {
+		errx(1, "poll timed out after %llu ms, expected %d",
+		     elapsed, TIMEOUT_MS);
+	}
+
+	/* Data makes the read end readable */
+	if (write(wfd, "hello", 5) != 5) {
+		err(1, "write");
+	}
+	rev = poll1(rfd, POLLIN, -1, 1);
+	if (rev != POLLIN) {
+		errx(1, "Readable pipe: revents 0x%x", rev);
+	}
+	if (read(rfd, buf, sizeof(buf)) != 5 || memcmp(buf, "hello", 5)) {
+		errx(1, "Wrong data read from pipe");
+	}
+	poll1(rfd, POLLIN, 0, 0);
+}
+
+static
+void
+test_select(int rfd, int wfd)
+{
+	fd_set rset, wset;
+	struct timeval tv;
+	char ch;
+	int ret;
+
+	FD_ZERO(&rset);
+	FD_ZERO(&wset);
+	FD_SET(rfd, &rset);
+	FD_SET(wfd, &wset);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	ret = select(wfd + 1, &rset, &wset, NULL, &tv);
+	if (ret != 1 || FD_ISSET(rfd, &rset) || !FD_ISSET(wfd, &wset)) {
+		errx(1, "select on empty pipe returned %d", ret);
+	}
+
+	if (write(wfd, "x", 1) != 1) {
+		err(1, "write");
+	}
+	FD_ZERO(&rset);
+	FD_SET(rfd, &rset);
+	ret = select(rfd + 1, &rset, NULL, NULL, NULL);
+	if (ret != 1 || !FD_ISSET(rfd, &rset)) {
+		errx(1, "select on readable pipe returned %d", ret);
+	}
+	if (read(rfd, &ch, 1) != 1 || ch != 'x') {
+		errx(1, "Wrong data read from pipe");
+	}
+}
+
+static
+void
+test_hangup_and_badfd(int rfd, int wfd)
+{
+	struct pollfd pfds[2];
+	fd_set rset;
+	int rev, ret;
+
+	close(wfd);
+	rev = poll1(rfd, POLLIN, -1, 1);
+	if ((rev & POLLHUP) == 0) {
+		errx(1, "Pipe with no writer: revents 0x%x", rev);
+	}
+
+	/* Negative handles are ignored; closed ones are POLLNVAL */
+	pfds[0].fd = -1;
+	pfds[0].events = POLLIN;
+	pfds[1].fd = wfd;
+	pfds[1].events = POLLIN;
+	ret = poll(pfds, 2, 0);
+	if (ret != 1 || pfds[0].revents != 0 || pfds[1].revents != POLLNVAL) {
+		errx(1, "poll with bad handles returned %d", ret);
+	}
+
+	FD_ZERO(&rset);
+	FD_SET(wfd, &rset);
+	ret = select(wfd + 1, &rset, NULL, NULL, NULL);
+	if (ret != -1 || errno != EBADF) {
+		errx(1, "select on closed handle returned %d", ret);
+	}
+
+	close(rfd);
+}
+
+int
+main(int argc, char **argv)
+{
+	int fds[2];
+
+	(void)argc;
+	(void)argv;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+
+	test_poll(fds[0], fds[1]);
+	test_select(fds[0], fds[1]);
+	test_hangup_and_badfd(fds[0], fds[1]);
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/polltest");
+	return 0;
+}
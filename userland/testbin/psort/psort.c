@@ -39,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -58,6 +59,9 @@
 #define PATH_TESTDIR "psortdir"
 #define PATH_RANDOM  "rand:"
 
+/* mmap offsets must be page-aligned */
+#define MAP_ALIGN    4096
+
 /*
  * Workload sizing.
  *
@@ -120,6 +124,9 @@ static long randomseed = 15432753;
 static off_t correctsize;
 static unsigned long checksum;
 
+/* Set by -m: map the key and bin files instead of reading them */
+static int usemmap = 0;
+
 #define NOBODY (-1)
 static int me = NOBODY;
 
@@ -422,6 +429,40 @@ dolseek(const char *name, int fd, off_t offset, int whence)
 	}
 }
 
+/*
+ * Map LEN bytes of FD starting at OFFSET, which need not be aligned.
+ * Hands back the start of the mapping (for dounmap) in *MAPPING and
+ * returns a pointer to OFFSET within it.
+ */
+static
+void *
+domap(const char *name, int fd, off_t offset, size_t len, int prot,
+      int flags, void **mapping, size_t *maplen)
+{
+	off_t base;
+	void *p;
+
+	base = offset - offset % MAP_ALIGN;
+	*maplen = len + (offset - base);
+	p = mmap(NULL, *maplen, prot, flags, fd, base);
+	if (p == MAP_FAILED) {
+		complain("%s: mmap", name);
+		exit(1);
+	}
+	*mapping = p;
+	return (char *)p + (offset - base);
+}
+
+static
+void
+dounmap(const char *name, void *mapping, size_t maplen)
+{
+	if (munmap(mapping, maplen) < 0) {
+		complain("%s: munmap", name);
+		exit(1);
+	}
+}
+
 #if 0 /* let's not require subdirs */
 static
 void
@@ -518,17 +559,21 @@ doforkall(const char *phasename, void (*func)(void))
 }
 
 static
-void
-seekmyplace(const char *name, int fd)
+off_t
+getmyplace(void)
 {
 	int keys_per, myfirst;
-	off_t offset;
 
 	keys_per = numkeys / numprocs;
 	myfirst = me*keys_per;
-	offset = myfirst * sizeof(int);
+	return myfirst * sizeof(int);
+}
 
-	dolseek(name, fd, offset, SEEK_SET);
+static
+void
+seekmyplace(const char *name, int fd)
+{
+	dolseek(name, fd, getmyplace(), SEEK_SET);
 }
 
 static
@@ -675,11 +720,23 @@ bin(void)
 	const char *name;
 	int i, mykeys, keys_done, keys_to_do;
 	int key, pivot, binnum;
+	const int *keys, *batch;
+	void *mapping = NULL;
+	size_t maplen = 0;
 
 	infd = doopen(PATH_KEYS, O_RDONLY, 0);
 
 	mykeys = getmykeys();
-	seekmyplace(PATH_KEYS, infd);
+	keys = NULL;
+	if (usemmap && mykeys > 0) {
+		/* Read the keys in place rather than copying them */
+		keys = domap(PATH_KEYS, infd, getmyplace(),
+			     mykeys * sizeof(int), PROT_READ, MAP_PRIVATE,
+			     &mapping, &maplen);
+	}
+	else {
+		seekmyplace(PATH_KEYS, infd);
+	}
 
 	for (i=0; i<numprocs; i++) {
 		name = binname(me, i);
@@ -695,11 +752,17 @@ bin(void)
 			keys_to_do = WORKNUM;
 		}
 
-		doexactread(PATH_KEYS, infd, workspace,
-			    keys_to_do * sizeof(int));
+		if (usemmap) {
+			batch = keys + keys_done;
+		}
+		else {
+			doexactread(PATH_KEYS, infd, workspace,
+				    keys_to_do * sizeof(int));
+			batch = workspace;
+		}
 
 		for (i=0; i<keys_to_do; i++) {
-			key = workspace[i];
+			key = batch[i];
 
 			binnum = key / pivot;
 			if (key <= 0) {
@@ -713,6 +776,9 @@ bin(void)
 
 		keys_done += keys_to_do;
 	}
+	if (mapping != NULL) {
+		dounmap(PATH_KEYS, mapping, maplen);
+	}
 	doclose(PATH_KEYS, infd);
 
 	for (i=0; i<numprocs; i++) {
@@ -742,6 +808,20 @@ sortbins(void)
 		}
 
 		fd = doopen(name, O_RDWR, 0);
+		if (usemmap && binsize > 0) {
+			/* Sort in place; munmap writes it back */
+			void *mapping;
+			size_t maplen;
+			int *bin;
+
+			bin = domap(name, fd, 0, binsize,
+				    PROT_READ|PROT_WRITE, MAP_SHARED,
+				    &mapping, &maplen);
+			sortints(bin, binsize/sizeof(int));
+			dounmap(name, mapping, maplen);
+			doclose(name, fd);
+			continue;
+		}
 		doexactread(name, fd, workspace, binsize);
 
 		sortints(workspace, binsize/sizeof(int));
@@ -1152,7 +1232,8 @@ static
 void
 usage(void)
 {
-	complain("Usage: %s [-p procs] [-k keys] [-s seed] [-r]", progname);
+	complain("Usage: %s [-p procs] [-k keys] [-s seed] [-r] [-m]",
+		 progname);
 	exit(1);
 }
 
@@ -1173,6 +1254,7 @@ doargs(int argc, char *argv[])
 		    case 'k': arg = 1; break;
 		    case 's': arg = 1; break;
 		    case 'r': arg = 0; break;
+		    case 'm': arg = 0; break;
 		    default: usage(); return;
 		}
 		if (arg) {
@@ -1198,6 +1280,7 @@ doargs(int argc, char *argv[])
 		else {
 			switch (ch) {
 			    case 'r': randomize(); break;
+			    case 'm': usemmap = 1; break;
 			    default: assert(0); break;
 			}
 		}
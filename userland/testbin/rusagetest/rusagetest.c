@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * rusagetest.c
+ *
+ * 	Tests getrusage: user time goes up while we compute, system
+ * 	time while we make system calls, a child's usage shows up
+ * 	under RUSAGE_CHILDREN once it has been waited for, and bad
+ * 	arguments are rejected.
+ *
+ * This should run correctly when fork, waitpid, _exit, getpid and
+ * getrusage are implemented correctly.
+ */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define SPINS 2000000
+#define CALLS 20000
+
+static volatile unsigned sink;
+
+static
+unsigned long long
+tv_us(const struct timeval *tv)
+{
+	return (unsigned long long)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static
+void
+get(int who, struct rusage *ru)
+{
+	if (getrusage(who, ru) < 0) {
+		err(1, "getrusage(%d)", who);
+	}
+}
+
+static
+void
+show(const char *what, const struct rusage *ru)
+{
+	tprintf("%s: user %llu us, sys %llu us, %lu/%lu switches, "
+		"%lu/%lu faults\n", what,
+		tv_us(&ru->ru_utime), tv_us(&ru->ru_stime),
+		(unsigned long)ru->ru_nvcsw, (unsigned long)ru->ru_nivcsw,
+		(unsigned long)ru->ru_minflt, (unsigned long)ru->ru_majflt);
+}
+
+/* Burn user time. */
+static
+void
+spin(void)
+{
+	unsigned i;
+
+	for (i=0; i<SPINS; i++) {
+		sink += i;
+	}
+}
+
+/* Burn system time. */
+static
+void
+calls(void)
+{
+	unsigned i;
+
+	for (i=0; i<CALLS; i++) {
+		sink += getpid();
+	}
+}
+
+static
+void
+test_self(void)
+{
+	struct rusage before, after;
+
+	get(RUSAGE_SELF, &before);
+	spin();
+	get(RUSAGE_SELF, &after);
+	show("after spinning", &after);
+	if (tv_us(&after.ru_utime) <= tv_us(&before.ru_utime)) {
+		errx(1, "User time did not go up while spinning");
+	}
+
+	get(RUSAGE_SELF, &before);
+	calls();
+	get(RUSAGE_SELF, &after);
+	show("after system calls", &after);
+	if (tv_us(&after.ru_stime) <= tv_us(&before.ru_stime)) {
+		errx(1, "System time did not go up during system calls");
+	}
+	if (after.ru_minflt + after.ru_majflt == 0) {
+		errx(1, "No page faults counted; we must have had some");
+	}
+}
+
+static
+void
+test_children(void)
+{
+	struct rusage before, after;
+	pid_t pid;
+	int status;
+
+	get(RUSAGE_CHILDREN, &before);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		spin();
+		_exit(0);
+	}
+
+	/* Not collected yet, so not counted yet */
+	get(RUSAGE_CHILDREN, &after);
+	if (tv_us(&after.ru_utime) != tv_us(&before.ru_utime)) {
+		errx(1, "Child counted before it was waited for");
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "Child failed");
+	}
+
+	get(RUSAGE_CHILDREN, &after);
+	show("children", &after);
+	if (tv_us(&after.ru_utime) <= tv_us(&before.ru_utime)) {
+		errx(1, "Child's user time not counted");
+	}
+
+	/* Waiting for the child blocked us at least once */
+	get(RUSAGE_SELF, &after);
+	if (after.ru_nvcsw == 0) {
+		errx(1, "No voluntary context switches counted");
+	}
+}
+
+static
+void
+test_errors(void)
+{
+	struct rusage ru;
+
+	if (getrusage(12345, &ru) == 0 || errno != EINVAL) {
+		errx(1, "getrusage with bad who: expected EINVAL");
+	}
+	if (getrusage(RUSAGE_SELF, (struct rusage *)0x40000000) == 0 ||
+	    errno != EFAULT) {
+		errx(1, "getrusage with bad pointer: expected EFAULT");
+	}
+	if (getrusage(RUSAGE_SELF, NULL) == 0 || errno != EFAULT) {
+		errx(1, "getrusage with NULL pointer: expected EFAULT");
+	}
+}
+
+int
+main(void)
+{
+	test_self();
+	test_children();
+	test_errors();
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/rusagetest");
+	return 0;
+}
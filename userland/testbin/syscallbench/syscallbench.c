@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * syscallbench - time null system calls.
+ *
+ * Times getpid, whose register-only arguments let the kernel skip
+ * the argument fetch, against __time, close(-1) and getrusage,
+ * which go through the full dispatcher. Reports the time per call.
+ *
+ * Usage: syscallbench [iterations]
+ */
+
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define DEFAULT_ITERS	20000
+
+static
+unsigned long long
+now_ns(void)
+{
+	time_t sec;
+	unsigned long ns;
+
+	__time(&sec, &ns);
+	return (unsigned long long)sec * 1000000000 + ns;
+}
+
+static
+void
+report(const char *what, unsigned long long start, unsigned iters)
+{
+	unsigned long long total = now_ns() - start;
+
+	tprintf("%-24s %8llu ns/call (%u calls)\n", what, total / iters,
+		iters);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long long start;
+	struct rusage ru;
+	time_t sec;
+	unsigned long ns;
+	unsigned i, iters;
+
+	iters = DEFAULT_ITERS;
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+		if (iters == 0) {
+			errx(1, "Usage: syscallbench [iterations]");
+		}
+	}
+
+	start = now_ns();
+	for (i=0; i<iters; i++) {
+		(void)getpid();
+	}
+	report("getpid (no arg fetch)", start, iters);
+
+	start = now_ns();
+	for (i=0; i<iters; i++) {
+		__time(&sec, &ns);
+	}
+	report("__time", start, iters);
+
+	start = now_ns();
+	for (i=0; i<iters; i++) {
+		if (close(-1) == 0) {
+			errx(1, "close(-1) succeeded");
+		}
+	}
+	report("close(-1)", start, iters);
+
+	start = now_ns();
+	for (i=0; i<iters; i++) {
+		if (getrusage(RUSAGE_SELF, &ru) < 0) {
+			err(1, "getrusage");
+		}
+	}
+	report("getrusage", start, iters);
+
+	success(TEST161_SUCCESS, SECRET, "/testbin/syscallbench");
+	return 0;
+}